@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Builds recordgen first, then every calculator and StackupTool
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+CONFIG   += ordered
+
+SUBDIRS = recordgen\
+		motherboard\
+		coldshield\
+		coldfilter\
+		stackup
+
+recordgen.file = recordgen/RecordGen.pro
+motherboard.file = motherboard/MotherboardMount.pro
+coldshield.file = coldshield/ColdshieldMount.pro
+coldfilter.file = coldfilter/ColdfilterMount.pro
+stackup.file = stackup/StackupTool.pro
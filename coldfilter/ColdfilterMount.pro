@@ -6,24 +6,63 @@
 
 QT       += core gui network
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = ColdfilterMount
 TEMPLATE = app
 
+# StartupTrace reads the working set with GetProcessMemoryInfo()
+win32: LIBS += -lpsapi
+
 
 SOURCES += main.cpp\
         mountcf.cpp\
 		viewbuilddata.cpp\
-		proteuslookup.cpp
+		proteuslookup.cpp\
+		phrcache.cpp\
+		phrreply.cpp\
+		proteusclient.cpp\
+		phrprefetch.cpp\
+		stackupcalc.cpp\
+		buildarchive.cpp\
+		recordparser.cpp\
+		buildrecordio.cpp\
+		spcstats.cpp\
+		summaryindex.cpp\
+		recordwatcher.cpp\
+		calcserviceclient.cpp\
+		startuptrace.cpp\
+		recordloader.cpp\
+		builddatamodel.cpp\
+		historybrowser.cpp\
+		recordquery.cpp
 
 HEADERS  += mountcf.h\
 		viewbuilddata.h\
-		proteuslookup.h
+		proteuslookup.h\
+		phrcache.h\
+		phrreply.h\
+		proteusclient.h\
+		phrprefetch.h\
+		stackupcalc.h\
+		buildarchive.h\
+		recordparser.h\
+		buildrecordio.h\
+		spcstats.h\
+		summaryindex.h\
+		recordwatcher.h\
+		calcserviceclient.h\
+		startuptrace.h\
+		recordloader.h\
+		builddatamodel.h\
+		historybrowser.h\
+		recordquery.h
 
 FORMS    += mountcf.ui\
-		viewbuilddata.ui\
-		proteuslookup.ui
+		viewbuilddata.ui
 
 RESOURCES += \
     res.qrc
+
+# buildrecord.h is generated from control/saveTemplate.csv
+include(../recordgen/buildrecord.pri)
@@ -0,0 +1,1085 @@
+/* BuildArchive class is shared code used by the calculators and StackupTool to keep every build
+ * record in a single file, control/archive.dat, instead of one control/<ctrl>.csv per dewar.
+ * The bytes stored for a record are exactly what saveData() used to write to the .csv, so the
+ * load/save code in each calculator parses them the same way it always has.
+ *
+ * File layout, all integers little-endian:
+ *   header   magic "N177ARC1", version, slot count, record count, delta count, end of data
+ *   slots    slot count x (control number, offset of newest record), open addressing
+ *   records  appended, each (control number, length, checksum) followed by the record text
+ *   deltas   appended the same way with the top bit of length set, followed by the offset of the
+ *            copy they change and one "line<tab>text" line per record line that changed
+ * A lookup hashes the 10-digit control number into the slot table and probes linearly, so it
+ * costs one or two slot reads and one record read no matter how many dewars are stored.
+ *
+ * read() and contains() map the file, look the record up, and unmap again, so a station never
+ * holds the file open on the share between operations.  map() keeps the archive mapped for
+ * batches of reads, e.g. StackupTool.  read() does not touch errorString(), so it is safe to
+ * call from several threads once the archive is mapped.
+ *
+ * write() appends the new record, then the header, then the slot, so a reader never sees a slot
+ * pointing past the end of data.  When the record has the same lines as the archive's copy, only
+ * the changed lines are appended, as a delta on that copy; a coldfilter calc2 save is then a
+ * couple of hundred bytes instead of the whole record, and nothing already written is touched.
+ * read() follows a delta back to its full copy and applies the deltas in order, checking each
+ * one's checksum.  A record is written out in full again once it is maxDeltaChain deltas deep,
+ * so a read never chains far.  Writers on different stations are serialized by
+ * control/archive.dat.lock, a directory because mkdir is atomic on the share.  The lock holds a
+ * heartbeat file naming its owner with a beat that heartbeat() raises every few seconds through a
+ * rebuild, a journal batch or an import, however long they take on the share.  A lock whose
+ * heartbeat a waiting station has seen unchanged for a minute, timed by that station's own clock,
+ * is assumed to belong to a crashed station; it is renamed aside and removed, and only the
+ * station whose rename succeeded goes straight for the lock.
+ *
+ * Saves go through a journal, control/archive.dat.journal, so stations saving at once don't queue
+ * up on the archive lock.  write() appends the record to the journal under its own short lock
+ * and syncs it to disk (fsync, FlushFileBuffers on Windows) before it returns, so a returned save
+ * survives the station crashing; on a share that is only as good as the server honors the sync.
+ * The journal is not reread for each save: archive.dat.saves keeps where its last whole entry
+ * ends, and a save only parses what lies past that, normally nothing, cutting off a torn entry
+ * left by a station that died mid-append.  Then whichever station gets the
+ * archive lock without waiting applies everything journaled so far, its own save and any other
+ * station's, as one batch.  The journal is renamed to .journal.applying under the journal lock
+ * first, so saves keep landing in a fresh journal while the batch goes in, and the applying
+ * file is removed once the archive has it all.
+ * A station that finds the archive busy leaves its entry for that batch or the next one.
+ * replayJournal() applies whatever is left, e.g. after a crash; the calculators call it at startup.
+ * A torn entry at the end of a journal fails its checksum and is skipped until a save cuts it off.
+ * read(), contains() and controls() look in the journal before the archive, so once write() has
+ * returned, every station reads the new record.  setJournaled(false) writes straight to the
+ * archive as before.
+ *
+ * rebuild() rewrites only the newest copy of each record, merged, which both grows the slot table
+ * when it gets crowded and drops superseded records and deltas.  The new copy is written to
+ * archive.dat.tmp; then archive.dat is renamed to .old, .tmp is renamed into its place and .old is
+ * removed, so archive.dat is never deleted before its replacement is complete.  Readers don't take
+ * the lock, and on Windows a file another station has open or mapped can't be renamed, so each
+ * rename is retried for about a second.  If archive.dat is still held, e.g. mapped by a StackupTool
+ * batch, rebuild() fails with the archive untouched and says so; the deltas are still there, so
+ * the next station to apply a save finds compaction due and tries again.  A reader that finds no
+ * archive.dat while .old exists waits out the moment between the renames.  A station that stops
+ * between the two renames leaves no archive.dat; restoreLocked() puts .tmp (or failing that .old)
+ * back before the next write, replayJournal() or map().  compact() runs it on demand, and
+ * wantsCompaction() tells a station that compactAfterDeltas deltas have been written since, so it
+ * can run compactPath() in the background.  remove() deletes an archive and all of its files.
+ *
+ * importDirectory() loads existing control/<ctrl>.csv files into the archive, skipping any control
+ * number the archive already holds since that copy was saved later.
+ *
+ * generation() counts the saves and imports the archive has taken, kept in archive.dat.saves ahead
+ * of the journal's end and raised under the journal lock.  Applying the journal, compaction and
+ * rebuild() move records without changing what a read returns, so they leave it alone;
+ * SummaryIndex compares it to tell whether it has missed a save.  watchPaths() lists the files a
+ * save changes, for a station that follows another's saves.
+*/
+
+#include "buildarchive.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThread>
+#include <QtEndian>
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QAtomicInt>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char archiveMagic[8] = { 'N', '1', '7', '7', 'A', 'R', 'C', '1' };
+// version 2 adds deltas, an older station refuses the archive rather than misread one
+static const quint32 archiveVersion = 2;
+static const qint64 headerSize = 32;
+static const qint64 slotSize = 16;
+static const qint64 recordHeaderSize = 16;
+static const quint32 initialSlots = 65536;
+static const quint32 deltaFlag = 0x80000000u;
+static const int maxDeltaChain = 8;
+static const quint32 compactAfterDeltas = 1000;
+
+// QThread::msleep() is protected in Qt 4
+class ArchiveSleep : public QThread
+{
+public:
+    static void msleep( unsigned long ms ) { QThread::msleep(ms); }
+};
+
+// a lock holds a heartbeat file, "pid host beat", that its owner rewrites through long operations,
+// raising the beat each time, so no two heartbeats are alike.  a waiter takes the owner for dead
+// once the heartbeat has not changed for a minute by the waiter's own clock, which neither the
+// share's file times nor another station's clock come into.  the directory of an owner that died
+// before writing one reads as an empty heartbeat and goes stale the same way
+struct LockSighting {
+    QByteArray heartbeat;
+    QElapsedTimer since;
+};
+
+static QMutex sightingMutex;
+static QHash <QString, LockSighting> sightings;
+static QAtomicInt beats;
+
+static QByteArray readHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (!beat.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return beat.readAll();
+}
+
+static QString lockOwner() {
+    return QString("%1 %2").arg(QCoreApplication::applicationPid()).arg(QHostInfo::localHostName());
+}
+
+static bool lockIsStale( const QString &lockPath, QByteArray &heartbeat ) {
+    heartbeat = readHeartbeat(lockPath);
+    if (!QFileInfo(lockPath).exists())
+        return false;
+    QMutexLocker locker(&sightingMutex);
+    if (!sightings.contains(lockPath) || sightings[lockPath].heartbeat != heartbeat) {
+        LockSighting &seen = sightings[lockPath];
+        seen.heartbeat = heartbeat;
+        seen.since.start();
+        return false;
+    }
+    return sightings[lockPath].since.elapsed() > 60000;
+}
+
+static void writeHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (beat.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        beat.write((lockOwner() + QString(" %1\n").arg(beats.fetchAndAddOrdered(1) + 1)).toUtf8());
+}
+
+static void removeLock( const QString &lockPath ) {
+    QFile::remove(lockPath + "/heartbeat");
+    QDir().rmdir(lockPath);
+}
+
+// a stale lock is renamed aside before it is removed: of the stations that found it stale, the one
+// whose rename succeeds breaks it and tries for the lock at once, the others go on waiting.  a lock
+// that was taken afresh just before the rename has another heartbeat and is put back
+static bool breakLock( const QString &lockPath, const QByteArray &stale ) {
+    QString aside = lockPath + ".broken." + lockOwner().replace(' ', '.') + "."
+            + QString::number(beats.fetchAndAddOrdered(1) + 1);
+    if (readHeartbeat(lockPath) != stale || !QDir().rename(lockPath, aside))
+        return false;
+    if (readHeartbeat(aside) != stale) {
+        QDir().rename(aside, lockPath);
+        return false;
+    }
+    removeLock(aside);
+    QMutexLocker locker(&sightingMutex);
+    sightings.remove(lockPath);
+    return true;
+}
+
+struct ArchiveHeader {
+    quint32 slotCount;
+    quint32 recordCount;
+    quint32 deltaCount;
+    quint64 dataEnd;
+};
+
+static bool parseHeader( const uchar *data, qint64 size, ArchiveHeader &header ) {
+    // version 1 archives have no deltas and a zero delta count
+    quint32 version = size < headerSize ? 0 : qFromLittleEndian<quint32>(data + 8);
+    if (size < headerSize || memcmp(data, archiveMagic, 8) != 0
+            || version < 1 || version > archiveVersion)
+        return false;
+    header.slotCount = qFromLittleEndian<quint32>(data + 12);
+    header.recordCount = qFromLittleEndian<quint32>(data + 16);
+    header.deltaCount = qFromLittleEndian<quint32>(data + 20);
+    header.dataEnd = qFromLittleEndian<quint64>(data + 24);
+    // slot count must be a power of two for the probe mask
+    if (header.slotCount == 0 || (header.slotCount & (header.slotCount - 1)) != 0
+            || headerSize + qint64(header.slotCount) * slotSize > size
+            || qint64(header.dataEnd) > size)
+        return false;
+    return true;
+}
+
+static QByteArray headerBytes( const ArchiveHeader &header ) {
+    QByteArray bytes(headerSize, '\0');
+    uchar *data = reinterpret_cast<uchar *>(bytes.data());
+    memcpy(data, archiveMagic, 8);
+    qToLittleEndian<quint32>(archiveVersion, data + 8);
+    qToLittleEndian<quint32>(header.slotCount, data + 12);
+    qToLittleEndian<quint32>(header.recordCount, data + 16);
+    qToLittleEndian<quint32>(header.deltaCount, data + 20);
+    qToLittleEndian<quint64>(header.dataEnd, data + 24);
+    return bytes;
+}
+
+static quint64 controlKey( const QString &control ) {
+    // control numbers are 10 digits, 0 marks an empty slot
+    bool ok;
+    quint64 key = control.toULongLong(&ok);
+    return ok ? key : 0;
+}
+
+static QString controlText( quint64 key ) {
+    return QString("%1").arg(key, 10, 10, QChar('0'));
+}
+
+static quint32 homeSlot( quint64 key, quint32 slotCount ) {
+    // fibonacci hashing spreads sequential control numbers across the table
+    return quint32((key * Q_UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (slotCount - 1);
+}
+
+static qint64 probe( const uchar *slots, quint32 slotCount, quint64 key, bool &found ) {
+    // returns the slot holding key, or the empty slot where it belongs
+    quint32 mask = slotCount - 1;
+    quint32 index = homeSlot(key, slotCount);
+    for (quint32 i = 0; i < slotCount; i++, index = (index + 1) & mask) {
+        quint64 slotKey = qFromLittleEndian<quint64>(slots + qint64(index) * slotSize);
+        if (slotKey == key || slotKey == 0) {
+            found = slotKey == key;
+            return index;
+        }
+    }
+    found = false;
+    return -1;
+}
+
+static QByteArray joinLines( const QList <QByteArray> &lines ) {
+    QByteArray text;
+    for (int i = 0; i < lines.size(); i++) {
+        if (i)
+            text += '\n';
+        text += lines[i];
+    }
+    return text;
+}
+
+// the lines of record that differ from base, false when the two don't line up line for line
+static bool makeDelta( const QByteArray &base, const QByteArray &record, QByteArray &delta ) {
+    QList <QByteArray> from = base.split('\n');
+    QList <QByteArray> to = record.split('\n');
+    if (from.size() != to.size())
+        return false;
+    delta.clear();
+    for (int i = 0; i < to.size(); i++) {
+        if (from[i] != to[i])
+            delta += QByteArray::number(i) + '\t' + to[i] + '\n';
+    }
+    return true;
+}
+
+static bool applyDelta( QByteArray &record, const QByteArray &delta ) {
+    QList <QByteArray> lines = record.split('\n');
+    QList <QByteArray> changes = delta.split('\n');
+    // the last change ends in a newline, leaving an empty entry
+    for (int i = 0; i + 1 < changes.size(); i++) {
+        int tab = changes[i].indexOf('\t');
+        bool ok;
+        int line = changes[i].left(tab).toInt(&ok);
+        if (tab < 0 || !ok || line < 0 || line >= lines.size())
+            return false;
+        lines[line] = changes[i].mid(tab + 1);
+    }
+    record = joinLines(lines);
+    return true;
+}
+
+// one stored copy as written: a full record, or a delta on the copy at base
+static bool entryAt( const uchar *data, qint64 size, quint64 offset, quint64 key, QByteArray &text,
+                     quint64 *base ) {
+    if (qint64(offset) + recordHeaderSize > size)
+        return false;
+    const uchar *head = data + offset;
+    quint32 length = qFromLittleEndian<quint32>(head + 8);
+    quint32 checksum = qFromLittleEndian<quint32>(head + 12);
+    bool delta = length & deltaFlag;
+    length &= ~deltaFlag;
+    if (qFromLittleEndian<quint64>(head) != key || qint64(offset) + recordHeaderSize + length > size
+            || (delta && length < 8))
+        return false;
+    const char *payload = reinterpret_cast<const char *>(head + recordHeaderSize);
+    if (qChecksum(payload, length) != checksum)
+        return false;
+    *base = 0;
+    if (delta) {
+        *base = qFromLittleEndian<quint64>(head + recordHeaderSize);
+        // a delta only ever refers back, anything else is damage
+        if (*base >= offset)
+            return false;
+        payload += 8;
+        length -= 8;
+    }
+    text = QByteArray(payload, length);
+    return true;
+}
+
+// the record as of the copy at offset, with its deltas applied; depth is how many there were
+static bool recordAt( const uchar *data, qint64 size, quint64 offset, quint64 key, QByteArray *record,
+                      int *depth = 0 ) {
+    QList <QByteArray> deltas;
+    QByteArray text;
+    quint64 base;
+    for (;;) {
+        if (deltas.size() > maxDeltaChain || !entryAt(data, size, offset, key, text, &base))
+            return false;
+        if (!base)
+            break;
+        deltas.prepend(text);
+        offset = base;
+    }
+    for (int i = 0; i < deltas.size(); i++) {
+        if (!applyDelta(text, deltas[i]))
+            return false;
+    }
+    if (record)
+        *record = text;
+    if (depth)
+        *depth = deltas.size();
+    return true;
+}
+
+static bool lookup( const uchar *data, qint64 size, quint64 key, QByteArray *record ) {
+    ArchiveHeader header;
+    if (!key || !parseHeader(data, size, header))
+        return false;
+    bool found;
+    qint64 index = probe(data + headerSize, header.slotCount, key, found);
+    if (!found)
+        return false;
+    quint64 offset = qFromLittleEndian<quint64>(data + headerSize + index * slotSize + 8);
+    return recordAt(data, size, offset, key, record);
+}
+
+static QByteArray recordBytes( quint64 key, const QByteArray &record ) {
+    QByteArray bytes(recordHeaderSize, '\0');
+    uchar *head = reinterpret_cast<uchar *>(bytes.data());
+    qToLittleEndian<quint64>(key, head);
+    qToLittleEndian<quint32>(record.size(), head + 8);
+    qToLittleEndian<quint32>(qChecksum(record.constData(), record.size()), head + 12);
+    bytes.append(record);
+    return bytes;
+}
+
+// journal entries are stored like full records, in save order; a damaged one ends the list.
+// returns how many bytes were good
+static qint64 parseJournal( const QByteArray &bytes, QList <QPair<quint64, QByteArray> > &entries ) {
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    qint64 offset = 0;
+    while (offset + recordHeaderSize <= bytes.size()) {
+        quint64 key = qFromLittleEndian<quint64>(data + offset);
+        quint32 length = qFromLittleEndian<quint32>(data + offset + 8);
+        quint32 checksum = qFromLittleEndian<quint32>(data + offset + 12);
+        const char *text = bytes.constData() + offset + recordHeaderSize;
+        if (!key || (length & deltaFlag) || offset + recordHeaderSize + length > bytes.size()
+                || qChecksum(text, length) != checksum)
+            return offset;
+        entries << qMakePair(key, QByteArray(text, length));
+        offset += recordHeaderSize + length;
+    }
+    return offset;
+}
+
+static QByteArray readAllOf( const QString &path ) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+// on Windows a file open or mapped at another station can't be renamed.  read() holds the archive
+// only for a moment, so a rename is tried for about a second before giving up
+static bool renameRetrying( const QString &from, const QString &to ) {
+    for (int attempt = 0; attempt < 20; attempt++) {
+        if (QFile::rename(from, to))
+            return true;
+        ArchiveSleep::msleep(50);
+    }
+    return false;
+}
+
+// flush() only hands the bytes to the system; a save has to be on the disk before write() returns
+static bool syncFile( QFile &file ) {
+#ifdef Q_OS_WIN
+    return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+static QByteArray deltaBytes( quint64 key, quint64 base, const QByteArray &delta ) {
+    QByteArray payload(8, '\0');
+    qToLittleEndian<quint64>(base, reinterpret_cast<uchar *>(payload.data()));
+    payload.append(delta);
+    QByteArray bytes = recordBytes(key, payload);
+    uchar *head = reinterpret_cast<uchar *>(bytes.data());
+    qToLittleEndian<quint32>(payload.size() | deltaFlag, head + 8);
+    return bytes;
+}
+
+BuildArchive::BuildArchive( const QString &path ) :
+    archivePath(path),
+    mappedFile(0),
+    mapped(0),
+    mappedSize(0),
+    compactionDue(false),
+    journaled(true)
+{
+}
+
+bool BuildArchive::contains( const QString &control ) const {
+    return find( control, 0 );
+}
+
+bool BuildArchive::read( const QString &control, QByteArray &record ) const {
+    return find( control, &record );
+}
+
+QString BuildArchive::journalPath() const {
+    return archivePath + ".journal";
+}
+
+QString BuildArchive::applyingPath() const {
+    return archivePath + ".journal.applying";
+}
+
+void BuildArchive::setJournaled( bool on ) {
+    journaled = on;
+}
+
+bool BuildArchive::journalLookup( quint64 key, QByteArray *record ) const {
+    if (mapped) {
+        QHash <quint64, QByteArray>::const_iterator i = mappedJournal.constFind(key);
+        if (i == mappedJournal.constEnd())
+            return false;
+        if (record)
+            *record = i.value();
+        return true;
+    }
+    // the live journal is newer than a batch still being applied, and is read first: an entry
+    // moved to the applying file in between is then still found there
+    QList <QPair<quint64, QByteArray> > entries;
+    if (QFileInfo(journalPath()).size() > 0)
+        parseJournal(readAllOf(journalPath()), entries);
+    int live = entries.size();
+    if (QFileInfo(applyingPath()).size() > 0)
+        parseJournal(readAllOf(applyingPath()), entries);
+    for (int pass = 0; pass < 2; pass++) {
+        int first = pass ? live : 0;
+        int last = pass ? entries.size() : live;
+        for (int i = last - 1; i >= first; i--) {
+            if (entries[i].first == key) {
+                if (record)
+                    *record = entries[i].second;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool BuildArchive::find( const QString &control, QByteArray *record ) const {
+    quint64 key = controlKey(control);
+    // journal first: an entry applied in between is in the archive by the time it leaves the journal
+    if (key && journalLookup( key, record ))
+        return true;
+    if (mapped)
+        return lookup(mapped, mappedSize, key, record);
+    QFile file(archivePath);
+    if (!openArchive( file ))
+        return false;
+    qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : 0;
+    if (!data)
+        return false;
+    bool found = lookup(data, size, key, record);
+    file.unmap(data);
+    file.close();
+    return found;
+}
+
+bool BuildArchive::write( const QString &control, const QByteArray &record ) {
+    lastError.clear();
+    quint64 key = controlKey(control);
+    if (!key) {
+        lastError = "Control number must be numeric: " + control;
+        return false;
+    }
+    // a mapped view would not see the appended record
+    unmap();
+    if (!journaled) {
+        if (!lock())
+            return false;
+        QFile file(archivePath);
+        bool ok = writeLocked( file, key, record, true );
+        file.close();
+        if (ok && lock( journalPath() + ".lock", 200 )) {
+            countSavesLocked( 1 );
+            unlock( journalPath() + ".lock" );
+        }
+        unlock();
+        return ok;
+    }
+    if (!lock( journalPath() + ".lock", 200 ))
+        return false;
+    QFile journal(journalPath());
+    QByteArray bytes = recordBytes(key, record);
+    quint64 saves;
+    qint64 good;
+    readSaves( saves, good );
+    bool ok = journal.open(QIODevice::ReadWrite);
+    if (ok) {
+        // only what lies past the recorded end is parsed: normally nothing, else an entry whose end
+        // never got recorded, or one torn by a station that died mid-append, which is cut off
+        // since it would hide every entry after it.  a shorter journal was started over
+        if (good < 0 || journal.size() < good)
+            good = 0;
+        if (good < journal.size() && journal.seek(good)) {
+            QList <QPair<quint64, QByteArray> > entries;
+            good += parseJournal(journal.readAll(), entries);
+        }
+        ok = (good == journal.size() || journal.resize(good)) && journal.seek(good)
+                && journal.write(bytes) == bytes.size() && journal.flush() && syncFile(journal);
+    }
+    if (!ok)
+        lastError = journal.errorString();
+    journal.close();
+    if (ok)
+        writeSaves( saves + 1, good + bytes.size() );
+    unlock( journalPath() + ".lock" );
+    if (!ok)
+        return false;
+    // group commit: a station that gets the archive without waiting applies every save journaled
+    // so far; otherwise the station holding it will, or the next save, or the next startup
+    if (lock( archivePath + ".lock", 1 )) {
+        applyJournal();
+        unlock();
+    }
+    lastError.clear();
+    return true;
+}
+
+bool BuildArchive::replayJournal() {
+    lastError.clear();
+    bool replaced = !QFile::exists(archivePath) && QFile::exists(archivePath + ".old");
+    if (!replaced && !QFile::exists(journalPath()) && !QFile::exists(applyingPath()))
+        return true;
+    unmap();
+    if (!lock())
+        return false;
+    bool ok = restoreLocked() && applyJournal();
+    unlock();
+    return ok;
+}
+
+bool BuildArchive::applyJournal() {
+    // caller holds the archive lock.  saves journaled while a batch goes in make up the next one
+    for (int batch = 0; batch < 4; batch++) {
+        // a batch left by a station that stopped part way goes first
+        if (!QFile::exists(applyingPath())) {
+            if (!QFile::exists(journalPath()))
+                return true;
+            if (!lock( journalPath() + ".lock", 200 ))
+                return false;
+            bool moved = QFile::rename(journalPath(), applyingPath());
+            if (moved) {
+                // the next save starts the journal over
+                quint64 saves;
+                qint64 end;
+                readSaves( saves, end );
+                writeSaves( saves, 0 );
+            }
+            unlock( journalPath() + ".lock" );
+            if (!moved) {
+                lastError = "Unable to move " + journalPath() + " aside";
+                return false;
+            }
+        }
+        QList <QPair<quint64, QByteArray> > entries;
+        parseJournal(readAllOf(applyingPath()), entries);
+        // one open of the archive for the whole batch, writing an entry twice is harmless
+        QFile file(archivePath);
+        for (int i = 0; i < entries.size(); i++) {
+            heartbeat();
+            if (!writeLocked( file, entries[i].first, entries[i].second, true )) {
+                file.close();
+                return false;
+            }
+        }
+        file.close();
+        QFile::remove(applyingPath());
+    }
+    return true;
+}
+
+QStringList BuildArchive::controls() const {
+    QStringList list;
+    // saves still in the journal count too
+    QList <QPair<quint64, QByteArray> > entries;
+    if (mapped) {
+        QList <quint64> keys = mappedJournal.keys();
+        for (int i = 0; i < keys.size(); i++)
+            entries << qMakePair(keys[i], QByteArray());
+    } else {
+        parseJournal(readAllOf(applyingPath()), entries);
+        parseJournal(readAllOf(journalPath()), entries);
+    }
+    QFile file(archivePath);
+    const uchar *data = mapped;
+    qint64 size = mappedSize;
+    if (!data) {
+        if (!openArchive( file ))
+            return list;
+        size = file.size();
+        data = size > 0 ? file.map(0, size) : 0;
+        if (!data)
+            return list;
+    }
+    ArchiveHeader header;
+    if (parseHeader(data, size, header)) {
+        for (quint32 i = 0; i < header.slotCount; i++) {
+            quint64 key = qFromLittleEndian<quint64>(data + headerSize + qint64(i) * slotSize);
+            if (key)
+                list << controlText(key);
+        }
+    }
+    if (data != mapped)
+        file.unmap(const_cast<uchar *>(data));
+    for (int i = 0; i < entries.size(); i++) {
+        QString control = controlText(entries[i].first);
+        if (!list.contains(control))
+            list << control;
+    }
+    list.sort();
+    return list;
+}
+
+int BuildArchive::importDirectory( const QString &dirPath ) {
+    lastError.clear();
+    unmap();
+    QDir dir(dirPath);
+    QStringList names = dir.entryList(QStringList() << "*.csv", QDir::Files, QDir::Name);
+    if (!lock())
+        return -1;
+    QFile file(archivePath);
+    int imported = 0;
+    for (int i = 0; i < names.size(); i++) {
+        heartbeat();
+        // only control/<ctrl>.csv records, never saveTemplate.csv
+        QString control = QFileInfo(names[i]).completeBaseName();
+        quint64 key = controlKey(control);
+        if (control.length() != 10 || !key)
+            continue;
+        // a record already in the archive was saved after the .csv, keep it
+        if (contains( control ))
+            continue;
+        QFile csv(dir.filePath(names[i]));
+        if (!csv.open(QIODevice::ReadOnly)) {
+            lastError = csv.fileName() + ": " + csv.errorString();
+            continue;
+        }
+        QByteArray record = csv.readAll();
+        csv.close();
+        if (!writeLocked( file, key, record, false )) {
+            file.close();
+            unlock();
+            return -1;
+        }
+        imported++;
+    }
+    file.close();
+    if (imported && lock( journalPath() + ".lock", 200 )) {
+        countSavesLocked( imported );
+        unlock( journalPath() + ".lock" );
+    }
+    unlock();
+    return imported;
+}
+
+bool BuildArchive::compact() {
+    lastError.clear();
+    unmap();
+    if (!lock())
+        return false;
+    bool ok = applyJournal() && rebuild( 0 );
+    unlock();
+    if (ok)
+        compactionDue = false;
+    return ok;
+}
+
+bool BuildArchive::wantsCompaction() const {
+    return compactionDue;
+}
+
+bool BuildArchive::compactPath( const QString &path ) {
+    // its own instance, so a calculator can hand this to another thread
+    BuildArchive archive(path);
+    return archive.compact();
+}
+
+void BuildArchive::remove( const QString &path ) {
+    // the archive and everything kept beside it, e.g. for a scratch archive
+    QStringList files;
+    files << "" << ".tmp" << ".old" << ".journal" << ".journal.applying" << ".saves";
+    for (int i = 0; i < files.size(); i++)
+        QFile::remove(path + files[i]);
+    removeLock(path + ".lock");
+    removeLock(path + ".journal.lock");
+}
+
+bool BuildArchive::map() {
+    unmap();
+    if (!QFile::exists(archivePath) && QFile::exists(archivePath + ".old")
+            && lock( archivePath + ".lock", 1 )) {
+        restoreLocked();
+        unlock();
+    }
+    mappedFile = new QFile(archivePath);
+    if (openArchive( *mappedFile ) && mappedFile->size() > 0) {
+        mappedSize = mappedFile->size();
+        mapped = mappedFile->map(0, mappedSize);
+    }
+    if (!mapped) {
+        lastError = mappedFile->errorString();
+        unmap();
+        return false;
+    }
+    // a batch of reads sees the journal as it was when the archive was mapped
+    QList <QPair<quint64, QByteArray> > entries;
+    parseJournal(readAllOf(applyingPath()), entries);
+    parseJournal(readAllOf(journalPath()), entries);
+    for (int i = 0; i < entries.size(); i++)
+        mappedJournal.insert(entries[i].first, entries[i].second);
+    return true;
+}
+
+void BuildArchive::unmap() {
+    if (!mappedFile)
+        return;
+    if (mapped)
+        mappedFile->unmap(const_cast<uchar *>(mapped));
+    mappedFile->close();
+    delete mappedFile;
+    mappedFile = 0;
+    mapped = 0;
+    mappedSize = 0;
+    mappedJournal.clear();
+}
+
+quint64 BuildArchive::generation() const {
+    quint64 saves;
+    qint64 journalEnd;
+    readSaves( saves, journalEnd );
+    return saves;
+}
+
+QString BuildArchive::generationPath() const {
+    return archivePath + ".saves";
+}
+
+void BuildArchive::readSaves( quint64 &saves, qint64 &journalEnd ) const {
+    // save count, then where the journal's last whole entry ends, -1 when that is not known
+    saves = 0;
+    journalEnd = -1;
+    QFile file(generationPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QByteArray bytes = file.read(16);
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    if (bytes.size() >= 8)
+        saves = qFromLittleEndian<quint64>(data);
+    if (bytes.size() == 16)
+        journalEnd = qFromLittleEndian<qint64>(data + 8);
+}
+
+void BuildArchive::writeSaves( quint64 saves, qint64 journalEnd ) {
+    // caller holds the journal lock.  a file that fails to write only costs an index rebuild and
+    // one walk of the journal
+    uchar data[16];
+    qToLittleEndian<quint64>(saves, data);
+    qToLittleEndian<qint64>(journalEnd, data + 8);
+    QFile file(generationPath());
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(reinterpret_cast<const char *>(data), 16);
+}
+
+void BuildArchive::countSavesLocked( int saves ) {
+    // caller holds the journal lock
+    quint64 count;
+    qint64 journalEnd;
+    readSaves( count, journalEnd );
+    writeSaves( count + saves, journalEnd );
+}
+
+QString BuildArchive::path() const {
+    return archivePath;
+}
+
+QStringList BuildArchive::watchPaths() const {
+    // a journaled save changes the journal and the count, a batch the archive.  the journal is
+    // renamed away with each batch and only comes back with the next save
+    return QStringList() << archivePath << journalPath() << generationPath();
+}
+
+QString BuildArchive::errorString() const {
+    return lastError;
+}
+
+bool BuildArchive::writeLocked( QFile &file, quint64 key, const QByteArray &record, bool allowDelta ) {
+    // caller holds the lock; file may be closed, and is left open for the next write.  a missing
+    // archive.dat is restored first, never recreated empty over a rebuild that stopped half way
+    if (!file.isOpen() && !restoreLocked())
+        return false;
+    if (!file.isOpen() && !file.open(QIODevice::ReadWrite)) {
+        lastError = file.errorString();
+        return false;
+    }
+    if (file.size() < headerSize && !createEmpty( file, initialSlots ))
+        return false;
+    file.seek(0);
+    QByteArray head = file.read(headerSize);
+    ArchiveHeader header;
+    if (!parseHeader(reinterpret_cast<const uchar *>(head.constData()), file.size(), header)) {
+        lastError = "Not a build record archive: " + archivePath;
+        return false;
+    }
+    uchar *slots = file.map(headerSize, qint64(header.slotCount) * slotSize);
+    if (!slots) {
+        lastError = file.errorString();
+        return false;
+    }
+    bool found;
+    qint64 index = probe(slots, header.slotCount, key, found);
+    file.unmap(slots);
+    // keep the table under 70% full so probes stay short
+    if (!found && (qint64(header.recordCount) + 1) * 10 > qint64(header.slotCount) * 7) {
+        file.close();
+        if (!rebuild( header.slotCount * 2 ))
+            return false;
+        return writeLocked( file, key, record, allowDelta );
+    }
+
+    QByteArray bytes;
+    if (found && allowDelta) {
+        // only the lines that changed since the newest copy, unless that chain is long enough
+        uchar *data = file.map(0, header.dataEnd);
+        if (!data) {
+            lastError = file.errorString();
+            return false;
+        }
+        quint64 newest = qFromLittleEndian<quint64>(data + headerSize + index * slotSize + 8);
+        QByteArray current;
+        QByteArray delta;
+        int depth;
+        bool merged = recordAt(data, header.dataEnd, newest, key, &current, &depth);
+        file.unmap(data);
+        if (merged && depth < maxDeltaChain && makeDelta( current, record, delta )) {
+            // nothing changed, nothing to write
+            if (delta.isEmpty())
+                return true;
+            if (delta.size() * 2 < record.size())
+                bytes = deltaBytes(key, newest, delta);
+        }
+    }
+    if (bytes.isEmpty())
+        bytes = recordBytes(key, record);
+    else
+        header.deltaCount++;
+
+    // record first, then header, then slot: a crash never leaves a slot pointing at nothing
+    quint64 offset = header.dataEnd;
+    if (!file.seek(offset) || file.write(bytes) != bytes.size()) {
+        lastError = file.errorString();
+        return false;
+    }
+    header.dataEnd = offset + bytes.size();
+    if (!found)
+        header.recordCount++;
+    QByteArray slot(slotSize, '\0');
+    qToLittleEndian<quint64>(key, reinterpret_cast<uchar *>(slot.data()));
+    qToLittleEndian<quint64>(offset, reinterpret_cast<uchar *>(slot.data()) + 8);
+    if (!file.seek(0) || file.write(headerBytes(header)) != headerSize
+            || !file.seek(headerSize + index * slotSize) || file.write(slot) != slotSize) {
+        lastError = file.errorString();
+        return false;
+    }
+    file.flush();
+    compactionDue = header.deltaCount >= compactAfterDeltas;
+    return true;
+}
+
+bool BuildArchive::rebuild( quint32 slotCount ) {
+    // caller holds the lock.  slotCount of 0 keeps the current table size
+    QFile in(archivePath);
+    if (!in.open(QIODevice::ReadOnly)) {
+        lastError = in.errorString();
+        return false;
+    }
+    qint64 size = in.size();
+    uchar *data = size > 0 ? in.map(0, size) : 0;
+    ArchiveHeader old;
+    if (!data || !parseHeader(data, size, old)) {
+        if (data)
+            in.unmap(data);
+        lastError = "Not a build record archive: " + archivePath;
+        return false;
+    }
+    ArchiveHeader header;
+    header.slotCount = slotCount ? slotCount : old.slotCount;
+    header.recordCount = 0;
+    header.deltaCount = 0;
+    header.dataEnd = headerSize + qint64(header.slotCount) * slotSize;
+    // build the new slot table in memory and stream the live records behind it
+    QByteArray table(qint64(header.slotCount) * slotSize, '\0');
+    uchar *slots = reinterpret_cast<uchar *>(table.data());
+    QString tmpPath = archivePath + ".tmp";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly|QIODevice::Truncate) || !out.seek(header.dataEnd)) {
+        lastError = out.errorString();
+        in.unmap(data);
+        return false;
+    }
+    bool ok = true;
+    for (quint32 i = 0; i < old.slotCount && ok; i++) {
+        if ((i & 4095) == 0)
+            heartbeat();
+        const uchar *oldSlot = data + headerSize + qint64(i) * slotSize;
+        quint64 key = qFromLittleEndian<quint64>(oldSlot);
+        QByteArray record;
+        if (!key || !recordAt(data, size, qFromLittleEndian<quint64>(oldSlot + 8), key, &record))
+            continue;
+        bool found;
+        qint64 index = probe(slots, header.slotCount, key, found);
+        qToLittleEndian<quint64>(key, slots + index * slotSize);
+        qToLittleEndian<quint64>(header.dataEnd, slots + index * slotSize + 8);
+        QByteArray bytes = recordBytes(key, record);
+        ok = out.write(bytes) == bytes.size();
+        header.dataEnd += bytes.size();
+        header.recordCount++;
+    }
+    in.unmap(data);
+    in.close();
+    ok = ok && out.seek(0) && out.write(headerBytes(header)) == headerSize
+            && out.write(table) == table.size();
+    if (!ok)
+        lastError = out.errorString();
+    out.close();
+    if (!ok) {
+        QFile::remove(tmpPath);
+        return false;
+    }
+    // renamed aside rather than removed, so a failure below still leaves an archive to restore
+    QString oldPath = archivePath + ".old";
+    QFile::remove(oldPath);
+    if (!renameRetrying( archivePath, oldPath )) {
+        // the archive is untouched and the deltas that made compaction due are still there, so
+        // the next station to apply a save finds it due and tries again
+        lastError = archivePath + " is open at another station, e.g. mapped by a StackupTool batch "
+                "or an index rebuild; compaction is left for a later save to retry";
+        QFile::remove(tmpPath);
+        return false;
+    }
+    if (!renameRetrying( tmpPath, archivePath )) {
+        // nothing can hold a file open under either name now, so putting .old back only fails
+        // with the share itself; restoreLocked() then tries again before the next write
+        if (!renameRetrying( oldPath, archivePath ))
+            restoreLocked();
+        lastError = "Unable to replace " + archivePath + " with " + tmpPath
+                + "; compaction is left for a later save to retry";
+        QFile::remove(tmpPath);
+        return false;
+    }
+    QFile::remove(oldPath);
+    return true;
+}
+
+bool BuildArchive::openArchive( QFile &file ) const {
+    // rebuild() between its two renames leaves no archive.dat for a moment; a reader waits that
+    // out rather than report a record missing
+    for (int attempt = 0; attempt < 40; attempt++) {
+        if (file.open(QIODevice::ReadOnly))
+            return true;
+        if (QFile::exists(archivePath) || !QFile::exists(archivePath + ".old"))
+            return false;
+        ArchiveSleep::msleep(50);
+    }
+    return false;
+}
+
+bool BuildArchive::restoreLocked() {
+    // caller holds the lock.  .old only exists without archive.dat between rebuild()'s two
+    // renames, and .tmp was complete before the first one
+    if (QFile::exists(archivePath) || !QFile::exists(archivePath + ".old"))
+        return true;
+    if (QFile::exists(archivePath + ".tmp") && QFile::rename(archivePath + ".tmp", archivePath)) {
+        QFile::remove(archivePath + ".old");
+        return true;
+    }
+    if (QFile::rename(archivePath + ".old", archivePath))
+        return true;
+    lastError = "Unable to restore " + archivePath + " from " + archivePath + ".old";
+    return false;
+}
+
+bool BuildArchive::createEmpty( QFile &file, quint32 slotCount ) {
+    ArchiveHeader header;
+    header.slotCount = slotCount;
+    header.recordCount = 0;
+    header.deltaCount = 0;
+    header.dataEnd = headerSize + qint64(slotCount) * slotSize;
+    bool ok = file.resize(0) && file.seek(0) && file.write(headerBytes(header)) == headerSize;
+    QByteArray zeros(64 * 1024, '\0');
+    for (qint64 left = qint64(slotCount) * slotSize; ok && left > 0; left -= zeros.size())
+        ok = file.write(zeros.constData(), qMin(left, qint64(zeros.size()))) > 0;
+    if (!ok)
+        lastError = file.errorString();
+    return ok;
+}
+
+bool BuildArchive::lock() {
+    // about ten seconds of retries before giving up on a busy archive
+    return lock( archivePath + ".lock", 200 );
+}
+
+bool BuildArchive::lock( const QString &lockPath, int attempts ) {
+    QDir dir;
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        if (dir.mkdir(lockPath)) {
+            writeHeartbeat(lockPath);
+            heartbeatAt = QDateTime::currentDateTime();
+            return true;
+        }
+        QByteArray stale;
+        if (lockIsStale(lockPath, stale) && breakLock(lockPath, stale))
+            continue;
+        if (attempt + 1 < attempts)
+            ArchiveSleep::msleep(50);
+    }
+    lastError = "Build record archive is locked by another station: " + lockPath;
+    return false;
+}
+
+void BuildArchive::unlock() {
+    unlock( archivePath + ".lock" );
+}
+
+void BuildArchive::unlock( const QString &lockPath ) {
+    removeLock(lockPath);
+}
+
+void BuildArchive::heartbeat() {
+    // caller holds the archive lock, rewritten at most every few seconds
+    QDateTime now = QDateTime::currentDateTime();
+    if (heartbeatAt.secsTo(now) < 5)
+        return;
+    heartbeatAt = now;
+    writeHeartbeat(archivePath + ".lock");
+}
+
+BuildArchive::~BuildArchive()
+{
+    unmap();
+}
@@ -0,0 +1,67 @@
+#ifndef BUILDARCHIVE_H
+#define BUILDARCHIVE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QDateTime>
+
+// BuildArchive keeps every control/<ctrl>.csv record in one indexed file, see buildarchive.cpp
+class BuildArchive
+{
+public:
+    explicit BuildArchive( const QString &path );
+    ~BuildArchive();
+    bool contains( const QString &control ) const;
+    bool read( const QString &control, QByteArray &record ) const;
+    bool write( const QString &control, const QByteArray &record );
+    QStringList controls() const;
+    int importDirectory( const QString &dirPath );
+    bool compact();
+    bool replayJournal();
+    void setJournaled( bool on );
+    bool wantsCompaction() const;
+    static bool compactPath( const QString &path );
+    static void remove( const QString &path );
+    quint64 generation() const;
+    bool map();
+    void unmap();
+    QString path() const;
+    QStringList watchPaths() const;
+    QString errorString() const;
+
+private:
+    QString archivePath;
+    QString lastError;
+    QFile *mappedFile;
+    const uchar *mapped;
+    qint64 mappedSize;
+    bool compactionDue;
+    bool journaled;
+    QHash <quint64, QByteArray> mappedJournal;
+    QDateTime heartbeatAt;
+    QString journalPath() const;
+    QString applyingPath() const;
+    QString generationPath() const;
+    void readSaves( quint64 &, qint64 & ) const;
+    void writeSaves( quint64, qint64 );
+    void countSavesLocked( int );
+    bool journalLookup( quint64, QByteArray * ) const;
+    bool applyJournal();
+    bool find( const QString &, QByteArray * ) const;
+    bool writeLocked( QFile &, quint64, const QByteArray &, bool );
+    bool rebuild( quint32 );
+    bool openArchive( QFile & ) const;
+    bool restoreLocked();
+    bool createEmpty( QFile &, quint32 );
+    bool lock();
+    bool lock( const QString &, int );
+    void unlock();
+    void unlock( const QString & );
+    void heartbeat();
+};
+
+#endif // BUILDARCHIVE_H
@@ -0,0 +1,80 @@
+/* BuildDataModel class is shared code used by ViewBuildData to show the production data of every
+ * step.  It views the calculator's own BuildRecord through a pointer, one table row per template
+ * row after the control and serial numbers, which ViewBuildData shows above the table.  Keys marked
+ * with '&' are the "important" or calculated values; they are shown bold, without the '&'.
+ *
+ * shown holds the text the view was last given for each row, so painting never formats a number.
+ * refresh() re-reads the record after the calculator changes it and signals dataChanged() for the
+ * runs of rows whose text changed, so the view repaints those rows and nothing else.
+*/
+
+#include "builddatamodel.h"
+#include "buildrecordio.h"
+
+// control and serial number rows are shown above the table
+static const int firstRow = BuildRecord::RowSerial + 1;
+
+BuildDataModel::BuildDataModel( const BuildRecord *record, QObject *parent ) :
+    QAbstractTableModel(parent),
+    source(record)
+{
+    boldFont.setBold(true);
+    shown.reserve(BuildRecord::RowCount - firstRow + 1);
+    for (int row = firstRow; row <= BuildRecord::RowCount; row++)
+        shown << rowText(row);
+}
+
+int BuildDataModel::rowCount( const QModelIndex &parent ) const {
+    return parent.isValid() ? 0 : shown.size();
+}
+
+int BuildDataModel::columnCount( const QModelIndex &parent ) const {
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant BuildDataModel::data( const QModelIndex &index, int role ) const {
+    if (!index.isValid() || index.row() >= shown.size())
+        return QVariant();
+    const ShownRow &row = shown[index.row()];
+    if (role == Qt::DisplayRole)
+        return index.column() == 0 ? row.key : row.value;
+    if (role == Qt::FontRole && row.bold)
+        return boldFont;
+    return QVariant();
+}
+
+const BuildRecord *BuildDataModel::record( ) const {
+    return source;
+}
+
+void BuildDataModel::refresh( ) {
+    // contiguous changed rows go out as one range
+    int changedFrom = -1;
+    for (int i = 0; i <= shown.size(); i++) {
+        bool changed = false;
+        if (i < shown.size()) {
+            ShownRow now = rowText(firstRow + i);
+            changed = now.key != shown[i].key || now.value != shown[i].value;
+            if (changed)
+                shown[i] = now;
+        }
+        if (changed && changedFrom < 0) {
+            changedFrom = i;
+        } else if (!changed && changedFrom >= 0) {
+            emit dataChanged(index(changedFrom, 0), index(i - 1, 1));
+            changedFrom = -1;
+        }
+    }
+}
+
+BuildDataModel::ShownRow BuildDataModel::rowText( int row ) const {
+    const BuildRecordField &f = buildRecordFields[row];
+    ShownRow shownRow;
+    shownRow.key = QString::fromLatin1(f.type == RecordMarker && source->*f.marker ? f.savedKey : f.key);
+    shownRow.value = BuildRecordIO::text(*source, row);
+    // the '&' marks the bold rows and is the last character of the key
+    shownRow.bold = shownRow.key.contains('&');
+    if (shownRow.bold)
+        shownRow.key.remove(shownRow.key.at(shownRow.key.length() - 1));
+    return shownRow;
+}
@@ -0,0 +1,36 @@
+#ifndef BUILDDATAMODEL_H
+#define BUILDDATAMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QString>
+#include <QFont>
+
+#include "buildrecord.h"
+
+// BuildDataModel shows a calculator's BuildRecord in ViewBuildData's table, see builddatamodel.cpp
+class BuildDataModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit BuildDataModel( const BuildRecord *record, QObject *parent = 0 );
+    int rowCount( const QModelIndex &parent = QModelIndex() ) const;
+    int columnCount( const QModelIndex &parent = QModelIndex() ) const;
+    QVariant data( const QModelIndex &index, int role = Qt::DisplayRole ) const;
+    const BuildRecord *record( ) const;
+    void refresh( );
+
+private:
+    struct ShownRow {
+        QString key;
+        QString value;
+        bool bold;
+    };
+    const BuildRecord *source;
+    QVector <ShownRow> shown;
+    QFont boldFont;
+    ShownRow rowText( int row ) const;
+};
+
+#endif // BUILDDATAMODEL_H
@@ -0,0 +1,94 @@
+#ifndef HISTORYBROWSER_H
+#define HISTORYBROWSER_H
+
+#include <QWidget>
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QString>
+#include <QBitArray>
+
+#include "summaryindex.h"
+#include "recordquery.h"
+
+class QComboBox;
+class QLineEdit;
+class QLabel;
+class QTableView;
+class QTimer;
+
+// HistoryModel lists every dewar in the summary index, sorted and filtered, see historybrowser.cpp
+class HistoryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryModel( QObject *parent = 0 );
+    void setColumns( const SummaryColumns &columns );
+    void setQuery( const QBitArray &selected );
+    void setFilter( int column, const QString &text );
+    const SummaryColumns &columns( ) const;
+    int total( ) const;
+    int rowCount( const QModelIndex &parent = QModelIndex() ) const;
+    int columnCount( const QModelIndex &parent = QModelIndex() ) const;
+    QVariant data( const QModelIndex &index, int role = Qt::DisplayRole ) const;
+    QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole ) const;
+    void sort( int column, Qt::SortOrder order = Qt::AscendingOrder );
+
+private:
+    enum Kind { ControlColumn, SerialColumn, StepsColumn, NumberColumn, TextColumn, SavedColumn };
+    struct Column {
+        Kind kind;
+        int index;              // into SummaryColumns::numbers or texts
+        int decimals;
+        QString title;
+    };
+    QVector <Column> columns;
+    SummaryColumns table;
+    QBitArray selected;         // dewars the query picked, empty for all of them
+    QVector <int> shown;        // dewars picked that pass the filter, in sort order
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+    int filterColumn;
+    QString filterText;
+    bool filterRange;
+    double filterLow;
+    double filterHigh;
+    QString text( int entry, int column ) const;
+    double number( int entry, int column ) const;
+    bool isNumber( int column ) const;
+    bool matches( int entry ) const;
+    void applyFilter( );
+    void applySort( );
+};
+
+// HistoryBrowser is the window over HistoryModel, see historybrowser.cpp
+class HistoryBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryBrowser( SummaryIndex *summary, QWidget *parent = 0 );
+    void reload( );
+
+private slots:
+    void filterChanged( );
+    void applyFilter( );
+    void applyQuery( );
+
+private:
+    SummaryIndex *summary;
+    HistoryModel *model;
+    QTableView *view;
+    QComboBox *columnBox;
+    QLineEdit *filterEdit;
+    QLineEdit *queryEdit;
+    QLabel *countLabel;
+    QTimer *filterTimer;
+    QString indexNote;
+    QString queryNote;
+    RecordQuery query;
+    bool queried;
+    void showCount( );
+};
+
+#endif // HISTORYBROWSER_H
@@ -3,9 +3,25 @@
 
 int main(int argc, char *argv[])
 {
+    // --trace-startup [file.json] writes a timeline of the launch, see StartupTrace
+    StartupTrace::enable( argc, argv );
+    StartupTrace::begin("QApplication");
     QApplication a(argc, argv);
+    StartupTrace::end();
+    StartupTrace::begin("MountCF");
     MountCF w;
+    StartupTrace::end();
+    StartupTrace::begin("show");
     w.show();
+    StartupTrace::end();
+    if (StartupTrace::isEnabled()) {
+        // the first paint is queued by show(), run it before the trace is written
+        StartupTrace::begin("first paint");
+        a.processEvents();
+        StartupTrace::end();
+        if (!StartupTrace::write("ColdfilterMount"))
+            qWarning("unable to write startup trace %s", qPrintable(StartupTrace::path()));
+    }
 
     return a.exec();
 }
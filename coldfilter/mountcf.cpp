@@ -1,20 +1,38 @@
 /* mountcf.cpp contains main callouts for coldfilter mounting calculator.
  *
- * loadData() does some basic error checking, loads a .csv file, populates the appropriate fields.
+ * loadData() does some basic error checking and starts loading a record from the archive (or a not
+ * yet imported .csv file) on RecordLoader's thread, so a slow share never freezes the window.  The
+ * window shows a busy cursor until recordLoaded() populates the appropriate fields.  A new scan
+ * or clearData() drops a record still loading, and saveData() waits for it.
  * Control and dataform numbers are passed to the ProteusLookup class so that PHR history can be
- * downloaded via ProteusLookup::proteusFetch().
+ * downloaded via ProteusLookup::proteusFetch().  proteusLookup() makes it on the first load.
+ * The fetch runs alongside the record load; a PHR that comes back first is checked by
+ * recordLoaded() once the form holds the new dewar, never against the previous one.
  *
- * saveData() checks for duplicate data, updates the saveTable, and writes the saveTable contents
- * to a .csv file.
+ * saveData() checks for duplicate data, updates the build record, and writes it to the build
+ * record archive, control/archive.dat.  Only the lines that changed are appended, and the archive
+ * is compacted in the background once enough deltas pile up.  See BuildArchive.  The SPC
+ * statistics in control/spc.dat are updated with the saved values, see SpcStats, and so is the
+ * dewar's line in the summary index, control/summary.dat, see SummaryIndex.  The constructor
+ * rebuilds the index when it is missing or out of step with the archive.  When StackupTool serve is
+ * running, loads and saves go through it instead, see CalcServiceClient; it keeps the archive, SPC
+ * statistics and index open for every station, and the constructor leaves the journal and the
+ * index to it.
  *
  * clearData() clears all fields and resets the dataLoaded boolean.
  *
+ * recordChanged() tells the operator when the open record was saved at another station.  The
+ * RecordWatcher has already merged the changed rows; recordLoaded() binds the form fields to rows
+ * for it, and saveData() asks before overwriting a copy saved elsewhere since it was loaded.
+ *
  * calculateData1() takes in the measured coldfilter thickness, adds it to the loaded coldshield
- * height, subtracts the loaded optical centerline and suggests coldfilter epoxy bondlines from a
- * range of [0.001, 0.0015, 0.002, 0.0025, 0.003] to get the build in spec.  The algebra used is
- * designed to favor a 0.001" bondline when possible.  Once the bondline is output, corresponding
- * tool ball height and expected ICD are also output.  The calculated values are then checked
- * against the design spec and color-coded accordingly.
+ * height, subtracts the loaded optical centerline and solves for the coldfilter epoxy bondline that
+ * gets the build closest to spec, rounded to what the dispenser can lay down.  The dispense range
+ * and resolution are read from the [bondline] section of control/stackup.ini (min, max,
+ * resolution), defaulting to 0.0010 to 0.0030 in 0.0005 steps.  Once the bondline is output,
+ * corresponding tool ball height and expected ICD are also output, and the margin to each ICD
+ * limit is shown in the status bar.  The calculated values are then checked against the design
+ * spec and color-coded accordingly.
  *
  * calculateData2() checks that all required fields are populated and then calculates Coldfilter
  * Height, final ICD, and CF Parallelism.  The function is structured to either take in an input
@@ -22,21 +40,43 @@
  * inputFiducial1, inputFiducial2, and inputFiducial3.  The calculated values are then checked
  * against the design spec and color-coded accordingly.
  *
+ * The formulas and spec limits behind both calculateData functions live in stackupcalc.cpp so
+ * that StackupTool can re-run them headless.
+ *
  * getScreenShot() takes a screenshot of the current window and saves to a desired directory.
  *
- * showNotepad(), showCalculations(), showBuildData(), showTutorial(), showAbout() all reference
- * functions in the ViewBuildData class.
+ * showNotepad(), showCalculations(), showBuildData(), showSpc(), showTutorial(), showAbout() all
+ * reference functions in the ViewBuildData class, which buildData() makes on first use.  The build
+ * data window views record directly and is refreshed wherever record changes.
+ *
+ * showHistory() opens a browser of every dewar in the summary index, sorted and filtered by any
+ * column of the template.  See HistoryBrowser.
  *
  * checkProteusData() calls the ProteusLookup class to verify that the data in the calculator
  * matches the production data saved in the PHR.  checkProteusData() is segregated by dataform.
  * It is called by way of the signal/slot in the constructor.
  *
- * initializeTables() sets up the save tables structures for load/save.
+ * prefetchProteus() takes a list of control numbers, wanded one per line, pasted or loaded from a
+ * file with loadPrefetchFile(), and has PhrPrefetch fetch their PHRs into the station's cache in
+ * the background, so loading them later doesn't wait on Proteus.  Progress and the final count
+ * are shown in the status bar.
+ *
+ * initializeTables() resets the build record to the saveTemplate.csv defaults.  The record is a
+ * BuildRecord, generated from the template at build time by recordgen, see buildrecordio.cpp.
  *
- * updateSaveTable() updates the save tables before writing to .csv.  calc1 and calc2 booleans are
- * passed to allow mid-assembly saves.
+ * verifyTemplate() warns at launch when control/saveTemplate.csv has changed since this
+ * calculator was built.
  *
- * fileExists() and checkText() are error checking functions.
+ * updateSaveTable() updates the build record before writing to the archive.  calc1 and calc2
+ * booleans are passed to allow mid-assembly saves.
+ *
+ * readRecord() reads a record through the service, or from the archive when none is running.
+ *
+ * The constructor times each step of the launch with StartupTrace when the calculator is started
+ * with --trace-startup.
+ *
+ * fileExists() and checkText() are error checking functions.  reportParseErrors() lists any
+ * malformed lines found by RecordParser when a record or the template is read.
 */
 
 #include "mountcf.h"
@@ -46,7 +86,9 @@ MountCF::MountCF(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MountCF)
 {
+    StartupTrace::phase("setupUi");
     ui->setupUi(this);
+    StartupTrace::phase("findChild");
     // set up local variables from XML in .ui file
     inputControl = MountCF::findChild<QLineEdit *>("lineEditControl");
     inputSerial = MountCF::findChild<QLineEdit *>("lineEditSerial");
@@ -63,27 +105,65 @@ MountCF::MountCF(QWidget *parent) :
     outputHeight1 = MountCF::findChild<QLabel *>("labelOutputHeight1");
     outputHeight2 = MountCF::findChild<QLabel *>("labelOutputHeight2");
     outputParallel = MountCF::findChild<QLabel *>("labelOutputParallel");
-    // calc1, calc2 tell the saveTables which data should be updated.
+    // calc1, calc2 tell the build record which data should be updated.
     calc1 = false;
     calc2 = false;
     // dataLoaded is a boolean which will tell whether data has been loaded
     dataLoaded = false;
-    // this is the saving table template path, then tables are initialized
-    pathTemplate = new QString("control/saveTemplate.csv");
-    initializeTables( pathTemplate );
+    StartupTrace::phase("archive and service");
+    // every control number's record is kept in this one indexed file
+    archive = new BuildArchive("control/archive.dat");
+    // a running StackupTool serve shares its cache of records it has read, see CalcServiceClient
+    service = new CalcServiceClient("control/archive.dat");
+    bool served = service->isAvailable();
+    // saves journaled by a station that stopped before applying them go in before anything is read,
+    // the service did that, and the index rebuild below, when it started
+    if (!served && !archive->replayJournal())
+        statusBar()->showMessage(tr("Save journal not replayed: %1").arg(archive->errorString()));
+    StartupTrace::phase("SpcStats, RecordWatcher, SummaryIndex");
+    // running mean, sigma and pass/fail counts of every characteristic, kept up to date on save
+    spc = new SpcStats("control/spc.dat");
+    // the open record follows saves from other stations, see RecordWatcher
+    watcher = new RecordWatcher(archive, &record);
+    connect(watcher, SIGNAL(recordChanged(QStringList,QStringList)), this,
+            SLOT(recordChanged(QStringList,QStringList)));
+    // records are read and parsed off the GUI thread, see loadData()
+    loader = new RecordLoader("control/archive.dat", this);
+    connect(loader, SIGNAL(loaded(RecordLoad)), this, SLOT(recordLoaded(RecordLoad)));
+    // step state and key outputs of every dewar, rebuilt here if a save or import went around it
+    summary = new SummaryIndex("control/summary.dat", "control/archive.dat");
+    if (!served && summary->isStale() && !summary->rebuild())
+        statusBar()->showMessage(tr("Summary index not rebuilt: %1").arg(summary->errorString()));
+    StartupTrace::phase("dialogs");
     controlInputDialog = new QInputDialog();
     kickBox = new QMessageBox();
-    viewBuildData = new ViewBuildData();
-    proteus = new ProteusLookup();
-    // connect signal from ProteusLookup class that data has been downloaded, SLOT checks text
-    connect(proteus, SIGNAL(returnText1061(QString*)), this, SLOT(checkProteusData1061()));
-    connect(proteus, SIGNAL(returnText1065(QString*)), this, SLOT(checkProteusData1065()));
+    // build data, notepad and SPC windows are made the first time one is asked for, see buildData()
+    viewBuildData = 0;
+    history = 0;
+    StartupTrace::phase("template");
+    // the record layout is compiled in from the template, check the template hasn't moved since
+    pathTemplate = new QString("control/saveTemplate.csv");
+    verifyTemplate( pathTemplate );
+    initializeTables( );
+    StartupTrace::phase("stackup.ini");
+    // dispenser range and resolution for calculateData1(), the shop's settings or the old five bondlines
+    QSettings stackupSettings("control/stackup.ini", QSettings::IniFormat);
+    bondSpec.min = stackupSettings.value("bondline/min", Stackup::defaultBondlineSpec.min).toDouble();
+    bondSpec.max = stackupSettings.value("bondline/max", Stackup::defaultBondlineSpec.max).toDouble();
+    bondSpec.resolution = stackupSettings.value("bondline/resolution",
+                                                Stackup::defaultBondlineSpec.resolution).toDouble();
+    // the PHR lookup and prefetch each load settings and prune the cache, neither is needed until
+    // the first load or prefetch, see proteusLookup() and prefetchProteus()
+    proteus = 0;
+    prefetch = 0;
+    StartupTrace::end();
 }
 
 void MountCF::loadData() {
     bool ok;
-    // reset saving tables
-    initializeTables( pathTemplate );
+    // reset build record, the previous one is no longer followed
+    watcher->stop();
+    initializeTables( );
     controlInputDialog->setOptions(QInputDialog::NoButtons);
     QString inputText = controlInputDialog->getText(this, "Load Data", "Wand or input Control Number:",
                                       QLineEdit::Normal, inputControl->text(), &ok);
@@ -92,68 +172,93 @@ void MountCF::loadData() {
     QString loadText = checkText( inputText );
     if (!goodText)
         return;
-    QString fileName = "control/" + loadText + ".csv";
-    // fetch data from proteus, ProteusLookup::proteusFetch( string );
+    // nothing on the form belongs to the new dewar until recordLoaded() fills it
+    inputCS->clear();
+    inputFPA1->clear();
+    inputFPA2->clear();
+    inputCF1->clear();
+    inputCF2->clear();
+    inputFiducial1->clear();
+    inputFiducial2->clear();
+    inputFiducial3->clear();
+    phrWaiting.clear();
+    // fetch data from proteus, ProteusLookup::proteusFetch( string ), both dataforms at once
+    // anything still in flight for the previous control is dropped first
+    proteusLookup()->cancelFetches();
     proteus->control = "C" + loadText;
     proteus->proteusFetch( "1061" );
     proteus->proteusFetch( "1065" );
-    QFile file(fileName);
-    if(!file.open(QIODevice::ReadOnly)) {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the record is read and parsed on the loader's thread, recordLoaded() fills the form
+    loader->load(loadText);
+    setCursor(Qt::BusyCursor);
+    statusBar()->showMessage(tr("Loading C%1...").arg(loadText));
+}
+
+void MountCF::recordLoaded( const RecordLoad &load ) {
+    unsetCursor();
+    statusBar()->clearMessage();
+    // with no record there is nothing to check the PHR against
+    QList <int> waiting = phrWaiting;
+    phrWaiting.clear();
+    if (!load.found) {
+        kickBox->information(this, tr("Unable to open file"), load.error);
         return;
     }
-    QMap <QString, QString> data;
-    int counter = 1;
-    // while loop to populate tables with values from .csv
-    while (!file.atEnd()) {
-        QByteArray line = file.readLine();
-        data.insert(line.split(',').first(), line.split(',').last().trimmed());
-        saveTable[counter++] = line.split(',').last().trimmed();
-    }
-    file.close();
-    if(data.isEmpty()) {
+    record = load.record;
+    reportParseErrors( load.errors, "C" + load.control );
+    if(load.fieldCount == 0) {
         kickBox->information(this, tr("No data in file"),
                 tr("The file you are attempting to open contains no data."));
     } else {
         dataLoaded = true;
-        // populate fields in calculator with table data
-        inputControl->setText(data.value(saveTemplate[1]));
-        inputSerial->setText(data.value(saveTemplate[2]));
+        // populate fields in calculator with record data
+        inputControl->setText(record.control);
+        inputSerial->setText(record.serial);
         // now separate which half or halves of the calculator should be populated
-        if (!data.contains("*****")) {
+        if (!record.coldfilter1Saved) {
             //no previous CF calc data, only data from previous calculator used
-            inputCS->setText(QString::number(data.value(saveTemplate[14]).toDouble(), 'f', 4));
-            inputFPA1->setText(QString::number(data.value(saveTemplate[8]).toDouble(), 'f', 4));
-            inputFPA2->setText(QString::number(data.value(saveTemplate[8]).toDouble(), 'f', 4));
+            watcher->bind(BuildRecord::RowColdshieldHeight, inputCS);
+            watcher->bind(BuildRecord::RowOpticalCenter, inputFPA1);
+            watcher->bind(BuildRecord::RowOpticalCenter, inputFPA2);
         } else {
             //only calc1 CF data, left half of UI
-            inputCF1->setText(QString::number(data.value(saveTemplate[21]).toDouble(), 'f', 4));
-            inputCS->setText(QString::number(data.value(saveTemplate[22]).toDouble(), 'f', 4));
-            inputFPA1->setText(QString::number(data.value(saveTemplate[23]).toDouble(), 'f', 4));
+            watcher->bind(BuildRecord::RowCfThickness, inputCF1);
+            watcher->bind(BuildRecord::RowCfColdshieldHeight, inputCS);
+            watcher->bind(BuildRecord::RowCfOpticalCenter1, inputFPA1);
             //once populated, calculate end values and lock control number and serial number fields.
             calculateData1( );
-            inputFPA2->setText(QString::number(data.value(saveTemplate[8]).toDouble(), 'f', 4));
+            watcher->bind(BuildRecord::RowOpticalCenter, inputFPA2);
         }
         inputCS->setEnabled(false);
         inputFPA1->setEnabled(false);
-        if (data.contains("******")) {
+        if (record.coldfilter2Saved) {
             //calc1 and calc2 data both exist, both halves of calculator filled
-            inputFiducial1->setText(QString::number(data.value(saveTemplate[28]).toDouble(), 'f', 4));
-            inputFiducial2->setText(QString::number(data.value(saveTemplate[29]).toDouble(), 'f', 4));
-            inputFiducial3->setText(QString::number(data.value(saveTemplate[30]).toDouble(), 'f', 4));
-            inputCF2->setText(QString::number(data.value(saveTemplate[31]).toDouble(), 'f', 4));
-            inputFPA2->setText(QString::number(data.value(saveTemplate[32]).toDouble(), 'f', 4));
+            watcher->bind(BuildRecord::RowFiducial1, inputFiducial1);
+            watcher->bind(BuildRecord::RowFiducial2, inputFiducial2);
+            watcher->bind(BuildRecord::RowFiducial3, inputFiducial3);
+            watcher->bind(BuildRecord::RowColdfilterHeight, inputCF2);
+            watcher->bind(BuildRecord::RowCfOpticalCenter2, inputFPA2);
             //once populated, calculate end values and lock control number and serial number fields.
             calculateData2( );
             inputFPA2->setEnabled(false);
         }
+        watcher->watch(load.control);
+        for (int i = 0; i < waiting.size(); i++)
+            checkProteusData(waiting[i]);
         inputControl->setEnabled(false);
         inputSerial->setEnabled(false);
     }
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountCF::saveData() {
     bool ok;
+    if (loader->isLoading()) {
+        kickBox->warning(this, tr("Save Error"), tr("C%1 is still loading.").arg(loader->control()));
+        return;
+    }
     if ( inputSerial->text().isEmpty() ) {
         kickBox->warning(this, tr("Save Error"), tr("No dewar serial number input."));
         return;
@@ -177,7 +282,7 @@ void MountCF::saveData() {
     QString fileName = "control/" + saveText + ".csv";
     // check for duplicate files and if so, should the file be overwritten
     // also flag user for partial load
-    if (!dataLoaded && fileExists(fileName)) {
+    if (!dataLoaded && (archive->contains(saveText) || fileExists(fileName))) {
         if (!calc1){
             kickBox->warning(this, tr("Saved Data Detected"),
                                 tr("Save data for C%1 detected but not loaded.\n"
@@ -196,31 +301,65 @@ void MountCF::saveData() {
         if (reply == QMessageBox::No)
             return;
     }
-    // update all tables from current calculator fields for writing to .csv
+    // update the build record from current calculator fields for writing to the archive
     updateSaveTable( calc1, calc2 );
-    QFile file(fileName);
-    QMap <QString, QString> data;
-    if(file.open(QFile::WriteOnly|QFile::Truncate)) {
-        QTextStream stream(&file);
-        int rowCount = saveTable.size() - 1;
-        // populate file stream with table data and close
-        for (int i = 1; i <= rowCount; i++) {
-            data.insert(saveTemplate[i], saveTable[i]);
-            stream << saveTemplate[i] << ",\t" << saveTable[i] << endl;
-        }
-        file.close();
-    } else {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the copy being overwritten comes back out of the SPC statistics
+    QByteArray previous;
+    readRecord(saveText, previous);
+    // another station saved this dewar after it was loaded here
+    if (!watcher->isCurrent(saveText, previous)) {
+        QString both;
+        if (!watcher->conflicts().isEmpty())
+            both = tr("\nChanged at both stations: %1").arg(watcher->conflicts().join(", "));
+        QMessageBox::StandardButton reply;
+        reply = QMessageBox::question(this, "Record Changed",
+                            tr("C%1 was saved at another station after it was loaded here.%2\n"
+                               "Overwrite it with this station's values?").arg(saveText).arg(both),
+                                    QMessageBox::Yes|QMessageBox::No);
+        if (reply == QMessageBox::No)
+            return;
+    }
+    // same "key,\tvalue" rows the .csv files used; the service writes and counts them in one go
+    QString warnings;
+    CalcServiceClient::Reply served = service->save(saveText, BuildRecordIO::save(record), warnings);
+    if (served == CalcServiceClient::Failed) {
+        kickBox->information(this, tr("Unable to save record"), service->errorString());
         return;
     }
-    if(data.isEmpty()) {
-        kickBox->information(this, tr("No data in file"),
-                tr("The file you are attempting to save contains no data."));
+    if (served == CalcServiceClient::Unavailable) {
+        qint64 archiveBefore = SummaryIndex::archiveGeneration( archive->path() );
+        if (!archive->write(saveText, BuildRecordIO::save(record))) {
+            kickBox->information(this, tr("Unable to save record"), archive->errorString());
+            return;
+        }
+        // the record is saved either way, StackupTool spc and summary --rebuild recover the rest
+        if (!spc->update(previous, record))
+            statusBar()->showMessage(tr("SPC statistics not updated: %1").arg(spc->errorString()));
+        if (!summary->update(record, archiveBefore))
+            statusBar()->showMessage(tr("Summary index not updated: %1").arg(summary->errorString()));
+        // saves append deltas, every so often one station folds them back in on another thread
+        if (archive->wantsCompaction())
+            QtConcurrent::run(BuildArchive::compactPath, archive->path());
+    } else if (!warnings.isEmpty()) {
+        statusBar()->showMessage(warnings.section('\n', 0, 0));
     }
+    // this save is now the copy the open record follows
+    watcher->watch(saveText);
 }
 
 void MountCF::clearData() {
     dataLoaded = false;
+    watcher->stop();
+    // a record still loading belongs to the dewar being cleared
+    if (loader->isLoading()) {
+        loader->cancel();
+        phrWaiting.clear();
+        unsetCursor();
+        statusBar()->clearMessage();
+    }
+    // PHR checks still in flight belong to the dewar being cleared, unless only the 2nd half goes
+    if (!calc2 && proteus)
+        proteus->cancelFetches();
     // error if no fields populated, set enabled toggled to active in case incorrectly disabled
     if( inputFiducial1->text().isEmpty() && inputFiducial2->text().isEmpty()
                 && inputFiducial3->text().isEmpty() && inputCS->text().isEmpty()
@@ -236,7 +375,7 @@ void MountCF::clearData() {
         inputFPA2->setEnabled(true);\
         inputControl->setEnabled(true);
         inputSerial->setEnabled(true);
-        initializeTables( pathTemplate );
+        initializeTables( );
     } else if (calc2) {
         // allow to clear 2nd half of calculator while leaving 1st half
         calc2 = false;
@@ -275,7 +414,7 @@ void MountCF::clearData() {
         outputHeight1->setStyleSheet("");
         inputControl->setEnabled(true);
         inputSerial->setEnabled(true);
-        initializeTables( pathTemplate );
+        initializeTables( );
     } else {
         // if no calculated, still clear all fields
         inputFiducial1->clear();
@@ -305,65 +444,44 @@ void MountCF::calculateData1() {
         return;
     } else {
         calc1 = true;
-        // create array of possible coldfilter bondlines
-        double bondline [] = { 0.0010, 0.0015, 0.0020, 0.0025, 0.0030 };
-        // create vectors for bondlines, ball heights, and associated sums
-        std::vector<double> bond;
-        bond.assign(bondline, bondline+5);
-        std::vector<double> balls (bond.size());
-        std::vector<double> sum (bond.size());
         double cf = inputCF1->text().toDouble();
         double cs = inputCS->text().toDouble();
         double fpa = inputFPA1->text().toDouble();
-        int choice;
-
-        // loop over size of possible coldfilter bondlines (5) and find bond value which gets build
-        // closest to spec.  Written to favor a 0.001" bondline when possible
-        for ( int i = 0; i < 5; i++ ) {
-            sum[i] = abs(cf) + abs(cs) - abs(fpa) + abs(bond[i]);
-            balls[i] =  sum[i] + abs(fpa);
-            if (i == 0)
-                choice = 0;
-            else if ( abs(5.5941 - sum[i]) < abs(5.5941 - sum[choice]) )
-                choice = i;
-        }
 
-        // once choice is determined, bondline at index choice is selected for build.  Ball height
-        // and expected ICD associated with that bondline are also given.
-        outputBond->setText(QString::number(bond[choice], 'f', 4));
-        outputBalls->setText(QString::number(balls[choice], 'f', 4));
-        outputHeight1->setText(QString::number(sum[choice], 'f', 4));
-        if( sum[choice] > 5.6013 || sum[choice] < 5.5933 ) {
+        // solve for the bondline which gets build closest to spec, rounded to the dispenser's
+        // resolution.  Ties go to the thinner bondline, see Stackup::chooseBondline()
+        Stackup::BondChoice choice = Stackup::chooseBondline( cf, cs, fpa, bondSpec );
+        statusBar()->showMessage(tr("Bondlines %1 to %2 meet ICD.  Margin %3 to %4, %5 to %6.")
+                                 .arg(choice.windowMin, 0, 'f', 4).arg(choice.windowMax, 0, 'f', 4)
+                                 .arg(choice.marginMin, 0, 'f', 4).arg(Stackup::icdMin, 0, 'f', 4)
+                                 .arg(choice.marginMax, 0, 'f', 4).arg(Stackup::icdMax, 0, 'f', 4));
+
+        // once choice is determined, that bondline is selected for build.  Ball height and
+        // expected ICD associated with that bondline are also given.
+        outputBond->setText(QString::number(choice.bondline, 'f', 4));
+        outputBalls->setText(QString::number(choice.ballHeight, 'f', 4));
+        outputHeight1->setText(QString::number(choice.icd, 'f', 4));
+        if( choice.status == Stackup::Red ) {
             // if no good bondline, kick out
             outputBalls->clear();
             outputBond->clear();
-            outputHeight1->setText(QString::number(sum[choice], 'f', 4));
+            outputHeight1->setText(QString::number(choice.icd, 'f', 4));
             outputHeight1->setStyleSheet("QLabel { background-color : red; color : black; }");
             kickBox->critical(this, tr("ICD not met"),
-                        tr("No possible bond line.\nExpected Height: %1").arg(sum[choice]));
-        } else if( sum[choice] == 5.6013 || sum[choice] == 5.5933 ) {
+                        tr("No possible bond line.\nExpected Height: %1\n"
+                           "Bondline needed: %2 to %3").arg(choice.icd)
+                        .arg(choice.windowMin, 0, 'f', 4).arg(choice.windowMax, 0, 'f', 4));
+        } else if( choice.status == Stackup::Yellow ) {
             // ICD barely met.  Flags user to take extreme caution
             outputHeight1->setStyleSheet("QLabel { background-color : yellow; color : black; }");
             kickBox->warning(this, tr("ICD met at critical dimension"),
                         tr("Expected ICD height is at extreme of allowable range.\n"
-                           "Expected Height: %1").arg(sum[choice]));
+                           "Expected Height: %1").arg(choice.icd));
         } else {
             // otherwise, all is well, proceed with build
             outputHeight1->setStyleSheet("QLabel { background-color : green; color : black; }");
             return;
         }
-        /*
-        } else if ( choice > 1 && abs(5.5973 - sum[choice]) <= bondline[0]/2 ) {
-            choice = choice - 1;
-        } else if ( choice > 1 && abs(5.5973 - sum[choice]) <= bondline[0] ) {
-            choice = choice - 2;
-
-        std::cout << bond[0] << " " << bond[1] << " " << bond[2] << " " << bond[4] << std::endl;
-        std::cout << sum[0] << " " << sum[1] << " " << sum[2] << " " << sum[4] << std::endl;
-        std::cout << balls[0] << " " << balls[1] << " " << balls[2] << " " << balls[4] << std::endl;
-        std::cout << bond[choice] << " " << sum[choice] << " " << balls[choice] << std::endl;
-        */
-        //QMessageBox::warning(this, tr("BILLY'S HERE!!"), tr("Size: %1").arg(balls.size()));
         return;
     }
 }
@@ -410,18 +528,16 @@ void MountCF::calculateData2() {
         double fid2 = inputFiducial2->text().toDouble();
         double fid3 = inputFiducial3->text().toDouble();
         // parallelism only possible if (3) fiducial heights input to calculate average height
-        QList<double> fiducials;
-        fiducials << fid1 << fid2 << fid3;
-        std::sort( fiducials.begin(), fiducials.end() );
+        double fiducials [] = { fid1, fid2, fid3 };
 
-        avg = ( abs(fid1) + abs(fid2) + abs(fid3) ) / fiducials.size();
+        avg = Stackup::averageHeight( fiducials, 3 );
 
-        parallel = abs( fiducials.back() - fiducials.front() );
+        parallel = Stackup::parallelism( fiducials, 3 );
 
         inputCF2->setText(QString::number(avg, 'f', 4));
         outputParallel->setText(QString::number(parallel, 'f', 4));
         // once calculated, populate output objects and color-code according to spec
-        if ( parallel > 0.0030 )
+        if ( Stackup::parallelStatus(parallel, Stackup::cfParallelMax) == Stackup::Red )
             outputParallel->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputParallel->setStyleSheet("QLabel { background-color : green; color : black; }");
@@ -442,11 +558,11 @@ void MountCF::calculateData2() {
         double cf = inputCF2->text().toDouble();
         double fpa = inputFPA2->text().toDouble();
 
-        sum = abs(cf) - abs(fpa);
+        sum = Stackup::coldfilterIcd( cf, fpa );
 
         outputHeight2->setText(QString::number(sum, 'f', 4));
         // once calculated, populate output objects and color-code according to spec
-        if(sum > 5.6013 || sum < 5.5933)
+        if(Stackup::icdStatus(sum) == Stackup::Red)
             outputHeight2->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputHeight2->setStyleSheet("QLabel { background-color : green; color : black; }");
@@ -466,89 +582,220 @@ void MountCF::getScreenShot() {
 }
 
 void MountCF::showNotepad() {
-    viewBuildData->showNotePad();
+    buildData()->showNotePad();
 }
 
 void MountCF::showCalculations() {
-    viewBuildData->showLink( QString("calcs") );
+    buildData()->showLink( QString("calcs") );
 }
 
 void MountCF::showBuildData() {
-    viewBuildData->showTable(saveTemplate, saveTable);
-    viewBuildData->show();
+    buildData()->showTable( &record );
+    buildData()->show();
+}
+
+void MountCF::showSpc() {
+    buildData()->showSpc( spc->summaries() );
+}
+
+void MountCF::showHistory() {
+    // made on first use, the summary index is reread every time it's opened
+    if (!history)
+        history = new HistoryBrowser(summary);
+    history->reload();
+    history->show();
+    history->raise();
+}
+
+void MountCF::recordChanged( const QStringList &applied, const QStringList &conflicts ) {
+    if (conflicts.isEmpty())
+        statusBar()->showMessage(tr("C%1 was saved at another station, updated %2")
+                                 .arg(watcher->control()).arg(applied.join(", ")));
+    else
+        statusBar()->showMessage(tr("C%1 was saved at another station, kept your edits to %2")
+                                 .arg(watcher->control()).arg(conflicts.join(", ")));
+    // outputs already shown are recalculated from the updated fields
+    if (!outputHeight1->text().isEmpty())
+        calculateData1( );
+    if (!outputHeight2->text().isEmpty())
+        calculateData2( );
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountCF::showTutorial() {
-    viewBuildData->showLink( QString("tutorial") );
+    buildData()->showLink( QString("tutorial") );
 }
 
 void MountCF::showAbout() {
     QString name = "ColdfilterMount.exe\n";
-    viewBuildData->showAbout( name );
+    buildData()->showAbout( name );
 }
 
-void MountCF::checkProteusData1061( ) {
-    // when ProteusLookup::replyFinished1061 finishes, it signals this function to check pulled text
-    // inputFPA is passed to checkFectchedText() to compare it to what is in the PHR.
-    proteus->checkFetchedText(inputFPA1->text(), 1061);
-    proteus->checkFetchedText(inputFPA2->text(), 1061);
+void MountCF::checkProteusData( int dataform ) {
+    // when ProteusLookup::replyFinished finishes, it signals this function to check pulled text
+    // inputFPA and inputCS are passed to checkFectchedText() to compare them to what is in the PHR.
+    // a PHR that arrives before the record is checked once recordLoaded() has filled them
+    if (loader->isLoading()) {
+        if (!phrWaiting.contains(dataform))
+            phrWaiting << dataform;
+        return;
+    }
+    switch (dataform) {
+    case 1061:
+        proteus->checkFetchedText(inputFPA1->text(), 1061);
+        proteus->checkFetchedText(inputFPA2->text(), 1061);
+        break;
+    case 1065:
+        proteus->checkFetchedText(inputCS->text(), 1065);
+        break;
+    }
 }
 
-void MountCF::checkProteusData1065( ) {
-    // when ProteusLookup::replyFinished1065 finishes, it signals this function to check pulled text
-    // inputCS is passed to checkFectchedText() to compare it to what is in the PHR.
-    proteus->checkFetchedText(inputCS->text(), 1065);
+void MountCF::prefetchProteus() {
+    // scan queue: the wand ends each control number with Enter, which starts a new line
+    QDialog listDialog(this);
+    listDialog.setWindowTitle(tr("Prefetch PHRs"));
+    QVBoxLayout *layout = new QVBoxLayout(&listDialog);
+    layout->addWidget(new QLabel(tr("Wand, paste or load the control numbers to prefetch:")));
+    QPlainTextEdit *listEdit = new QPlainTextEdit();
+    listEdit->setObjectName("plainTextPrefetch");
+    layout->addWidget(listEdit);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    QPushButton *fileButton = buttons->addButton(tr("Load File..."), QDialogButtonBox::ActionRole);
+    layout->addWidget(buttons);
+    connect(fileButton, SIGNAL(clicked()), this, SLOT(loadPrefetchFile()));
+    connect(buttons, SIGNAL(accepted()), &listDialog, SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), &listDialog, SLOT(reject()));
+    if (listDialog.exec() != QDialog::Accepted)
+        return;
+    QStringList controls = PhrPrefetch::parseControls(listEdit->toPlainText());
+    if (controls.isEmpty()) {
+        kickBox->warning(this, tr("Input Error"), tr("No 10-digit Control Numbers were found."));
+        return;
+    }
+    if (!prefetch) {
+        // fills the PHR cache ahead of the shift, separate from proteus so loadData() never cancels it
+        prefetch = new PhrPrefetch();
+        connect(prefetch, SIGNAL(progress(int,int)), this, SLOT(showPrefetchProgress(int,int)));
+        connect(prefetch, SIGNAL(finished()), this, SLOT(prefetchFinished()));
+    }
+    if (prefetch->client->cacheDir().isEmpty()) {
+        kickBox->warning(this, tr("Prefetch Error"), tr("The PHR cache is turned off in "
+                                                          "control/proteus.ini, nothing can be prefetched."));
+        return;
+    }
+    prefetch->start(controls);
+}
+
+void MountCF::loadPrefetchFile() {
+    // the list edit lives in the dialog that owns the button
+    QWidget *button = qobject_cast<QWidget *>(sender());
+    QPlainTextEdit *listEdit = button ? button->window()->findChild<QPlainTextEdit *>("plainTextPrefetch") : 0;
+    if (!listEdit)
+        return;
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Control Numbers"), "control",
+                                                    tr("Text Files (*.txt *.csv);;All Files (*)"));
+    QFile file(fileName);
+    if (fileName.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    listEdit->appendPlainText(QString::fromLatin1(file.readAll()));
 }
 
-void MountCF::initializeTables( QString* path ) {
-    // reset all tables at .exe launch or during clearData(), etc
-    saveTemplate.clear();
-    saveTable.clear();
+void MountCF::showPrefetchProgress( int done, int total ) {
+    statusBar()->showMessage(tr("Prefetching PHRs: %1 of %2 dataforms").arg(done).arg(total));
+}
+
+void MountCF::prefetchFinished() {
+    statusBar()->showMessage(tr("PHR prefetch done, %1").arg(prefetch->summary()));
+}
+
+void MountCF::initializeTables( ) {
+    // reset the build record at .exe launch or during clearData(), etc
+    BuildRecordIO::clear( record );
+}
+
+void MountCF::verifyTemplate( QString* path ) {
     QFile templat(*path);
     if(!templat.open(QIODevice::ReadOnly)) {
         kickBox->information(this, tr("Unable to open file"), templat.errorString());
         return;
     }
-    while (!templat.atEnd()) {
-        QByteArray line = templat.readLine();
-        saveTemplate << line.split(',').first().trimmed();
-        saveTable << line.split(',').last().trimmed();
-    }
-    // bandaid to line up indices :(
-    saveTemplate.prepend("@@@@@");
-    saveTable.prepend("@@@@@");
+    QString problem = BuildRecordIO::checkTemplate( templat.readAll() );
     templat.close();
+    if (!problem.isEmpty())
+        kickBox->warning(this, tr("Template Mismatch"),
+                         tr("%1 has changed since this calculator was built.\n"
+                            "Records saved now may not line up with the template.\n\n%2")
+                         .arg(*path).arg(problem));
 }
 
 void MountCF::updateSaveTable( bool calculated1, bool calculated2 ) {
-    saveTable[1] = inputControl->text();
-    saveTable[2] = inputSerial->text();
-    // get all current data from calulator fields and insert in saveTable array
+    record.control = inputControl->text();
+    record.serial = inputSerial->text();
+    // get all current data from calulator fields and insert in the build record
     if (calculated1) {
-        saveTable[21] = inputCF1->text();
-        saveTable[22] = inputCS->text();
-        saveTable[23] = inputFPA1->text();
-        saveTable[24] = outputBond->text();
-        saveTable[25] = outputBalls->text();
-        saveTable[26] = outputHeight1->text();
+        record.cfThickness = BuildRecordIO::number(inputCF1->text());
+        record.cfColdshieldHeight = BuildRecordIO::number(inputCS->text());
+        record.cfOpticalCenter1 = BuildRecordIO::number(inputFPA1->text());
+        record.cfBondline = BuildRecordIO::number(outputBond->text());
+        record.ballHeight = BuildRecordIO::number(outputBalls->text());
+        record.cfExpectedIcd = BuildRecordIO::number(outputHeight1->text());
         // asterisks are used to tell saveData() whether file is fully or only half saved.
-        // default in saveTemplate is "$$$$$", which is overwritten to "*****", etc.
-        saveTable[27] = "*****";
-        saveTemplate[27] = "*****";
+        // default in saveTemplate is "$$$$$", which is saved as "*****", etc.
+        record.coldfilter1Saved = true;
     }
     if (calculated2) {
-        saveTable[28] = inputFiducial1->text();
-        saveTable[29] = inputFiducial2->text();
-        saveTable[30] = inputFiducial3->text();
-        saveTable[31] = inputCF2->text();
-        saveTable[32] = inputFPA2->text();
-        saveTable[33] = outputHeight2->text();
-        saveTable[34] = outputParallel->text();
+        record.fiducial1 = BuildRecordIO::number(inputFiducial1->text());
+        record.fiducial2 = BuildRecordIO::number(inputFiducial2->text());
+        record.fiducial3 = BuildRecordIO::number(inputFiducial3->text());
+        record.coldfilterHeight = BuildRecordIO::number(inputCF2->text());
+        record.cfOpticalCenter2 = BuildRecordIO::number(inputFPA2->text());
+        record.finalIcd = BuildRecordIO::number(outputHeight2->text());
+        record.cfParallelism = BuildRecordIO::number(outputParallel->text());
         // asterisks are used to tell saveData() whether file is fully or only half saved.
-        // default in saveTemplate is "$$$$$$", which is overwritten to "******", etc.
-        saveTable[35] = "******";
-        saveTemplate[35] = "******";
+        // default in saveTemplate is "$$$$$$", which is saved as "******", etc.
+        record.coldfilter2Saved = true;
+    }
+    if (viewBuildData)
+        viewBuildData->refreshTable();
+}
+
+void MountCF::reportParseErrors( const std::vector <RecordError> &errors, QString source ) {
+    // malformed lines are skipped by the parser, flag them so the record can be fixed
+    if (errors.empty())
+        return;
+    QString lines;
+    for (unsigned i = 0; i < errors.size() && i < 10; i++)
+        lines += tr("Line %1: %2\n").arg(errors[i].line).arg(errors[i].message);
+    kickBox->warning(this, tr("Malformed Record"),
+                     tr("%1 contains malformed lines.\n"
+                        "Verify build data before proceeding.\n\n%2").arg(source).arg(lines));
+}
+
+ViewBuildData *MountCF::buildData( ) {
+    // most sessions never open one of its windows
+    if (!viewBuildData)
+        viewBuildData = new ViewBuildData();
+    return viewBuildData;
+}
+
+ProteusLookup *MountCF::proteusLookup( ) {
+    if (!proteus) {
+        proteus = new ProteusLookup(this);
+        // connect signal from ProteusLookup class that data has been downloaded, SLOT checks text
+        connect(proteus, SIGNAL(returnText(int)), this, SLOT(checkProteusData(int)));
     }
+    return proteus;
+}
+
+bool MountCF::readRecord( const QString &control, QByteArray &bytes ) {
+    // the service answers from its record cache, without one the archive is read here
+    CalcServiceClient::Reply served = service->load(control, bytes);
+    if (served == CalcServiceClient::Unavailable)
+        return archive->read(control, bytes);
+    return served == CalcServiceClient::Ok;
 }
 
 bool MountCF::fileExists( QString path ) {
@@ -599,9 +846,16 @@ MountCF::~MountCF()
     delete outputHeight2;
     delete outputParallel;
     delete pathTemplate;
+    delete archive;
+    delete spc;
+    delete watcher;
+    delete summary;
+    delete service;
     delete controlInputDialog;
     delete kickBox;
     delete viewBuildData;
+    delete history;
+    delete prefetch;
     delete proteus;
     delete ui;
 }
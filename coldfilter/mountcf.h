@@ -6,19 +6,33 @@
 #include <QTextStream>
 #include <QFile>
 #include <QFileInfo>
+#include <QVector>
 #include <QList>
 #include <QStringList>
 #include <QMap>
 #include <iostream>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QtConcurrentRun>
 #include <cmath>
 #include <algorithm>
 #include <array>
 #include <iostream>
 
 #include <viewbuilddata.h>
+#include <historybrowser.h>
 #include <proteuslookup.h>
+#include <phrprefetch.h>
+#include <stackupcalc.h>
+#include <buildarchive.h>
+#include <spcstats.h>
+#include <summaryindex.h>
+#include <recordwatcher.h>
+#include <calcserviceclient.h>
+#include <recordloader.h>
+#include <startuptrace.h>
+#include <recordparser.h>
+#include <buildrecordio.h>
 
 class QLabel;
 class QLineEdit;
@@ -48,10 +62,19 @@ public slots:
     void showNotepad();
     void showCalculations();
     void showBuildData();
+    void showSpc();
+    void showHistory();
     void showTutorial();
     void showAbout();
-    void checkProteusData1061( );
-    void checkProteusData1065( );
+    void checkProteusData( int );
+    void prefetchProteus();
+
+private slots:
+    void recordChanged( const QStringList &, const QStringList & );
+    void recordLoaded( const RecordLoad & );
+    void loadPrefetchFile();
+    void showPrefetchProgress( int, int );
+    void prefetchFinished();
 
 private:
     Ui::MountCF *ui;
@@ -78,14 +101,28 @@ private:
     QMessageBox *kickBox;
     QInputDialog *controlInputDialog;
     QString *pathTemplate;
-    QList <QString> saveTemplate;
-    QList <QString> saveTable;
-    void initializeTables( QString* );
+    BuildArchive *archive;
+    SpcStats *spc;
+    SummaryIndex *summary;
+    RecordWatcher *watcher;
+    RecordLoader *loader;
+    QList <int> phrWaiting;             // PHR checks held until recordLoaded() fills the form
+    CalcServiceClient *service;
+    BuildRecord record;
+    Stackup::BondlineSpec bondSpec;
+    void initializeTables( );
+    void verifyTemplate( QString* );
     void updateSaveTable( bool, bool );
+    void reportParseErrors( const std::vector <RecordError> &, QString );
+    ViewBuildData *buildData( );
+    ProteusLookup *proteusLookup( );
+    bool readRecord( const QString &, QByteArray & );
     bool fileExists( QString );
     QString checkText( QString );
     ViewBuildData *viewBuildData;
+    HistoryBrowser *history;
     ProteusLookup *proteus;
+    PhrPrefetch *prefetch;
 };
 
 #endif // MOUNTCF_H
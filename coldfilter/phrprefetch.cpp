@@ -0,0 +1,139 @@
+/* PhrPrefetch class is shared code used by the calculators and StackupTool to fill the PHR cache
+ * ahead of a shift, so each loadData() is answered from the station's disk instead of waiting on
+ * two Proteus round trips.
+ *
+ * It has its own ProteusClient, set up from control/proteus.ini like ProteusLookup's, so the two
+ * share the cache directory but the operator loading or clearing a dewar never cancels a prefetch.
+ *
+ * parseControls() takes scanned, pasted or file text and returns the control numbers in it, in the
+ * "C2001933086" form ProteusLookup uses, with duplicates dropped.  Any word that is not 10 digits,
+ * with or without the leading 'C', is skipped, so a schedule can be pasted in as is.
+ *
+ * start() queues every dataform in dataforms (1061 and 1065) for every control, skipping any
+ * already fresh in the cache, and keeps at most concurrent requests with Proteus at a time.
+ * progress() is emitted as each one finishes and finished() once the queue is empty.  The
+ * counters tell how many were already warm, fetched, had no data yet or failed.  A fetch that
+ * only found an older cached copy counts as failed, the cache is no warmer for it.
+ *
+ * cancel() drops the queue and aborts what is in flight.
+*/
+
+#include "phrprefetch.h"
+
+#include <QRegExp>
+
+PhrPrefetch::PhrPrefetch( QObject *parent ) :
+    QObject(parent),
+    // QNetworkAccessManager opens six connections per server, more than that only queues
+    concurrent(6),
+    total(0),
+    warm(0),
+    fetched(0),
+    noData(0),
+    failed(0)
+{
+    dataforms << 1061 << 1065;
+    client = new ProteusClient(this);
+    client->loadSettings("control/proteus.ini");
+    connect(client, SIGNAL(replyReady(QString,int,PhrReply)), this,
+            SLOT(replyReady(QString,int,PhrReply)));
+    connect(client, SIGNAL(staleReply(QString,int,QString,QDateTime)), this,
+            SLOT(staleReply(QString,int,QString,QDateTime)));
+    connect(client, SIGNAL(noData(QString,int)), this, SLOT(noDataFound(QString,int)));
+    connect(client, SIGNAL(fetchFailed(QString,int,QString)), this,
+            SLOT(fetchFailed(QString,int,QString)));
+}
+
+QStringList PhrPrefetch::parseControls( const QString &text ) {
+    QStringList controls;
+    QStringList words = text.split(QRegExp("[\\s,;]+"), QString::SkipEmptyParts);
+    QRegExp controlNumber("C?\\d{10}");
+    for (int i = 0; i < words.size(); i++) {
+        QString control = words[i].toUpper();
+        if (!controlNumber.exactMatch(control))
+            continue;
+        // wanded labels carry the 'C', typed ones often don't
+        if (!control.startsWith('C'))
+            control.prepend('C');
+        if (!controls.contains(control))
+            controls << control;
+    }
+    return controls;
+}
+
+void PhrPrefetch::start( const QStringList &controls ) {
+    cancel();
+    total = warm = fetched = noData = failed = 0;
+    for (int i = 0; i < controls.size(); i++) {
+        for (int j = 0; j < dataforms.size(); j++) {
+            total++;
+            if (client->isCached(controls[i], dataforms[j]))
+                warm++;
+            else
+                queue << Job(controls[i], dataforms[j]);
+        }
+    }
+    emit progress(warm, total);
+    startJobs();
+}
+
+void PhrPrefetch::cancel( ) {
+    queue.clear();
+    inFlight.clear();
+    stale.clear();
+    client->cancel();
+}
+
+bool PhrPrefetch::isRunning() const {
+    return !queue.isEmpty() || !inFlight.isEmpty();
+}
+
+QString PhrPrefetch::summary() const {
+    return tr("%1 dataforms: %2 already cached, %3 fetched, %4 with no data, %5 failed")
+            .arg(total).arg(warm).arg(fetched).arg(noData).arg(failed);
+}
+
+void PhrPrefetch::startJobs( ) {
+    while (!queue.isEmpty() && inFlight.size() < concurrent) {
+        Job job = queue.takeFirst();
+        inFlight.insert(job);
+        client->fetch(job.first, job.second);
+    }
+    if (!isRunning())
+        emit finished();
+}
+
+void PhrPrefetch::jobDone( const QString &control, int dataform ) {
+    if (!inFlight.remove(Job(control, dataform)))
+        return;
+    emit progress(warm + fetched + noData + failed, total);
+    startJobs();
+}
+
+void PhrPrefetch::replyReady( const QString &control, int dataform, const PhrReply & ) {
+    Job job(control, dataform);
+    if (!inFlight.contains(job))
+        return;
+    if (stale.remove(job))
+        failed++;
+    else
+        fetched++;
+    jobDone(control, dataform);
+}
+
+void PhrPrefetch::staleReply( const QString &control, int dataform, const QString &, const QDateTime & ) {
+    // replyReady follows with the copy that was already cached
+    stale.insert(Job(control, dataform));
+}
+
+void PhrPrefetch::noDataFound( const QString &control, int dataform ) {
+    if (inFlight.contains(Job(control, dataform)))
+        noData++;
+    jobDone(control, dataform);
+}
+
+void PhrPrefetch::fetchFailed( const QString &control, int dataform, const QString & ) {
+    if (inFlight.contains(Job(control, dataform)))
+        failed++;
+    jobDone(control, dataform);
+}
@@ -0,0 +1,117 @@
+/* PhrReply class is shared code used by ProteusLookup to pull the fields out of a Proteus
+ * dataFormResult reply.  A reply is a run of fields like
+ *     MPPStepMountFPAMB_DATAFORM1061_Datum__dash_A_dash__to_Optical_Center_Height = 1.2345
+ * one after another, possibly with line breaks or markup in between, or none at all: a value can
+ * run straight into the next key, as in "= 1.2345MPPStepMount...".
+ *
+ * parse() walks the reply once.  Each " = " ends a key, which is the run of letters, digits and
+ * underscores just before it, starting at "MPPStep" when the run has it so the digits of a value
+ * that runs into the key stay with the value.  The value of the previous key runs from its " = "
+ * up to the start of this key.  Values are trimmed and cut at the first '<' so trailing markup is dropped.
+ * Nothing is copied: keys and values are kept as offsets into the reply text, and only the index
+ * holds the lower-cased keys, so lookups ignore case like the old indexOf() search did.
+ *
+ * A repeated key keeps its first value.
+*/
+
+#include "phrreply.h"
+
+// every Proteus dataform field starts with this
+static const QString keyPrefix("MPPStep");
+
+static bool isKeyChar( QChar c ) {
+    return c.isLetterOrNumber() || c == '_';
+}
+
+PhrReply::PhrReply()
+{
+}
+
+PhrReply::PhrReply( const QString &text ) :
+    text(text)
+{
+    parse();
+}
+
+bool PhrReply::contains( const QString &key ) const {
+    return index.contains(key.toLower());
+}
+
+QString PhrReply::value( const QString &key ) const {
+    QHash <QString, int>::const_iterator it = index.constFind(key.toLower());
+    if (it == index.constEnd())
+        return QString();
+    const Span &span = valueSpans[it.value()];
+    return text.mid(span.start, span.length);
+}
+
+QStringList PhrReply::keys() const {
+    QStringList list;
+    for (int i = 0; i < keySpans.size(); i++)
+        list << text.mid(keySpans[i].start, keySpans[i].length);
+    return list;
+}
+
+int PhrReply::size() const {
+    return keySpans.size();
+}
+
+QString PhrReply::rawText() const {
+    return text;
+}
+
+void PhrReply::parse() {
+    const QChar *data = text.constData();
+    int length = text.length();
+    // the field waiting for its value to end, -1 before the first key
+    int keyStart = -1;
+    int keyLength = 0;
+    int valueStart = 0;
+    for (int i = 0; i < length; i++) {
+        if (data[i] != '=')
+            continue;
+        // key is the identifier right before the '=', spaces allowed in between
+        int end = i;
+        while (end > valueStart && data[end - 1].isSpace())
+            end--;
+        int start = end;
+        while (start > valueStart && isKeyChar(data[start - 1]))
+            start--;
+        if (start == end)
+            continue;
+        QString run = QString::fromRawData(data + start, end - start);
+        int prefix = run.indexOf(keyPrefix, 0, Qt::CaseInsensitive);
+        if (prefix > 0)
+            start += prefix;
+        if (keyStart >= 0)
+            addField(keyStart, keyLength, valueStart, start);
+        keyStart = start;
+        keyLength = end - start;
+        valueStart = i + 1;
+    }
+    if (keyStart >= 0)
+        addField(keyStart, keyLength, valueStart, length);
+}
+
+void PhrReply::addField( int keyStart, int keyLength, int valueStart, int valueEnd ) {
+    const QChar *data = text.constData();
+    // drop markup, then trim whitespace both ends
+    for (int i = valueStart; i < valueEnd; i++) {
+        if (data[i] == '<') {
+            valueEnd = i;
+            break;
+        }
+    }
+    while (valueStart < valueEnd && data[valueStart].isSpace())
+        valueStart++;
+    while (valueEnd > valueStart && data[valueEnd - 1].isSpace())
+        valueEnd--;
+    QString key = text.mid(keyStart, keyLength).toLower();
+    if (index.contains(key))
+        return;
+    Span k = { keyStart, keyLength };
+    Span v = { valueStart, valueEnd - valueStart };
+    index.insert(key, keySpans.size());
+    keySpans << k;
+    valueSpans << v;
+}
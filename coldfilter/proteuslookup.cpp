@@ -1,47 +1,46 @@
 /* ProteusLookup class is shared code used in multiple calculators to handle communications with
  * the Proteus server.  It is designed to take a control number and dataform and pull relevant text.
- * Overall, the function is pretty clunky, and it calls functions with dataforms hardcoded in. This
- * happened because I struggled with asynchronicity of the network requests with the main code.
- * In a nutshell, the network replies were out of sync with their return calls in the main code.  To
- * circumvent this, I added several signals/slots to make sure functions were called sequentially.
+ * The network side, connection reuse, deadlines, cancellation and the local PHR cache, is
+ * ProteusClient; this class ties its replies to the dewar currently loaded and tells the operator
+ * when a PHR check could not be made.  The server URL, timeout and cache settings come from
+ * control/proteus.ini, see ProteusClient::loadSettings().  It has no window of its own; its messages
+ * are shown over the calculator window passed to the constructor.
  *
  * testFetch() is defunct.  It was used in preliminary URL and call tests.  It was left in as an
  * ideal sandbox function for future maintenance.
  *
- * proteusFetch() is called in the main class.  It takes in a dataform, combines with the set control
- * number, and constructs the call URL.  That URL is passed to the appropriate network manager based
- * on dataform.
+ * proteusFetch() is called in the main class.  It takes in a dataform and fetches it for the set
+ * control number.  Any number of dataforms can be in flight at once.
  *
- * replyFinished1061() and replyFinished1065() are called sequentially when the URL call from
- * proteusFetch() completes.  This is called using the signal/slot connection in the constructor.
- * When called, replyFinished() converts the returned data to a string, and then signals the main
- * class that it is ready to compare data.  See MountCS::checkProteusData1061(),
- * MountCS::checkProteusData1065(), MountCF::checkProteusData1061(), MountCF::checkProteusData1065()
+ * cancelFetches() aborts everything still in flight.  The calculators call it when the operator
+ * clears or loads another control number, so a late reply can't be checked against the wrong dewar.
+ *
+ * replyReady() is called when a dataform arrives, from Proteus or the cache.  It keeps the parsed
+ * reply per dataform, and then signals the main class with returnText(dataform) that it is ready to
+ * compare data.  See MountCS::checkProteusData() and MountCF::checkProteusData().  staleReply(),
+ * noData() and fetchFailed() warn the operator so they know how, or whether, the PHR was checked.
+ * Replies for a control number that is no longer loaded are dropped.
  *
  * checkFetchedText() takes in text and a dataform from the main class.  It compares the input text
- * to the downloaded text from the PHR.  Most of this function is locating indices and formatting.
+ * to that dataform's field in the PHR, looked up in the PhrReply parsed when the reply arrived.
+ * fetchedReply() gives the calculators every field of a dataform for any further checks.
 */
 
 #include "proteuslookup.h"
-#include "ui_proteuslookup.h"
 
-ProteusLookup::ProteusLookup(QWidget *parent) :
-    QMainWindow(parent),
-    ui(new Ui::ProteusLookup)
+ProteusLookup::ProteusLookup(QWidget *window) :
+    QObject(window),
+    window(window)
 {
-    ui->setupUi(this);
-    // to store raw text from both dataforms
-    rawText1061 = new QString;
-    rawText1065 = new QString;
-    // manages network communications for both dataforms
-    m_manager_1061 = new QNetworkAccessManager(this);
-    m_manager_1065 = new QNetworkAccessManager(this);
-
-    // when the reply pointer has done downloading, it signals replyFinished to convert to string
-    connect(m_manager_1061, SIGNAL(finished(QNetworkReply*)), this,
-            SLOT(replyFinished1061(QNetworkReply*)));
-    connect(m_manager_1065, SIGNAL(finished(QNetworkReply*)), this,
-            SLOT(replyFinished1065(QNetworkReply*)));
+    // manages network communications and the PHR cache for every dataform
+    client = new ProteusClient(this);
+    client->loadSettings("control/proteus.ini");
+    connect(client, SIGNAL(replyReady(QString,int,PhrReply)),
+            this, SLOT(replyReady(QString,int,PhrReply)));
+    connect(client, SIGNAL(staleReply(QString,int,QString,QDateTime)),
+            this, SLOT(staleReply(QString,int,QString,QDateTime)));
+    connect(client, SIGNAL(noData(QString,int)), this, SLOT(noData(QString,int)));
+    connect(client, SIGNAL(fetchFailed(QString,int,QString)), this, SLOT(fetchFailed(QString,int,QString)));
 }
 
 void ProteusLookup::testFetch( ) {
@@ -59,101 +58,99 @@ void ProteusLookup::testFetch( ) {
 void ProteusLookup::proteusFetch( QString newDataform ) {
     // update ProteusLookup dataform
     dataform = newDataform;
-    currentDataform = dataform.toInt();
-    QString urlStr1 = "http://sbfdb/proteus/application/admin.php?page=GenericService&sender=dataFormResult&controlNbr=";
-    QString urlStr2 = "&dataForm=";
-    // construct url
-    QUrl url(urlStr1 + control + urlStr2 + dataform);
-    // pass url to appropriate network manager
-    switch (currentDataform) {
-    case 1061:  m_manager_1061->get(QNetworkRequest(url)); break;
-    case 1065:  m_manager_1065->get(QNetworkRequest(url)); break;
-    default: QMessageBox::information(this, tr("Dataform Error"), "Could not find dataform.");
-    }
+    // forget any older text for this dataform so it can't be checked against the new control
+    fetched.remove(dataform.toInt());
+    client->fetch(control, dataform.toInt());
+}
+
+void ProteusLookup::cancelFetches( ) {
+    client->cancel();
+}
+
+QString ProteusLookup::rawText( int form ) const {
+    return fetched.value(form).rawText();
 }
 
-void ProteusLookup::replyFinished1061( QNetworkReply *pReply ) {
-    // when data downloaded, replyFinished is signalled and converts data to string
-    QByteArray data = pReply->readAll();
-    *rawText1061 = QString(data);
-    if (rawText1061->contains("No data found")){
-        QMessageBox::warning(this, tr("No PHR Data"),
-                        "No PHR Data found for Optical Center Height.\n"
-                        "All previous dataforms should be completed and uploaded to Proteus.\n"
-                        "Verify and then try again.");
+PhrReply ProteusLookup::fetchedReply( int form ) const {
+    return fetched.value(form);
+}
+
+void ProteusLookup::replyReady( const QString &fetchedControl, int form, const PhrReply &reply ) {
+    if (fetchedControl != control)
         return;
-    }
+    fetched.insert(form, reply);
     // signal main class that it is ready to compare downloaded PHR text to calculator text
-    emit returnText1061(rawText1061);
+    emit returnText(form);
 }
 
-void ProteusLookup::replyFinished1065( QNetworkReply *pReply ) {
-    // when data downloaded, replyFinished is signalled and converts data to string
-    QByteArray data = pReply->readAll();
-    *rawText1065 = QString(data);
-    if (rawText1065->contains("No data found")){
-        QMessageBox::warning(this, tr("No PHR Data"),
-                        "No PHR Data found for Coldshield Height.\n"
-                        "All previous dataforms should be completed and uploaded to Proteus.\n"
-                        "Verify and then try again.");
+void ProteusLookup::staleReply( const QString &fetchedControl, int form, const QString &reason,
+                                const QDateTime &fetchedAt ) {
+    // Proteus is slow or down, the check goes ahead against the cached PHR
+    if (fetchedControl != control)
         return;
-    }
-    // signal main class that it is ready to compare downloaded PHR text to calculator text
-    emit returnText1065(rawText1065);
+    QMessageBox::information(window, tr("PHR From Cache"),
+                    tr("Could not download %1 from Proteus.\n%2\n"
+                       "Checking against the PHR as it was on %3.")
+                    .arg(fieldName(form)).arg(reason).arg(fetchedAt.toString("yyyy-MM-dd hh:mm")));
+}
+
+void ProteusLookup::noData( const QString &fetchedControl, int form ) {
+    if (fetchedControl != control)
+        return;
+    QMessageBox::warning(window, tr("No PHR Data"),
+                    tr("No PHR Data found for %1.\n"
+                       "All previous dataforms should be completed and uploaded to Proteus.\n"
+                       "Verify and then try again.").arg(fieldName(form)));
+}
+
+void ProteusLookup::fetchFailed( const QString &fetchedControl, int form, const QString &reason ) {
+    if (fetchedControl != control)
+        return;
+    QMessageBox::warning(window, tr("PHR Lookup Failed"),
+                    tr("Could not download %1 from Proteus.\n%2\n"
+                       "Verify data in calculator with PHR before proceeding with assembly.")
+                    .arg(fieldName(form)).arg(reason));
 }
 
 void ProteusLookup::checkFetchedText( QString inputText, int dataform ) {
-    // receive inputText (calculator text) and dataform, compare to downloaded PHR text
-    QString checkProteusText;
+    // receive inputText (calculator text) and dataform, compare to the PHR field for that dataform
+    QString key;
     switch (dataform) {
-    case 1061: {
-        // get current proteus text
-        QString rawText = *rawText1061;
-        // get index to start of useful data
-        QString searchText("MPPStepMountFPAMB_DATAFORM1061_Datum__dash_A_dash__to_Optical_Center_Height = ");
-        int searchInd = rawText.indexOf(searchText, Qt::CaseInsensitive) + searchText.length();
-        // parse text for value
-        while (rawText.at(searchInd) != 'M')
-            checkProteusText = checkProteusText + rawText.at(searchInd++);
-        checkProteusText = checkProteusText.trimmed();
-        // check proteus data with input data, return if no issue
-        if (checkProteusText == inputText || checkProteusText.toDouble() == inputText.toDouble())
-            return;
-        else
-            QMessageBox::warning(this, tr("Data Load Error"), tr("Centerline data loaded from Calculator: %1 "
-                                                                "\nCenterline data loaded from Proteus PHR: %2 "
-                                                                "\nData does not appear to match."
-                        "\nVerify data in calculator with PHR before proceeding with assembly.").arg(inputText).arg(checkProteusText));
-        break;
+    case 1061: key = "MPPStepMountFPAMB_DATAFORM1061_Datum__dash_A_dash__to_Optical_Center_Height"; break;
+    case 1065: key = "MPPStepMountColdshield_DATAFORM1065_Datum__dash_A_dash__to_Coldshield_Pedestal__leftParen_CURE_rightParen_"; break;
+    default:
+        QMessageBox::information(window, tr("Dataform Error"), "Could not find dataform.");
+        return;
     }
-    case 1065: {
-        // get current proteus text
-        QString rawText = *rawText1065;
-        // get index to start of useful data
-        QString searchText("MPPStepMountColdshield_DATAFORM1065_Datum__dash_A_dash__to_Coldshield_Pedestal__leftParen_CURE_rightParen_ = ");
-        int searchInd = rawText.indexOf(searchText, Qt::CaseInsensitive) + searchText.length();
-        // parse text for value
-        while (rawText.at(searchInd) != 'M')
-            checkProteusText = checkProteusText + rawText.at(searchInd++);
-        checkProteusText = checkProteusText.trimmed();
-        // check proteus data with input data, return if no issue
-        if (checkProteusText == inputText || checkProteusText.toDouble() == inputText.toDouble())
-            return;
-        else
-            QMessageBox::warning(this, tr("Data Load Error"), tr("Coldshield Height data loaded from Calculator: %1 "
-                                                                "\nColdshield Height loaded from Proteus PHR: %2 "
-                                                                "\nData does not appear to match."
-                        "\nVerify data in calculator with PHR before proceeding with assembly.").arg(inputText).arg(checkProteusText));
-        break;
+    PhrReply reply = fetched.value(dataform);
+    if (!reply.contains(key)) {
+        QMessageBox::warning(window, tr("Data Load Error"), tr("%1 was not found in the Proteus PHR."
+                        "\nVerify data in calculator with PHR before proceeding with assembly.")
+                        .arg(fieldName(dataform)));
+        return;
     }
-    default:
-        QMessageBox::information(this, tr("Dataform Error"), "Could not find dataform.");
+    QString checkProteusText = reply.value(key);
+    // check proteus data with input data, return if no issue
+    if (checkProteusText == inputText || checkProteusText.toDouble() == inputText.toDouble())
+        return;
+    QMessageBox::warning(window, tr("Data Load Error"), tr("%1 data loaded from Calculator: %2 "
+                                                        "\n%1 data loaded from Proteus PHR: %3 "
+                                                        "\nData does not appear to match."
+                "\nVerify data in calculator with PHR before proceeding with assembly.")
+                .arg(fieldName(dataform)).arg(inputText).arg(checkProteusText));
+}
+
+QString ProteusLookup::fieldName( int form ) {
+    // what each dataform is fetched for, used in the operator messages
+    switch (form) {
+    case 1061: return tr("Optical Center Height");
+    case 1065: return tr("Coldshield Height");
+    default: return tr("dataform %1").arg(form);
     }
 }
 
 ProteusLookup::~ProteusLookup()
 {
-    delete rawText1061;
-    delete rawText1065;
-    delete ui;
+    // client is a child and goes with this, nothing may finish into it on the way out
+    disconnect(client, 0, this, 0);
 }
@@ -0,0 +1,125 @@
+/* RecordLoader class is shared code used by the calculators to read and parse a record without
+ * holding up the window.  loadData() asks for the record and returns; the read from the service,
+ * the archive or control/<ctrl>.csv on the share, and the parse into a BuildRecord, happen on the
+ * loader's own thread, and loaded() hands the result back to the GUI thread to fill the form.
+ *
+ * load() starts a record and makes it the one the calculator is waiting for.  A scan that comes in
+ * while a record is still loading supersedes it: every request carries a ticket, the worker skips
+ * a request whose ticket is no longer the latest before reading and again before parsing, and a
+ * result for an old ticket is dropped before it reaches the calculator.  cancel() supersedes the
+ * pending record without starting another, e.g. when the operator clears the form.
+ *
+ * isLoading() and control() tell the calculator whether, and which, record is still on its way.
+ *
+ * RecordLoadWorker does the reading in the loader's thread.  Its archive and service connection
+ * are its own, made there on the first load, so nothing it touches is shared with the GUI thread.
+*/
+
+#include "recordloader.h"
+#include "buildrecordio.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+RecordLoadWorker::RecordLoadWorker( const QString &archivePath, QAtomicInt *latest ) :
+    archivePath(archivePath),
+    latest(latest),
+    archive(0),
+    service(0)
+{
+}
+
+RecordLoadWorker::~RecordLoadWorker()
+{
+    delete archive;
+    delete service;
+}
+
+void RecordLoadWorker::load( int ticket, const QString &control ) {
+    // a newer scan came in while this one was queued
+    if (ticket != latest->fetchAndAddOrdered(0))
+        return;
+    if (!archive) {
+        archive = new BuildArchive(archivePath);
+        service = new CalcServiceClient(archivePath);
+    }
+    RecordLoad result;
+    result.ticket = ticket;
+    result.control = control;
+    result.found = false;
+    result.fieldCount = 0;
+    // records live in the archive, control/<ctrl>.csv is only read for dewars not yet imported
+    QByteArray bytes;
+    CalcServiceClient::Reply served = service->load(control, bytes);
+    if (served == CalcServiceClient::Unavailable)
+        result.found = archive->read(control, bytes);
+    else
+        result.found = served == CalcServiceClient::Ok;
+    if (!result.found) {
+        QFile file(QFileInfo(archivePath).dir().filePath(control + ".csv"));
+        if (!file.open(QIODevice::ReadOnly)) {
+            result.error = file.errorString();
+            emit loaded(result);
+            return;
+        }
+        bytes = file.readAll();
+        result.found = true;
+    }
+    // the share may have taken long enough for the operator to move on
+    if (ticket != latest->fetchAndAddOrdered(0))
+        return;
+    RecordParser parser(bytes.constData(), bytes.size());
+    // single pass over the record populates the build record, one field per line
+    result.fieldCount = BuildRecordIO::load( parser, result.record );
+    result.errors = parser.errors();
+    emit loaded(result);
+}
+
+RecordLoader::RecordLoader( const QString &archivePath, QObject *parent ) :
+    QObject(parent),
+    latest(0)
+{
+    qRegisterMetaType<RecordLoad>("RecordLoad");
+    worker = new RecordLoadWorker(archivePath, &latest);
+    worker->moveToThread(&thread);
+    connect(this, SIGNAL(startLoad(int,QString)), worker, SLOT(load(int,QString)));
+    connect(worker, SIGNAL(loaded(RecordLoad)), this, SLOT(finished(RecordLoad)));
+    thread.start();
+}
+
+RecordLoader::~RecordLoader()
+{
+    // a read in progress finishes, anything queued behind it is skipped
+    cancel();
+    thread.quit();
+    thread.wait();
+    delete worker;
+}
+
+void RecordLoader::load( const QString &control ) {
+    int ticket = latest.fetchAndAddOrdered(1) + 1;
+    pending = control;
+    emit startLoad(ticket, control);
+}
+
+void RecordLoader::cancel( ) {
+    latest.fetchAndAddOrdered(1);
+    pending.clear();
+}
+
+bool RecordLoader::isLoading( ) const {
+    return !pending.isEmpty();
+}
+
+QString RecordLoader::control( ) const {
+    return pending;
+}
+
+void RecordLoader::finished( const RecordLoad &load ) {
+    // superseded by a later load() or cancel() while it was being read
+    if (load.ticket != latest.fetchAndAddOrdered(0))
+        return;
+    pending.clear();
+    emit loaded(load);
+}
@@ -0,0 +1,37 @@
+#ifndef RECORDPARSER_H
+#define RECORDPARSER_H
+
+#include <vector>
+
+// one "key,<tab>value" line of a build record or saveTemplate.csv.  key and value point into
+// the parser's buffer, trimmed, and are only valid while that buffer is.
+struct RecordField {
+    const char *key;
+    int keyLength;
+    const char *value;
+    int valueLength;
+    int line;
+    bool keyIs( const char *text ) const;
+};
+
+struct RecordError {
+    int line;
+    const char *message;
+};
+
+class RecordParser
+{
+public:
+    RecordParser( const char *data, int size );
+    bool next( RecordField &field );
+    const std::vector <RecordError> &errors() const;
+    static double number( const RecordField &field, bool *ok = 0 );
+
+private:
+    const char *pos;
+    const char *end;
+    int line;
+    std::vector <RecordError> errorList;
+};
+
+#endif // RECORDPARSER_H
@@ -0,0 +1,513 @@
+/* SummaryIndex class is shared code used by the calculators and StackupTool to answer questions
+ * across dewars, e.g. which ones are waiting for the coldfilter mount, without opening every
+ * record in the archive.
+ *
+ * control/summary.dat is a 32 byte header followed by one fixed-size entry per control number:
+ * control and serial number, which step markers have been saved, when the calculator saved it,
+ * and every other column of the template, each number row as a double and each text row in 16
+ * bytes (TextWidth), so a question about any column is answered from here.  Longer text is cut
+ * off, so the index, HistoryBrowser and RecordQuery only ever see the first 16 characters.  numberRows() and textRows() list
+ * those rows in the order they are stored.  The header holds the archive's generation, its count
+ * of saves, when the index last matched it, and how many number and text rows an entry holds; an
+ * index written for another template doesn't parse, so it reads as stale and is rebuilt.
+ *
+ * update() is called by saveData() after the record is written to the archive, with the
+ * archive's generation before the write.  The entry is overwritten in place, or appended before the header
+ * count is raised, so a reader never sees a count past the entries written.  The stored
+ * generation only moves forward when it matched archiveBefore; a write the index didn't see, e.g.
+ * StackupTool import, leaves it stale.  Compaction and journal replay change the archive's size
+ * but not its generation, so neither costs the next calculator start a rebuild.  Writers are serialized by control/summary.dat.lock, the
+ * same way BuildArchive locks the archive.
+ *
+ * isStale() is true when the index is missing, unreadable or doesn't match the archive's generation.
+ * rebuild() then summarizes every record in the archive on all cores and rewrites the index.
+ *
+ * waitingFor() lists the dewars whose previous step is saved and the given one isn't.
+ *
+ * columns() reads the index into one array per field, see SummaryColumns, so a question about one
+ * field scans one contiguous array; RecordQuery and HistoryBrowser work from it.
+*/
+
+#include "summaryindex.h"
+#include "buildarchive.h"
+#include "buildrecordio.h"
+#include "recordparser.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+#include <QAtomicInt>
+#include <QtEndian>
+#include <QtConcurrentMap>
+
+static const char summaryMagic[8] = { 'N', '1', '7', '7', 'S', 'U', 'M', '1' };
+static const quint32 summaryVersion = 2;
+static const qint64 summaryHeaderSize = 32;
+static const qint64 summaryFixedSize = 56;
+static const int controlBytes = SummaryIndex::ControlWidth;
+static const int serialBytes = SummaryIndex::SerialWidth;
+static const int textBytes = SummaryIndex::TextWidth;
+
+// fixed part, then a double per number row and textBytes per text row
+static qint64 entrySize() {
+    return summaryFixedSize + 8 * SummaryIndex::numberRows().size()
+            + textBytes * SummaryIndex::textRows().size();
+}
+
+// QThread::msleep() is protected in Qt 4
+class SummarySleep : public QThread
+{
+public:
+    static void msleep( unsigned long ms ) { QThread::msleep(ms); }
+};
+
+// a lock holds a heartbeat file, "pid host beat", that its owner rewrites through long operations,
+// raising the beat each time, so no two heartbeats are alike.  a waiter takes the owner for dead
+// once the heartbeat has not changed for a minute by the waiter's own clock, which neither the
+// share's file times nor another station's clock come into.  the directory of an owner that died
+// before writing one reads as an empty heartbeat and goes stale the same way
+struct LockSighting {
+    QByteArray heartbeat;
+    QElapsedTimer since;
+};
+
+static QMutex sightingMutex;
+static QHash <QString, LockSighting> sightings;
+static QAtomicInt beats;
+
+static QByteArray readHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (!beat.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return beat.readAll();
+}
+
+static QString lockOwner() {
+    return QString("%1 %2").arg(QCoreApplication::applicationPid()).arg(QHostInfo::localHostName());
+}
+
+static bool lockIsStale( const QString &lockPath, QByteArray &heartbeat ) {
+    heartbeat = readHeartbeat(lockPath);
+    if (!QFileInfo(lockPath).exists())
+        return false;
+    QMutexLocker locker(&sightingMutex);
+    if (!sightings.contains(lockPath) || sightings[lockPath].heartbeat != heartbeat) {
+        LockSighting &seen = sightings[lockPath];
+        seen.heartbeat = heartbeat;
+        seen.since.start();
+        return false;
+    }
+    return sightings[lockPath].since.elapsed() > 60000;
+}
+
+static void writeHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (beat.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        beat.write((lockOwner() + QString(" %1\n").arg(beats.fetchAndAddOrdered(1) + 1)).toUtf8());
+}
+
+static void removeLock( const QString &lockPath ) {
+    QFile::remove(lockPath + "/heartbeat");
+    QDir().rmdir(lockPath);
+}
+
+// a stale lock is renamed aside before it is removed: of the stations that found it stale, the one
+// whose rename succeeds breaks it and tries for the lock at once, the others go on waiting.  a lock
+// that was taken afresh just before the rename has another heartbeat and is put back
+static bool breakLock( const QString &lockPath, const QByteArray &stale ) {
+    QString aside = lockPath + ".broken." + lockOwner().replace(' ', '.') + "."
+            + QString::number(beats.fetchAndAddOrdered(1) + 1);
+    if (readHeartbeat(lockPath) != stale || !QDir().rename(lockPath, aside))
+        return false;
+    if (readHeartbeat(aside) != stale) {
+        QDir().rename(aside, lockPath);
+        return false;
+    }
+    removeLock(aside);
+    QMutexLocker locker(&sightingMutex);
+    sightings.remove(lockPath);
+    return true;
+}
+
+// QtConcurrent functor, summarizes one archived record; read() is thread safe once mapped
+struct SummarizeRecord {
+    typedef SummaryEntry result_type;
+    const BuildArchive *archive;
+    SummaryEntry operator()( const QString &control ) const {
+        BuildRecord record;
+        QByteArray bytes;
+        if (archive->read(control, bytes)) {
+            RecordParser parser(bytes.constData(), bytes.size());
+            if (BuildRecordIO::load( parser, record ))
+                return SummaryIndex::summarize( record );
+        }
+        // an empty control number marks a record that couldn't be read, rebuild() drops it
+        SummaryEntry missing;
+        missing.steps = 0;
+        return missing;
+    }
+};
+
+static double readDouble( const uchar *data ) {
+    quint64 bits = qFromLittleEndian<quint64>(data);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void writeDouble( double value, uchar *data ) {
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, data);
+}
+
+static void writeText( const QString &text, uchar *data, int size ) {
+    QByteArray bytes = text.toLatin1().left(size);
+    memset(data, 0, size);
+    memcpy(data, bytes.constData(), bytes.size());
+}
+
+static QString readText( const uchar *data, int size ) {
+    const char *text = reinterpret_cast<const char *>(data);
+    return QString::fromLatin1(text, qstrnlen(text, size));
+}
+
+// the named members are the number rows the summary command and kitting ask for
+static void nameNumbers( SummaryEntry &entry ) {
+    const QVector <int> &rows = SummaryIndex::numberRows();
+    entry.fpaAngle = entry.numbers[rows.indexOf(BuildRecord::RowFpaAngle)];
+    entry.opticalCenter = entry.numbers[rows.indexOf(BuildRecord::RowOpticalCenter)];
+    entry.coldshieldHeight = entry.numbers[rows.indexOf(BuildRecord::RowColdshieldHeight)];
+    entry.csExpectedIcd = entry.numbers[rows.indexOf(BuildRecord::RowCsExpectedIcd)];
+    entry.cfExpectedIcd = entry.numbers[rows.indexOf(BuildRecord::RowCfExpectedIcd)];
+    entry.finalIcd = entry.numbers[rows.indexOf(BuildRecord::RowFinalIcd)];
+}
+
+static QByteArray entryBytes( const SummaryEntry &entry ) {
+    QByteArray bytes(entrySize(), '\0');
+    uchar *data = reinterpret_cast<uchar *>(bytes.data());
+    writeText(entry.control, data, controlBytes);
+    writeText(entry.serial, data + 16, serialBytes);
+    qToLittleEndian<quint32>(entry.steps, data + 40);
+    qToLittleEndian<qint64>(entry.saved.isValid() ? entry.saved.toTime_t() : 0, data + 48);
+    data += summaryFixedSize;
+    for (int i = 0; i < entry.numbers.size(); i++, data += 8)
+        writeDouble(entry.numbers[i], data);
+    for (int i = 0; i < entry.texts.size(); i++, data += textBytes)
+        writeText(entry.texts[i], data, textBytes);
+    return bytes;
+}
+
+static SummaryEntry parseEntry( const uchar *data ) {
+    SummaryEntry entry;
+    entry.control = readText(data, controlBytes);
+    entry.serial = readText(data + 16, serialBytes);
+    entry.steps = qFromLittleEndian<quint32>(data + 40);
+    qint64 saved = qFromLittleEndian<qint64>(data + 48);
+    if (saved)
+        entry.saved = QDateTime::fromTime_t(saved);
+    data += summaryFixedSize;
+    entry.numbers.resize(SummaryIndex::numberRows().size());
+    for (int i = 0; i < entry.numbers.size(); i++, data += 8)
+        entry.numbers[i] = readDouble(data);
+    entry.texts.resize(SummaryIndex::textRows().size());
+    for (int i = 0; i < entry.texts.size(); i++, data += textBytes)
+        entry.texts[i] = readText(data, textBytes);
+    nameNumbers( entry );
+    return entry;
+}
+
+static QByteArray headerBytes( quint32 count, qint64 generation ) {
+    QByteArray bytes(summaryHeaderSize, '\0');
+    uchar *data = reinterpret_cast<uchar *>(bytes.data());
+    memcpy(data, summaryMagic, 8);
+    qToLittleEndian<quint32>(summaryVersion, data + 8);
+    qToLittleEndian<quint32>(count, data + 12);
+    qToLittleEndian<qint64>(generation, data + 16);
+    qToLittleEndian<quint16>(SummaryIndex::numberRows().size(), data + 24);
+    qToLittleEndian<quint16>(SummaryIndex::textRows().size(), data + 26);
+    return bytes;
+}
+
+// false unless bytes starts with a header and fileSize covers its entries
+static bool parseHeader( const QByteArray &bytes, qint64 fileSize, quint32 &count, qint64 &generation ) {
+    if (bytes.size() < summaryHeaderSize || memcmp(bytes.constData(), summaryMagic, 8) != 0)
+        return false;
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    if (qFromLittleEndian<quint32>(data + 8) != summaryVersion
+            || qFromLittleEndian<quint16>(data + 24) != SummaryIndex::numberRows().size()
+            || qFromLittleEndian<quint16>(data + 26) != SummaryIndex::textRows().size())
+        return false;
+    quint32 stored = qFromLittleEndian<quint32>(data + 12);
+    if (fileSize < summaryHeaderSize + stored * entrySize())
+        return false;
+    count = stored;
+    generation = qFromLittleEndian<qint64>(data + 16);
+    return true;
+}
+
+SummaryIndex::SummaryIndex( const QString &path, const QString &archivePath ) :
+    indexPath(path),
+    archivePath(archivePath)
+{
+}
+
+SummaryEntry SummaryIndex::summarize( const BuildRecord &record ) {
+    SummaryEntry entry;
+    entry.control = record.control;
+    entry.serial = record.serial;
+    entry.steps = (record.motherboardSaved ? MotherboardStep : 0)
+            | (record.coldshieldSaved ? ColdshieldStep : 0)
+            | (record.coldfilter1Saved ? Coldfilter1Step : 0)
+            | (record.coldfilter2Saved ? Coldfilter2Step : 0);
+    const QVector <int> &numbers = numberRows();
+    for (int i = 0; i < numbers.size(); i++)
+        entry.numbers << record.*buildRecordFields[numbers[i]].number;
+    const QVector <int> &texts = textRows();
+    for (int i = 0; i < texts.size(); i++)
+        entry.texts << record.*buildRecordFields[texts[i]].text;
+    nameNumbers( entry );
+    return entry;
+}
+
+const QVector <int> &SummaryIndex::numberRows() {
+    static QVector <int> rows;
+    if (rows.isEmpty()) {
+        for (int row = 1; row <= BuildRecord::RowCount; row++)
+            if (buildRecordFields[row].type == RecordNumber)
+                rows << row;
+    }
+    return rows;
+}
+
+const QVector <int> &SummaryIndex::textRows() {
+    // control and serial numbers have their own fields
+    static QVector <int> rows;
+    if (rows.isEmpty()) {
+        for (int row = BuildRecord::RowSerial + 1; row <= BuildRecord::RowCount; row++)
+            if (buildRecordFields[row].type == RecordText)
+                rows << row;
+    }
+    return rows;
+}
+
+qint64 SummaryIndex::archiveGeneration( const QString &archivePath ) {
+    return BuildArchive(archivePath).generation();
+}
+
+bool SummaryIndex::isStale() const {
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return true;
+    quint32 count;
+    qint64 indexed;
+    if (!parseHeader( file.read(summaryHeaderSize), file.size(), count, indexed ))
+        return true;
+    return indexed != archiveGeneration( archivePath );
+}
+
+bool SummaryIndex::update( const BuildRecord &record, qint64 archiveBefore ) {
+    lastError.clear();
+    SummaryEntry entry = summarize( record );
+    entry.saved = QDateTime::currentDateTime();
+    QByteArray control = entry.control.toLatin1().left(controlBytes);
+    if (!lock())
+        return false;
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        lastError = file.errorString();
+        unlock();
+        return false;
+    }
+    QByteArray bytes = file.readAll();
+    quint32 count = 0;
+    qint64 indexed = -1;
+    // an index that can't be read starts over here and stays stale until rebuilt
+    if (!parseHeader( bytes, bytes.size(), count, indexed )) {
+        count = 0;
+        indexed = -1;
+        bytes = headerBytes( 0, -1 );
+        if (!file.resize(0) || file.write(bytes) != bytes.size()) {
+            lastError = file.errorString();
+            file.close();
+            unlock();
+            return false;
+        }
+    }
+    qint64 size = entrySize();
+    quint32 slot = 0;
+    for ( ; slot < count; slot++) {
+        const char *stored = bytes.constData() + summaryHeaderSize + slot * size;
+        if (qstrnlen(stored, controlBytes) == (uint)control.size()
+                && memcmp(stored, control.constData(), control.size()) == 0)
+            break;
+    }
+    QByteArray data = entryBytes( entry );
+    bool ok = file.seek(summaryHeaderSize + slot * size) && file.write(data) == data.size();
+    if (ok) {
+        if (slot == count)
+            count++;
+        if (indexed == archiveBefore)
+            indexed = archiveGeneration( archivePath );
+        QByteArray header = headerBytes( count, indexed );
+        ok = file.flush() && file.seek(0) && file.write(header) == header.size();
+    }
+    if (!ok)
+        lastError = file.errorString();
+    file.close();
+    unlock();
+    return ok;
+}
+
+bool SummaryIndex::rebuild() {
+    lastError.clear();
+    QList <SummaryEntry> list;
+    qint64 indexed = archiveGeneration( archivePath );
+    // the row lists are made here, before summarize() runs on every core
+    numberRows();
+    textRows();
+    if (QFile::exists(archivePath)) {
+        BuildArchive archive(archivePath);
+        if (!archive.map()) {
+            lastError = archive.errorString();
+            return false;
+        }
+        SummarizeRecord summarizeRecord;
+        summarizeRecord.archive = &archive;
+        list = QtConcurrent::blockingMapped(archive.controls(), summarizeRecord);
+        archive.unmap();
+    }
+    QByteArray bytes;
+    quint32 count = 0;
+    for (int i = 0; i < list.size(); i++) {
+        if (list[i].control.isEmpty())
+            continue;
+        bytes += entryBytes( list[i] );
+        count++;
+    }
+    bytes.prepend(headerBytes( count, indexed ));
+    if (!lock())
+        return false;
+    QFile file(indexPath);
+    bool ok = file.open(QIODevice::WriteOnly|QIODevice::Truncate) && file.write(bytes) == bytes.size();
+    if (!ok)
+        lastError = file.errorString();
+    file.close();
+    unlock();
+    return ok;
+}
+
+QList <SummaryEntry> SummaryIndex::entries() const {
+    lastError.clear();
+    QList <SummaryEntry> list;
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = file.errorString();
+        return list;
+    }
+    QByteArray bytes = file.readAll();
+    quint32 count;
+    qint64 indexed;
+    if (!parseHeader( bytes, bytes.size(), count, indexed )) {
+        lastError = "Not a summary index: " + indexPath;
+        return list;
+    }
+    qint64 size = entrySize();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData()) + summaryHeaderSize;
+    list.reserve(count);
+    for (quint32 i = 0; i < count; i++, data += size)
+        list << parseEntry( data );
+    return list;
+}
+
+bool SummaryIndex::columns( SummaryColumns &columns ) const {
+    lastError.clear();
+    columns = SummaryColumns();
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        lastError = file.errorString();
+        return false;
+    }
+    QByteArray bytes = file.readAll();
+    quint32 count;
+    qint64 indexed;
+    if (!parseHeader( bytes, bytes.size(), count, indexed )) {
+        lastError = "Not a summary index: " + indexPath;
+        return false;
+    }
+    int numbers = numberRows().size();
+    int texts = textRows().size();
+    columns.control.resize(count);
+    columns.serial.resize(count);
+    columns.steps.resize(count);
+    columns.saved.resize(count);
+    columns.numbers.resize(numbers);
+    for (int n = 0; n < numbers; n++)
+        columns.numbers[n].resize(count);
+    columns.texts.resize(texts);
+    for (int t = 0; t < texts; t++)
+        columns.texts[t].resize(count);
+    qint64 size = entrySize();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData()) + summaryHeaderSize;
+    for (quint32 i = 0; i < count; i++, data += size) {
+        columns.control[i] = readText(data, controlBytes);
+        columns.serial[i] = readText(data + 16, serialBytes);
+        columns.steps[i] = qFromLittleEndian<quint32>(data + 40);
+        columns.saved[i] = qFromLittleEndian<qint64>(data + 48);
+        const uchar *field = data + summaryFixedSize;
+        for (int n = 0; n < numbers; n++, field += 8)
+            columns.numbers[n][i] = readDouble(field);
+        for (int t = 0; t < texts; t++, field += textBytes)
+            columns.texts[t][i] = readText(field, textBytes);
+    }
+    return true;
+}
+
+QList <SummaryEntry> SummaryIndex::waitingFor( Step step ) const {
+    // the step before has to be saved, the motherboard mount waits on nothing
+    int previous = step >> 1;
+    QList <SummaryEntry> all = entries();
+    QList <SummaryEntry> waiting;
+    for (int i = 0; i < all.size(); i++) {
+        if ((all[i].steps & previous) == previous && !(all[i].steps & step))
+            waiting << all[i];
+    }
+    return waiting;
+}
+
+QString SummaryIndex::path() const {
+    return indexPath;
+}
+
+QString SummaryIndex::errorString() const {
+    return lastError;
+}
+
+bool SummaryIndex::lock() {
+    QDir dir;
+    QString lockPath = indexPath + ".lock";
+    // about five seconds of retries, a save is never held up long for its index entry
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (dir.mkdir(lockPath)) {
+            writeHeartbeat(lockPath);
+            return true;
+        }
+        QByteArray stale;
+        if (lockIsStale(lockPath, stale) && breakLock(lockPath, stale))
+            continue;
+        SummarySleep::msleep(50);
+    }
+    lastError = "Summary index is locked by another station: " + lockPath;
+    return false;
+}
+
+void SummaryIndex::unlock() {
+    removeLock(indexPath + ".lock");
+}
@@ -0,0 +1,135 @@
+/* buildrecordio.cpp contains the load/save code for BuildRecord, the struct recordgen generates from
+ * saveTemplate.csv.  Every row is handled through buildRecordFields[], so nothing here indexes a
+ * template row by number.
+ *
+ * clear() resets a record to the template's default values with no step saved.
+ *
+ * load() copies one record's fields straight into the struct, in template order, and returns the
+ * number of fields read.  A step marker counts as saved when its key is the '*' form.
+ *
+ * save() writes the record back out as the same "key,<tab>value" lines the .csv files used.  Saved
+ * step markers are written as "***", "****", etc. in both columns, like updateSaveTable() did.
+ *
+ * text(), keys() and values() give the text of one row or of the whole record, the latter with the
+ * "@@@" bandaid at index 0 so indices line up with template rows.
+ *
+ * checkTemplate() compares control/saveTemplate.csv as it is now against the template this
+ * program was built with, and describes the first difference it finds.
+*/
+
+#include "buildrecordio.h"
+
+#include <QTextStream>
+#include <qnumeric.h>
+
+namespace BuildRecordIO {
+
+void clear( BuildRecord &record ) {
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        const BuildRecordField &f = buildRecordFields[row];
+        if (f.type == RecordText)
+            record.*f.text = QString::fromLatin1(f.defaultValue);
+        else if (f.type == RecordNumber)
+            record.*f.number = number(QString::fromLatin1(f.defaultValue));
+        else
+            record.*f.marker = false;
+    }
+}
+
+int load( RecordParser &parser, BuildRecord &record ) {
+    clear( record );
+    RecordField field;
+    int row = 1;
+    while (row <= BuildRecord::RowCount && parser.next(field)) {
+        const BuildRecordField &f = buildRecordFields[row++];
+        if (f.type == RecordText) {
+            record.*f.text = QString::fromLatin1(field.value, field.valueLength);
+        } else if (f.type == RecordNumber) {
+            bool ok;
+            double value = RecordParser::number(field, &ok);
+            record.*f.number = ok ? value : qQNaN();
+        } else {
+            record.*f.marker = field.keyIs(f.savedKey);
+        }
+    }
+    return row - 1;
+}
+
+QByteArray save( const BuildRecord &record ) {
+    QByteArray bytes;
+    QTextStream stream(&bytes, QIODevice::WriteOnly);
+    QList <QString> rowKeys = keys(record);
+    for (int row = 1; row <= BuildRecord::RowCount; row++)
+        stream << rowKeys[row] << ",\t" << text(record, row) << endl;
+    stream.flush();
+    return bytes;
+}
+
+QString text( const BuildRecord &record, int row ) {
+    const BuildRecordField &f = buildRecordFields[row];
+    if (f.type == RecordText)
+        return record.*f.text;
+    if (f.type == RecordNumber)
+        return numberText(record.*f.number, f.decimals);
+    return QString::fromLatin1(record.*f.marker ? f.savedKey : f.defaultValue);
+}
+
+double number( const QString &text ) {
+    // empty or non-numeric text is a value that was never entered
+    bool ok;
+    double value = text.trimmed().toDouble(&ok);
+    return ok ? value : qQNaN();
+}
+
+QString numberText( double value, int decimals ) {
+    if (!isSet(value))
+        return QString();
+    return QString::number(value, 'f', decimals);
+}
+
+bool isSet( double value ) {
+    return !qIsNaN(value);
+}
+
+QList <QString> keys( const BuildRecord &record ) {
+    QList <QString> list;
+    // bandaid to line up indices :(
+    list << "@@@";
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        const BuildRecordField &f = buildRecordFields[row];
+        bool saved = f.type == RecordMarker && record.*f.marker;
+        list << QString::fromLatin1(saved ? f.savedKey : f.key);
+    }
+    return list;
+}
+
+QList <QString> values( const BuildRecord &record ) {
+    QList <QString> list;
+    list << "@@@";
+    for (int row = 1; row <= BuildRecord::RowCount; row++)
+        list << text(record, row);
+    return list;
+}
+
+QString checkTemplate( const QByteArray &bytes ) {
+    RecordParser parser(bytes.constData(), bytes.size());
+    RecordField field;
+    int row = 0;
+    while (parser.next(field)) {
+        if (++row > BuildRecord::RowCount)
+            continue;
+        const BuildRecordField &f = buildRecordFields[row];
+        if (!field.keyIs(f.key))
+            return QString("Row %1 is \"%2\", this calculator was built for \"%3\".")
+                    .arg(row).arg(QString::fromLatin1(field.key, field.keyLength))
+                    .arg(QString::fromLatin1(f.key));
+    }
+    if (!parser.errors().empty())
+        return QString("Line %1: %2").arg(parser.errors()[0].line).arg(parser.errors()[0].message);
+    if (row != BuildRecord::RowCount)
+        return QString("The template has %1 rows, this calculator was built for %2.")
+                .arg(row).arg(int(BuildRecord::RowCount));
+    return QString();
+}
+
+}
@@ -0,0 +1,402 @@
+/* HistoryBrowser class is shared code used by the calculators to compare builds across every
+ * dewar in the archive without opening one record at a time.  It lists the summary index,
+ * control/summary.dat, which holds every column of the template for every dewar, so the window
+ * reads one file however many records the archive has.  See SummaryIndex.
+ *
+ * HistoryModel has one row per dewar and one column per template column: control and serial
+ * number, the steps saved so far, every number and text row, and when it was last saved.  It
+ * holds the index column by column, see SummaryColumns, keeps shown, the dewars that pass the
+ * query and the filter in sort order, and formats a cell only when the view paints it, so a table
+ * of 100k dewars only ever formats the rows on screen.
+ *
+ * sort() orders shown by one column, numbers by value with blanks last either way, text without
+ * regard to case.  setFilter() keeps the dewars whose column matches the text: a number column
+ * takes "<x", "<=x", ">x", ">=x" or "low..high", anything else is matched against the cell's text.
+ * The step column reads e.g. "MB CS CF1", so "CF1" finds every dewar through the first coldfilter
+ * mount.
+ *
+ * The query box takes a RecordQuery, e.g. "cfParallelism > 0.0025 and saved >= -90d", run when
+ * Enter is pressed; the filter then narrows what the query picked.
+ *
+ * reload() rereads the index, and reruns the query, each time the window is opened.  Typing in the
+ * filter waits for a pause before filtering, so a long list isn't refiltered on every keystroke.
+*/
+
+#include "historybrowser.h"
+#include "buildrecordio.h"
+
+#include <QComboBox>
+#include <QLineEdit>
+#include <QLabel>
+#include <QTableView>
+#include <QHeaderView>
+#include <QTimer>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QDateTime>
+#include <qnumeric.h>
+
+#include <algorithm>
+
+// blanks sort last in either order
+struct NumberOrder {
+    const QVector <double> *keys;
+    bool descending;
+    bool operator()( int a, int b ) const {
+        double x = (*keys)[a], y = (*keys)[b];
+        if (qIsNaN(x) || qIsNaN(y))
+            return !qIsNaN(x) && qIsNaN(y);
+        return descending ? x > y : x < y;
+    }
+};
+
+struct TextOrder {
+    const QVector <QString> *keys;
+    bool descending;
+    bool operator()( int a, int b ) const {
+        const QString &x = (*keys)[a], &y = (*keys)[b];
+        if (x.isEmpty() || y.isEmpty())
+            return !x.isEmpty() && y.isEmpty();
+        int order = x.compare(y, Qt::CaseInsensitive);
+        return descending ? order > 0 : order < 0;
+    }
+};
+
+static QString stepNames( int steps ) {
+    QStringList names;
+    if (steps & SummaryIndex::MotherboardStep)
+        names << "MB";
+    if (steps & SummaryIndex::ColdshieldStep)
+        names << "CS";
+    if (steps & SummaryIndex::Coldfilter1Step)
+        names << "CF1";
+    if (steps & SummaryIndex::Coldfilter2Step)
+        names << "CF2";
+    return names.join(" ");
+}
+
+static QString columnTitle( int row ) {
+    // template keys are what the build data window shows, less the '&' that makes them bold
+    QString key = QString::fromLatin1(buildRecordFields[row].key);
+    key.remove('&');
+    return key.trimmed();
+}
+
+HistoryModel::HistoryModel( QObject *parent ) :
+    QAbstractTableModel(parent),
+    sortColumn(0),
+    sortOrder(Qt::AscendingOrder),
+    filterColumn(0),
+    filterRange(false),
+    filterLow(0),
+    filterHigh(0)
+{
+    Column column;
+    column.index = 0;
+    column.decimals = 0;
+    column.kind = ControlColumn;
+    column.title = tr("Control");
+    columns << column;
+    column.kind = SerialColumn;
+    column.title = tr("Serial");
+    columns << column;
+    column.kind = StepsColumn;
+    column.title = tr("Steps");
+    columns << column;
+    // template order, so the columns read the way the build goes
+    const QVector <int> &numbers = SummaryIndex::numberRows();
+    const QVector <int> &texts = SummaryIndex::textRows();
+    int n = 0, t = 0;
+    while (n < numbers.size() || t < texts.size()) {
+        if (t == texts.size() || (n < numbers.size() && numbers[n] < texts[t])) {
+            column.kind = NumberColumn;
+            column.index = n;
+            column.decimals = buildRecordFields[numbers[n]].decimals;
+            column.title = columnTitle(numbers[n++]);
+        } else {
+            column.kind = TextColumn;
+            column.index = t;
+            column.decimals = 0;
+            column.title = columnTitle(texts[t++]);
+        }
+        columns << column;
+    }
+    column.kind = SavedColumn;
+    column.index = 0;
+    column.decimals = 0;
+    column.title = tr("Saved");
+    columns << column;
+}
+
+void HistoryModel::setColumns( const SummaryColumns &columns ) {
+    beginResetModel();
+    table = columns;
+    selected.clear();
+    applyFilter();
+    applySort();
+    endResetModel();
+}
+
+void HistoryModel::setQuery( const QBitArray &bits ) {
+    beginResetModel();
+    selected = bits;
+    applyFilter();
+    applySort();
+    endResetModel();
+}
+
+const SummaryColumns &HistoryModel::columns( ) const {
+    return table;
+}
+
+void HistoryModel::setFilter( int column, const QString &text ) {
+    beginResetModel();
+    filterColumn = qBound(0, column, columns.size() - 1);
+    filterText = text.trimmed();
+    filterRange = false;
+    if (isNumber(filterColumn) && !filterText.isEmpty()) {
+        // "low..high", or one bound; an open bound is infinite
+        QString low, high;
+        bool lowOpen = false, highOpen = false;
+        if (filterText.contains("..")) {
+            low = filterText.section("..", 0, 0);
+            high = filterText.section("..", 1);
+        } else if (filterText.startsWith("<")) {
+            highOpen = !filterText.startsWith("<=");
+            high = filterText.mid(highOpen ? 1 : 2);
+            low = "-inf";
+        } else if (filterText.startsWith(">")) {
+            lowOpen = !filterText.startsWith(">=");
+            low = filterText.mid(lowOpen ? 1 : 2);
+            high = "inf";
+        }
+        bool lowOk = false, highOk = false;
+        filterLow = low.trimmed() == "-inf" ? -qInf() : low.trimmed().toDouble(&lowOk);
+        filterHigh = high.trimmed() == "inf" ? qInf() : high.trimmed().toDouble(&highOk);
+        lowOk = lowOk || qIsInf(filterLow);
+        highOk = highOk || qIsInf(filterHigh);
+        if (lowOk && highOk) {
+            filterRange = true;
+            // open bounds become closed ones a hair inside, the values carry 4 decimals at most
+            if (lowOpen)
+                filterLow += 0.00005;
+            if (highOpen)
+                filterHigh -= 0.00005;
+        }
+    }
+    applyFilter();
+    applySort();
+    endResetModel();
+}
+
+int HistoryModel::total( ) const {
+    return table.size();
+}
+
+int HistoryModel::rowCount( const QModelIndex &parent ) const {
+    return parent.isValid() ? 0 : shown.size();
+}
+
+int HistoryModel::columnCount( const QModelIndex &parent ) const {
+    return parent.isValid() ? 0 : columns.size();
+}
+
+QVariant HistoryModel::data( const QModelIndex &index, int role ) const {
+    if (!index.isValid() || index.row() >= shown.size())
+        return QVariant();
+    if (role == Qt::DisplayRole)
+        return text( shown[index.row()], index.column() );
+    if (role == Qt::TextAlignmentRole && isNumber(index.column()))
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    return QVariant();
+}
+
+QVariant HistoryModel::headerData( int section, Qt::Orientation orientation, int role ) const {
+    if (role != Qt::DisplayRole)
+        return QVariant();
+    if (orientation == Qt::Vertical)
+        return section + 1;
+    return section < columns.size() ? columns[section].title : QVariant();
+}
+
+void HistoryModel::sort( int column, Qt::SortOrder order ) {
+    beginResetModel();
+    sortColumn = qBound(0, column, columns.size() - 1);
+    sortOrder = order;
+    applySort();
+    endResetModel();
+}
+
+QString HistoryModel::text( int entry, int column ) const {
+    const Column &c = columns[column];
+    switch (c.kind) {
+    case ControlColumn:
+        return table.control[entry];
+    case SerialColumn:
+        return table.serial[entry];
+    case StepsColumn:
+        return stepNames( table.steps[entry] );
+    case NumberColumn:
+        return BuildRecordIO::numberText( table.numbers[c.index][entry], c.decimals );
+    case TextColumn:
+        return table.texts[c.index][entry];
+    case SavedColumn:
+        if (!table.saved[entry])
+            return QString();
+        return QDateTime::fromTime_t(table.saved[entry]).toString("yyyy-MM-dd hh:mm");
+    }
+    return QString();
+}
+
+double HistoryModel::number( int entry, int column ) const {
+    const Column &c = columns[column];
+    if (c.kind == NumberColumn)
+        return table.numbers[c.index][entry];
+    if (c.kind == StepsColumn)
+        return table.steps[entry];
+    if (c.kind == SavedColumn)
+        return table.saved[entry] ? double(table.saved[entry]) : qQNaN();
+    return qQNaN();
+}
+
+bool HistoryModel::isNumber( int column ) const {
+    return columns[column].kind == NumberColumn;
+}
+
+bool HistoryModel::matches( int entry ) const {
+    if (!selected.isEmpty() && !selected.testBit(entry))
+        return false;
+    if (filterText.isEmpty())
+        return true;
+    if (filterRange) {
+        double value = number( entry, filterColumn );
+        return !qIsNaN(value) && value >= filterLow && value <= filterHigh;
+    }
+    return text( entry, filterColumn ).contains(filterText, Qt::CaseInsensitive);
+}
+
+void HistoryModel::applyFilter( ) {
+    shown.clear();
+    shown.reserve(table.size());
+    for (int i = 0; i < table.size(); i++)
+        if (matches( i ))
+            shown << i;
+}
+
+void HistoryModel::applySort( ) {
+    // keys are pulled out once, the comparisons only index them
+    bool descending = sortOrder == Qt::DescendingOrder;
+    Kind kind = columns[sortColumn].kind;
+    if (kind == NumberColumn || kind == StepsColumn || kind == SavedColumn) {
+        QVector <double> keys(table.size());
+        for (int i = 0; i < shown.size(); i++)
+            keys[shown[i]] = number( shown[i], sortColumn );
+        NumberOrder order;
+        order.keys = &keys;
+        order.descending = descending;
+        std::stable_sort(shown.begin(), shown.end(), order);
+    } else {
+        QVector <QString> keys(table.size());
+        for (int i = 0; i < shown.size(); i++)
+            keys[shown[i]] = text( shown[i], sortColumn );
+        TextOrder order;
+        order.keys = &keys;
+        order.descending = descending;
+        std::stable_sort(shown.begin(), shown.end(), order);
+    }
+}
+
+HistoryBrowser::HistoryBrowser( SummaryIndex *summary, QWidget *parent ) :
+    QWidget(parent),
+    summary(summary),
+    queried(false)
+{
+    setWindowTitle(tr("Build History, All Dewars"));
+    model = new HistoryModel(this);
+    view = new QTableView(this);
+    view->setModel(model);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setAlternatingRowColors(true);
+    view->setWordWrap(false);
+    // every row the same height, so the view only ever lays out the rows on screen
+    view->verticalHeader()->setResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(view->fontMetrics().height() + 4);
+    view->horizontalHeader()->setMovable(true);
+    view->setSortingEnabled(true);
+    view->sortByColumn(0, Qt::AscendingOrder);
+    columnBox = new QComboBox(this);
+    for (int i = 0; i < model->columnCount(); i++) {
+        QString title = model->headerData(i, Qt::Horizontal).toString();
+        columnBox->addItem(title);
+        view->setColumnWidth(i, qMax(70, view->fontMetrics().width(title) + 24));
+    }
+    filterEdit = new QLineEdit(this);
+    filterEdit->setToolTip(tr("Text to find in the column.  Number columns also take\n"
+                              "<x, <=x, >x, >=x or low..high"));
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText(tr("Query, e.g. cfParallelism > 0.0025 and saved >= -90d, then Enter"));
+    queryEdit->setToolTip(tr("Terms are field op value, joined by and, or and ( ).\n"
+                             "Fields: %1").arg(RecordQuery::fieldNames().join(", ")));
+    countLabel = new QLabel(this);
+    filterTimer = new QTimer(this);
+    filterTimer->setSingleShot(true);
+    filterTimer->setInterval(200);
+    connect(filterEdit, SIGNAL(textChanged(QString)), this, SLOT(filterChanged()));
+    connect(columnBox, SIGNAL(currentIndexChanged(int)), this, SLOT(filterChanged()));
+    connect(filterTimer, SIGNAL(timeout()), this, SLOT(applyFilter()));
+    connect(queryEdit, SIGNAL(returnPressed()), this, SLOT(applyQuery()));
+    QHBoxLayout *filterRow = new QHBoxLayout();
+    filterRow->addWidget(new QLabel(tr("Filter"), this));
+    filterRow->addWidget(columnBox);
+    filterRow->addWidget(filterEdit, 1);
+    filterRow->addWidget(countLabel);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(queryEdit);
+    layout->addLayout(filterRow);
+    layout->addWidget(view);
+    resize(960, 600);
+}
+
+void HistoryBrowser::reload( ) {
+    SummaryColumns columns;
+    indexNote.clear();
+    if (!summary->columns( columns ))
+        indexNote = summary->errorString();
+    else if (summary->isStale())
+        indexNote = tr("index is behind the archive");
+    model->setColumns( columns );
+    if (queried)
+        model->setQuery( query.run( model->columns() ) );
+    showCount();
+}
+
+void HistoryBrowser::filterChanged( ) {
+    filterTimer->start();
+}
+
+void HistoryBrowser::applyFilter( ) {
+    model->setFilter( columnBox->currentIndex(), filterEdit->text() );
+    showCount();
+}
+
+void HistoryBrowser::applyQuery( ) {
+    queryNote.clear();
+    queried = !queryEdit->text().trimmed().isEmpty();
+    if (queried && !query.parse( queryEdit->text() )) {
+        queryNote = query.errorString();
+        queried = false;
+    }
+    model->setQuery( queried ? query.run( model->columns() ) : QBitArray() );
+    showCount();
+}
+
+void HistoryBrowser::showCount( ) {
+    QStringList notes;
+    notes << tr("%1 of %2 dewars").arg(model->rowCount()).arg(model->total());
+    if (!queryNote.isEmpty())
+        notes << queryNote;
+    if (!indexNote.isEmpty())
+        notes << indexNote;
+    countLabel->setText(notes.join(", "));
+}
@@ -1,34 +1,70 @@
 /* mountcs.cpp contains main callouts for coldshield mounting calculator.
  *
- * loadData() does some basic error checking, loads a .csv file, populates the appropriate fields.
+ * loadData() does some basic error checking and starts loading a record from the archive (or a not
+ * yet imported .csv file) on RecordLoader's thread, so a slow share never freezes the window.  The
+ * window shows a busy cursor until recordLoaded() populates the appropriate fields.  A new scan
+ * or clearData() drops a record still loading, and saveData() waits for it.
  * Control and dataform numbers are passed to the ProteusLookup class so that PHR history can be
- * downloaded via ProteusLookup::proteusFetch().
+ * downloaded via ProteusLookup::proteusFetch().  proteusLookup() makes it on the first load.
+ * The fetch runs alongside the record load; a PHR that comes back first is checked by
+ * recordLoaded() once the form holds the new dewar, never against the previous one.
  *
- * saveData() checks for duplicate data, updates the saveTable, and writes the saveTable contents
- * to a .csv file.
+ * saveData() checks for duplicate data, updates the build record, and writes it to the build
+ * record archive, control/archive.dat.  Only the lines that changed are appended, and the archive
+ * is compacted in the background once enough deltas pile up.  See BuildArchive.  The SPC
+ * statistics in control/spc.dat are updated with the saved values, see SpcStats, and so is the
+ * dewar's line in the summary index, control/summary.dat, see SummaryIndex.  The constructor
+ * rebuilds the index when it is missing or out of step with the archive.  When StackupTool serve is
+ * running, loads and saves go through it instead, see CalcServiceClient; it keeps the archive, SPC
+ * statistics and index open for every station, and the constructor leaves the journal and the
+ * index to it.
  *
  * clearData() clears all fields and resets the dataLoaded boolean.
  *
+ * recordChanged() tells the operator when the open record was saved at another station.  The
+ * RecordWatcher has already merged the changed rows; recordLoaded() binds the form fields to rows
+ * for it, and saveData() asks before overwriting a copy saved elsewhere since it was loaded.
+ *
  * calculateData() checks that all required fields are populated and then calculates Coldshield
  * Height, expected ICD, and Parallelism.  The function is structured to either take in an input
  * average coldshield height from inputCS, or to calculate an average height for inputCS from
  * inputPlateau1, inputPlateau2, inputPlateau3, and inputPlateau4.  The calculated values are then
- * checked against the design spec and color-coded accordingly.
+ * checked against the design spec and color-coded accordingly.  The formulas and spec limits live
+ * in stackupcalc.cpp so that StackupTool can re-run them headless.
  *
  * getScreenShot() takes a screenshot of the current window and saves to a desired directory.
  *
- * showNotepad(), showCalculations(), showBuildData(), showTutorial(), showAbout() all reference
- * functions in the ViewBuildData class.
+ * showNotepad(), showCalculations(), showBuildData(), showSpc(), showTutorial(), showAbout() all
+ * reference functions in the ViewBuildData class, which buildData() makes on first use.  The build
+ * data window views record directly and is refreshed wherever record changes.
+ *
+ * showHistory() opens a browser of every dewar in the summary index, sorted and filtered by any
+ * column of the template.  See HistoryBrowser.
  *
  * checkProteusData() calls the ProteusLookup class to verify that the data in the calculator
  * matches the production data saved in the PHR.  checkProteusData() is segregated by dataform.
  * It is called by way of the signal/slot in the constructor.
  *
- * initializeTables() sets up the save tables structures for load/save.
+ * prefetchProteus() takes a list of control numbers, wanded one per line, pasted or loaded from a
+ * file with loadPrefetchFile(), and has PhrPrefetch fetch their PHRs into the station's cache in
+ * the background, so loading them later doesn't wait on Proteus.  Progress and the final count
+ * are shown in the status bar.
+ *
+ * initializeTables() resets the build record to the saveTemplate.csv defaults.  The record is a
+ * BuildRecord, generated from the template at build time by recordgen, see buildrecordio.cpp.
+ *
+ * verifyTemplate() warns at launch when control/saveTemplate.csv has changed since this
+ * calculator was built.
+ *
+ * updateSaveTable() updates the build record before writing to the archive.
  *
- * updateSaveTable() updates the save tables before writing to .csv.
+ * readRecord() reads a record through the service, or from the archive when none is running.
  *
- * fileExists() and checkText() are error checking functions.
+ * The constructor times each step of the launch with StartupTrace when the calculator is started
+ * with --trace-startup.
+ *
+ * fileExists() and checkText() are error checking functions.  reportParseErrors() lists any
+ * malformed lines found by RecordParser when a record or the template is read.
 */
 
 #include "mountcs.h"
@@ -38,7 +74,9 @@ MountCS::MountCS(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MountCS)
 {
+    StartupTrace::phase("setupUi");
     ui->setupUi(this);
+    StartupTrace::phase("findChild");
     // set up local variables from XML in .ui file
     inputControl = MountCS::findChild<QLineEdit *>("lineEditControl");
     inputSerial = MountCS::findChild<QLineEdit *>("lineEditSerial");
@@ -54,21 +92,53 @@ MountCS::MountCS(QWidget *parent) :
     outputParallel = MountCS::findChild<QLabel *>("labelOutputParallel");
     // dataLoaded is a boolean which will tell whether data has been loaded
     dataLoaded = false;
-    // this is the saving table template path, then tables are initialized
-    pathTemplate = new QString("control/saveTemplate.csv");
-    initializeTables( pathTemplate );
+    StartupTrace::phase("archive and service");
+    // every control number's record is kept in this one indexed file
+    archive = new BuildArchive("control/archive.dat");
+    // a running StackupTool serve shares its cache of records it has read, see CalcServiceClient
+    service = new CalcServiceClient("control/archive.dat");
+    bool served = service->isAvailable();
+    // saves journaled by a station that stopped before applying them go in before anything is read,
+    // the service did that, and the index rebuild below, when it started
+    if (!served && !archive->replayJournal())
+        statusBar()->showMessage(tr("Save journal not replayed: %1").arg(archive->errorString()));
+    StartupTrace::phase("SpcStats, RecordWatcher, SummaryIndex");
+    // running mean, sigma and pass/fail counts of every characteristic, kept up to date on save
+    spc = new SpcStats("control/spc.dat");
+    // the open record follows saves from other stations, see RecordWatcher
+    watcher = new RecordWatcher(archive, &record);
+    connect(watcher, SIGNAL(recordChanged(QStringList,QStringList)), this,
+            SLOT(recordChanged(QStringList,QStringList)));
+    // records are read and parsed off the GUI thread, see loadData()
+    loader = new RecordLoader("control/archive.dat", this);
+    connect(loader, SIGNAL(loaded(RecordLoad)), this, SLOT(recordLoaded(RecordLoad)));
+    // step state and key outputs of every dewar, rebuilt here if a save or import went around it
+    summary = new SummaryIndex("control/summary.dat", "control/archive.dat");
+    if (!served && summary->isStale() && !summary->rebuild())
+        statusBar()->showMessage(tr("Summary index not rebuilt: %1").arg(summary->errorString()));
+    StartupTrace::phase("dialogs");
     controlInputDialog = new QInputDialog();
     kickBox = new QMessageBox();
-    viewBuildData = new ViewBuildData();
-    proteus = new ProteusLookup();
-    // connect signal from ProteusLookup class that data has been downloaded, SLOT checks text
-    connect(proteus, SIGNAL(returnText1061(QString*)), this, SLOT(checkProteusData1061()));
+    // build data, notepad and SPC windows are made the first time one is asked for, see buildData()
+    viewBuildData = 0;
+    history = 0;
+    StartupTrace::phase("template");
+    // the record layout is compiled in from the template, check the template hasn't moved since
+    pathTemplate = new QString("control/saveTemplate.csv");
+    verifyTemplate( pathTemplate );
+    initializeTables( );
+    // the PHR lookup and prefetch each load settings and prune the cache, neither is needed until
+    // the first load or prefetch, see proteusLookup() and prefetchProteus()
+    proteus = 0;
+    prefetch = 0;
+    StartupTrace::end();
 }
 
 void MountCS::loadData() {
     bool ok;
-    // reset saving tables
-    initializeTables( pathTemplate );
+    // reset build record, the previous one is no longer followed
+    watcher->stop();
+    initializeTables( );
     controlInputDialog->setOptions(QInputDialog::NoButtons);
     QString inputText = controlInputDialog->getText(this, "Load Data", "Wand or input Control Number:",
                                       QLineEdit::Normal, inputControl->text(), &ok);
@@ -77,59 +147,83 @@ void MountCS::loadData() {
     QString loadText = checkText( inputText );
     if (!goodText)
         return;
-    QString fileName = "control/" + loadText + ".csv";
+    // nothing on the form belongs to the new dewar until recordLoaded() fills it
+    inputCF->clear();
+    inputFPA->clear();
+    inputCS->clear();
+    inputPlateau1->clear();
+    inputPlateau2->clear();
+    inputPlateau3->clear();
+    inputPlateau4->clear();
+    phrWaiting.clear();
     // fetch data from proteus, ProteusLookup::proteusFetch( string );
+    // anything still in flight for the previous control is dropped first
+    proteusLookup()->cancelFetches();
     proteus->control = "C" + loadText;
     proteus->proteusFetch( "1061" );
-    QFile file(fileName);
-    if(!file.open(QIODevice::ReadOnly)) {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the record is read and parsed on the loader's thread, recordLoaded() fills the form
+    loader->load(loadText);
+    setCursor(Qt::BusyCursor);
+    statusBar()->showMessage(tr("Loading C%1...").arg(loadText));
+}
+
+void MountCS::recordLoaded( const RecordLoad &load ) {
+    unsetCursor();
+    statusBar()->clearMessage();
+    // with no record there is nothing to check the PHR against
+    QList <int> waiting = phrWaiting;
+    phrWaiting.clear();
+    if (!load.found) {
+        kickBox->information(this, tr("Unable to open file"), load.error);
         return;
     }
-    QMap <QString, QString> data;
-    int counter = 1;
-    // while loop to populate tables with values from .csv
-    while (!file.atEnd()) {
-        QByteArray line = file.readLine();
-        data.insert(line.split(',').first(), line.split(',').last().trimmed());
-        saveTable[counter++] = line.split(',').last().trimmed();
-    }
-    file.close();
-    if(data.isEmpty()) {
+    record = load.record;
+    reportParseErrors( load.errors, "C" + load.control );
+    if(load.fieldCount == 0) {
         kickBox->information(this, tr("No data in file"),
                 tr("The file you are attempting to open contains no data."));
     } else {
         dataLoaded = true;
-        // populate fields in calculator with table data
-        inputControl->setText(data.value(saveTemplate[1]));
-        inputSerial->setText(data.value(saveTemplate[2]));
-        if (!data.contains("****")) {
-            inputCF->setText(QString::number(saveTable[15].toDouble(), 'f', 3));
-            inputFPA->setText(QString::number(data.value(saveTemplate[8]).toDouble(), 'f', 4));
+        // populate fields in calculator with record data
+        inputControl->setText(record.control);
+        inputSerial->setText(record.serial);
+        if (!record.coldshieldSaved) {
+            watcher->bind(BuildRecord::RowColdfilterThickness, inputCF, 3);
+            watcher->bind(BuildRecord::RowOpticalCenter, inputFPA);
         } else {
-            inputPlateau1->setText(QString::number(data.value(saveTemplate[10]).toDouble(), 'f', 4));
-            inputPlateau2->setText(QString::number(data.value(saveTemplate[11]).toDouble(), 'f', 4));
-            inputPlateau3->setText(QString::number(data.value(saveTemplate[12]).toDouble(), 'f', 4));
-            inputPlateau4->setText(QString::number(data.value(saveTemplate[13]).toDouble(), 'f', 4));
-            inputCS->setText(QString::number(data.value(saveTemplate[14]).toDouble(), 'f', 4));
-            inputCF->setText(QString::number(data.value(saveTemplate[15]).toDouble(), 'f', 3));
-            inputFPA->setText(QString::number(data.value(saveTemplate[16]).toDouble(), 'f', 4));
-            if (inputBL->findText(data.value(saveTemplate[17]))==-1)
-                inputBL->addItem(data.value(saveTemplate[17]));
-            inputBL->setCurrentIndex(inputBL->findText(data.value(saveTemplate[17])));
+            watcher->bind(BuildRecord::RowPlateau1, inputPlateau1);
+            watcher->bind(BuildRecord::RowPlateau2, inputPlateau2);
+            watcher->bind(BuildRecord::RowPlateau3, inputPlateau3);
+            watcher->bind(BuildRecord::RowPlateau4, inputPlateau4);
+            watcher->bind(BuildRecord::RowColdshieldHeight, inputCS);
+            watcher->bind(BuildRecord::RowColdfilterThickness, inputCF, 3);
+            watcher->bind(BuildRecord::RowCsOpticalCenter, inputFPA);
+            if (inputBL->findText(record.csBondline)==-1)
+                inputBL->addItem(record.csBondline);
+            inputBL->setCurrentIndex(inputBL->findText(record.csBondline));
             // once data loaded, calculate end values and lock control number and serial number fields.
             calculateData( );
         }
+        watcher->watch(load.control);
+        for (int i = 0; i < waiting.size(); i++)
+            checkProteusData(waiting[i]);
         inputControl->setEnabled(false);
         inputSerial->setEnabled(false);
         inputCF->setEnabled(false);
         inputFPA->setEnabled(false);
     }
     //rawProteusText = proteus->rawText1061;
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountCS::saveData() {
     bool ok;
+    if (loader->isLoading()) {
+        kickBox->warning(this, tr("Save Error"), tr("C%1 is still loading.").arg(loader->control()));
+        return;
+    }
     if ( inputSerial->text().isEmpty() ) {
         kickBox->warning(this, tr("Save Error"), tr("No dewar serial number input."));
         return;
@@ -152,7 +246,7 @@ void MountCS::saveData() {
     inputControl->setText(saveText);
     QString fileName = "control/" + saveText + ".csv";
     // check for duplicate files and if so, should the file be overwritten
-    if (!dataLoaded && fileExists(fileName)) {
+    if (!dataLoaded && (archive->contains(saveText) || fileExists(fileName))) {
         kickBox->warning(this, tr("Saved Data Detected"),
                             tr("Save data for C%1 detected but not loaded.\n"
                                "To avoid overwriting production history, "
@@ -164,31 +258,65 @@ void MountCS::saveData() {
         if (reply == QMessageBox::No)
             return;
     }
-    // update all tables from current calculator fields for writing to .csv
+    // update the build record from current calculator fields for writing to the archive
     updateSaveTable( );
-    QFile file(fileName);
-    QMap <QString, QString> data;
-    if(file.open(QFile::WriteOnly|QFile::Truncate)) {
-        QTextStream stream(&file);
-        int rowCount = saveTable.size() - 1;
-        // populate file stream with table data and close
-        for (int i = 1; i <= rowCount; i++) {
-            data.insert(saveTemplate[i], saveTable[i]);
-            stream << saveTemplate[i] << ",\t" << saveTable[i] << endl;
-        }
-        file.close();
-    } else {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the copy being overwritten comes back out of the SPC statistics
+    QByteArray previous;
+    readRecord(saveText, previous);
+    // another station saved this dewar after it was loaded here
+    if (!watcher->isCurrent(saveText, previous)) {
+        QString both;
+        if (!watcher->conflicts().isEmpty())
+            both = tr("\nChanged at both stations: %1").arg(watcher->conflicts().join(", "));
+        QMessageBox::StandardButton reply;
+        reply = QMessageBox::question(this, "Record Changed",
+                            tr("C%1 was saved at another station after it was loaded here.%2\n"
+                               "Overwrite it with this station's values?").arg(saveText).arg(both),
+                                    QMessageBox::Yes|QMessageBox::No);
+        if (reply == QMessageBox::No)
+            return;
+    }
+    // same "key,\tvalue" rows the .csv files used; the service writes and counts them in one go
+    QString warnings;
+    CalcServiceClient::Reply served = service->save(saveText, BuildRecordIO::save(record), warnings);
+    if (served == CalcServiceClient::Failed) {
+        kickBox->information(this, tr("Unable to save record"), service->errorString());
         return;
     }
-    if(data.isEmpty()) {
-        kickBox->information(this, tr("No data in file"),
-                tr("The file you are attempting to save contains no data."));
+    if (served == CalcServiceClient::Unavailable) {
+        qint64 archiveBefore = SummaryIndex::archiveGeneration( archive->path() );
+        if (!archive->write(saveText, BuildRecordIO::save(record))) {
+            kickBox->information(this, tr("Unable to save record"), archive->errorString());
+            return;
+        }
+        // the record is saved either way, StackupTool spc and summary --rebuild recover the rest
+        if (!spc->update(previous, record))
+            statusBar()->showMessage(tr("SPC statistics not updated: %1").arg(spc->errorString()));
+        if (!summary->update(record, archiveBefore))
+            statusBar()->showMessage(tr("Summary index not updated: %1").arg(summary->errorString()));
+        // saves append deltas, every so often one station folds them back in on another thread
+        if (archive->wantsCompaction())
+            QtConcurrent::run(BuildArchive::compactPath, archive->path());
+    } else if (!warnings.isEmpty()) {
+        statusBar()->showMessage(warnings.section('\n', 0, 0));
     }
+    // this save is now the copy the open record follows
+    watcher->watch(saveText);
 }
 
 void MountCS::clearData() {
     dataLoaded = false;
+    watcher->stop();
+    // a record still loading belongs to the dewar being cleared
+    if (loader->isLoading()) {
+        loader->cancel();
+        phrWaiting.clear();
+        unsetCursor();
+        statusBar()->clearMessage();
+    }
+    // PHR checks still in flight belong to the dewar being cleared
+    if (proteus)
+        proteus->cancelFetches();
     // error if no fields populated, set enabled toggled to active in case incorrectly disabled
     if( inputFPA->text().isEmpty() && inputCF->text().isEmpty()
             && inputCS->text().isEmpty() && inputPlateau1->text().isEmpty()
@@ -229,7 +357,7 @@ void MountCS::clearData() {
     outputHeight->setStyleSheet("");
     outputParallel->clear();
     outputParallel->setStyleSheet("");
-    initializeTables( pathTemplate );
+    initializeTables( );
 }
 
 void MountCS::calculateData() {
@@ -274,20 +402,18 @@ void MountCS::calculateData() {
         double plat2 = inputPlateau2->text().toDouble();
         double plat3 = inputPlateau3->text().toDouble();
         double plat4 = inputPlateau4->text().toDouble();
+        double plateaus [] = { plat1, plat2, plat3, plat4 };
 
-        avg = ( abs(plat1) + abs(plat2) + abs(plat3) + abs(plat4) ) / 4;
+        avg = Stackup::averageHeight( plateaus, 4 );
 
         // parallelism only possible if (4) plateau heights input to calculate average height
         inputCS->setText(QString::number(avg, 'f', 4));
-        QList<double> plateaus;
-        plateaus << plat1 << plat2 << plat3 << plat4;
-        std::sort( plateaus.begin(), plateaus.end() );
 
-        parallel = abs( plateaus.back() - plateaus.front() );
+        parallel = Stackup::parallelism( plateaus, 4 );
 
         outputParallel->setText(QString::number(parallel, 'f', 4));
         // once calculated, populate output objects and color-code according to spec
-        if ( parallel > 0.0020 )
+        if ( Stackup::parallelStatus(parallel, Stackup::csParallelMax) == Stackup::Red )
             outputParallel->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputParallel->setStyleSheet("QLabel { background-color : green; color : black; }");
@@ -312,11 +438,11 @@ void MountCS::calculateData() {
         double cf = inputCF->text().toDouble();
         double bl = inputBL->currentText().toDouble();
 
-        sum = abs(cs) - abs(fpa) + abs(cf) + abs(bl);
+        sum = Stackup::coldshieldIcd( cs, fpa, cf, bl );
 
         outputHeight->setText(QString::number(sum, 'f', 4));
         // once calculated, populate output objects and color-code according to spec
-        if(sum > 5.6013 || sum < 5.5933)
+        if(Stackup::icdStatus(sum) == Stackup::Red)
             outputHeight->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputHeight->setStyleSheet("QLabel { background-color : green; color : black; }");
@@ -336,71 +462,201 @@ void MountCS::getScreenShot() {
 }
 
 void MountCS::showNotepad() {
-    viewBuildData->showNotePad();
+    buildData()->showNotePad();
 }
 
 void MountCS::showCalculations() {
-    viewBuildData->showLink( QString("calcs") );
+    buildData()->showLink( QString("calcs") );
 }
 
 void MountCS::showBuildData() {
-    viewBuildData->showTable( saveTemplate, saveTable );
-    viewBuildData->show();
+    buildData()->showTable( &record );
+    buildData()->show();
+}
+
+void MountCS::showSpc() {
+    buildData()->showSpc( spc->summaries() );
+}
+
+void MountCS::showHistory() {
+    // made on first use, the summary index is reread every time it's opened
+    if (!history)
+        history = new HistoryBrowser(summary);
+    history->reload();
+    history->show();
+    history->raise();
+}
+
+void MountCS::recordChanged( const QStringList &applied, const QStringList &conflicts ) {
+    if (conflicts.isEmpty())
+        statusBar()->showMessage(tr("C%1 was saved at another station, updated %2")
+                                 .arg(watcher->control()).arg(applied.join(", ")));
+    else
+        statusBar()->showMessage(tr("C%1 was saved at another station, kept your edits to %2")
+                                 .arg(watcher->control()).arg(conflicts.join(", ")));
+    // outputs already shown are recalculated from the updated fields
+    if (!outputHeight->text().isEmpty())
+        calculateData( );
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountCS::showTutorial() {
-    viewBuildData->showLink( QString("tutorial") );
+    buildData()->showLink( QString("tutorial") );
 }
 
 void MountCS::showAbout() {
     QString exeName = "ColdshieldMount.exe\n";
-    viewBuildData->showAbout( exeName );
+    buildData()->showAbout( exeName );
 }
 
-void MountCS::checkProteusData1061( ) {
-    // when ProteusLookup::replyFinished1061 finishes, it signals this function to check pulled text
+void MountCS::checkProteusData( int dataform ) {
+    // when ProteusLookup::replyFinished finishes, it signals this function to check pulled text
     // inputFPA is passed to checkFectchedText() to compare it to what is in the PHR.
-    proteus->checkFetchedText(inputFPA->text(), 1061);
+    // a PHR that arrives before the record is checked once recordLoaded() has filled it
+    if (loader->isLoading()) {
+        if (!phrWaiting.contains(dataform))
+            phrWaiting << dataform;
+        return;
+    }
+    if (dataform == 1061)
+        proteus->checkFetchedText(inputFPA->text(), 1061);
+}
+
+void MountCS::prefetchProteus() {
+    // scan queue: the wand ends each control number with Enter, which starts a new line
+    QDialog listDialog(this);
+    listDialog.setWindowTitle(tr("Prefetch PHRs"));
+    QVBoxLayout *layout = new QVBoxLayout(&listDialog);
+    layout->addWidget(new QLabel(tr("Wand, paste or load the control numbers to prefetch:")));
+    QPlainTextEdit *listEdit = new QPlainTextEdit();
+    listEdit->setObjectName("plainTextPrefetch");
+    layout->addWidget(listEdit);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    QPushButton *fileButton = buttons->addButton(tr("Load File..."), QDialogButtonBox::ActionRole);
+    layout->addWidget(buttons);
+    connect(fileButton, SIGNAL(clicked()), this, SLOT(loadPrefetchFile()));
+    connect(buttons, SIGNAL(accepted()), &listDialog, SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), &listDialog, SLOT(reject()));
+    if (listDialog.exec() != QDialog::Accepted)
+        return;
+    QStringList controls = PhrPrefetch::parseControls(listEdit->toPlainText());
+    if (controls.isEmpty()) {
+        kickBox->warning(this, tr("Input Error"), tr("No 10-digit Control Numbers were found."));
+        return;
+    }
+    if (!prefetch) {
+        // fills the PHR cache ahead of the shift, separate from proteus so loadData() never cancels it
+        prefetch = new PhrPrefetch();
+        connect(prefetch, SIGNAL(progress(int,int)), this, SLOT(showPrefetchProgress(int,int)));
+        connect(prefetch, SIGNAL(finished()), this, SLOT(prefetchFinished()));
+    }
+    if (prefetch->client->cacheDir().isEmpty()) {
+        kickBox->warning(this, tr("Prefetch Error"), tr("The PHR cache is turned off in "
+                                                          "control/proteus.ini, nothing can be prefetched."));
+        return;
+    }
+    prefetch->start(controls);
+}
+
+void MountCS::loadPrefetchFile() {
+    // the list edit lives in the dialog that owns the button
+    QWidget *button = qobject_cast<QWidget *>(sender());
+    QPlainTextEdit *listEdit = button ? button->window()->findChild<QPlainTextEdit *>("plainTextPrefetch") : 0;
+    if (!listEdit)
+        return;
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Control Numbers"), "control",
+                                                    tr("Text Files (*.txt *.csv);;All Files (*)"));
+    QFile file(fileName);
+    if (fileName.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    listEdit->appendPlainText(QString::fromLatin1(file.readAll()));
+}
+
+void MountCS::showPrefetchProgress( int done, int total ) {
+    statusBar()->showMessage(tr("Prefetching PHRs: %1 of %2 dataforms").arg(done).arg(total));
+}
+
+void MountCS::prefetchFinished() {
+    statusBar()->showMessage(tr("PHR prefetch done, %1").arg(prefetch->summary()));
 }
 
-void MountCS::initializeTables( QString* path ) {
-    // reset all tables at .exe launch or during clearData(), etc
-    saveTemplate.clear();
-    saveTable.clear();
+void MountCS::initializeTables( ) {
+    // reset the build record at .exe launch or during clearData(), etc
+    BuildRecordIO::clear( record );
+}
+
+void MountCS::verifyTemplate( QString* path ) {
     QFile templat(*path);
     if(!templat.open(QIODevice::ReadOnly)) {
         kickBox->information(this, tr("Unable to open file"), templat.errorString());
         return;
     }
-    while (!templat.atEnd()) {
-        QByteArray line = templat.readLine();
-        saveTemplate << line.split(',').first().trimmed();
-        saveTable << line.split(',').last().trimmed();
-    }
-    // bandaid to line up indices :(
-    saveTemplate.prepend("@@@@");
-    saveTable.prepend("@@@@");
+    QString problem = BuildRecordIO::checkTemplate( templat.readAll() );
     templat.close();
+    if (!problem.isEmpty())
+        kickBox->warning(this, tr("Template Mismatch"),
+                         tr("%1 has changed since this calculator was built.\n"
+                            "Records saved now may not line up with the template.\n\n%2")
+                         .arg(*path).arg(problem));
 }
 
 void MountCS::updateSaveTable( ) {
-    // get all current data from calulator fields and insert in saveTable array
-    saveTable[1] = inputControl->text();
-    saveTable[2] = inputSerial->text();
-    saveTable[10] = inputPlateau1->text();
-    saveTable[11] = inputPlateau2->text();
-    saveTable[12] = inputPlateau3->text();
-    saveTable[13] = inputPlateau4->text();
-    saveTable[14] = inputCS->text();
-    saveTable[15] = inputCF->text();
-    saveTable[16] = inputFPA->text();
-    saveTable[17] = inputBL->currentText();
-    saveTable[18] = outputHeight->text();
-    saveTable[19] = outputParallel->text();
+    // get all current data from calulator fields and insert in the build record
+    record.control = inputControl->text();
+    record.serial = inputSerial->text();
+    record.plateau1 = BuildRecordIO::number(inputPlateau1->text());
+    record.plateau2 = BuildRecordIO::number(inputPlateau2->text());
+    record.plateau3 = BuildRecordIO::number(inputPlateau3->text());
+    record.plateau4 = BuildRecordIO::number(inputPlateau4->text());
+    record.coldshieldHeight = BuildRecordIO::number(inputCS->text());
+    record.coldfilterThickness = BuildRecordIO::number(inputCF->text());
+    record.csOpticalCenter = BuildRecordIO::number(inputFPA->text());
+    record.csBondline = inputBL->currentText();
+    record.csExpectedIcd = BuildRecordIO::number(outputHeight->text());
+    record.csParallelism = BuildRecordIO::number(outputParallel->text());
     // asterisks are used to tell saveData() in next calculator whether file is new or not
-    // default in saveTemplate is "$$$$", which is overwritten to "****", etc.
-    saveTable[20] = "****";
-    saveTemplate[20] = "****";
+    // default in saveTemplate is "$$$$", which is saved as "****", etc.
+    record.coldshieldSaved = true;
+    if (viewBuildData)
+        viewBuildData->refreshTable();
+}
+
+void MountCS::reportParseErrors( const std::vector <RecordError> &errors, QString source ) {
+    // malformed lines are skipped by the parser, flag them so the record can be fixed
+    if (errors.empty())
+        return;
+    QString lines;
+    for (unsigned i = 0; i < errors.size() && i < 10; i++)
+        lines += tr("Line %1: %2\n").arg(errors[i].line).arg(errors[i].message);
+    kickBox->warning(this, tr("Malformed Record"),
+                     tr("%1 contains malformed lines.\n"
+                        "Verify build data before proceeding.\n\n%2").arg(source).arg(lines));
+}
+
+ViewBuildData *MountCS::buildData( ) {
+    // most sessions never open one of its windows
+    if (!viewBuildData)
+        viewBuildData = new ViewBuildData();
+    return viewBuildData;
+}
+
+ProteusLookup *MountCS::proteusLookup( ) {
+    if (!proteus) {
+        proteus = new ProteusLookup(this);
+        // connect signal from ProteusLookup class that data has been downloaded, SLOT checks text
+        connect(proteus, SIGNAL(returnText(int)), this, SLOT(checkProteusData(int)));
+    }
+    return proteus;
+}
+
+bool MountCS::readRecord( const QString &control, QByteArray &bytes ) {
+    // the service answers from its record cache, without one the archive is read here
+    CalcServiceClient::Reply served = service->load(control, bytes);
+    if (served == CalcServiceClient::Unavailable)
+        return archive->read(control, bytes);
+    return served == CalcServiceClient::Ok;
 }
 
 bool MountCS::fileExists( QString path ) {
@@ -448,10 +704,17 @@ MountCS::~MountCS()
     delete outputHeight;
     delete outputParallel;
     delete pathTemplate;
+    delete archive;
+    delete spc;
+    delete watcher;
+    delete summary;
+    delete service;
     delete controlInputDialog;
     delete kickBox;
     //delete rawProteusText;
     delete viewBuildData;
+    delete history;
+    delete prefetch;
     delete proteus;
     delete ui;
 }
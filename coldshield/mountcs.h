@@ -6,17 +6,31 @@
 #include <QTextStream>
 #include <QFile>
 #include <QFileInfo>
+#include <QVector>
 #include <QList>
 #include <QStringList>
 #include <QMap>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QtConcurrentRun>
 #include <cmath>
 #include <algorithm>
 #include <iostream>
 
 #include <viewbuilddata.h>
+#include <historybrowser.h>
 #include <proteuslookup.h>
+#include <phrprefetch.h>
+#include <stackupcalc.h>
+#include <buildarchive.h>
+#include <spcstats.h>
+#include <summaryindex.h>
+#include <recordwatcher.h>
+#include <calcserviceclient.h>
+#include <recordloader.h>
+#include <startuptrace.h>
+#include <recordparser.h>
+#include <buildrecordio.h>
 
 class QLabel;
 class QLineEdit;
@@ -45,9 +59,19 @@ public slots:
     void showNotepad();
     void showCalculations();
     void showBuildData();
+    void showSpc();
+    void showHistory();
     void showTutorial();
     void showAbout();
-    void checkProteusData1061( );
+    void checkProteusData( int );
+    void prefetchProteus();
+
+private slots:
+    void recordChanged( const QStringList &, const QStringList & );
+    void recordLoaded( const RecordLoad & );
+    void loadPrefetchFile();
+    void showPrefetchProgress( int, int );
+    void prefetchFinished();
 
 private:
     Ui::MountCS *ui;
@@ -69,14 +93,27 @@ private:
     QMessageBox *kickBox;
     QInputDialog *controlInputDialog;
     QString *pathTemplate;
-    QList <QString> saveTemplate;
-    QList <QString> saveTable;
-    void initializeTables( QString* );
+    BuildArchive *archive;
+    SpcStats *spc;
+    SummaryIndex *summary;
+    RecordWatcher *watcher;
+    RecordLoader *loader;
+    QList <int> phrWaiting;             // PHR checks held until recordLoaded() fills the form
+    CalcServiceClient *service;
+    BuildRecord record;
+    void initializeTables( );
+    void verifyTemplate( QString* );
     void updateSaveTable( );
+    void reportParseErrors( const std::vector <RecordError> &, QString );
+    ViewBuildData *buildData( );
+    ProteusLookup *proteusLookup( );
+    bool readRecord( const QString &, QByteArray & );
     bool fileExists( QString );
     QString checkText( QString );
     ViewBuildData *viewBuildData;
+    HistoryBrowser *history;
     ProteusLookup *proteus;
+    PhrPrefetch *prefetch;
     //QString *rawProteusText;
 };
 
@@ -0,0 +1,53 @@
+#ifndef PHRPREFETCH_H
+#define PHRPREFETCH_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QSet>
+#include <QPair>
+
+#include "proteusclient.h"
+
+// PhrPrefetch warms the PHR cache for a list of control numbers, see phrprefetch.cpp
+class PhrPrefetch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PhrPrefetch( QObject *parent = 0 );
+    ProteusClient *client;
+    QList <int> dataforms;
+    int concurrent;
+    int total;
+    int warm;
+    int fetched;
+    int noData;
+    int failed;
+    static QStringList parseControls( const QString &text );
+    void start( const QStringList &controls );
+    void cancel( );
+    bool isRunning() const;
+    QString summary() const;
+
+signals:
+    void progress( int done, int total );
+    void finished( );
+
+private slots:
+    void replyReady( const QString &, int, const PhrReply & );
+    void staleReply( const QString &, int, const QString &, const QDateTime & );
+    void noDataFound( const QString &, int );
+    void fetchFailed( const QString &, int, const QString & );
+
+private:
+    typedef QPair <QString, int> Job;
+    QList <Job> queue;
+    QSet <Job> inFlight;
+    QSet <Job> stale;
+    void jobDone( const QString &, int );
+    void startJobs( );
+};
+
+#endif // PHRPREFETCH_H
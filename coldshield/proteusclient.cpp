@@ -0,0 +1,205 @@
+/* ProteusClient class is shared code used by ProteusLookup in the calculators and by StackupTool
+ * to pull PHR dataforms from Proteus.  It has no UI; ProteusLookup turns its signals into the
+ * operator messages.
+ *
+ * Every dataform goes through one QNetworkAccessManager, which keeps its connections to the
+ * server open between requests, so any number of fetches can be in flight at once.  Each reply is
+ * tracked in pending until it finishes, times out or is cancelled, and is then deleted.
+ *
+ * fetch() builds the dataFormResult URL from baseUrl, the control number and the dataform.  A copy
+ * in the PhrCache younger than cacheTtlSecs is delivered from the event loop with no round trip.
+ * Otherwise the request goes out with a deadline of timeoutMs and is aborted early if the reply
+ * grows past maxReplyBytes; an older cached copy is sent along as a conditional request, so an
+ * unchanged dataform costs a 304 instead of the full reply.
+ *
+ * isCached() tells whether fetch() would be answered from the cache without a round trip.
+ *
+ * cancel() aborts everything still in flight and drops pending cache hits.  Cancelled fetches
+ * emit nothing; a fetch aborted for its deadline or for growing past maxReplyBytes is flagged
+ * first, so it is reported like any other failure.
+ *
+ * replyFinished() parses a reply into a PhrReply once, caches it and emits replyReady().  When the
+ * fetch timed out or failed and a cached copy exists it emits staleReply() and then replyReady()
+ * with that copy; without one it emits fetchFailed().  "No data found" replies emit noData() and
+ * are never cached.
+ *
+ * loadSettings() reads control/proteus.ini:
+ *   [server]  url, timeout (ms)
+ *   [cache]   ttl (s), maxAge (s), path
+*/
+
+#include "proteusclient.h"
+
+#include <QDir>
+#include <QTimer>
+#include <QUrl>
+#include <QSettings>
+
+ProteusClient::ProteusClient( QObject *parent ) :
+    QObject(parent),
+    baseUrl("http://sbfdb/proteus/application/admin.php"),
+    // a slow PHR should not hold up the floor, give up after 15 s
+    timeoutMs(15000),
+    // dataform replies are a few kB, anything this large is not a dataform reply
+    maxReplyBytes(1024 * 1024),
+    cacheTtlSecs(30 * 60),
+    cacheMaxAgeSecs(7 * 24 * 3600),
+    cache(0)
+{
+    manager = new QNetworkAccessManager(this);
+    // when a reply has done downloading, it signals replyFinished to parse it
+    connect(manager, SIGNAL(finished(QNetworkReply*)), this,
+            SLOT(replyFinished(QNetworkReply*)));
+}
+
+ProteusClient::~ProteusClient()
+{
+    // replies are children of manager, none may finish into a half-deleted client
+    disconnect(manager, 0, this, 0);
+    cancel();
+    delete cache;
+}
+
+void ProteusClient::loadSettings( const QString &path ) {
+    QSettings settings(path, QSettings::IniFormat);
+    baseUrl = settings.value("server/url", baseUrl).toString();
+    timeoutMs = settings.value("server/timeout", timeoutMs).toInt();
+    cacheTtlSecs = settings.value("cache/ttl", cacheTtlSecs).toInt();
+    cacheMaxAgeSecs = settings.value("cache/maxAge", cacheMaxAgeSecs).toInt();
+    setCacheDir(settings.value("cache/path", QDir::temp().filePath("Next177/phrcache")).toString());
+}
+
+void ProteusClient::setCacheDir( const QString &path ) {
+    delete cache;
+    cache = 0;
+    if (path.isEmpty())
+        return;
+    cache = new PhrCache(path);
+    cache->prune( cacheMaxAgeSecs );
+}
+
+QString ProteusClient::cacheDir() const {
+    return cache ? cache->path() : QString();
+}
+
+bool ProteusClient::isCached( const QString &control, int dataform ) const {
+    PhrEntry entry;
+    if (!cache || !cache->read(control, dataform, entry))
+        return false;
+    int age = entry.fetched.secsTo(QDateTime::currentDateTime());
+    return age >= 0 && age < cacheTtlSecs;
+}
+
+void ProteusClient::fetch( const QString &control, int dataform ) {
+    ProteusFetch fetch;
+    fetch.control = control;
+    fetch.dataform = dataform;
+    fetch.timedOut = false;
+    fetch.oversize = false;
+    fetch.cached = cache && cache->read(control, dataform, fetch.entry);
+    // a recent enough copy is used as is, no round trip
+    int age = fetch.entry.fetched.secsTo(QDateTime::currentDateTime());
+    if (fetch.cached && age >= 0 && age < cacheTtlSecs) {
+        cacheHits << fetch;
+        QTimer::singleShot(0, this, SLOT(deliverCached()));
+        return;
+    }
+    // construct url
+    QUrl url(baseUrl + "?page=GenericService&sender=dataFormResult&controlNbr=" + control
+             + "&dataForm=" + QString::number(dataform));
+    QNetworkRequest request(url);
+    // an older copy is revalidated, Proteus can answer 304 instead of sending the dataform again
+    if (fetch.cached && !fetch.entry.etag.isEmpty())
+        request.setRawHeader("If-None-Match", fetch.entry.etag);
+    if (fetch.cached && !fetch.entry.lastModified.isEmpty())
+        request.setRawHeader("If-Modified-Since", fetch.entry.lastModified);
+    QNetworkReply *reply = manager->get(request);
+    pending.insert(reply, fetch);
+    // the deadline timer belongs to the reply, so it goes away with it
+    QTimer *deadline = new QTimer(reply);
+    deadline->setSingleShot(true);
+    connect(deadline, SIGNAL(timeout()), this, SLOT(fetchTimedOut()));
+    deadline->start(timeoutMs);
+    connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(fetchProgress(qint64,qint64)));
+}
+
+void ProteusClient::cancel( ) {
+    cacheHits.clear();
+    // abort() emits finished, which removes each reply from pending
+    QList <QNetworkReply*> replies = pending.keys();
+    for (int i = 0; i < replies.size(); i++)
+        replies[i]->abort();
+}
+
+int ProteusClient::pendingCount() const {
+    return pending.size() + cacheHits.size();
+}
+
+void ProteusClient::fetchTimedOut( ) {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender()->parent());
+    if (!reply || !pending.contains(reply))
+        return;
+    pending[reply].timedOut = true;
+    reply->abort();
+}
+
+void ProteusClient::fetchProgress( qint64 received, qint64 ) {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || !pending.contains(reply) || received <= maxReplyBytes)
+        return;
+    pending[reply].oversize = true;
+    reply->abort();
+}
+
+void ProteusClient::deliverCached( ) {
+    while (!cacheHits.isEmpty()) {
+        ProteusFetch fetch = cacheHits.takeFirst();
+        emit replyReady(fetch.control, fetch.dataform, PhrReply(fetch.entry.text));
+    }
+}
+
+void ProteusClient::replyFinished( QNetworkReply *pReply ) {
+    pReply->deleteLater();
+    if (!pending.contains(pReply))
+        return;
+    ProteusFetch fetch = pending.take(pReply);
+    if (pReply->error() == QNetworkReply::OperationCanceledError && !fetch.timedOut && !fetch.oversize)
+        return;
+    if (fetch.timedOut || fetch.oversize || pReply->error() != QNetworkReply::NoError) {
+        QString reason = pReply->errorString();
+        if (fetch.timedOut)
+            reason = tr("Proteus did not answer within %1 s.").arg(timeoutMs / 1000.0);
+        else if (fetch.oversize)
+            reason = tr("Proteus sent more than %1 kB, which is not a dataform reply.")
+                    .arg(maxReplyBytes / 1024);
+        // Proteus is slow or down, an older copy of the PHR is better than no check at all
+        if (fetch.cached) {
+            emit staleReply(fetch.control, fetch.dataform, reason, fetch.entry.fetched);
+            emit replyReady(fetch.control, fetch.dataform, PhrReply(fetch.entry.text));
+        } else {
+            emit fetchFailed(fetch.control, fetch.dataform, reason);
+        }
+        return;
+    }
+    // 304, the cached copy is still what Proteus has
+    int status = pReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 304 && fetch.cached) {
+        cache->touch(fetch.control, fetch.dataform);
+        emit replyReady(fetch.control, fetch.dataform, PhrReply(fetch.entry.text));
+        return;
+    }
+    QString text = QString(pReply->readAll());
+    if (text.contains("No data found")) {
+        emit noData(fetch.control, fetch.dataform);
+        return;
+    }
+    if (cache) {
+        PhrEntry entry;
+        entry.text = text;
+        entry.fetched = QDateTime::currentDateTime();
+        entry.etag = pReply->rawHeader("ETag");
+        entry.lastModified = pReply->rawHeader("Last-Modified");
+        cache->write(fetch.control, fetch.dataform, entry);
+    }
+    emit replyReady(fetch.control, fetch.dataform, PhrReply(text));
+}
@@ -1,51 +1,50 @@
 #ifndef PROTEUSLOOKUP_H
 #define PROTEUSLOOKUP_H
 
-#include <QMainWindow>
 #include <QObject>
+#include <QWidget>
 #include <QByteArray>
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QSslConfiguration>
+#include <QMap>
+#include <QDateTime>
 #include <QMessageBox>
 #include <iostream>
 
-class QTextEdit;
+#include <proteusclient.h>
+#include <phrreply.h>
 
-namespace Ui {
-class ProteusLookup;
-}
-
-class ProteusLookup : public QMainWindow
+class ProteusLookup : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit ProteusLookup(QWidget *parent = 0);
+    explicit ProteusLookup(QWidget *window = 0);
     QString control;
     QString dataform;
     void testFetch( );
     void proteusFetch( QString );
-    QString *rawText1061;
-    QString *rawText1065;
+    void cancelFetches( );
+    QString rawText( int ) const;
+    PhrReply fetchedReply( int ) const;
     ~ProteusLookup();
 
 public slots:
-    void replyFinished1061(QNetworkReply*);
-    void replyFinished1065(QNetworkReply*);
     void checkFetchedText( QString, int );
 
+private slots:
+    void replyReady( const QString &, int, const PhrReply & );
+    void staleReply( const QString &, int, const QString &, const QDateTime & );
+    void noData( const QString &, int );
+    void fetchFailed( const QString &, int, const QString & );
+
 signals:
-    // signals are sent to other classes to signify text has been downloaded from the PHR
-    void returnText1061(QString*);
-    void returnText1065(QString*);
+    // sent to other classes to signify text has been downloaded from the PHR for a dataform
+    void returnText(int);
 
 private:
-    Ui::ProteusLookup *ui;
-    int currentDataform;
-    QNetworkAccessManager *m_manager_1061;
-    QNetworkAccessManager *m_manager_1065;
+    QWidget *window;
+    ProteusClient *client;
+    QMap <int, PhrReply> fetched;
+    QString fieldName( int );
 };
 
 #endif // PROTEUSLOOKUP_H
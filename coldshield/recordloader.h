@@ -0,0 +1,78 @@
+#ifndef RECORDLOADER_H
+#define RECORDLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QAtomicInt>
+#include <QMetaType>
+#include <vector>
+
+#include "buildarchive.h"
+#include "calcserviceclient.h"
+#include "recordparser.h"
+#include "buildrecord.h"
+
+// one record read and parsed off the GUI thread by RecordLoader
+struct RecordLoad {
+    int ticket;
+    QString control;
+    bool found;                 // false when neither the archive nor control/<ctrl>.csv had it
+    QString error;              // why the .csv could not be opened
+    int fieldCount;
+    BuildRecord record;
+    std::vector <RecordError> errors;
+};
+
+Q_DECLARE_METATYPE(RecordLoad)
+
+// runs in RecordLoader's thread, with its own archive and service connection
+class RecordLoadWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    RecordLoadWorker( const QString &archivePath, QAtomicInt *latest );
+    ~RecordLoadWorker();
+
+public slots:
+    void load( int ticket, const QString &control );
+
+signals:
+    void loaded( const RecordLoad & );
+
+private:
+    QString archivePath;
+    QAtomicInt *latest;
+    BuildArchive *archive;
+    CalcServiceClient *service;
+};
+
+// RecordLoader reads and parses records on a worker thread for loadData(), see recordloader.cpp
+class RecordLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RecordLoader( const QString &archivePath, QObject *parent = 0 );
+    ~RecordLoader();
+    void load( const QString &control );
+    void cancel( );
+    bool isLoading( ) const;
+    QString control( ) const;
+
+signals:
+    void loaded( const RecordLoad & );
+    void startLoad( int, const QString & );
+
+private slots:
+    void finished( const RecordLoad & );
+
+private:
+    QThread thread;
+    RecordLoadWorker *worker;
+    QAtomicInt latest;
+    QString pending;
+};
+
+#endif // RECORDLOADER_H
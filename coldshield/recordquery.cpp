@@ -0,0 +1,413 @@
+/* RecordQuery class is shared code used by StackupTool query and the history browser to answer
+ * questions across every dewar, e.g.
+ *     cfParallelism > 0.0025 and cfBondline = 0.0030 and saved >= -90d
+ * from the summary index instead of opening every record.  See SummaryIndex::columns().
+ *
+ * A query is terms joined by "and" and "or", "and" binding tighter, with parentheses to group
+ * them.  A term is a field, an operator and a value:
+ *     field = value, field != value, <, <=, >, >=    compare
+ *     field between low and high                     inclusive range
+ *     field ~ text                                   text field contains text
+ * Fields are the template's field names (see recordgen/buildrecord.fields, case doesn't matter)
+ * plus "saved".  Number fields compare by value, equal to within half the last decimal they are
+ * saved with.  Text fields compare without regard to case, and only the first
+ * SummaryIndex::TextWidth characters (SerialWidth for serial) are in the index: a value longer
+ * than that could never match, so parse() refuses it rather than quietly match nothing, and a
+ * value exactly that long also matches longer text that starts with it.  Step markers, e.g. coldfilter1Saved,
+ * compare to true or false.  saved takes a date, yyyy-MM-dd (the whole day) or
+ * yyyy-MM-ddThh:mm, or -Nd for N days ago.  A field that was never entered, or a record never
+ * saved by a calculator, matches no comparison, not even !=.
+ *
+ * parse() checks the query against the template once, so run() only scans columns: each term
+ * walks the one array it reads and sets a bit per matching dewar, and "and"/"or" combine the bits.
+*/
+
+#include "recordquery.h"
+#include "buildrecordio.h"
+
+#include <QDateTime>
+#include <qnumeric.h>
+
+#include <math.h>
+
+static QStringList tokenize( const QString &text ) {
+    QStringList tokens;
+    int i = 0;
+    while (i < text.size()) {
+        QChar c = text[i];
+        if (c.isSpace()) {
+            i++;
+        } else if (c == '(' || c == ')' || c == '~') {
+            tokens << QString(c);
+            i++;
+        } else if (c == '<' || c == '>' || c == '!' || c == '=') {
+            // <=, >= and != are one token
+            bool pair = i + 1 < text.size() && text[i + 1] == '=' && c != '=';
+            tokens << text.mid(i, pair ? 2 : 1);
+            i += pair ? 2 : 1;
+        } else if (c == '"') {
+            // quoted values keep their spaces, the quote marks the token as a value
+            int end = text.indexOf('"', i + 1);
+            if (end < 0)
+                end = text.size();
+            tokens << text.mid(i, end - i);
+            i = end + 1;
+        } else {
+            int start = i;
+            while (i < text.size() && !text[i].isSpace() && QString("()<>=!~\"").indexOf(text[i]) < 0)
+                i++;
+            tokens << text.mid(start, i - start);
+        }
+    }
+    return tokens;
+}
+
+static bool isKeyword( const QString &token, const char *keyword ) {
+    return token.compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+}
+
+// the step bit a marker row stands for, 0 for any other row
+static int stepBit( int row ) {
+    switch (row) {
+    case BuildRecord::RowMotherboardSaved:
+        return SummaryIndex::MotherboardStep;
+    case BuildRecord::RowColdshieldSaved:
+        return SummaryIndex::ColdshieldStep;
+    case BuildRecord::RowColdfilter1Saved:
+        return SummaryIndex::Coldfilter1Step;
+    case BuildRecord::RowColdfilter2Saved:
+        return SummaryIndex::Coldfilter2Step;
+    }
+    return 0;
+}
+
+RecordQuery::RecordQuery() :
+    root(-1),
+    next(0)
+{
+}
+
+QStringList RecordQuery::fieldNames() {
+    QStringList names;
+    for (int row = 1; row <= BuildRecord::RowCount; row++)
+        names << QString::fromLatin1(buildRecordFields[row].name);
+    names << "saved";
+    return names;
+}
+
+bool RecordQuery::parse( const QString &text ) {
+    terms.clear();
+    nodes.clear();
+    root = -1;
+    lastError.clear();
+    tokens = tokenize( text );
+    next = 0;
+    if (tokens.isEmpty()) {
+        fail("The query is empty.");
+        return false;
+    }
+    root = parseOr();
+    if (root >= 0 && next < tokens.size())
+        fail(QString("Unexpected \"%1\".").arg(tokens[next]));
+    if (!lastError.isEmpty())
+        root = -1;
+    return root >= 0;
+}
+
+QString RecordQuery::errorString() const {
+    return lastError;
+}
+
+QBitArray RecordQuery::run( const SummaryColumns &columns ) const {
+    if (root < 0)
+        return QBitArray(columns.size());
+    return evaluate( root, columns );
+}
+
+QVector <int> RecordQuery::matches( const SummaryColumns &columns ) const {
+    QBitArray bits = run( columns );
+    QVector <int> list;
+    for (int i = 0; i < bits.size(); i++)
+        if (bits.testBit(i))
+            list << i;
+    return list;
+}
+
+int RecordQuery::parseOr( ) {
+    int left = parseAnd();
+    while (left >= 0 && next < tokens.size() && isKeyword(tokens[next], "or")) {
+        next++;
+        int right = parseAnd();
+        if (right < 0)
+            return -1;
+        Node node = { -1, false, left, right };
+        nodes << node;
+        left = nodes.size() - 1;
+    }
+    return left;
+}
+
+int RecordQuery::parseAnd( ) {
+    int left = parseTerm();
+    while (left >= 0 && next < tokens.size() && isKeyword(tokens[next], "and")) {
+        next++;
+        int right = parseTerm();
+        if (right < 0)
+            return -1;
+        Node node = { -1, true, left, right };
+        nodes << node;
+        left = nodes.size() - 1;
+    }
+    return left;
+}
+
+int RecordQuery::parseTerm( ) {
+    if (next >= tokens.size())
+        return fail("The query ends too soon.");
+    if (tokens[next] == "(") {
+        next++;
+        int inner = parseOr();
+        if (inner < 0)
+            return -1;
+        if (next >= tokens.size() || tokens[next] != ")")
+            return fail("A \"(\" is never closed.");
+        next++;
+        return inner;
+    }
+    // field
+    QString name = tokens[next++];
+    Term term;
+    term.index = 0;
+    term.tolerance = 0;
+    term.low = term.lowEnd = term.high = term.highEnd = 0;
+    if (isKeyword(name, "control")) {
+        term.kind = ControlField;
+    } else if (isKeyword(name, "serial")) {
+        term.kind = SerialField;
+    } else if (isKeyword(name, "saved")) {
+        term.kind = SavedField;
+    } else {
+        int row = 1;
+        while (row <= BuildRecord::RowCount && !isKeyword(name, buildRecordFields[row].name))
+            row++;
+        if (row > BuildRecord::RowCount)
+            return fail(QString("There is no field \"%1\".").arg(name));
+        const BuildRecordField &f = buildRecordFields[row];
+        if (f.type == RecordNumber) {
+            term.kind = NumberField;
+            term.index = SummaryIndex::numberRows().indexOf(row);
+            term.tolerance = 0.5 * pow(10.0, -f.decimals);
+        } else if (f.type == RecordText) {
+            term.kind = TextField;
+            term.index = SummaryIndex::textRows().indexOf(row);
+        } else {
+            term.kind = StepField;
+            term.index = stepBit(row);
+        }
+    }
+    // operator
+    if (next >= tokens.size())
+        return fail(QString("\"%1\" needs a comparison.").arg(name));
+    QString op = tokens[next++];
+    if (op == "=")
+        term.op = Equal;
+    else if (op == "!=")
+        term.op = NotEqual;
+    else if (op == "<")
+        term.op = Less;
+    else if (op == "<=")
+        term.op = LessEqual;
+    else if (op == ">")
+        term.op = Greater;
+    else if (op == ">=")
+        term.op = GreaterEqual;
+    else if (op == "~")
+        term.op = Contains;
+    else if (isKeyword(op, "between"))
+        term.op = Between;
+    else
+        return fail(QString("\"%1\" is not a comparison.").arg(op));
+    if (term.op == Contains && term.kind != TextField && term.kind != ControlField
+            && term.kind != SerialField)
+        return fail(QString("~ only applies to text fields, not \"%1\".").arg(name));
+    if (term.kind == StepField && term.op != Equal && term.op != NotEqual)
+        return fail(QString("\"%1\" is a step, compare it with = or !=.").arg(name));
+    // value, two for between
+    if (next >= tokens.size())
+        return fail(QString("\"%1 %2\" needs a value.").arg(name).arg(op));
+    if (!parseValue(term, tokens[next++], false))
+        return -1;
+    if (term.op == Between) {
+        if (next + 1 >= tokens.size() || !isKeyword(tokens[next], "and"))
+            return fail(QString("\"%1 between\" needs \"low and high\".").arg(name));
+        next++;
+        if (!parseValue(term, tokens[next++], true))
+            return -1;
+    }
+    terms << term;
+    Node node = { terms.size() - 1, false, -1, -1 };
+    nodes << node;
+    return nodes.size() - 1;
+}
+
+bool RecordQuery::parseValue( Term &term, const QString &value, bool highEnd ) {
+    QString text = value.startsWith('"') ? value.mid(1) : value;
+    double start = 0, end = 0;
+    bool ok = true;
+    if (term.kind == NumberField) {
+        start = end = text.toDouble(&ok);
+        if (!ok) {
+            fail(QString("\"%1\" is not a number.").arg(text));
+            return false;
+        }
+    } else if (term.kind == StepField) {
+        if (isKeyword(text, "true") || isKeyword(text, "yes") || text == "1")
+            start = end = 1;
+        else if (!isKeyword(text, "false") && !isKeyword(text, "no") && text != "0") {
+            fail(QString("\"%1\" is not true or false.").arg(text));
+            return false;
+        }
+    } else if (term.kind == SavedField) {
+        QDateTime from, to;
+        if (text.startsWith('-') && text.endsWith('d', Qt::CaseInsensitive)) {
+            from = QDateTime::currentDateTime().addDays(-text.mid(1, text.size() - 2).toInt(&ok));
+            to = from.addSecs(1);
+        } else if (text.contains('T')) {
+            from = QDateTime::fromString(text, Qt::ISODate);
+            to = from.addSecs(60);
+            ok = from.isValid();
+        } else {
+            QDate day = QDate::fromString(text, "yyyy-MM-dd");
+            from = QDateTime(day);
+            to = QDateTime(day.addDays(1));
+            ok = day.isValid();
+        }
+        if (!ok) {
+            fail(QString("\"%1\" is not a date, use yyyy-MM-dd or -Nd.").arg(text));
+            return false;
+        }
+        start = from.toTime_t();
+        end = to.toTime_t();
+    } else {
+        // wanded control numbers carry a leading 'C'
+        if (term.kind == ControlField && (text.startsWith('C') || text.startsWith('c')))
+            text.remove(0, 1);
+        int width = term.kind == ControlField ? SummaryIndex::ControlWidth
+                : term.kind == SerialField ? SummaryIndex::SerialWidth : SummaryIndex::TextWidth;
+        if (text.toLatin1().size() > width) {
+            fail(QString("\"%1\" is longer than the %2 characters the summary index keeps of this "
+                         "field, compare the first %2 or use ~ with part of it.").arg(text).arg(width));
+            return false;
+        }
+    }
+    if (highEnd) {
+        term.high = start;
+        term.highEnd = end;
+        term.highText = text;
+    } else {
+        term.low = start;
+        term.lowEnd = end;
+        term.text = text;
+    }
+    return true;
+}
+
+int RecordQuery::fail( const QString &message ) {
+    if (lastError.isEmpty())
+        lastError = message;
+    return -1;
+}
+
+QBitArray RecordQuery::evaluate( int index, const SummaryColumns &columns ) const {
+    const Node &node = nodes[index];
+    if (node.term >= 0)
+        return evaluateTerm( terms[node.term], columns );
+    QBitArray bits = evaluate( node.left, columns );
+    if (node.isAnd)
+        bits &= evaluate( node.right, columns );
+    else
+        bits |= evaluate( node.right, columns );
+    return bits;
+}
+
+QBitArray RecordQuery::evaluateTerm( const Term &term, const SummaryColumns &columns ) const {
+    int count = columns.size();
+    QBitArray bits(count);
+    if (term.kind == NumberField) {
+        const double *values = columns.numbers[term.index].constData();
+        double t = term.tolerance;
+        double low = term.low, high = term.high;
+        for (int i = 0; i < count; i++) {
+            double x = values[i];
+            if (qIsNaN(x))
+                continue;
+            bool match = false;
+            switch (term.op) {
+            case Equal:        match = fabs(x - low) <= t; break;
+            case NotEqual:     match = fabs(x - low) > t; break;
+            case Less:         match = x < low - t; break;
+            case LessEqual:    match = x <= low + t; break;
+            case Greater:      match = x > low + t; break;
+            case GreaterEqual: match = x >= low - t; break;
+            case Between:      match = x >= low - t && x <= high + t; break;
+            case Contains:     break;
+            }
+            if (match)
+                bits.setBit(i);
+        }
+    } else if (term.kind == SavedField) {
+        const qint64 *values = columns.saved.constData();
+        qint64 low = qint64(term.low), lowEnd = qint64(term.lowEnd), highEnd = qint64(term.highEnd);
+        for (int i = 0; i < count; i++) {
+            qint64 x = values[i];
+            if (!x)
+                continue;
+            bool match = false;
+            switch (term.op) {
+            case Equal:        match = x >= low && x < lowEnd; break;
+            case NotEqual:     match = x < low || x >= lowEnd; break;
+            case Less:         match = x < low; break;
+            case LessEqual:    match = x < lowEnd; break;
+            case Greater:      match = x >= lowEnd; break;
+            case GreaterEqual: match = x >= low; break;
+            case Between:      match = x >= low && x < highEnd; break;
+            case Contains:     break;
+            }
+            if (match)
+                bits.setBit(i);
+        }
+    } else if (term.kind == StepField) {
+        const int *values = columns.steps.constData();
+        bool wanted = term.low != 0;
+        if (term.op == NotEqual)
+            wanted = !wanted;
+        for (int i = 0; i < count; i++)
+            if (((values[i] & term.index) != 0) == wanted)
+                bits.setBit(i);
+    } else {
+        const QVector <QString> &values = term.kind == ControlField ? columns.control
+                : term.kind == SerialField ? columns.serial : columns.texts[term.index];
+        const QString &low = term.text;
+        const QString &high = term.highText;
+        for (int i = 0; i < count; i++) {
+            const QString &x = values[i];
+            if (x.isEmpty())
+                continue;
+            bool match = false;
+            switch (term.op) {
+            case Equal:        match = x.compare(low, Qt::CaseInsensitive) == 0; break;
+            case NotEqual:     match = x.compare(low, Qt::CaseInsensitive) != 0; break;
+            case Less:         match = x.compare(low, Qt::CaseInsensitive) < 0; break;
+            case LessEqual:    match = x.compare(low, Qt::CaseInsensitive) <= 0; break;
+            case Greater:      match = x.compare(low, Qt::CaseInsensitive) > 0; break;
+            case GreaterEqual: match = x.compare(low, Qt::CaseInsensitive) >= 0; break;
+            case Between:      match = x.compare(low, Qt::CaseInsensitive) >= 0
+                                       && x.compare(high, Qt::CaseInsensitive) <= 0; break;
+            case Contains:     match = x.contains(low, Qt::CaseInsensitive); break;
+            }
+            if (match)
+                bits.setBit(i);
+        }
+    }
+    return bits;
+}
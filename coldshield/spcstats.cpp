@@ -0,0 +1,369 @@
+/* SpcStats class is shared code used by the calculators and StackupTool to keep process capability
+ * statistics for the coldstack without re-reading every build record.
+ *
+ * control/spc.dat holds one fixed-size slot per characteristic: count, mean and sum of squared
+ * deviations (Welford's running form), and how many values landed red, yellow and green.  Each
+ * characteristic is a field of the build record, checked against the same limits the calculators
+ * color their labels with (see stackupcalc.h).  Parallelism only has an upper limit.
+ *
+ * update() is called by saveData() after the record is written to the archive.  previous is the
+ * archive's copy from before the save, if any: its values are taken back out of the statistics
+ * before the new ones go in, so resaving a dewar never counts it twice.  Either way it is a read
+ * and a write of one 16 + 7 x 48 byte file, whatever the number of builds.  Writers are serialized
+ * by control/spc.dat.lock, the same way BuildArchive locks the archive.
+ *
+ * rebuild() starts the statistics over from a list of records, e.g. the whole archive.
+ *
+ * summaries() reads the file and works out sigma and Cpk for each characteristic.  Cpk is the
+ * distance from the mean to the nearer limit in units of 3 sigma.
+ *
+ * A value removed can't take the minimum or maximum with it, so neither is kept.
+*/
+
+#include "spcstats.h"
+#include "stackupcalc.h"
+#include "recordparser.h"
+#include "buildrecordio.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+#include <QAtomicInt>
+#include <QtEndian>
+#include <qnumeric.h>
+#include <qmath.h>
+
+static const char spcMagic[8] = { 'N', '1', '7', '7', 'S', 'P', 'C', '1' };
+static const qint64 spcHeaderSize = 16;
+static const qint64 spcSlotSize = 48;
+
+// QThread::msleep() is protected in Qt 4
+class SpcSleep : public QThread
+{
+public:
+    static void msleep( unsigned long ms ) { QThread::msleep(ms); }
+};
+
+// a lock holds a heartbeat file, "pid host beat", that its owner rewrites through long operations,
+// raising the beat each time, so no two heartbeats are alike.  a waiter takes the owner for dead
+// once the heartbeat has not changed for a minute by the waiter's own clock, which neither the
+// share's file times nor another station's clock come into.  the directory of an owner that died
+// before writing one reads as an empty heartbeat and goes stale the same way
+struct LockSighting {
+    QByteArray heartbeat;
+    QElapsedTimer since;
+};
+
+static QMutex sightingMutex;
+static QHash <QString, LockSighting> sightings;
+static QAtomicInt beats;
+
+static QByteArray readHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (!beat.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return beat.readAll();
+}
+
+static QString lockOwner() {
+    return QString("%1 %2").arg(QCoreApplication::applicationPid()).arg(QHostInfo::localHostName());
+}
+
+static bool lockIsStale( const QString &lockPath, QByteArray &heartbeat ) {
+    heartbeat = readHeartbeat(lockPath);
+    if (!QFileInfo(lockPath).exists())
+        return false;
+    QMutexLocker locker(&sightingMutex);
+    if (!sightings.contains(lockPath) || sightings[lockPath].heartbeat != heartbeat) {
+        LockSighting &seen = sightings[lockPath];
+        seen.heartbeat = heartbeat;
+        seen.since.start();
+        return false;
+    }
+    return sightings[lockPath].since.elapsed() > 60000;
+}
+
+static void writeHeartbeat( const QString &lockPath ) {
+    QFile beat(lockPath + "/heartbeat");
+    if (beat.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        beat.write((lockOwner() + QString(" %1\n").arg(beats.fetchAndAddOrdered(1) + 1)).toUtf8());
+}
+
+static void removeLock( const QString &lockPath ) {
+    QFile::remove(lockPath + "/heartbeat");
+    QDir().rmdir(lockPath);
+}
+
+// a stale lock is renamed aside before it is removed: of the stations that found it stale, the one
+// whose rename succeeds breaks it and tries for the lock at once, the others go on waiting.  a lock
+// that was taken afresh just before the rename has another heartbeat and is put back
+static bool breakLock( const QString &lockPath, const QByteArray &stale ) {
+    QString aside = lockPath + ".broken." + lockOwner().replace(' ', '.') + "."
+            + QString::number(beats.fetchAndAddOrdered(1) + 1);
+    if (readHeartbeat(lockPath) != stale || !QDir().rename(lockPath, aside))
+        return false;
+    if (readHeartbeat(aside) != stale) {
+        QDir().rename(aside, lockPath);
+        return false;
+    }
+    removeLock(aside);
+    QMutexLocker locker(&sightingMutex);
+    sightings.remove(lockPath);
+    return true;
+}
+
+struct SpcLimits {
+    const char *name;
+    double lower;
+    double upper;
+    bool yellowAtLimit;         // calculateData1() flags an ICD exactly on a limit yellow
+};
+
+static const SpcLimits spcLimits[SpcStats::CharacteristicCount] = {
+    { "FPA Angle", Stackup::angleMin, Stackup::angleMax, false },
+    { "Optical Centerline", Stackup::centerMin, Stackup::centerMax, false },
+    { "Coldshield Expected ICD", Stackup::icdMin, Stackup::icdMax, false },
+    { "Coldshield Parallelism", -1, Stackup::csParallelMax, false },
+    { "Coldfilter Expected ICD", Stackup::icdMin, Stackup::icdMax, true },
+    { "Final ICD", Stackup::icdMin, Stackup::icdMax, false },
+    { "Coldfilter Parallelism", -1, Stackup::cfParallelMax, false }
+};
+
+struct SpcSlot {
+    qint64 count;
+    double mean;
+    double m2;
+    qint64 red;
+    qint64 yellow;
+    qint64 green;
+};
+
+static double readDouble( const uchar *data ) {
+    quint64 bits = qFromLittleEndian<quint64>(data);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void writeDouble( double value, uchar *data ) {
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, data);
+}
+
+static void parseSlots( const QByteArray &bytes, SpcSlot *slots ) {
+    memset(slots, 0, sizeof(SpcSlot) * SpcStats::CharacteristicCount);
+    // anything that isn't a complete stats file starts over from nothing
+    if (bytes.size() < spcHeaderSize + SpcStats::CharacteristicCount * spcSlotSize
+            || memcmp(bytes.constData(), spcMagic, 8) != 0)
+        return;
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData()) + spcHeaderSize;
+    for (int i = 0; i < SpcStats::CharacteristicCount; i++, data += spcSlotSize) {
+        slots[i].count = qFromLittleEndian<qint64>(data);
+        slots[i].mean = readDouble(data + 8);
+        slots[i].m2 = readDouble(data + 16);
+        slots[i].red = qFromLittleEndian<qint64>(data + 24);
+        slots[i].yellow = qFromLittleEndian<qint64>(data + 32);
+        slots[i].green = qFromLittleEndian<qint64>(data + 40);
+    }
+}
+
+static QByteArray slotBytes( const SpcSlot *slots ) {
+    QByteArray bytes(spcHeaderSize + SpcStats::CharacteristicCount * spcSlotSize, '\0');
+    uchar *data = reinterpret_cast<uchar *>(bytes.data());
+    memcpy(data, spcMagic, 8);
+    qToLittleEndian<quint32>(SpcStats::CharacteristicCount, data + 8);
+    data += spcHeaderSize;
+    for (int i = 0; i < SpcStats::CharacteristicCount; i++, data += spcSlotSize) {
+        qToLittleEndian<qint64>(slots[i].count, data);
+        writeDouble(slots[i].mean, data + 8);
+        writeDouble(slots[i].m2, data + 16);
+        qToLittleEndian<qint64>(slots[i].red, data + 24);
+        qToLittleEndian<qint64>(slots[i].yellow, data + 32);
+        qToLittleEndian<qint64>(slots[i].green, data + 40);
+    }
+    return bytes;
+}
+
+static qint64 &statusCount( SpcSlot &slot, const SpcLimits &limits, double value ) {
+    if (value > limits.upper || (limits.lower >= 0 && value < limits.lower))
+        return slot.red;
+    if (limits.yellowAtLimit && (value == limits.upper || value == limits.lower))
+        return slot.yellow;
+    return slot.green;
+}
+
+static void addValue( SpcSlot &slot, const SpcLimits &limits, double value ) {
+    slot.count++;
+    double delta = value - slot.mean;
+    slot.mean += delta / slot.count;
+    slot.m2 += delta * (value - slot.mean);
+    statusCount(slot, limits, value)++;
+}
+
+static void removeValue( SpcSlot &slot, const SpcLimits &limits, double value ) {
+    if (slot.count <= 1) {
+        memset(&slot, 0, sizeof(slot));
+        return;
+    }
+    // Welford's update run backwards
+    double mean = (slot.mean * slot.count - value) / (slot.count - 1);
+    slot.m2 = qMax(0.0, slot.m2 - (value - mean) * (value - slot.mean));
+    slot.mean = mean;
+    slot.count--;
+    qint64 &status = statusCount(slot, limits, value);
+    if (status > 0)
+        status--;
+}
+
+SpcStats::SpcStats( const QString &path ) :
+    statsPath(path)
+{
+}
+
+void SpcStats::values( const BuildRecord &record, double *out ) {
+    // a characteristic is counted once its step has been saved with the value calculated
+    double nan = qQNaN();
+    out[Angle] = record.motherboardSaved ? record.fpaAngle : nan;
+    out[Center] = record.motherboardSaved ? record.opticalCenter : nan;
+    out[CsIcd] = record.coldshieldSaved ? record.csExpectedIcd : nan;
+    out[CsParallel] = record.coldshieldSaved ? record.csParallelism : nan;
+    out[CfExpectedIcd] = record.coldfilter1Saved ? record.cfExpectedIcd : nan;
+    out[CfIcd] = record.coldfilter2Saved ? record.finalIcd : nan;
+    out[CfParallel] = record.coldfilter2Saved ? record.cfParallelism : nan;
+}
+
+bool SpcStats::update( const QByteArray &previous, const BuildRecord &record ) {
+    lastError.clear();
+    double before[CharacteristicCount];
+    double after[CharacteristicCount];
+    for (int i = 0; i < CharacteristicCount; i++)
+        before[i] = qQNaN();
+    if (!previous.isEmpty()) {
+        BuildRecord old;
+        RecordParser parser(previous.constData(), previous.size());
+        if (BuildRecordIO::load( parser, old ))
+            values( old, before );
+    }
+    values( record, after );
+    if (!lock())
+        return false;
+    QFile file(statsPath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        lastError = file.errorString();
+        unlock();
+        return false;
+    }
+    SpcSlot slots[CharacteristicCount];
+    parseSlots( file.readAll(), slots );
+    for (int i = 0; i < CharacteristicCount; i++) {
+        // an unchanged value is left alone rather than taken out and put back
+        if (BuildRecordIO::isSet(before[i]) && BuildRecordIO::isSet(after[i]) && before[i] == after[i])
+            continue;
+        if (BuildRecordIO::isSet(before[i]))
+            removeValue( slots[i], spcLimits[i], before[i] );
+        if (BuildRecordIO::isSet(after[i]))
+            addValue( slots[i], spcLimits[i], after[i] );
+    }
+    QByteArray bytes = slotBytes( slots );
+    bool ok = file.seek(0) && file.write(bytes) == bytes.size();
+    if (!ok)
+        lastError = file.errorString();
+    file.close();
+    unlock();
+    return ok;
+}
+
+bool SpcStats::rebuild( const QList <BuildRecord> &records ) {
+    lastError.clear();
+    SpcSlot slots[CharacteristicCount];
+    memset(slots, 0, sizeof(slots));
+    double value[CharacteristicCount];
+    for (int r = 0; r < records.size(); r++) {
+        values( records[r], value );
+        for (int i = 0; i < CharacteristicCount; i++) {
+            if (BuildRecordIO::isSet(value[i]))
+                addValue( slots[i], spcLimits[i], value[i] );
+        }
+    }
+    if (!lock())
+        return false;
+    QFile file(statsPath);
+    QByteArray bytes = slotBytes( slots );
+    bool ok = file.open(QIODevice::WriteOnly|QIODevice::Truncate) && file.write(bytes) == bytes.size();
+    if (!ok)
+        lastError = file.errorString();
+    file.close();
+    unlock();
+    return ok;
+}
+
+QList <SpcSummary> SpcStats::summaries() const {
+    lastError.clear();
+    QFile file(statsPath);
+    QByteArray bytes;
+    if (file.open(QIODevice::ReadOnly))
+        bytes = file.readAll();
+    else if (file.exists())
+        lastError = file.errorString();
+    SpcSlot slots[CharacteristicCount];
+    parseSlots( bytes, slots );
+    QList <SpcSummary> list;
+    for (int i = 0; i < CharacteristicCount; i++) {
+        SpcSummary s;
+        s.name = spcLimits[i].name;
+        s.lower = spcLimits[i].lower >= 0 ? spcLimits[i].lower : qQNaN();
+        s.upper = spcLimits[i].upper;
+        s.count = slots[i].count;
+        s.mean = s.count ? slots[i].mean : qQNaN();
+        s.sigma = s.count > 1 ? qSqrt(slots[i].m2 / (s.count - 1)) : qQNaN();
+        s.cpk = qQNaN();
+        if (s.count > 1 && s.sigma > 0) {
+            double reach = s.upper - s.mean;
+            if (!qIsNaN(s.lower))
+                reach = qMin(reach, s.mean - s.lower);
+            s.cpk = reach / (3 * s.sigma);
+        }
+        s.red = slots[i].red;
+        s.yellow = slots[i].yellow;
+        s.green = slots[i].green;
+        list << s;
+    }
+    return list;
+}
+
+QString SpcStats::path() const {
+    return statsPath;
+}
+
+QString SpcStats::errorString() const {
+    return lastError;
+}
+
+bool SpcStats::lock() {
+    QDir dir;
+    QString lockPath = statsPath + ".lock";
+    // about five seconds of retries, a save is never held up long for its statistics
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (dir.mkdir(lockPath)) {
+            writeHeartbeat(lockPath);
+            return true;
+        }
+        QByteArray stale;
+        if (lockIsStale(lockPath, stale) && breakLock(lockPath, stale))
+            continue;
+        SpcSleep::msleep(50);
+    }
+    lastError = "SPC statistics are locked by another station: " + lockPath;
+    return false;
+}
+
+void SpcStats::unlock() {
+    removeLock(statsPath + ".lock");
+}
@@ -0,0 +1,120 @@
+#ifndef STACKUPCALC_H
+#define STACKUPCALC_H
+
+// Qt-free stackup math shared by the calculators and the StackupTool batch CLI.
+// Nothing in here touches a widget, so the same formulas run headless.
+
+namespace Stackup {
+
+// design spec used across the coldstack calculators, inches unless noted
+const double icdTarget = 5.5941;
+const double icdMin = 5.5933;
+const double icdMax = 5.6013;
+const double angleMin = 10.93;          // degrees
+const double angleMax = 11.53;          // degrees
+const double centerMin = 0.011;
+const double centerMax = 0.015;
+const double csParallelMax = 0.0020;
+const double cfParallelMax = 0.0030;
+
+// coldfilter epoxy bondlines the dispenser can lay down, min to max in steps of resolution.
+// the defaults are the five bondlines calculateData1() used to offer, 0.0010 to 0.0030.
+struct BondlineSpec {
+    double min;
+    double max;
+    double resolution;
+};
+const BondlineSpec defaultBondlineSpec = { 0.0010, 0.0030, 0.0005 };
+
+// color codes used by the calculators' output labels
+enum Status { NotCalculated, Red, Yellow, Green };
+
+// motherboard mount
+double fpaAngle( double y1, double z1, double y2, double z2 );
+double opticalCenter( double z1, double z2 );
+Status angleStatus( double angle );
+Status centerStatus( double center );
+
+// plateau / fiducial averaging and parallelism
+double averageHeight( const double *heights, int count );
+double parallelism( const double *heights, int count );
+Status parallelStatus( double parallel, double limit );
+
+// coldshield mount, expected ICD = cs - fpa + cf + bl
+double coldshieldIcd( double cs, double fpa, double cf, double bl );
+Status icdStatus( double icd );
+
+// coldfilter mount, first half: bondline suggestion and tool ball height
+struct BondChoice {
+    double bondline;
+    double ballHeight;
+    double icd;
+    double windowMin;   // any bondline from windowMin to windowMax puts the ICD in spec
+    double windowMax;
+    double marginMin;   // icd - icdMin
+    double marginMax;   // icdMax - icd
+    Status status;      // Yellow when the ICD lands exactly on a limit
+};
+BondChoice chooseBondline( double cf, double cs, double fpa,
+                           const BondlineSpec &spec = defaultBondlineSpec );
+void chooseBondlines( const double *cf, const double *cs, const double *fpa, int count,
+                      BondChoice *choices, const BondlineSpec &spec = defaultBondlineSpec );
+
+// coldfilter mount, second half: final ICD = cf height - fpa
+double coldfilterIcd( double cf, double fpa );
+
+// a whole build as saved across the three calculators.  has* flags mirror the step
+// markers ("***", "****", "*****", "******") written by each updateSaveTable().
+struct BuildInputs {
+    bool hasMotherboard;
+    double sca1y, sca1z, sca2y, sca2z;
+
+    bool hasColdshield;
+    bool hasPlateaus;
+    double plateaus[4];
+    double csHeight;
+    double csCf;
+    double csFpa;
+    double csBondline;
+
+    bool hasColdfilter1;
+    BondlineSpec bondSpec;
+    double cf1Thickness;
+    double cf1Cs;
+    double cf1Fpa;
+
+    bool hasColdfilter2;
+    bool hasFiducials;
+    double fiducials[3];
+    double cf2Height;
+    double cf2Fpa;
+};
+
+struct BuildResults {
+    double angle;
+    double center;
+    Status angleStatus;
+    Status centerStatus;
+
+    double csHeight;
+    double csParallel;
+    double csIcd;
+    Status csParallelStatus;
+    Status csIcdStatus;
+
+    BondChoice bond;
+
+    double cfHeight;
+    double cfParallel;
+    double cfIcd;
+    Status cfParallelStatus;
+    Status cfIcdStatus;
+};
+
+void clearInputs( BuildInputs &in );
+void evaluateBuild( const BuildInputs &in, BuildResults &out );
+const char *statusName( Status status );
+
+}
+
+#endif // STACKUPCALC_H
@@ -0,0 +1,164 @@
+/* StartupTrace class is shared code used by the calculators to show where launch time goes.  Run a
+ * calculator with --trace-startup (optionally followed by a file name, startup-trace.json by
+ * default) and it writes a Chrome trace of its launch, which chrome://tracing or
+ * https://ui.perfetto.dev open as a timeline.  Without the flag every call returns at once.
+ *
+ * enable() looks for the flag before QApplication is constructed, so its construction is timed
+ * too, and starts the clock.  begin() and end() time a span; spans begun inside another span nest
+ * under it in the timeline.  phase() ends the span the previous phase() began, if it is still the
+ * innermost one, and begins the next, so a constructor's steps can be timed one after another with
+ * one line each and a single end() after the last.
+ *
+ * write() ends any spans still open and writes every span as a complete ("X") event, in
+ * microseconds from enable(), on one thread of one process named after the program.  main()
+ * calls it once the first paint has been processed.  The process' resident memory (working set on
+ * Windows) is sampled when tracing starts and as each span ends, and written as a "resident MB"
+ * counter, so a trace shows what each step costs in memory as well as time.
+*/
+
+#include "startuptrace.h"
+
+#include <QFile>
+#include <QList>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+struct TraceSpan {
+    const char *name;
+    qint64 start;
+    qint64 duration;
+    bool phase;
+};
+
+struct TraceSample {
+    qint64 time;
+    qint64 bytes;
+};
+
+static bool enabled = false;
+static QString tracePath;
+static QElapsedTimer traceClock;
+static QList <TraceSpan> openSpans;
+static QList <TraceSpan> spans;
+static QList <TraceSample> samples;
+
+static qint64 now() {
+    // microseconds; Qt 4.7 only counts milliseconds
+#if QT_VERSION >= 0x040800
+    return traceClock.nsecsElapsed() / 1000;
+#else
+    return traceClock.elapsed() * 1000;
+#endif
+}
+
+static qint64 residentBytes() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#elif defined(Q_OS_LINUX)
+    // second field of statm is resident pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return 0;
+    QList <QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+static void sample() {
+    TraceSample s;
+    s.time = now();
+    s.bytes = residentBytes();
+    if (s.bytes)
+        samples << s;
+}
+
+bool StartupTrace::enable( int argc, char *argv[] ) {
+    for (int i = 1; i < argc; i++) {
+        if (QString::fromLocal8Bit(argv[i]) != "--trace-startup")
+            continue;
+        tracePath = "startup-trace.json";
+        if (i + 1 < argc && argv[i + 1][0] != '-')
+            tracePath = QString::fromLocal8Bit(argv[i + 1]);
+        enabled = true;
+        traceClock.start();
+        sample();
+        return true;
+    }
+    return false;
+}
+
+bool StartupTrace::isEnabled() {
+    return enabled;
+}
+
+void StartupTrace::begin( const char *name ) {
+    if (!enabled)
+        return;
+    TraceSpan span;
+    span.name = name;
+    span.start = now();
+    span.duration = 0;
+    span.phase = false;
+    openSpans << span;
+}
+
+void StartupTrace::phase( const char *name ) {
+    if (!enabled)
+        return;
+    if (!openSpans.isEmpty() && openSpans.last().phase)
+        end();
+    begin(name);
+    openSpans.last().phase = true;
+}
+
+void StartupTrace::end() {
+    if (!enabled || openSpans.isEmpty())
+        return;
+    TraceSpan span = openSpans.takeLast();
+    span.duration = now() - span.start;
+    spans << span;
+    sample();
+}
+
+bool StartupTrace::write( const QString &program ) {
+    if (!enabled)
+        return false;
+    while (!openSpans.isEmpty())
+        end();
+    QFile file(tracePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return false;
+    QTextStream out(&file);
+    qint64 pid = QCoreApplication::applicationPid();
+    out << "{\"traceEvents\":[" << endl;
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":1,"
+        << "\"args\":{\"name\":\"" << program << "\"}}";
+    for (int i = 0; i < spans.size(); i++)
+        out << "," << endl << "{\"name\":\"" << spans[i].name << "\",\"cat\":\"startup\",\"ph\":\"X\","
+            << "\"ts\":" << spans[i].start << ",\"dur\":" << spans[i].duration
+            << ",\"pid\":" << pid << ",\"tid\":1}";
+    for (int i = 0; i < samples.size(); i++)
+        out << "," << endl << "{\"name\":\"resident MB\",\"ph\":\"C\",\"ts\":" << samples[i].time
+            << ",\"pid\":" << pid << ",\"tid\":1,\"args\":{\"MB\":"
+            << QString::number(samples[i].bytes / 1048576.0, 'f', 2) << "}}";
+    out << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+    out.flush();
+    return file.error() == QFile::NoError;
+}
+
+QString StartupTrace::path() {
+    return tracePath;
+}
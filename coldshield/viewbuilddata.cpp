@@ -5,9 +5,16 @@
  * showLink() launches a browser to view a .html.  Calculations performed at that step and
  * calculator tutorials file names are passed to it.
  *
- * showTable() outputs a window of all assembly data at that point.
+ * showTable() outputs a window of all assembly data at that point.  The table views the calculator's
+ * record through a BuildDataModel made on the first call; refreshTable() repaints only the rows
+ * that changed since, and the calculator calls it whenever its record changes.
  *
  * showAbout() provides software development information.
+ *
+ * showSpc() outputs a window of the running process statistics for every characteristic, see
+ * SpcStats.
+ *
+ * The notepad and SPC windows are made the first time they are shown.
 */
 
 #include "viewbuilddata.h"
@@ -22,12 +29,15 @@ ViewBuildData::ViewBuildData(QWidget *parent) :
     // set up children variables
     inputControl = ViewBuildData::findChild<QLineEdit *>("lineEditControl");
     inputSerial = ViewBuildData::findChild<QLineEdit *>("lineEditSerial");
-    tableView = ViewBuildData::findChild<QTableWidget *>("tableView");
-    kickBox = new QMessageBox();
-    notePad = new QTextEdit();
+    tableView = ViewBuildData::findChild<QTableView *>("tableView");
+    tableModel = 0;
+    notePad = 0;
+    spcTable = 0;
 }
 
 void ViewBuildData::showNotePad( ) {
+    if (!notePad)
+        notePad = new QTextEdit();
     notePad->show();
 }
 
@@ -40,49 +50,33 @@ void ViewBuildData::showLink( QString linkName ) {
     QProcess::startDetached("cmd", commands );
 }
 
-void ViewBuildData::showTable( QList<QString> tableKeys, QList<QString> tableVals ) {
-    // populates a table of production data across all steps.  most of this function is formatting.
-    tableView->clear();
-    if(tableVals.isEmpty() || tableKeys.isEmpty()) {
-        kickBox->information(this, tr("Error!!"), tr("No data to show."));
+void ViewBuildData::showTable( const BuildRecord *record ) {
+    // populates a table of production data across all steps, straight from the calculator's record
+    if (tableModel) {
+        refreshTable();
         return;
     }
-    int rowCount = 0;
-    inputControl->setText(tableVals[1]);
-    inputSerial->setText(tableVals[2]);
+    tableModel = new BuildDataModel(record, this);
+    tableView->setModel(tableModel);
+    tableView->setColumnWidth(0,175);
+    tableView->horizontalHeader()->setStretchLastSection(true);
+    // rows share one height, filling the table until the template outgrows it and it scrolls
+    int rowCount = qMax(1, tableModel->rowCount());
+    int rowHeight = qMax(tableView->fontMetrics().height() + 4, (tableView->height() - 2) / rowCount);
+    tableView->verticalHeader()->setResizeMode(QHeaderView::Fixed);
+    tableView->verticalHeader()->setDefaultSectionSize(rowHeight);
     inputControl->setEnabled(false);
     inputSerial->setEnabled(false);
-    bool isBold = false;
-    // bold values are the "important" values, or those calculated values
-    while (rowCount != tableVals.length()-3) {
-        tableView->setRowCount(rowCount+1);
-        QString str1 = tableKeys[rowCount+3];
-        QString str2 = tableVals[rowCount+3];
-        if (str1.contains("&")) {
-            str1.remove(str1.at(str1.length()-1));
-            isBold = true;
-        }
-        QTableWidgetItem *tableKey = new QTableWidgetItem(str1);
-        QTableWidgetItem *tableVal = new QTableWidgetItem(str2);
-        tableView->setItem(rowCount, 0, tableKey);
-        tableView->setItem(rowCount, 1, tableVal);
-        if (isBold) {
-            QFont font;
-            font.setBold(true);
-            tableView->item(rowCount, 0)->setFont(font);
-            tableView->item(rowCount, 1)->setFont(font);
-            isBold = false;
-        }
-        rowCount++;
-    }
-    tableView->setColumnWidth(0,175);
-    tableView->setColumnWidth(1,75);
-    tableView->resizeRowsToContents();
-    int rowHeight = (tableView->height() - 2) / rowCount;
-    int tableViewHeight = rowHeight * rowCount + 2;
-    for (int i = 0; i <= rowCount; i++)
-        tableView->setRowHeight(i, rowHeight);
-    tableView->setFixedHeight(tableViewHeight);
+    refreshTable();
+}
+
+void ViewBuildData::refreshTable( ) {
+    // nothing to do until the table has been opened once
+    if (!tableModel)
+        return;
+    tableModel->refresh();
+    inputControl->setText(tableModel->record()->control);
+    inputSerial->setText(tableModel->record()->serial);
 }
 
 void ViewBuildData::showAbout( QString exeName ) {
@@ -98,12 +92,48 @@ void ViewBuildData::showAbout( QString exeName ) {
     // shameless, truly
 }
 
+void ViewBuildData::showSpc( const QList <SpcSummary> &list ) {
+    // one row per characteristic, Cpk below 1.33 is flagged the way out of spec labels are
+    QStringList headers;
+    headers << tr("Characteristic") << tr("Limits") << tr("n") << tr("Mean") << tr("Sigma")
+            << tr("Cpk") << tr("Red") << tr("Yellow") << tr("Green");
+    if (!spcTable) {
+        spcTable = new QTableWidget();
+        spcTable->setWindowTitle(tr("SPC Statistics"));
+        spcTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    }
+    spcTable->clear();
+    spcTable->setColumnCount(headers.size());
+    spcTable->setHorizontalHeaderLabels(headers);
+    spcTable->setRowCount(list.size());
+    for (int i = 0; i < list.size(); i++) {
+        const SpcSummary &s = list[i];
+        QString limits = (qIsNaN(s.lower) ? QString("<= ") : QString::number(s.lower, 'f', 4) + " - ")
+                + QString::number(s.upper, 'f', 4);
+        QStringList cells;
+        cells << s.name << limits << QString::number(s.count)
+              << (s.count ? QString::number(s.mean, 'f', 4) : QString())
+              << (qIsNaN(s.sigma) ? QString() : QString::number(s.sigma, 'f', 5))
+              << (qIsNaN(s.cpk) ? QString() : QString::number(s.cpk, 'f', 2))
+              << QString::number(s.red) << QString::number(s.yellow) << QString::number(s.green);
+        for (int j = 0; j < cells.size(); j++)
+            spcTable->setItem(i, j, new QTableWidgetItem(cells[j]));
+        if (!qIsNaN(s.cpk))
+            spcTable->item(i, 5)->setBackground(s.cpk < 1.0 ? Qt::red : s.cpk < 1.33 ? Qt::yellow : Qt::green);
+    }
+    spcTable->resizeColumnsToContents();
+    spcTable->resize(640, 260);
+    spcTable->show();
+    spcTable->raise();
+}
+
 ViewBuildData::~ViewBuildData()
 {
     delete inputControl;
     delete inputSerial;
-    delete kickBox;
     delete notePad;
     delete tableView;
+    delete tableModel;
+    delete spcTable;
     delete ui;
 }
@@ -6,21 +6,53 @@
 
 QT       += core gui network
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = MotherboardMount
 TEMPLATE = app
 
+# StartupTrace reads the working set with GetProcessMemoryInfo()
+win32: LIBS += -lpsapi
+
 
 SOURCES += main.cpp\
         mountmb.cpp\
-		viewbuilddata.cpp
+		viewbuilddata.cpp\
+		stackupcalc.cpp\
+		buildarchive.cpp\
+		recordparser.cpp\
+		buildrecordio.cpp\
+		spcstats.cpp\
+		summaryindex.cpp\
+		recordwatcher.cpp\
+		calcserviceclient.cpp\
+		startuptrace.cpp\
+		recordloader.cpp\
+		builddatamodel.cpp\
+		historybrowser.cpp\
+		recordquery.cpp
 
 HEADERS  += mountmb.h\
-		viewbuilddata.h
+		viewbuilddata.h\
+		stackupcalc.h\
+		buildarchive.h\
+		recordparser.h\
+		buildrecordio.h\
+		spcstats.h\
+		summaryindex.h\
+		recordwatcher.h\
+		calcserviceclient.h\
+		startuptrace.h\
+		recordloader.h\
+		builddatamodel.h\
+		historybrowser.h\
+		recordquery.h
 
 FORMS    += mountmb.ui\
 		viewbuilddata.ui
 
 RESOURCES += \
     res.qrc
+
+# buildrecord.h is generated from control/saveTemplate.csv
+include(../recordgen/buildrecord.pri)
@@ -0,0 +1,35 @@
+#ifndef CALCSERVICECLIENT_H
+#define CALCSERVICECLIENT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QLocalSocket>
+#include <QDateTime>
+
+// CalcServiceClient asks a running StackupTool serve for records, see calcserviceclient.cpp
+class CalcServiceClient
+{
+public:
+    enum Reply { Ok, Failed, Unavailable };
+    explicit CalcServiceClient( const QString &archivePath, const QString &name = defaultName );
+    ~CalcServiceClient();
+    bool isAvailable();
+    Reply load( const QString &control, QByteArray &record );
+    Reply save( const QString &control, const QByteArray &record, QString &warnings );
+    Reply calculate( const QString &control, const QByteArray &record, QString &row );
+    Reply stats( QString &text );
+    QString errorString() const;
+    static const char *defaultName;
+
+private:
+    QString serverName;
+    QString archivePath;
+    QString lastError;
+    QLocalSocket *socket;
+    QDateTime retryAfter;
+    bool sent;
+    bool connectToService();
+    Reply request( const QByteArray &, const QString &, const QByteArray &, QByteArray &, int );
+};
+
+#endif // CALCSERVICECLIENT_H
@@ -1,26 +1,55 @@
 /* mountmb.cpp contains main callouts for motherboard mounting calculator.
  *
- * loadData() does some basic error checking, loads a .csv file, and populates appropriate fields.
+ * loadData() does some basic error checking and starts loading a record from the archive (or a not
+ * yet imported .csv file) on RecordLoader's thread, so a slow share never freezes the window.  The
+ * window shows a busy cursor until recordLoaded() populates the appropriate fields.  A new scan
+ * or clearData() drops a record still loading, and saveData() waits for it.
  *
- * saveData() checks for duplicate data, updates the saveTable, and writes the saveTable contents
- * to a .csv file.
+ * saveData() checks for duplicate data, updates the build record, and writes it to the build
+ * record archive, control/archive.dat.  Only the lines that changed are appended, and the archive
+ * is compacted in the background once enough deltas pile up.  See BuildArchive.  The SPC
+ * statistics in control/spc.dat are updated with the saved values, see SpcStats, and so is the
+ * dewar's line in the summary index, control/summary.dat, see SummaryIndex.  The constructor
+ * rebuilds the index when it is missing or out of step with the archive.  When StackupTool serve is
+ * running, loads and saves go through it instead, see CalcServiceClient; it keeps the archive, SPC
+ * statistics and index open for every station, and the constructor leaves the journal and the
+ * index to it.
  *
  * clearData() clears all fields and resets the dataLoaded boolean.
  *
+ * recordChanged() tells the operator when the open record was saved at another station.  The
+ * RecordWatcher has already merged the changed rows; recordLoaded() binds the form fields to rows
+ * for it, and saveData() asks before overwriting a copy saved elsewhere since it was loaded.
+ *
  * calculateData() checks that all required fields are populated and then calculates FPA Angle
  * and Optical Centerline.  The calculated values are then checked against the design spec and
- * color-coded accordingly.
+ * color-coded accordingly.  The formulas and spec limits live in stackupcalc.cpp so that
+ * StackupTool can re-run them headless.
  *
  * getScreenShot() takes a screenshot of the current window and saves to a desired directory.
  *
- * showNotepad(), showCalculations(), showBuildData(), showTutorial(), showAbout() all reference
- * functions in the ViewBuildData class.
+ * showNotepad(), showCalculations(), showBuildData(), showSpc(), showTutorial(), showAbout() all
+ * reference functions in the ViewBuildData class, which buildData() makes on first use.  The build
+ * data window views record directly and is refreshed wherever record changes.
+ *
+ * showHistory() opens a browser of every dewar in the summary index, sorted and filtered by any
+ * column of the template.  See HistoryBrowser.
+ *
+ * initializeTables() resets the build record to the saveTemplate.csv defaults.  The record is a
+ * BuildRecord, generated from the template at build time by recordgen, see buildrecordio.cpp.
  *
- * initializeTables() sets up the save tables structures for load/save.
+ * verifyTemplate() warns at launch when control/saveTemplate.csv has changed since this
+ * calculator was built.
  *
- * updateSaveTable() updates the save tables before writing to .csv.
+ * updateSaveTable() updates the build record before writing to the archive.
  *
- * fileExists() and checkText() are error checking functions.
+ * readRecord() reads a record through the service, or from the archive when none is running.
+ *
+ * The constructor times each step of the launch with StartupTrace when the calculator is started
+ * with --trace-startup.
+ *
+ * fileExists() and checkText() are error checking functions.  reportParseErrors() lists any
+ * malformed lines found by RecordParser when a record or the template is read.
 */
 
 #include "mountmb.h"
@@ -30,7 +59,9 @@ MountMB::MountMB(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MountMB)
 {
+    StartupTrace::phase("setupUi");
     ui->setupUi(this);
+    StartupTrace::phase("findChild");
     // set up local variables from XML in .ui file
     inputControl = MountMB::findChild<QLineEdit *>("lineEditControl");
     inputSerial = MountMB::findChild<QLineEdit *>("lineEditSerial");
@@ -42,18 +73,49 @@ MountMB::MountMB(QWidget *parent) :
     outputCenter = MountMB::findChild<QLabel *>("labelOutputCenter");
     // dataLoaded is a boolean which will tell whether data has been loaded
     dataLoaded = false;
-    // this is the saving table template path, then tables are initialized
-    pathTemplate = new QString("control/saveTemplate.csv");
-    initializeTables( pathTemplate );
+    StartupTrace::phase("archive and service");
+    // every control number's record is kept in this one indexed file
+    archive = new BuildArchive("control/archive.dat");
+    // a running StackupTool serve shares its cache of records it has read, see CalcServiceClient
+    service = new CalcServiceClient("control/archive.dat");
+    bool served = service->isAvailable();
+    // saves journaled by a station that stopped before applying them go in before anything is read,
+    // the service did that, and the index rebuild below, when it started
+    if (!served && !archive->replayJournal())
+        statusBar()->showMessage(tr("Save journal not replayed: %1").arg(archive->errorString()));
+    StartupTrace::phase("SpcStats, RecordWatcher, SummaryIndex");
+    // running mean, sigma and pass/fail counts of every characteristic, kept up to date on save
+    spc = new SpcStats("control/spc.dat");
+    // the open record follows saves from other stations, see RecordWatcher
+    watcher = new RecordWatcher(archive, &record);
+    connect(watcher, SIGNAL(recordChanged(QStringList,QStringList)), this,
+            SLOT(recordChanged(QStringList,QStringList)));
+    // records are read and parsed off the GUI thread, see loadData()
+    loader = new RecordLoader("control/archive.dat", this);
+    connect(loader, SIGNAL(loaded(RecordLoad)), this, SLOT(recordLoaded(RecordLoad)));
+    // step state and key outputs of every dewar, rebuilt here if a save or import went around it
+    summary = new SummaryIndex("control/summary.dat", "control/archive.dat");
+    if (!served && summary->isStale() && !summary->rebuild())
+        statusBar()->showMessage(tr("Summary index not rebuilt: %1").arg(summary->errorString()));
+    StartupTrace::phase("dialogs");
     controlInputDialog = new QInputDialog();
     kickBox = new QMessageBox();
-    viewBuildData = new ViewBuildData();
+    // build data, notepad and SPC windows are made the first time one is asked for, see buildData()
+    viewBuildData = 0;
+    history = 0;
+    StartupTrace::phase("template");
+    // the record layout is compiled in from the template, check the template hasn't moved since
+    pathTemplate = new QString("control/saveTemplate.csv");
+    verifyTemplate( pathTemplate );
+    initializeTables( );
+    StartupTrace::end();
 }
 
 void MountMB::loadData() {
     bool ok;
-    // reset saving tables
-    initializeTables( pathTemplate );
+    // reset build record, the previous one is no longer followed
+    watcher->stop();
+    initializeTables( );
     controlInputDialog->setOptions(QInputDialog::NoButtons);
     QString inputText = controlInputDialog->getText(this, "Load Data", "Wand or input Control Number:",
                                       QLineEdit::Normal, inputControl->text(), &ok);
@@ -62,42 +124,50 @@ void MountMB::loadData() {
     QString loadText = checkText( inputText );
     if (!goodText)
         return;
-    QString fileName = "control/" + loadText + ".csv";
-    QFile file(fileName);
-    if(!file.open(QIODevice::ReadOnly)) {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the record is read and parsed on the loader's thread, recordLoaded() fills the form
+    loader->load(loadText);
+    setCursor(Qt::BusyCursor);
+    statusBar()->showMessage(tr("Loading C%1...").arg(loadText));
+}
+
+void MountMB::recordLoaded( const RecordLoad &load ) {
+    unsetCursor();
+    statusBar()->clearMessage();
+    if (!load.found) {
+        kickBox->information(this, tr("Unable to open file"), load.error);
         return;
     }
-    QMap <QString, QString> data;
-    int counter = 1;
-    // while loop to populate tables with values from .csv
-    while (!file.atEnd()) {
-        QByteArray line = file.readLine();
-        data.insert(line.split(',').first(), line.split(',').last().trimmed());
-        saveTable[counter++] = line.split(',').last().trimmed();
-    }
-    file.close();
-    if(data.isEmpty()) {
+    record = load.record;
+    reportParseErrors( load.errors, "C" + load.control );
+    if(load.fieldCount == 0) {
         kickBox->information(this, tr("No data in file"),
                 tr("The file you are attempting to open contains no data."));
     } else {
         dataLoaded = true;
-        // populate fields in calculator with table data
-        inputControl->setText(data.value(saveTemplate[1]));
-        inputSerial->setText(data.value(saveTemplate[2]));
-        inputSCA1y->setText(QString::number(data.value(saveTemplate[3]).toDouble(), 'f', 4));
-        inputSCA1z->setText(QString::number(data.value(saveTemplate[4]).toDouble(), 'f', 4));
-        inputSCA2y->setText(QString::number(data.value(saveTemplate[5]).toDouble(), 'f', 4));
-        inputSCA2z->setText(QString::number(data.value(saveTemplate[6]).toDouble(), 'f', 4));
+        // populate fields in calculator with record data
+        inputControl->setText(record.control);
+        inputSerial->setText(record.serial);
+        watcher->bind(BuildRecord::RowSca1y, inputSCA1y);
+        watcher->bind(BuildRecord::RowSca1z, inputSCA1z);
+        watcher->bind(BuildRecord::RowSca2y, inputSCA2y);
+        watcher->bind(BuildRecord::RowSca2z, inputSCA2z);
         // once data loaded, calculate end values and lock control number and serial number fields.
         calculateData( );
+        watcher->watch(load.control);
         inputControl->setEnabled(false);
         inputSerial->setEnabled(false);
     }
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountMB::saveData() {
     bool ok;
+    if (loader->isLoading()) {
+        kickBox->warning(this, tr("Save Error"), tr("C%1 is still loading.").arg(loader->control()));
+        return;
+    }
     if ( inputSerial->text().isEmpty() ) {
         kickBox->warning(this, tr("Save Error"), tr("No dewar serial number input."));
         return;
@@ -120,7 +190,7 @@ void MountMB::saveData() {
     inputControl->setText(saveText);
     QString fileName = "control/" + saveText + ".csv";
     // check for duplicate files and if so, should the file be overwritten
-    if (!dataLoaded && fileExists(fileName)) {
+    if (!dataLoaded && (archive->contains(saveText) || fileExists(fileName))) {
         kickBox->warning(this, tr("Saved Data Detected"),
                             tr("Save data for C%1 detected but not loaded.\n"
                                "To avoid overwriting production history, "
@@ -132,31 +202,61 @@ void MountMB::saveData() {
         if (reply == QMessageBox::No)
             return;
     }
-    // update all tables from current calculator fields for writing to .csv
+    // update the build record from current calculator fields for writing to the archive
     updateSaveTable( );
-    QFile file(fileName);
-    QMap <QString, QString> data;
-    if(file.open(QFile::WriteOnly|QFile::Truncate)) {
-        QTextStream stream(&file);
-        int rowCount = saveTable.size() - 1;
-        // populate file stream with table data and close
-        for (int i = 1; i <= rowCount; i++) {
-            data.insert(saveTemplate[i], saveTable[i]);
-            stream << saveTemplate[i] << ",\t" << saveTable[i] << endl;
-        }
-        file.close();
-    } else {
-        kickBox->information(this, tr("Unable to open file"), file.errorString());
+    // the copy being overwritten comes back out of the SPC statistics
+    QByteArray previous;
+    readRecord(saveText, previous);
+    // another station saved this dewar after it was loaded here
+    if (!watcher->isCurrent(saveText, previous)) {
+        QString both;
+        if (!watcher->conflicts().isEmpty())
+            both = tr("\nChanged at both stations: %1").arg(watcher->conflicts().join(", "));
+        QMessageBox::StandardButton reply;
+        reply = QMessageBox::question(this, "Record Changed",
+                            tr("C%1 was saved at another station after it was loaded here.%2\n"
+                               "Overwrite it with this station's values?").arg(saveText).arg(both),
+                                    QMessageBox::Yes|QMessageBox::No);
+        if (reply == QMessageBox::No)
+            return;
+    }
+    // same "key,\tvalue" rows the .csv files used; the service writes and counts them in one go
+    QString warnings;
+    CalcServiceClient::Reply served = service->save(saveText, BuildRecordIO::save(record), warnings);
+    if (served == CalcServiceClient::Failed) {
+        kickBox->information(this, tr("Unable to save record"), service->errorString());
         return;
     }
-    if(data.isEmpty()) {
-        kickBox->information(this, tr("No data in file"),
-                tr("The file you are attempting to save contains no data."));
+    if (served == CalcServiceClient::Unavailable) {
+        qint64 archiveBefore = SummaryIndex::archiveGeneration( archive->path() );
+        if (!archive->write(saveText, BuildRecordIO::save(record))) {
+            kickBox->information(this, tr("Unable to save record"), archive->errorString());
+            return;
+        }
+        // the record is saved either way, StackupTool spc and summary --rebuild recover the rest
+        if (!spc->update(previous, record))
+            statusBar()->showMessage(tr("SPC statistics not updated: %1").arg(spc->errorString()));
+        if (!summary->update(record, archiveBefore))
+            statusBar()->showMessage(tr("Summary index not updated: %1").arg(summary->errorString()));
+        // saves append deltas, every so often one station folds them back in on another thread
+        if (archive->wantsCompaction())
+            QtConcurrent::run(BuildArchive::compactPath, archive->path());
+    } else if (!warnings.isEmpty()) {
+        statusBar()->showMessage(warnings.section('\n', 0, 0));
     }
+    // this save is now the copy the open record follows
+    watcher->watch(saveText);
 }
 
 void MountMB::clearData() {
     dataLoaded = false;
+    watcher->stop();
+    // a record still loading belongs to the dewar being cleared
+    if (loader->isLoading()) {
+        loader->cancel();
+        unsetCursor();
+        statusBar()->clearMessage();
+    }
     // error if no fields populated
     if (inputSCA1y->text().isEmpty() && inputSCA1z->text().isEmpty()
             && inputSCA2y->text().isEmpty() && inputSCA2z->text().isEmpty()) {
@@ -175,7 +275,7 @@ void MountMB::clearData() {
     }
     inputControl->setEnabled(true);
     inputSerial->setEnabled(true);
-    initializeTables( pathTemplate );
+    initializeTables( );
 }
 
 void MountMB::calculateData() {
@@ -195,20 +295,20 @@ void MountMB::calculateData() {
         double y2 = inputSCA2y->text().toDouble();
         double z2 = inputSCA2z->text().toDouble();
 
-        angle = atan( (z2 - z1) / (y2 - y1) ) * ( 180 / M_PI );
+        angle = Stackup::fpaAngle( y1, z1, y2, z2 );
 
-        center = ( (z1 - z2) / 2 ) + z2;
+        center = Stackup::opticalCenter( z1, z2 );
 
         QString angleShow = QString::number(angle, 'f', 4);
         outputAngle->setText(angleShow);
         QString centerShow = QString::number(center, 'f', 4);
         outputCenter->setText(centerShow);
         // once calculated, populate output objects and color-code according to spec
-        if (angle > 11.53 || angle < 10.93)
+        if (Stackup::angleStatus(angle) == Stackup::Red)
             outputAngle->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputAngle->setStyleSheet("QLabel { background-color : green; color : black; }");
-        if (center > 0.015 || center < 0.011)
+        if (Stackup::centerStatus(center) == Stackup::Red)
             outputCenter->setStyleSheet("QLabel { background-color : red; color : black; }");
         else
             outputCenter->setStyleSheet("QLabel { background-color : green; color : black; }");
@@ -228,61 +328,117 @@ void MountMB::getScreenShot() {
 }
 
 void MountMB::showNotepad() {
-    viewBuildData->showNotePad();
+    buildData()->showNotePad();
 }
 
 void MountMB::showCalculations() {
-    viewBuildData->showLink( QString("calcs") );
+    buildData()->showLink( QString("calcs") );
 }
 
 void MountMB::showBuildData() {
-    viewBuildData->showTable(saveTemplate, saveTable);
-    viewBuildData->show();
+    buildData()->showTable( &record );
+    buildData()->show();
+}
+
+void MountMB::showSpc() {
+    buildData()->showSpc( spc->summaries() );
+}
+
+void MountMB::showHistory() {
+    // made on first use, the summary index is reread every time it's opened
+    if (!history)
+        history = new HistoryBrowser(summary);
+    history->reload();
+    history->show();
+    history->raise();
+}
+
+void MountMB::recordChanged( const QStringList &applied, const QStringList &conflicts ) {
+    if (conflicts.isEmpty())
+        statusBar()->showMessage(tr("C%1 was saved at another station, updated %2")
+                                 .arg(watcher->control()).arg(applied.join(", ")));
+    else
+        statusBar()->showMessage(tr("C%1 was saved at another station, kept your edits to %2")
+                                 .arg(watcher->control()).arg(conflicts.join(", ")));
+    // outputs already shown are recalculated from the updated fields
+    if (!outputAngle->text().isEmpty())
+        calculateData( );
+    // an open build data window repaints the rows that changed
+    if (viewBuildData)
+        viewBuildData->refreshTable();
 }
 
 void MountMB::showTutorial() {
-    viewBuildData->showLink( QString("tutorial") );
+    buildData()->showLink( QString("tutorial") );
 }
 
 void MountMB::showAbout() {
     QString exeName = "MotherboardMount.exe\n";
-    viewBuildData->showAbout( exeName );
+    buildData()->showAbout( exeName );
 }
 
-void MountMB::initializeTables( QString* path ) {
-    // reset all tables at .exe launch or during clearData(), etc.
-    saveTemplate.clear();
-    saveTable.clear();
+void MountMB::initializeTables( ) {
+    // reset the build record at .exe launch or during clearData(), etc.
+    BuildRecordIO::clear( record );
+}
+
+void MountMB::verifyTemplate( QString* path ) {
     QFile templat(*path);
     if(!templat.open(QIODevice::ReadOnly)) {
         kickBox->information(this, tr("Unable to open file"), templat.errorString());
         return;
     }
-    while (!templat.atEnd()) {
-        QByteArray line = templat.readLine();
-        saveTemplate << line.split(',').first().trimmed();
-        saveTable << line.split(',').last().trimmed();
-    }
-    // bandaid to line up indices :(
-    saveTemplate.prepend("@@@");
-    saveTable.prepend("@@@");
+    QString problem = BuildRecordIO::checkTemplate( templat.readAll() );
     templat.close();
+    if (!problem.isEmpty())
+        kickBox->warning(this, tr("Template Mismatch"),
+                         tr("%1 has changed since this calculator was built.\n"
+                            "Records saved now may not line up with the template.\n\n%2")
+                         .arg(*path).arg(problem));
 }
 
 void MountMB::updateSaveTable( ) {
-    // get all current data from calulator fields and insert in saveTable array
-    saveTable[1] = inputControl->text();
-    saveTable[2] = inputSerial->text();
-    saveTable[3] = inputSCA1y->text();
-    saveTable[4] = inputSCA1z->text();
-    saveTable[5] = inputSCA2y->text();
-    saveTable[6] = inputSCA2z->text();
-    saveTable[7] = outputAngle->text();
-    saveTable[8] = outputCenter->text();
+    // get all current data from calulator fields and insert in the build record
+    record.control = inputControl->text();
+    record.serial = inputSerial->text();
+    record.sca1y = BuildRecordIO::number(inputSCA1y->text());
+    record.sca1z = BuildRecordIO::number(inputSCA1z->text());
+    record.sca2y = BuildRecordIO::number(inputSCA2y->text());
+    record.sca2z = BuildRecordIO::number(inputSCA2z->text());
+    record.fpaAngle = BuildRecordIO::number(outputAngle->text());
+    record.opticalCenter = BuildRecordIO::number(outputCenter->text());
     // asterisks are used to tell saveData() in later calculators whether file is new or not
-    // default in saveTemplate is "$$$", which is overwritten to "***", etc.
-    saveTable[9] = "***";
-    saveTemplate[9] = "***";
+    // default in saveTemplate is "$$$", which is saved as "***", etc.
+    record.motherboardSaved = true;
+    if (viewBuildData)
+        viewBuildData->refreshTable();
+}
+
+void MountMB::reportParseErrors( const std::vector <RecordError> &errors, QString source ) {
+    // malformed lines are skipped by the parser, flag them so the record can be fixed
+    if (errors.empty())
+        return;
+    QString lines;
+    for (unsigned i = 0; i < errors.size() && i < 10; i++)
+        lines += tr("Line %1: %2\n").arg(errors[i].line).arg(errors[i].message);
+    kickBox->warning(this, tr("Malformed Record"),
+                     tr("%1 contains malformed lines.\n"
+                        "Verify build data before proceeding.\n\n%2").arg(source).arg(lines));
+}
+
+ViewBuildData *MountMB::buildData( ) {
+    // most sessions never open one of its windows
+    if (!viewBuildData)
+        viewBuildData = new ViewBuildData();
+    return viewBuildData;
+}
+
+bool MountMB::readRecord( const QString &control, QByteArray &bytes ) {
+    // the service answers from its record cache, without one the archive is read here
+    CalcServiceClient::Reply served = service->load(control, bytes);
+    if (served == CalcServiceClient::Unavailable)
+        return archive->read(control, bytes);
+    return served == CalcServiceClient::Ok;
 }
 
 bool MountMB::fileExists( QString path ) {
@@ -326,8 +482,14 @@ MountMB::~MountMB()
     delete outputAngle;
     delete outputCenter;
     delete pathTemplate;
+    delete archive;
+    delete spc;
+    delete watcher;
+    delete summary;
+    delete service;
     delete controlInputDialog;
     delete kickBox;
     delete viewBuildData;
+    delete history;
     delete ui;
 }
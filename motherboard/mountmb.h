@@ -6,16 +6,29 @@
 #include <QTextStream>
 #include <QFile>
 #include <QFileInfo>
+#include <QVector>
 #include <QList>
 #include <QStringList>
 #include <QMap>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QtConcurrentRun>
 #include <cmath>
 #include <algorithm>
 #include <iostream>
 
 #include <viewbuilddata.h>
+#include <historybrowser.h>
+#include <stackupcalc.h>
+#include <buildarchive.h>
+#include <spcstats.h>
+#include <summaryindex.h>
+#include <recordwatcher.h>
+#include <calcserviceclient.h>
+#include <recordloader.h>
+#include <startuptrace.h>
+#include <recordparser.h>
+#include <buildrecordio.h>
 
 class QLabel;
 class QLineEdit;
@@ -44,9 +57,15 @@ public slots:
     void showNotepad();
     void showCalculations();
     void showBuildData();
+    void showSpc();
+    void showHistory();
     void showTutorial();
     void showAbout();
 
+private slots:
+    void recordChanged( const QStringList &, const QStringList & );
+    void recordLoaded( const RecordLoad & );
+
 private:
     Ui::MountMB *ui;
     QLineEdit *inputControl;
@@ -62,13 +81,23 @@ private:
     QMessageBox *kickBox;
     QInputDialog *controlInputDialog;
     QString *pathTemplate;
-    QList <QString> saveTemplate;
-    QList <QString> saveTable;
-    void initializeTables( QString* );
+    BuildArchive *archive;
+    SpcStats *spc;
+    SummaryIndex *summary;
+    RecordWatcher *watcher;
+    RecordLoader *loader;
+    CalcServiceClient *service;
+    BuildRecord record;
+    void initializeTables( );
+    void verifyTemplate( QString* );
     void updateSaveTable( );
+    void reportParseErrors( const std::vector <RecordError> &, QString );
+    ViewBuildData *buildData( );
+    bool readRecord( const QString &, QByteArray & );
     bool fileExists( QString );
     QString checkText( QString );
     ViewBuildData *viewBuildData;
+    HistoryBrowser *history;
 };
 
 #endif // MOUNTMB_H
@@ -0,0 +1,58 @@
+#ifndef RECORDQUERY_H
+#define RECORDQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QBitArray>
+
+#include "summaryindex.h"
+
+// RecordQuery picks dewars out of the summary index with a small predicate language, see recordquery.cpp
+class RecordQuery
+{
+public:
+    RecordQuery();
+    bool parse( const QString &text );
+    QString errorString() const;
+    QBitArray run( const SummaryColumns &columns ) const;
+    QVector <int> matches( const SummaryColumns &columns ) const;
+    static QStringList fieldNames();
+
+private:
+    enum FieldKind { ControlField, SerialField, StepField, SavedField, NumberField, TextField };
+    enum Op { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Between, Contains };
+    struct Term {
+        FieldKind kind;
+        int index;              // column of SummaryColumns::numbers or texts, or the step bit
+        double tolerance;       // half the last decimal a number field is saved with
+        Op op;
+        double low;             // numbers and dates; a date covers low to lowEnd, lowEnd excluded
+        double lowEnd;
+        double high;            // the high end of between
+        double highEnd;
+        QString text;
+        QString highText;
+    };
+    struct Node {
+        int term;               // -1 for "and" and "or" nodes
+        bool isAnd;
+        int left;
+        int right;
+    };
+    QVector <Term> terms;
+    QVector <Node> nodes;
+    int root;
+    QStringList tokens;
+    int next;
+    QString lastError;
+    int parseOr( );
+    int parseAnd( );
+    int parseTerm( );
+    bool parseValue( Term &term, const QString &value, bool highEnd );
+    int fail( const QString &message );
+    QBitArray evaluate( int node, const SummaryColumns &columns ) const;
+    QBitArray evaluateTerm( const Term &term, const SummaryColumns &columns ) const;
+};
+
+#endif // RECORDQUERY_H
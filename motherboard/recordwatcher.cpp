@@ -0,0 +1,161 @@
+/* RecordWatcher class is shared code used by the calculators to follow the open record while other
+ * stations save it, so an operator doesn't have to reload "just in case".
+ *
+ * watch() is called once a record is loaded (or saved) and remembers the archive's copy of it.
+ * The files BuildArchive::watchPaths() lists are watched with QFileSystemWatcher: a save lands in
+ * archive.dat.journal and raises the count in archive.dat.saves, and only reaches archive.dat when
+ * a batch is applied, maybe much later.  The control directory is watched as well, since the
+ * journal is renamed away with each batch and a new one appears with the next save.  A change is
+ * settled for a moment (a save touches two files, a batch several times) and the open control's
+ * record is read back, journal first.  Nothing further happens unless its bytes differ from the
+ * copy remembered, which is one indexed read per save on the floor and never a Proteus fetch.
+ *
+ * When the record did change, only the rows that differ are merged into the calculator's record.
+ * bind() tells the watcher which form field shows a row: a field still showing the old value is
+ * updated, one the operator has since edited is left alone and reported as a conflict.  Rows
+ * without a field are always merged, so a save here no longer puts back another station's old
+ * values.  recordChanged() reports both lists by field name.
+ *
+ * isCurrent() is asked by saveData() before writing: false when the archive copy has moved on
+ * since it was last merged, or a merge left conflicts, so the operator can decide before
+ * overwriting.
+ *
+ * The archive lives on the share, where change notification depends on the file server; if none
+ * arrives the save check still catches the stale copy.
+*/
+
+#include "recordwatcher.h"
+#include "buildrecordio.h"
+#include "recordparser.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+RecordWatcher::RecordWatcher( const BuildArchive *archive, BuildRecord *record, QObject *parent ) :
+    QObject(parent),
+    archive(archive),
+    record(record)
+{
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, SIGNAL(fileChanged(QString)), this, SLOT(archiveChanged(QString)));
+    connect(watcher, SIGNAL(directoryChanged(QString)), this, SLOT(archiveChanged(QString)));
+    settle = new QTimer(this);
+    settle->setSingleShot(true);
+    settle->setInterval(300);
+    connect(settle, SIGNAL(timeout()), this, SLOT(checkRecord()));
+}
+
+void RecordWatcher::watch( const QString &control ) {
+    watched = control;
+    seen = *record;
+    conflicted.clear();
+    baseline.clear();
+    archive->read(control, baseline);
+    QString dir = QFileInfo(archive->path()).absolutePath();
+    if (watcher->directories().isEmpty() && QFile::exists(dir))
+        watcher->addPath(dir);
+    watchFiles();
+}
+
+void RecordWatcher::watchFiles( ) {
+    // compact() replaces the archive and a batch renames the journal away, which drops them from
+    // the watcher; they are picked up again once they exist
+    QStringList paths = archive->watchPaths();
+    for (int i = 0; i < paths.size(); i++) {
+        if (!watcher->files().contains(paths[i]) && QFile::exists(paths[i]))
+            watcher->addPath(paths[i]);
+    }
+}
+
+void RecordWatcher::stop( ) {
+    watched.clear();
+    baseline.clear();
+    conflicted.clear();
+    bindings.clear();
+    settle->stop();
+}
+
+void RecordWatcher::bind( int row, QLineEdit *edit, int decimals ) {
+    // a field shows one row at a time, the last one it was filled from
+    QMultiMap <int, RecordBinding>::iterator i = bindings.begin();
+    while (i != bindings.end()) {
+        if (i.value().edit == edit)
+            i = bindings.erase(i);
+        else
+            ++i;
+    }
+    RecordBinding binding;
+    binding.edit = edit;
+    binding.decimals = decimals;
+    bindings.insert(row, binding);
+    edit->setText(rowText( *record, row, decimals ));
+}
+
+bool RecordWatcher::isCurrent( const QString &control, const QByteArray &archived ) const {
+    if (control != watched)
+        return true;
+    return archived == baseline && conflicted.isEmpty();
+}
+
+QString RecordWatcher::control( ) const {
+    return watched;
+}
+
+QStringList RecordWatcher::conflicts( ) const {
+    return conflicted;
+}
+
+QString RecordWatcher::rowText( const BuildRecord &from, int row, int decimals ) {
+    const BuildRecordField &f = buildRecordFields[row];
+    if (f.type == RecordNumber)
+        return BuildRecordIO::numberText(from.*f.number, decimals);
+    return BuildRecordIO::text(from, row);
+}
+
+void RecordWatcher::archiveChanged( const QString & ) {
+    watchFiles();
+    if (!watched.isEmpty())
+        settle->start();
+}
+
+void RecordWatcher::checkRecord( ) {
+    QByteArray bytes;
+    if (watched.isEmpty() || !archive->read(watched, bytes) || bytes == baseline)
+        return;
+    BuildRecord latest;
+    RecordParser parser(bytes.constData(), bytes.size());
+    if (BuildRecordIO::load( parser, latest ) == 0)
+        return;
+    QStringList applied;
+    QStringList conflicts;
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        const BuildRecordField &f = buildRecordFields[row];
+        if (BuildRecordIO::text(seen, row) == BuildRecordIO::text(latest, row))
+            continue;
+        QList <RecordBinding> bound = bindings.values(row);
+        // the operator has typed over a field showing this row, their value wins until they decide
+        bool edited = false;
+        for (int i = 0; i < bound.size(); i++)
+            edited = edited || bound[i].edit->text() != rowText( seen, row, bound[i].decimals );
+        if (edited) {
+            conflicts << f.name;
+            continue;
+        }
+        for (int i = 0; i < bound.size(); i++)
+            bound[i].edit->setText(rowText( latest, row, bound[i].decimals ));
+        if (f.type == RecordText)
+            record->*f.text = latest.*f.text;
+        else if (f.type == RecordNumber)
+            record->*f.number = latest.*f.number;
+        else
+            record->*f.marker = latest.*f.marker;
+        applied << f.name;
+    }
+    seen = latest;
+    baseline = bytes;
+    for (int i = 0; i < conflicts.size(); i++) {
+        if (!conflicted.contains(conflicts[i]))
+            conflicted << conflicts[i];
+    }
+    emit recordChanged(applied, conflicts);
+}
@@ -0,0 +1,57 @@
+#ifndef RECORDWATCHER_H
+#define RECORDWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMultiMap>
+#include <QLineEdit>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+#include "buildarchive.h"
+#include "buildrecord.h"
+
+// one form field filled from a build record row, see RecordWatcher::bind()
+struct RecordBinding {
+    QLineEdit *edit;
+    int decimals;
+};
+
+// RecordWatcher keeps the open record in step with saves from other stations, see recordwatcher.cpp
+class RecordWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    RecordWatcher( const BuildArchive *archive, BuildRecord *record, QObject *parent = 0 );
+    void watch( const QString &control );
+    void stop( );
+    void bind( int row, QLineEdit *edit, int decimals = 4 );
+    bool isCurrent( const QString &control, const QByteArray &archived ) const;
+    QString control( ) const;
+    QStringList conflicts( ) const;
+
+signals:
+    void recordChanged( const QStringList &applied, const QStringList &conflicts );
+
+private slots:
+    void archiveChanged( const QString & );
+    void checkRecord( );
+
+private:
+    const BuildArchive *archive;
+    BuildRecord *record;
+    QFileSystemWatcher *watcher;
+    QTimer *settle;
+    QString watched;
+    QByteArray baseline;
+    BuildRecord seen;
+    QMultiMap <int, RecordBinding> bindings;
+    QStringList conflicted;
+    void watchFiles( );
+    static QString rowText( const BuildRecord &, int, int );
+};
+
+#endif // RECORDWATCHER_H
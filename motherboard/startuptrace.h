@@ -0,0 +1,19 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+// StartupTrace times the phases of a calculator's launch into a Chrome trace file, see startuptrace.cpp
+class StartupTrace
+{
+public:
+    static bool enable( int argc, char *argv[] );
+    static bool isEnabled();
+    static void begin( const char *name );
+    static void phase( const char *name );
+    static void end();
+    static bool write( const QString &program );
+    static QString path();
+};
+
+#endif // STARTUPTRACE_H
@@ -0,0 +1,67 @@
+#ifndef SUMMARYINDEX_H
+#define SUMMARYINDEX_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QDateTime>
+
+#include "buildrecord.h"
+
+// one dewar's line in the summary index, enough to answer where it is in the build
+struct SummaryEntry {
+    QString control;
+    QString serial;
+    int steps;                  // SummaryIndex::Step bits, one per step marker saved
+    double fpaAngle;
+    double opticalCenter;
+    double coldshieldHeight;
+    double csExpectedIcd;
+    double cfExpectedIcd;
+    double finalIcd;
+    QVector <double> numbers;   // every number row, in SummaryIndex::numberRows() order
+    QVector <QString> texts;    // every other text row, in SummaryIndex::textRows() order
+    QDateTime saved;            // invalid for entries rebuilt from the archive
+};
+
+// every entry of the summary index column by column, one array per field, for queries and browsing
+struct SummaryColumns {
+    QVector <QString> control;
+    QVector <QString> serial;
+    QVector <int> steps;
+    QVector <qint64> saved;                 // time_t, 0 for entries rebuilt from the archive
+    QVector < QVector <double> > numbers;   // one column per SummaryIndex::numberRows()
+    QVector < QVector <QString> > texts;    // one column per SummaryIndex::textRows()
+    int size() const { return control.size(); }
+};
+
+// SummaryIndex keeps the step state and key outputs of every archived record, see summaryindex.cpp
+class SummaryIndex
+{
+public:
+    enum Step { MotherboardStep = 1, ColdshieldStep = 2, Coldfilter1Step = 4, Coldfilter2Step = 8 };
+    // how many characters of each text value an entry keeps, anything longer is cut off
+    enum Width { ControlWidth = 16, SerialWidth = 24, TextWidth = 16 };
+    SummaryIndex( const QString &path, const QString &archivePath );
+    bool isStale() const;
+    bool update( const BuildRecord &record, qint64 archiveBefore );
+    bool rebuild();
+    QList <SummaryEntry> entries() const;
+    bool columns( SummaryColumns &columns ) const;
+    QList <SummaryEntry> waitingFor( Step step ) const;
+    static SummaryEntry summarize( const BuildRecord &record );
+    static const QVector <int> &numberRows();
+    static const QVector <int> &textRows();
+    static qint64 archiveGeneration( const QString &archivePath );
+    QString path() const;
+    QString errorString() const;
+
+private:
+    QString indexPath;
+    QString archivePath;
+    mutable QString lastError;
+    bool lock();
+    void unlock();
+};
+
+#endif // SUMMARYINDEX_H
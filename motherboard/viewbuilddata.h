@@ -7,6 +7,9 @@
 #include <QTableWidget>
 #include <QTableWidgetItem>
 
+#include <spcstats.h>
+#include <builddatamodel.h>
+
 class QLabel;
 class QLineEdit;
 class QTextEdit;
@@ -24,17 +27,20 @@ public:
     explicit ViewBuildData(QWidget *parent = 0);
     void showNotePad( );
     void showLink( QString );
-    void showTable( QList <QString>, QList <QString> );
+    void showTable( const BuildRecord * );
+    void refreshTable( );
     void showAbout( QString );
+    void showSpc( const QList <SpcSummary> & );
     ~ViewBuildData();
 
 private:
     Ui::ViewBuildData *ui;
     QLineEdit *inputControl;
     QLineEdit *inputSerial;
-    QMessageBox *kickBox;
     QTextEdit *notePad;
-    QTableWidget *tableView;
+    QTableView *tableView;
+    BuildDataModel *tableModel;
+    QTableWidget *spcTable;
 };
 
 #endif // VIEWBUILDDATA_H
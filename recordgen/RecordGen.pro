@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Build-time generator for buildrecord.h, see buildrecord.pri
+#
+#-------------------------------------------------
+
+CONFIG   -= qt
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = recordgen
+TEMPLATE = app
+# keep the tool next to the Makefile so buildrecord.pri can find it in debug and release builds
+DESTDIR = $$OUT_PWD
+
+
+SOURCES += main.cpp\
+		recordparser.cpp
+
+HEADERS  += recordparser.h
@@ -0,0 +1,27 @@
+# buildrecord.pri generates buildrecord.h from control/saveTemplate.csv for the project including it.
+#
+# The template is read at build time from SAVE_TEMPLATE, which defaults to the production copy on
+# the share.  Point it elsewhere with:  qmake SAVE_TEMPLATE=C:/path/to/saveTemplate.csv
+# recordgen itself is built first by Next177.pro.
+
+isEmpty(SAVE_TEMPLATE): SAVE_TEMPLATE = //sbf40010/SHARED/DEWAR/PUBLIC/ENB-Dewar/ENB-DF/coldstackCalculator/calculator/control/saveTemplate.csv
+!exists($$SAVE_TEMPLATE): error("saveTemplate.csv not found at $$SAVE_TEMPLATE, run qmake SAVE_TEMPLATE=<path>")
+
+RECORDGEN = $$OUT_PWD/../recordgen/recordgen
+win32: RECORDGEN = $${RECORDGEN}.exe
+!exists($$RECORDGEN): warning("recordgen not built yet, build Next177.pro or recordgen/RecordGen.pro first")
+RECORDGEN_COMMAND = $$RECORDGEN
+win32: RECORDGEN_COMMAND ~= s,/,\\,g
+
+RECORD_FIELDS = $$PWD/buildrecord.fields
+RECORD_TEMPLATE = $$SAVE_TEMPLATE
+
+recordgen.input = RECORD_TEMPLATE
+recordgen.output = buildrecord.h
+recordgen.commands = $$RECORDGEN_COMMAND $$RECORD_FIELDS ${QMAKE_FILE_NAME} ${QMAKE_FILE_OUT}
+recordgen.depends = $$RECORD_FIELDS $$RECORDGEN
+recordgen.CONFIG += no_link target_predeps
+recordgen.name = recordgen ${QMAKE_FILE_IN}
+QMAKE_EXTRA_COMPILERS += recordgen
+
+INCLUDEPATH += $$OUT_PWD
@@ -0,0 +1,314 @@
+/* main.cpp is recordgen, the build step that turns control/saveTemplate.csv into buildrecord.h.
+ *
+ *     recordgen buildrecord.fields saveTemplate.csv buildrecord.h
+ *
+ * readFields() reads the checked-in field list, which gives each template row a C++ name, a type
+ * and the key the template has on that row.  readTemplate() reads the template with the same
+ * RecordParser the calculators use.  checkTemplate() is where template drift fails the build: the
+ * row count, every step marker position, every listed key and every malformed line must agree
+ * with the field list, so a row renamed or moved fails here instead of landing in the wrong
+ * member.  Every row has to list its key; a row that doesn't fails too, and the lines to paste
+ * into the field list are printed with the keys the template has.  header() then emits
+ * the BuildRecord struct, its Row enum and a table of member pointers per row, so loading and
+ * saving are direct field copies.  The header is only rewritten when its contents change, so an
+ * untouched template does not rebuild the calculators.
+*/
+
+#include "recordparser.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+
+enum FieldType { TextField, NumberField, MarkerField };
+
+struct FieldSpec {
+    int row;
+    std::string name;
+    FieldType type;
+    int decimals;
+    std::string key;            // the template's key on this row, empty when not listed
+};
+
+struct TemplateRow {
+    std::string key;
+    std::string value;
+};
+
+static bool readFile( const std::string &path, std::string &contents ) {
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+    if (!in)
+        return false;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+static bool fail( const std::string &message ) {
+    std::cerr << "recordgen: " << message << std::endl;
+    return false;
+}
+
+static std::string number( int value ) {
+    std::ostringstream text;
+    text << value;
+    return text.str();
+}
+
+static bool isIdentifier( const std::string &name ) {
+    if (name.empty() || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+        return false;
+    for (size_t i = 1; i < name.size(); i++) {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_'))
+            return false;
+    }
+    return true;
+}
+
+static bool isMarkerKey( const std::string &key, char c ) {
+    if (key.empty())
+        return false;
+    for (size_t i = 0; i < key.size(); i++) {
+        if (key[i] != c)
+            return false;
+    }
+    return true;
+}
+
+static std::string quoted( const std::string &text ) {
+    // C string literal, escaping anything the template could plausibly contain
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            sprintf(escaped, "\\%03o", (unsigned char)c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string enumName( const std::string &name ) {
+    std::string out = "Row";
+    out += char(toupper((unsigned char)name[0]));
+    return out + name.substr(1);
+}
+
+static bool readFields( const std::string &path, std::vector <FieldSpec> &fields ) {
+    std::string contents;
+    if (!readFile(path, contents))
+        return fail("unable to read " + path);
+    std::istringstream lines(contents);
+    std::string line;
+    std::set <std::string> names;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        std::string::size_type hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+        std::istringstream words(line);
+        FieldSpec field;
+        std::string type;
+        if (!(words >> field.row))
+            continue;
+        std::string where = path + ":" + number(lineNumber) + ": ";
+        if (!(words >> field.name >> type))
+            return fail(where + "expected <row> <name> <type>");
+        if (field.row != int(fields.size()) + 1)
+            return fail(where + "rows must be listed in order starting at 1");
+        if (!isIdentifier(field.name) || !names.insert(field.name).second)
+            return fail(where + "'" + field.name + "' is not a unique C++ name");
+        field.decimals = 0;
+        if (type == "text") {
+            field.type = TextField;
+        } else if (type == "marker") {
+            field.type = MarkerField;
+        } else if (type.compare(0, 7, "number:") == 0 && type.size() > 7) {
+            field.type = NumberField;
+            field.decimals = atoi(type.c_str() + 7);
+        } else {
+            return fail(where + "unknown type '" + type + "'");
+        }
+        // the rest of the line is the template key, which may contain spaces
+        std::getline(words, field.key);
+        std::string::size_type first = field.key.find_first_not_of(" \t\r");
+        std::string::size_type last = field.key.find_last_not_of(" \t\r");
+        if (first == std::string::npos)
+            field.key.clear();
+        else
+            field.key = field.key.substr(first, last - first + 1);
+        fields.push_back(field);
+    }
+    if (fields.empty())
+        return fail(path + " lists no fields");
+    return true;
+}
+
+static bool readTemplate( const std::string &path, std::vector <TemplateRow> &rows ) {
+    std::string contents;
+    if (!readFile(path, contents))
+        return fail("unable to read " + path);
+    RecordParser parser(contents.data(), int(contents.size()));
+    RecordField field;
+    while (parser.next(field)) {
+        TemplateRow row;
+        row.key.assign(field.key, field.keyLength);
+        row.value.assign(field.value, field.valueLength);
+        rows.push_back(row);
+    }
+    if (!parser.errors().empty()) {
+        for (size_t i = 0; i < parser.errors().size(); i++)
+            fail(path + ":" + number(parser.errors()[i].line) + ": " + parser.errors()[i].message);
+        return false;
+    }
+    return true;
+}
+
+static std::string fieldLine( const FieldSpec &field, const std::string &key ) {
+    std::string type = "text";
+    if (field.type == NumberField)
+        type = "number:" + number(field.decimals);
+    else if (field.type == MarkerField)
+        type = "marker";
+    std::string line = number(field.row);
+    line.resize(4, ' ');
+    line += field.name;
+    line.resize(line.size() < 28 ? 28 : line.size() + 1, ' ');
+    line += type;
+    line.resize(line.size() < 40 ? 40 : line.size() + 1, ' ');
+    return line + key + "\n";
+}
+
+static bool checkTemplate( const std::string &path, const std::vector <FieldSpec> &fields,
+                           const std::vector <TemplateRow> &rows ) {
+    bool ok = true;
+    if (rows.size() != fields.size())
+        ok = fail(path + " has " + number(int(rows.size())) + " rows, buildrecord.fields expects "
+                  + number(int(fields.size())));
+    for (size_t i = 0; i < rows.size() && i < fields.size(); i++) {
+        bool marker = isMarkerKey(rows[i].key, '$');
+        if (fields[i].type == MarkerField && !marker)
+            ok = fail(path + ": row " + number(fields[i].row) + " should be the "
+                      + fields[i].name + " step marker, found '" + rows[i].key + "'");
+        if (fields[i].type != MarkerField && marker)
+            ok = fail(path + ": row " + number(fields[i].row) + " is a step marker, "
+                      "buildrecord.fields expects " + fields[i].name);
+        if (!fields[i].key.empty() && rows[i].key != fields[i].key)
+            ok = fail(path + ": row " + number(fields[i].row) + " is '" + rows[i].key
+                      + "', buildrecord.fields expects '" + fields[i].key + "' for " + fields[i].name);
+    }
+    // a row listed without a key could be renamed or moved unnoticed, so it fails as well, with
+    // the line to paste in its place
+    std::string unlisted;
+    for (size_t i = 0; ok && i < rows.size(); i++) {
+        if (fields[i].key.empty())
+            unlisted += fieldLine( fields[i], rows[i].key );
+    }
+    if (!unlisted.empty())
+        ok = fail("buildrecord.fields lists no key for these rows, replace their lines with:\n"
+                  + unlisted.substr(0, unlisted.size() - 1));
+    if (!ok)
+        fail("saveTemplate.csv no longer matches buildrecord.fields, update the field list");
+    return ok;
+}
+
+static std::string header( const std::vector <FieldSpec> &fields, const std::vector <TemplateRow> &rows ) {
+    std::ostringstream out;
+    out << "// buildrecord.h is generated by recordgen from saveTemplate.csv and buildrecord.fields.\n"
+           "// Do not edit, change the template or the field list and rebuild.\n"
+           "\n"
+           "#ifndef BUILDRECORD_H\n"
+           "#define BUILDRECORD_H\n"
+           "\n"
+           "#include <QString>\n"
+           "\n"
+           "// one build record, a named member per saveTemplate.csv row\n"
+           "struct BuildRecord {\n"
+           "    enum Row {\n";
+    for (size_t i = 0; i < fields.size(); i++)
+        out << "        " << enumName(fields[i].name) << " = " << fields[i].row << ",\n";
+    out << "        RowCount = " << fields.size() << "\n"
+           "    };\n";
+    for (size_t i = 0; i < fields.size(); i++) {
+        const FieldSpec &f = fields[i];
+        const char *type = f.type == TextField ? "QString" : f.type == NumberField ? "double" : "bool";
+        std::string member = std::string("    ") + type + " " + f.name + ";";
+        out << member << std::string(member.size() < 40 ? 40 - member.size() : 1, ' ');
+        out << "// " << rows[i].key << "\n";
+    }
+    out << "};\n"
+           "\n"
+           "enum BuildRecordType { RecordText, RecordNumber, RecordMarker };\n"
+           "\n"
+           "// how a row is keyed in the template, stored in BuildRecord, and written back out\n"
+           "struct BuildRecordField {\n"
+           "    int row;\n"
+           "    const char *name;\n"
+           "    const char *key;\n"
+           "    const char *defaultValue;\n"
+           "    const char *savedKey;\n"
+           "    BuildRecordType type;\n"
+           "    int decimals;\n"
+           "    QString BuildRecord::*text;\n"
+           "    double BuildRecord::*number;\n"
+           "    bool BuildRecord::*marker;\n"
+           "};\n"
+           "\n"
+           "// indexed by row, entry 0 is the bandaid that lines indices up with template rows\n"
+           "static const BuildRecordField buildRecordFields[BuildRecord::RowCount + 1] = {\n"
+           "    { 0, \"\", \"@@@\", \"\", 0, RecordText, 0, 0, 0, 0 },\n";
+    for (size_t i = 0; i < fields.size(); i++) {
+        const FieldSpec &f = fields[i];
+        out << "    { " << f.row << ", " << quoted(f.name) << ", " << quoted(rows[i].key) << ", "
+            << quoted(rows[i].value) << ", ";
+        if (f.type == MarkerField)
+            out << quoted(std::string(rows[i].key.size(), '*')) << ", RecordMarker, 0, 0, 0, &BuildRecord::"
+                << f.name;
+        else if (f.type == NumberField)
+            out << "0, RecordNumber, " << f.decimals << ", 0, &BuildRecord::" << f.name << ", 0";
+        else
+            out << "0, RecordText, 0, &BuildRecord::" << f.name << ", 0, 0";
+        out << " }" << (i + 1 < fields.size() ? "," : "") << "\n";
+    }
+    out << "};\n"
+           "\n"
+           "#endif // BUILDRECORD_H\n";
+    return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4) {
+        std::cerr << "usage: recordgen <buildrecord.fields> <saveTemplate.csv> <buildrecord.h>" << std::endl;
+        return 1;
+    }
+    std::vector <FieldSpec> fields;
+    std::vector <TemplateRow> rows;
+    if (!readFields(argv[1], fields) || !readTemplate(argv[2], rows)
+            || !checkTemplate(argv[2], fields, rows))
+        return 1;
+    std::string generated = header(fields, rows);
+    std::string existing;
+    if (readFile(argv[3], existing) && existing == generated)
+        return 0;
+    std::ofstream out(argv[3], std::ios::out | std::ios::binary | std::ios::trunc);
+    out << generated;
+    if (!out) {
+        fail(std::string("unable to write ") + argv[3]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/* RecordParser class is shared code used by the calculators and StackupTool to read build records
+ * and saveTemplate.csv.  It is Qt-free so it can run over a mapped archive as well as a QByteArray.
+ *
+ * next() scans the buffer one line at a time and hands back the key and value in place.  Each
+ * line is walked once, nothing is copied, and nothing is allocated unless a line is malformed.
+ * The key is everything before the first ',' and the value everything after the last ',', both
+ * trimmed, which is what the old QByteArray::split(',') first()/last() code produced.
+ *
+ * Blank lines are skipped.  A line without a ',' is skipped and reported in errors() with its
+ * line number; a line with more than one ',' is still returned but is reported too, since the
+ * calculators never write one.
+ *
+ * number() converts a value to double without building a QString.  Values that are not plain
+ * decimal numbers ("$$$", "***", empty) come back as 0 with ok set false, same as toDouble().
+*/
+
+#include "recordparser.h"
+
+#include <cstring>
+#include <cmath>
+
+static bool isBlank( char c ) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void trim( const char *&text, int &length ) {
+    while (length > 0 && isBlank(text[0])) {
+        text++;
+        length--;
+    }
+    while (length > 0 && isBlank(text[length - 1]))
+        length--;
+}
+
+bool RecordField::keyIs( const char *text ) const {
+    int length = int(strlen(text));
+    return length == keyLength && memcmp(key, text, length) == 0;
+}
+
+RecordParser::RecordParser( const char *data, int size ) :
+    pos(data),
+    end(data + size),
+    line(0)
+{
+}
+
+bool RecordParser::next( RecordField &field ) {
+    while (pos < end) {
+        const char *start = pos;
+        const char *firstComma = 0;
+        const char *lastComma = 0;
+        bool blank = true;
+        // single walk to the end of the line, noting both commas on the way
+        while (pos < end && *pos != '\n') {
+            if (*pos == ',') {
+                if (!firstComma)
+                    firstComma = pos;
+                lastComma = pos;
+            }
+            if (!isBlank(*pos))
+                blank = false;
+            pos++;
+        }
+        const char *lineEnd = pos;
+        if (pos < end)
+            pos++;
+        line++;
+        if (blank)
+            continue;
+        if (!firstComma) {
+            RecordError error = { line, "missing ',' between key and value" };
+            errorList.push_back(error);
+            continue;
+        }
+        if (firstComma != lastComma) {
+            RecordError error = { line, "more than one ',' on the line" };
+            errorList.push_back(error);
+        }
+        field.key = start;
+        field.keyLength = int(firstComma - start);
+        trim(field.key, field.keyLength);
+        field.value = lastComma + 1;
+        field.valueLength = int(lineEnd - field.value);
+        trim(field.value, field.valueLength);
+        field.line = line;
+        return true;
+    }
+    return false;
+}
+
+const std::vector <RecordError> &RecordParser::errors() const {
+    return errorList;
+}
+
+double RecordParser::number( const RecordField &field, bool *ok ) {
+    const char *p = field.value;
+    const char *stop = field.value + field.valueLength;
+    if (ok)
+        *ok = false;
+    bool negative = false;
+    if (p < stop && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    // mantissa digits as an integer, then one division, keeps 4-decimal values exact
+    double mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+    bool point = false;
+    for (; p < stop; p++) {
+        if (*p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+            if (point)
+                decimals++;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (!digits)
+        return 0;
+    int exponent = 0;
+    if (p < stop && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negativeExp = false;
+        if (e < stop && (*e == '-' || *e == '+'))
+            negativeExp = *e++ == '-';
+        if (e == stop)
+            return 0;
+        for (; e < stop && *e >= '0' && *e <= '9'; e++)
+            exponent = exponent * 10 + (*e - '0');
+        if (negativeExp)
+            exponent = -exponent;
+        p = e;
+    }
+    if (p != stop)
+        return 0;
+    exponent -= decimals;
+    double value = mantissa;
+    if (exponent < 0)
+        value /= pow(10.0, -exponent);
+    else if (exponent > 0)
+        value *= pow(10.0, exponent);
+    if (ok)
+        *ok = true;
+    return negative ? -value : value;
+}
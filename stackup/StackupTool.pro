@@ -0,0 +1,82 @@
+#-------------------------------------------------
+#
+# Headless batch front end for the coldstack calculators
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+TARGET = StackupTool
+CONFIG   += console
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+
+SOURCES += main.cpp\
+        batchcalc.cpp\
+		stackupcalc.cpp\
+		buildarchive.cpp\
+		archivecommand.cpp\
+		recordparser.cpp\
+		buildrecordio.cpp\
+		spcstats.cpp\
+		summaryindex.cpp\
+		parsebench.cpp\
+		journalbench.cpp\
+		phrcache.cpp\
+		phrreply.cpp\
+		proteusclient.cpp\
+		proteusstandin.cpp\
+		proteusbench.cpp\
+		phrprefetch.cpp\
+		prefetchcommand.cpp\
+		screencommand.cpp\
+		kitting.cpp\
+		kitcommand.cpp\
+		montecarlo.cpp\
+		simulatecommand.cpp\
+		spccommand.cpp\
+		summarycommand.cpp\
+		calcservice.cpp\
+		calcserviceclient.cpp\
+		tracecompare.cpp\
+		recordquery.cpp\
+		querycommand.cpp\
+		exportcommand.cpp
+
+HEADERS  += batchcalc.h\
+		stackupcalc.h\
+		buildarchive.h\
+		archivecommand.h\
+		recordparser.h\
+		buildrecordio.h\
+		spcstats.h\
+		summaryindex.h\
+		parsebench.h\
+		journalbench.h\
+		phrcache.h\
+		phrreply.h\
+		proteusclient.h\
+		proteusstandin.h\
+		proteusbench.h\
+		phrprefetch.h\
+		prefetchcommand.h\
+		screencommand.h\
+		kitting.h\
+		kitcommand.h\
+		montecarlo.h\
+		simulatecommand.h\
+		spccommand.h\
+		summarycommand.h\
+		calcservice.h\
+		calcserviceclient.h\
+		tracecompare.h\
+		recordquery.h\
+		querycommand.h\
+		exportcommand.h
+
+# buildrecord.h is generated from control/saveTemplate.csv
+include(../recordgen/buildrecord.pri)
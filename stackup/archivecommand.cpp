@@ -0,0 +1,98 @@
+/* archivecommand.cpp contains the StackupTool commands that maintain control/archive.dat.
+ *
+ * import copies existing control/<ctrl>.csv files into the archive.  Records already in the
+ * archive are left alone, so it is safe to rerun while stations are saving.
+ *
+ * get prints one record exactly as its .csv used to look, for Excel or a quick check.
+ *
+ * compact rewrites the archive with only the newest copy of each record.
+ *
+ * All commands take -a <archive> to point somewhere other than control/archive.dat.
+*/
+
+#include "archivecommand.h"
+#include "buildarchive.h"
+
+#include <QTextStream>
+#include <QFile>
+
+ArchiveCommand::ArchiveCommand() :
+    archivePath("control/archive.dat")
+{
+}
+
+int ArchiveCommand::run( const QString &command, QStringList args ) {
+    QStringList rest;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else
+            rest << arg;
+    }
+    if (command == "import")
+        return importRecords( rest );
+    if (command == "get")
+        return getRecord( rest );
+    return compactArchive( );
+}
+
+int ArchiveCommand::importRecords( const QStringList &dirs ) {
+    QTextStream err(stderr);
+    if (dirs.isEmpty()) {
+        err << "import: no control directory given" << endl;
+        return 1;
+    }
+    BuildArchive archive(archivePath);
+    int total = 0;
+    for (int i = 0; i < dirs.size(); i++) {
+        int imported = archive.importDirectory( dirs[i] );
+        if (imported < 0) {
+            err << "import: " << dirs[i] << ": " << archive.errorString() << endl;
+            return 2;
+        }
+        if (!archive.errorString().isEmpty())
+            err << "import: " << archive.errorString() << endl;
+        total += imported;
+    }
+    err << total << " records imported into " << archivePath << endl;
+    return 0;
+}
+
+int ArchiveCommand::getRecord( const QStringList &controls ) {
+    QTextStream err(stderr);
+    if (controls.isEmpty()) {
+        err << "get: no control number given" << endl;
+        return 1;
+    }
+    BuildArchive archive(archivePath);
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    int missing = 0;
+    for (int i = 0; i < controls.size(); i++) {
+        // accept wanded control numbers with the leading 'C'
+        QString control = controls[i];
+        if (control.startsWith('C') || control.startsWith('c'))
+            control.remove(0, 1);
+        QByteArray record;
+        if (!archive.read(control, record)) {
+            err << "get: C" << control << " not in " << archivePath << endl;
+            missing++;
+            continue;
+        }
+        out.write(record);
+    }
+    out.close();
+    return missing ? 2 : 0;
+}
+
+int ArchiveCommand::compactArchive( ) {
+    QTextStream err(stderr);
+    BuildArchive archive(archivePath);
+    if (!archive.compact()) {
+        err << "compact: " << archive.errorString() << endl;
+        return 2;
+    }
+    err << archive.controls().size() << " records in " << archivePath << endl;
+    return 0;
+}
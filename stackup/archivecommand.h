@@ -0,0 +1,20 @@
+#ifndef ARCHIVECOMMAND_H
+#define ARCHIVECOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class ArchiveCommand
+{
+public:
+    ArchiveCommand();
+    int run( const QString &, QStringList );
+
+private:
+    QString archivePath;
+    int importRecords( const QStringList & );
+    int getRecord( const QStringList & );
+    int compactArchive( );
+};
+
+#endif // ARCHIVECOMMAND_H
@@ -0,0 +1,308 @@
+/* batchcalc.cpp contains the StackupTool "calc" command, a headless re-check of saved build records.
+ *
+ * run() parses options, collects records, and maps evaluateRecord() over them on all cores via
+ * QtConcurrent.  Records come from control/<ctrl>.csv files, or from every control number in a
+ * build record archive (archive.dat), which is mapped once and shared by all worker threads.
+ * Results come back in input order and are written as one .csv report row each.
+ *
+ * evaluateRecord() takes one record's text, fills Stackup::BuildInputs for every step whose
+ * marker ("***", "****", "*****", "******") has been saved, runs Stackup::evaluateBuild() and
+ * compares each recomputed output to the value the calculator saved at the time.
+ *
+ * loadBondlineSpec() reads the dispenser range and resolution from the [bondline] section of
+ * control/stackup.ini, the same settings MountCF uses, so bondlines are recomputed the way the
+ * station would.
+ *
+ * reportHeader() and formatRow() make the report's .csv rows; "StackupTool serve" answers calc
+ * requests with the same rows.
+ *
+ * collectFiles() expands directories to their record files, skipping saveTemplate.csv.
+ *
+ * readRecord() loads the record into a BuildRecord and fillInputs() maps its fields onto the
+ * stackup inputs.  Malformed lines found by RecordParser are printed to stderr with their line
+ * numbers.
+*/
+
+#include "batchcalc.h"
+#include "recordparser.h"
+#include "buildrecordio.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+static bool usable( double value ) {
+    // same test the calculators use before calculating: empty or zero is not usable data
+    return BuildRecordIO::isSet(value) && value;
+}
+
+static QString number( double value ) {
+    return QString::number(value, 'f', 4);
+}
+
+static void compareSaved( double saved, double value, const char *name, QStringList &mismatches ) {
+    // saved values are label text, so compare at label precision; empty means never output
+    if (!BuildRecordIO::isSet(saved))
+        return;
+    if (number(saved) != number(value))
+        mismatches << QString(name);
+}
+
+BatchCalc::BatchCalc()
+{
+}
+
+int BatchCalc::run( QStringList args ) {
+    QTextStream err(stderr);
+    QStringList paths;
+    QString archivePath;
+    QString settingsPath = "control/stackup.ini";
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-o" && !args.isEmpty()) {
+            outputPath = args.takeFirst();
+        } else if (arg == "-j" && !args.isEmpty()) {
+            int threads = args.takeFirst().toInt();
+            if (threads > 0)
+                QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        } else if (arg == "-i" && !args.isEmpty()) {
+            settingsPath = args.takeFirst();
+        } else if (arg.endsWith(".dat")) {
+            archivePath = arg;
+        } else {
+            paths << arg;
+        }
+    }
+    BuildArchive archive(archivePath);
+    EvaluateRecord evaluate;
+    evaluate.archive = 0;
+    evaluate.bondSpec = loadBondlineSpec( settingsPath );
+    QStringList sources;
+    if (!archivePath.isEmpty()) {
+        if (!archive.map()) {
+            err << "calc: unable to open " << archivePath << ": " << archive.errorString() << endl;
+            return 1;
+        }
+        evaluate.archive = &archive;
+        sources = archive.controls();
+    } else {
+        sources = collectFiles( paths );
+    }
+    if (sources.isEmpty()) {
+        err << "calc: no records given" << endl;
+        return 1;
+    }
+
+    // every record is independent, so spread them over the global thread pool
+    QList <BatchRow> rows = QtConcurrent::blockingMapped(sources, evaluate);
+
+    QFile outFile;
+    if (outputPath.isEmpty()) {
+        outFile.open(stdout, QIODevice::WriteOnly);
+    } else {
+        outFile.setFileName(outputPath);
+        if (!outFile.open(QFile::WriteOnly|QFile::Truncate)) {
+            err << "calc: unable to open " << outputPath << ": " << outFile.errorString() << endl;
+            return 1;
+        }
+    }
+    QTextStream out(&outFile);
+    out << reportHeader() << endl;
+    int failed = 0;
+    int red = 0;
+    int mismatched = 0;
+    for (int i = 0; i < rows.size(); i++) {
+        const BatchRow &row = rows[i];
+        for (int j = 0; j < row.malformed.size(); j++)
+            err << "calc: " << row.path << ": " << row.malformed[j] << endl;
+        if (!row.loaded) {
+            err << "calc: unable to read " << row.path << endl;
+            failed++;
+            continue;
+        }
+        const Stackup::BuildResults &r = row.results;
+        if (r.angleStatus == Stackup::Red || r.centerStatus == Stackup::Red
+                || r.csParallelStatus == Stackup::Red || r.csIcdStatus == Stackup::Red
+                || r.bond.status == Stackup::Red || r.cfParallelStatus == Stackup::Red
+                || r.cfIcdStatus == Stackup::Red)
+            red++;
+        if (!row.mismatches.isEmpty())
+            mismatched++;
+        out << formatRow( row ) << endl;
+    }
+    out.flush();
+    err << rows.size() << " records, " << red << " out of spec, " << mismatched
+        << " not matching saved values, " << failed << " unreadable" << endl;
+    return failed ? 2 : 0;
+}
+
+BatchRow EvaluateRecord::operator()( const QString &source ) const {
+    QByteArray record;
+    if (archive) {
+        archive->read(source, record);
+    } else {
+        QFile file(source);
+        if (file.open(QIODevice::ReadOnly))
+            record = file.readAll();
+    }
+    return BatchCalc::evaluateRecord( source, record, bondSpec );
+}
+
+BatchRow BatchCalc::evaluateRecord( const QString &source, const QByteArray &record,
+                                    const Stackup::BondlineSpec &bondSpec ) {
+    BatchRow row;
+    row.path = source;
+    BuildRecord saved;
+    row.loaded = readRecord( record, saved, row.malformed );
+    Stackup::BuildInputs in;
+    fillInputs( saved, in );
+    in.bondSpec = bondSpec;
+    Stackup::evaluateBuild( in, row.results );
+    if (!row.loaded)
+        return row;
+    row.control = saved.control;
+    row.serial = saved.serial;
+    const Stackup::BuildResults &r = row.results;
+    if (in.hasMotherboard) {
+        compareSaved(saved.fpaAngle, r.angle, "angle", row.mismatches);
+        compareSaved(saved.opticalCenter, r.center, "center", row.mismatches);
+    }
+    if (in.hasColdshield) {
+        compareSaved(saved.csExpectedIcd, r.csIcd, "csIcd", row.mismatches);
+        if (in.hasPlateaus)
+            compareSaved(saved.csParallelism, r.csParallel, "csParallel", row.mismatches);
+    }
+    if (in.hasColdfilter1) {
+        // bondline and ball height are cleared by calculateData1() when no bondline works
+        if (r.bond.status != Stackup::Red) {
+            compareSaved(saved.cfBondline, r.bond.bondline, "bondline", row.mismatches);
+            compareSaved(saved.ballHeight, r.bond.ballHeight, "ballHeight", row.mismatches);
+        }
+        compareSaved(saved.cfExpectedIcd, r.bond.icd, "expectedIcd", row.mismatches);
+    }
+    if (in.hasColdfilter2) {
+        compareSaved(saved.finalIcd, r.cfIcd, "cfIcd", row.mismatches);
+        if (in.hasFiducials)
+            compareSaved(saved.cfParallelism, r.cfParallel, "cfParallel", row.mismatches);
+    }
+    return row;
+}
+
+Stackup::BondlineSpec BatchCalc::loadBondlineSpec( const QString &path ) {
+    QSettings settings(path, QSettings::IniFormat);
+    Stackup::BondlineSpec spec = Stackup::defaultBondlineSpec;
+    spec.min = settings.value("bondline/min", spec.min).toDouble();
+    spec.max = settings.value("bondline/max", spec.max).toDouble();
+    spec.resolution = settings.value("bondline/resolution", spec.resolution).toDouble();
+    return spec;
+}
+
+QStringList BatchCalc::collectFiles( const QStringList &paths ) {
+    QStringList files;
+    for (int i = 0; i < paths.size(); i++) {
+        QFileInfo info(paths[i]);
+        if (info.isDir()) {
+            QDir dir(paths[i]);
+            QStringList names = dir.entryList(QStringList() << "*.csv", QDir::Files, QDir::Name);
+            for (int j = 0; j < names.size(); j++) {
+                if (names[j] != "saveTemplate.csv")
+                    files << dir.filePath(names[j]);
+            }
+        } else {
+            files << paths[i];
+        }
+    }
+    return files;
+}
+
+QString BatchCalc::reportHeader() {
+    return "control,serial,angle,angleStatus,center,centerStatus,"
+           "csHeight,csParallel,csParallelStatus,csIcd,csIcdStatus,"
+           "bondline,ballHeight,expectedIcd,bondStatus,"
+           "cfHeight,cfParallel,cfParallelStatus,cfIcd,cfIcdStatus,mismatch";
+}
+
+QString BatchCalc::formatRow( const BatchRow &row ) {
+    const Stackup::BuildResults &r = row.results;
+    QStringList cells;
+    cells << row.control << row.serial;
+    // only steps that were calculated get numbers, the rest stay blank like the saved record
+    if (r.angleStatus != Stackup::NotCalculated)
+        cells << number(r.angle) << Stackup::statusName(r.angleStatus)
+              << number(r.center) << Stackup::statusName(r.centerStatus);
+    else
+        cells << "" << "" << "" << "";
+    if (r.csIcdStatus != Stackup::NotCalculated)
+        cells << number(r.csHeight)
+              << (r.csParallelStatus != Stackup::NotCalculated ? number(r.csParallel) : QString())
+              << Stackup::statusName(r.csParallelStatus)
+              << number(r.csIcd) << Stackup::statusName(r.csIcdStatus);
+    else
+        cells << "" << "" << "" << "" << "";
+    if (r.bond.status != Stackup::NotCalculated)
+        cells << number(r.bond.bondline) << number(r.bond.ballHeight)
+              << number(r.bond.icd) << Stackup::statusName(r.bond.status);
+    else
+        cells << "" << "" << "" << "";
+    if (r.cfIcdStatus != Stackup::NotCalculated)
+        cells << number(r.cfHeight)
+              << (r.cfParallelStatus != Stackup::NotCalculated ? number(r.cfParallel) : QString())
+              << Stackup::statusName(r.cfParallelStatus)
+              << number(r.cfIcd) << Stackup::statusName(r.cfIcdStatus);
+    else
+        cells << "" << "" << "" << "" << "";
+    cells << row.mismatches.join(" ");
+    return cells.join(",");
+}
+
+bool BatchCalc::readRecord( const QByteArray &bytes, BuildRecord &record, QStringList &malformed ) {
+    RecordParser parser(bytes.constData(), bytes.size());
+    int fieldCount = BuildRecordIO::load( parser, record );
+    for (unsigned i = 0; i < parser.errors().size(); i++)
+        malformed << QString("line %1: %2").arg(parser.errors()[i].line).arg(parser.errors()[i].message);
+    return fieldCount > 0;
+}
+
+void BatchCalc::fillInputs( const BuildRecord &record, Stackup::BuildInputs &in ) {
+    Stackup::clearInputs( in );
+    // a step counts only once its calculator has saved its marker and the inputs are usable
+    in.hasMotherboard = record.motherboardSaved && usable(record.sca1y) && usable(record.sca1z)
+            && usable(record.sca2y) && usable(record.sca2z);
+    in.sca1y = record.sca1y;
+    in.sca1z = record.sca1z;
+    in.sca2y = record.sca2y;
+    in.sca2z = record.sca2z;
+
+    in.hasPlateaus = usable(record.plateau1) && usable(record.plateau2)
+            && usable(record.plateau3) && usable(record.plateau4);
+    in.plateaus[0] = record.plateau1;
+    in.plateaus[1] = record.plateau2;
+    in.plateaus[2] = record.plateau3;
+    in.plateaus[3] = record.plateau4;
+    in.csHeight = record.coldshieldHeight;
+    in.csCf = record.coldfilterThickness;
+    in.csFpa = record.csOpticalCenter;
+    in.csBondline = record.csBondline.toDouble();
+    in.hasColdshield = record.coldshieldSaved
+            && (in.hasPlateaus || usable(in.csHeight)) && usable(in.csCf) && usable(in.csFpa)
+            && in.csBondline;
+
+    in.cf1Thickness = record.cfThickness;
+    in.cf1Cs = record.cfColdshieldHeight;
+    in.cf1Fpa = record.cfOpticalCenter1;
+    in.hasColdfilter1 = record.coldfilter1Saved && usable(in.cf1Thickness) && usable(in.cf1Cs)
+            && usable(in.cf1Fpa);
+
+    in.hasFiducials = usable(record.fiducial1) && usable(record.fiducial2) && usable(record.fiducial3);
+    in.fiducials[0] = record.fiducial1;
+    in.fiducials[1] = record.fiducial2;
+    in.fiducials[2] = record.fiducial3;
+    in.cf2Height = record.coldfilterHeight;
+    in.cf2Fpa = record.cfOpticalCenter2;
+    in.hasColdfilter2 = record.coldfilter2Saved
+            && (in.hasFiducials || usable(in.cf2Height)) && usable(in.cf2Fpa);
+}
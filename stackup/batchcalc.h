@@ -0,0 +1,48 @@
+#ifndef BATCHCALC_H
+#define BATCHCALC_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "stackupcalc.h"
+#include "buildarchive.h"
+#include "buildrecord.h"
+
+// one recomputed record, produced on a worker thread by BatchCalc::evaluateFile()
+struct BatchRow {
+    QString path;
+    QString control;
+    QString serial;
+    bool loaded;
+    Stackup::BuildResults results;
+    QStringList mismatches;
+    QStringList malformed;
+};
+
+// QtConcurrent functor: a source is a record .csv path, or a control number when archive is set
+struct EvaluateRecord {
+    typedef BatchRow result_type;
+    const BuildArchive *archive;
+    Stackup::BondlineSpec bondSpec;
+    BatchRow operator()( const QString & ) const;
+};
+
+class BatchCalc
+{
+public:
+    BatchCalc();
+    int run( QStringList );
+    static BatchRow evaluateRecord( const QString &, const QByteArray &, const Stackup::BondlineSpec & );
+    static Stackup::BondlineSpec loadBondlineSpec( const QString & );
+    static QString reportHeader();
+    static QString formatRow( const BatchRow & );
+
+private:
+    QString outputPath;
+    QStringList collectFiles( const QStringList & );
+    static bool readRecord( const QByteArray &, BuildRecord &, QStringList & );
+    static void fillInputs( const BuildRecord &, Stackup::BuildInputs & );
+};
+
+#endif // BATCHCALC_H
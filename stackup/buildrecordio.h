@@ -0,0 +1,31 @@
+#ifndef BUILDRECORDIO_H
+#define BUILDRECORDIO_H
+
+#include <QString>
+#include <QList>
+#include <QByteArray>
+
+#include "buildrecord.h"
+#include "recordparser.h"
+
+// reading and writing BuildRecord as "key,<tab>value" record text, see buildrecordio.cpp.
+// numbers that were never entered are NaN, and are written back as empty fields.
+namespace BuildRecordIO {
+
+void clear( BuildRecord &record );
+int load( RecordParser &parser, BuildRecord &record );
+QByteArray save( const BuildRecord &record );
+
+QString text( const BuildRecord &record, int row );
+double number( const QString &text );
+QString numberText( double value, int decimals = 4 );
+bool isSet( double value );
+
+QList <QString> keys( const BuildRecord &record );
+QList <QString> values( const BuildRecord &record );
+
+QString checkTemplate( const QByteArray &bytes );
+
+}
+
+#endif // BUILDRECORDIO_H
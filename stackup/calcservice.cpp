@@ -0,0 +1,321 @@
+/* calcservice.cpp contains the StackupTool "serve" command, one long-running process on a station
+ * that the calculators share over a local socket (Next177Calc, or -n).  What it shares is a read
+ * cache of the raw record bytes it has loaded from the archive, and one place where saves are
+ * written along with the SPC statistics and summary index updates that follow them.  It is not a
+ * calculation service: each calculator still parses records into its own BuildRecord, looks PHR
+ * data up through its own ProteusLookup and the on-disk PhrCache, and runs the stackup formulas
+ * itself, so a calculator starts no faster for it beyond the startup checks below.
+ * Run it from the calculators' directory so it keeps the same control/ files they do.  The
+ * calculators ask it first through CalcServiceClient and go to the files themselves whenever it
+ * is not running, so starting or stopping it never changes what gets saved.
+ *
+ * start() replays the save journal, checks control/saveTemplate.csv against the template this
+ * program was built with and rebuilds a stale summary index once, so a calculator started while
+ * the service runs can skip all three.
+ *
+ * serve() answers one request:
+ *   archive        the archive this service keeps, checked by every client when it connects
+ *   load <ctrl>    the archived record
+ *   save <ctrl>    write the record, then update the SPC statistics and summary index the way
+ *                  saveData() does; the reply lists anything that was saved but not counted
+ *   calc <ctrl>    recompute the record sent, or the archived one when none is sent, with the
+ *                  [bondline] settings from control/stackup.ini (-i), as one StackupTool calc row;
+ *                  for headless callers, the calculators don't use it
+ *   stats          what the service holds and has served
+ * Requests are one "command argument length" line followed by length bytes of payload; replies
+ * are "ok length" and length bytes, or "error message".  Requests are answered one at a time in
+ * the order they arrive, so saves from different stations never race each other in here.
+ *
+ * load() keeps every record it reads in records.  The cache belongs to one state of the archive
+ * files, archiveStamp(); a save from any station, this one included, changes the stamp and
+ * empties it, so a station never loads an older copy than the archive holds.
+ *
+ * "serve --stats" asks a running service for its stats instead of starting one.
+*/
+
+#include "calcservice.h"
+#include "calcserviceclient.h"
+#include "batchcalc.h"
+#include "recordparser.h"
+#include "buildrecordio.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QtConcurrentRun>
+
+// records are a few kB, this bounds the cache at a few tens of MB
+static const int maxCachedRecords = 10000;
+// anything longer is not a request from CalcServiceClient
+static const int maxHeaderBytes = 1024;
+static const int maxPayloadBytes = 1024 * 1024;
+
+CalcService::CalcService( QObject *parent ) :
+    QObject(parent),
+    name(CalcServiceClient::defaultName),
+    archivePath("control/archive.dat"),
+    settingsPath("control/stackup.ini"),
+    archive(0),
+    spc(0),
+    summary(0),
+    clients(0),
+    loads(0),
+    hits(0),
+    saves(0),
+    calcs(0),
+    failures(0)
+{
+    server = new QLocalServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+CalcService::~CalcService()
+{
+    server->close();
+    delete archive;
+    delete spc;
+    delete summary;
+}
+
+int CalcService::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    bool showStats = false;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "-i" && !args.isEmpty())
+            settingsPath = args.takeFirst();
+        else if (arg == "-n" && !args.isEmpty())
+            name = args.takeFirst();
+        else if (arg == "--stats")
+            showStats = true;
+        else
+            err << "serve: ignoring " << arg << endl;
+    }
+    if (showStats) {
+        CalcServiceClient client(archivePath, name);
+        QString text;
+        if (client.stats(text) != CalcServiceClient::Ok) {
+            err << "serve: no service for " << archivePath << " on " << name << ": "
+                << client.errorString() << endl;
+            return 1;
+        }
+        out << text;
+        return 0;
+    }
+    QString error;
+    if (!start(error)) {
+        err << "serve: " << error << endl;
+        return 1;
+    }
+    err << "serving " << QFileInfo(archivePath).absoluteFilePath() << " on " << server->fullServerName() << endl;
+    return QCoreApplication::exec();
+}
+
+bool CalcService::start( QString &error ) {
+    QTextStream err(stderr);
+    // a second service would answer half the stations with its own cache
+    QLocalSocket running;
+    running.connectToServer(name);
+    if (running.waitForConnected(250)) {
+        error = "a service is already running on " + name + ", see serve --stats";
+        return false;
+    }
+    archive = new BuildArchive(archivePath);
+    if (!archive->replayJournal())
+        err << "serve: save journal not replayed: " << archive->errorString() << endl;
+    QDir control = QFileInfo(archivePath).dir();
+    QFile templateFile(control.filePath("saveTemplate.csv"));
+    if (templateFile.open(QIODevice::ReadOnly)) {
+        QString problem = BuildRecordIO::checkTemplate(templateFile.readAll());
+        if (!problem.isEmpty())
+            err << "serve: " << templateFile.fileName() << " has changed since StackupTool was built. "
+                << problem << endl;
+    }
+    spc = new SpcStats(control.filePath("spc.dat"));
+    summary = new SummaryIndex(control.filePath("summary.dat"), archivePath);
+    if (summary->isStale() && !summary->rebuild())
+        err << "serve: summary index not rebuilt: " << summary->errorString() << endl;
+    bondSpec = BatchCalc::loadBondlineSpec(settingsPath);
+    // a service that crashed leaves its socket file behind on Unix, nobody answered on it above
+    if (!server->listen(name)) {
+        QLocalServer::removeServer(name);
+        if (!server->listen(name)) {
+            error = "unable to listen on " + name + ": " + server->errorString();
+            return false;
+        }
+    }
+    started = QDateTime::currentDateTime();
+    return true;
+}
+
+void CalcService::newConnection( ) {
+    while (server->hasPendingConnections()) {
+        QLocalSocket *socket = server->nextPendingConnection();
+        buffers.insert(socket, QByteArray());
+        clients++;
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(dropConnection()));
+    }
+}
+
+void CalcService::dropConnection( ) {
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+        return;
+    buffers.remove(socket);
+    clients--;
+    socket->deleteLater();
+}
+
+void CalcService::readRequest( ) {
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket || !buffers.contains(socket))
+        return;
+    // a reply that fails to write can drop the connection, and its buffer, before this returns
+    QByteArray buffer = buffers.take(socket) + socket->readAll();
+    // "command argument length\n" then length bytes; a client may send the next one right away
+    while (true) {
+        int end = buffer.indexOf('\n');
+        if (end < 0) {
+            if (buffer.size() > maxHeaderBytes) {
+                socket->abort();
+                return;
+            }
+            break;
+        }
+        QList <QByteArray> header = buffer.left(end).trimmed().split(' ');
+        int length = header.size() == 3 ? header[2].toInt() : -1;
+        if (length < 0 || length > maxPayloadBytes) {
+            socket->write("error malformed request\n");
+            socket->disconnectFromServer();
+            return;
+        }
+        if (buffer.size() < end + 1 + length)
+            break;
+        QByteArray payload = buffer.mid(end + 1, length);
+        buffer.remove(0, end + 1 + length);
+        serve(socket, header[0], QString::fromLatin1(header[1]), payload);
+        if (socket->state() != QLocalSocket::ConnectedState)
+            return;
+    }
+    buffers.insert(socket, buffer);
+}
+
+void CalcService::serve( QLocalSocket *socket, const QByteArray &command, const QString &argument,
+                         const QByteArray &payload ) {
+    QByteArray reply;
+    QString error;
+    if (command == "archive") {
+        reply = QFileInfo(archivePath).absoluteFilePath().toLocal8Bit();
+    } else if (command == "load") {
+        if (!load(argument, reply))
+            error = QString("C%1 is not in the archive").arg(argument);
+    } else if (command == "save") {
+        QString warnings;
+        if (save(argument, payload, warnings))
+            reply = warnings.toLatin1();
+        else
+            error = warnings;
+    } else if (command == "calc") {
+        QByteArray record = payload;
+        if (record.isEmpty())
+            load(argument, record);
+        QString row = calculate(argument, record);
+        if (row.isEmpty())
+            error = QString("C%1 has no data to calculate").arg(argument);
+        else
+            reply = row.toLatin1();
+    } else if (command == "stats") {
+        reply = stats().toLatin1();
+    } else {
+        error = "unknown request " + QString::fromLatin1(command);
+    }
+    if (!error.isEmpty()) {
+        failures++;
+        socket->write("error " + error.simplified().toLatin1() + "\n");
+        return;
+    }
+    socket->write("ok " + QByteArray::number(reply.size()) + "\n" + reply);
+}
+
+bool CalcService::load( const QString &control, QByteArray &record ) {
+    loads++;
+    QString stamp = archiveStamp();
+    if (stamp != recordsStamp) {
+        records.clear();
+        recordsStamp = stamp;
+    }
+    if (records.contains(control)) {
+        hits++;
+        record = records.value(control);
+        return true;
+    }
+    if (!archive->read(control, record))
+        return false;
+    if (records.size() >= maxCachedRecords)
+        records.clear();
+    records.insert(control, record);
+    return true;
+}
+
+bool CalcService::save( const QString &control, const QByteArray &record, QString &warnings ) {
+    BuildRecord saved;
+    RecordParser parser(record.constData(), record.size());
+    if (BuildRecordIO::load(parser, saved) == 0) {
+        warnings = QString("The record sent for C%1 contains no data.").arg(control);
+        return false;
+    }
+    // the same steps as a calculator's saveData(), see mountmb.cpp
+    QByteArray previous;
+    archive->read(control, previous);
+    qint64 archiveBefore = SummaryIndex::archiveGeneration( archivePath );
+    if (!archive->write(control, record)) {
+        warnings = archive->errorString();
+        return false;
+    }
+    saves++;
+    QStringList notCounted;
+    if (!spc->update(previous, saved))
+        notCounted << "SPC statistics not updated: " + spc->errorString();
+    if (!summary->update(saved, archiveBefore))
+        notCounted << "Summary index not updated: " + summary->errorString();
+    warnings = notCounted.join("\n");
+    if (archive->wantsCompaction())
+        QtConcurrent::run(BuildArchive::compactPath, archivePath);
+    return true;
+}
+
+QString CalcService::calculate( const QString &control, const QByteArray &record ) {
+    calcs++;
+    BatchRow row = BatchCalc::evaluateRecord( control, record, bondSpec );
+    if (!row.loaded)
+        return QString();
+    return BatchCalc::formatRow( row );
+}
+
+QString CalcService::stats() const {
+    QString text;
+    QTextStream out(&text);
+    out << "archive " << QFileInfo(archivePath).absoluteFilePath() << endl
+        << "up since " << started.toString("yyyy-MM-dd hh:mm:ss") << ", " << clients << " stations connected" << endl
+        << records.size() << " records cached" << endl
+        << loads << " loads, " << hits << " from the cache" << endl
+        << saves << " saves, " << calcs << " calcs, " << failures << " requests refused" << endl
+        << "bondline " << bondSpec.min << " to " << bondSpec.max << " by " << bondSpec.resolution << endl;
+    return text;
+}
+
+QString CalcService::archiveStamp() const {
+    // every save lands in the journal or the archive, and compaction rewrites the archive
+    QFileInfo data(archivePath);
+    QFileInfo journal(archivePath + ".journal");
+    QFileInfo applying(archivePath + ".journal.applying");
+    return QString("%1 %2 %3 %4 %5").arg(data.size()).arg(data.lastModified().toMSecsSinceEpoch())
+            .arg(journal.exists() ? journal.size() : -1).arg(applying.exists() ? applying.size() : -1)
+            .arg(journal.lastModified().toMSecsSinceEpoch());
+}
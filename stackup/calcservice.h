@@ -0,0 +1,62 @@
+#ifndef CALCSERVICE_H
+#define CALCSERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QDateTime>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "stackupcalc.h"
+#include "buildarchive.h"
+#include "spcstats.h"
+#include "summaryindex.h"
+
+// CalcService shares one cache of archived records and one save path among the calculators, see
+// calcservice.cpp
+class CalcService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CalcService( QObject *parent = 0 );
+    ~CalcService();
+    int run( QStringList );
+
+private slots:
+    void newConnection( );
+    void readRequest( );
+    void dropConnection( );
+
+private:
+    QString name;
+    QString archivePath;
+    QString settingsPath;
+    QLocalServer *server;
+    BuildArchive *archive;
+    SpcStats *spc;
+    SummaryIndex *summary;
+    Stackup::BondlineSpec bondSpec;
+    QHash <QString, QByteArray> records;
+    QString recordsStamp;
+    QHash <QLocalSocket*, QByteArray> buffers;
+    QDateTime started;
+    int clients;
+    int loads;
+    int hits;
+    int saves;
+    int calcs;
+    int failures;
+    bool start( QString & );
+    void serve( QLocalSocket *, const QByteArray &, const QString &, const QByteArray & );
+    bool load( const QString &, QByteArray & );
+    bool save( const QString &, const QByteArray &, QString & );
+    QString calculate( const QString &, const QByteArray & );
+    QString stats() const;
+    QString archiveStamp() const;
+};
+
+#endif // CALCSERVICE_H
@@ -0,0 +1,176 @@
+/* CalcServiceClient class is shared code used by the calculators and StackupTool to talk to a
+ * running "StackupTool serve", see calcservice.cpp, over a local socket (a named pipe on Windows).
+ *
+ * Each call sends one request and waits for its reply, so it can stand in for the BuildArchive
+ * call it replaces without changing the order of anything around it:
+ *   load()       the record's bytes for a control number, from the service's cache when it has them
+ *   save()       writes the record to the archive and updates the SPC statistics and summary
+ *                index with it, the whole of a station's save in one round trip
+ *   calculate()  recomputes a record with the service's settings, as one StackupTool calc row
+ *   stats()      what the service holds and has served, as text
+ * Every call returns Ok, Failed when the service answered with an error (errorString() says which,
+ * e.g. a load of a control number the archive does not have), or Unavailable when there is no
+ * service to ask.  Unavailable means nothing was done, so the caller goes to the archive itself.
+ * The one exception is a save whose reply is lost after the request went out: the service may
+ * have written it, so that is Failed and the operator saves again once the station has reloaded.
+ *
+ * The socket stays connected between calls.  Connecting is checked against the archive the
+ * caller would otherwise use, so a service started in another directory is never written to.  A
+ * station without a service tries again only every retrySecs, so each call costs nothing extra.
+ *
+ * Requests are one "command argument length" line followed by length bytes of payload; replies
+ * are "ok length" and length bytes, or "error message".
+*/
+
+#include "calcserviceclient.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+const char *CalcServiceClient::defaultName = "Next177Calc";
+// a local connect either happens at once or there is no service
+static const int connectTimeoutMs = 250;
+// a save can wait out the archive lock, about ten seconds, before the service answers
+static const int requestTimeoutMs = 15000;
+static const int retrySecs = 30;
+
+static QString absolutePath( const QString &path ) {
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+CalcServiceClient::CalcServiceClient( const QString &archivePath, const QString &name ) :
+    serverName(name),
+    archivePath(absolutePath(archivePath)),
+    sent(false)
+{
+    socket = new QLocalSocket();
+}
+
+CalcServiceClient::~CalcServiceClient()
+{
+    socket->abort();
+    delete socket;
+}
+
+bool CalcServiceClient::isAvailable() {
+    return connectToService();
+}
+
+CalcServiceClient::Reply CalcServiceClient::load( const QString &control, QByteArray &record ) {
+    if (!connectToService())
+        return Unavailable;
+    return request("load", control, QByteArray(), record, requestTimeoutMs);
+}
+
+CalcServiceClient::Reply CalcServiceClient::save( const QString &control, const QByteArray &record,
+                                                  QString &warnings ) {
+    if (!connectToService())
+        return Unavailable;
+    QByteArray reply;
+    Reply result = request("save", control, record, reply, requestTimeoutMs);
+    // the request reached the service, a second write from here could double count it
+    if (result == Unavailable && sent) {
+        lastError = "The calculation service stopped during the save: " + lastError;
+        return Failed;
+    }
+    warnings = QString::fromLatin1(reply);
+    return result;
+}
+
+CalcServiceClient::Reply CalcServiceClient::calculate( const QString &control, const QByteArray &record,
+                                                       QString &row ) {
+    if (!connectToService())
+        return Unavailable;
+    QByteArray reply;
+    Reply result = request("calc", control, record, reply, requestTimeoutMs);
+    row = QString::fromLatin1(reply);
+    return result;
+}
+
+CalcServiceClient::Reply CalcServiceClient::stats( QString &text ) {
+    if (!connectToService())
+        return Unavailable;
+    QByteArray reply;
+    Reply result = request("stats", "-", QByteArray(), reply, requestTimeoutMs);
+    text = QString::fromLatin1(reply);
+    return result;
+}
+
+QString CalcServiceClient::errorString() const {
+    return lastError;
+}
+
+bool CalcServiceClient::connectToService() {
+    if (socket->state() == QLocalSocket::ConnectedState)
+        return true;
+    if (retryAfter.isValid() && QDateTime::currentDateTime() < retryAfter)
+        return false;
+    socket->abort();
+    socket->connectToServer(serverName);
+    if (!socket->waitForConnected(connectTimeoutMs)) {
+        lastError = socket->errorString();
+        socket->abort();
+        retryAfter = QDateTime::currentDateTime().addSecs(retrySecs);
+        return false;
+    }
+    // the service must be keeping the same archive this station would write
+    QByteArray served;
+    if (request("archive", "-", QByteArray(), served, connectTimeoutMs * 4) != Ok
+            || absolutePath(QString::fromLocal8Bit(served)) != archivePath) {
+        if (!served.isEmpty())
+            lastError = "The calculation service keeps " + QString::fromLocal8Bit(served)
+                    + ", not " + archivePath;
+        socket->abort();
+        retryAfter = QDateTime::currentDateTime().addSecs(retrySecs);
+        return false;
+    }
+    retryAfter = QDateTime();
+    return true;
+}
+
+CalcServiceClient::Reply CalcServiceClient::request( const QByteArray &command, const QString &argument,
+                                                     const QByteArray &payload, QByteArray &reply,
+                                                     int timeoutMs ) {
+    reply.clear();
+    sent = false;
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray header = command + ' ' + argument.toLatin1() + ' ' + QByteArray::number(payload.size()) + '\n';
+    socket->write(header + payload);
+    while (socket->bytesToWrite() > 0) {
+        if (!socket->waitForBytesWritten(qMax(1, int(timeoutMs - timer.elapsed())))) {
+            lastError = socket->errorString();
+            socket->abort();
+            return Unavailable;
+        }
+    }
+    sent = true;
+    while (!socket->canReadLine()) {
+        if (!socket->waitForReadyRead(qMax(1, int(timeoutMs - timer.elapsed())))) {
+            lastError = "No answer from the calculation service: " + socket->errorString();
+            socket->abort();
+            return Unavailable;
+        }
+    }
+    QByteArray status = socket->readLine().trimmed();
+    if (status.startsWith("error ")) {
+        lastError = QString::fromLatin1(status.mid(6));
+        return Failed;
+    }
+    if (!status.startsWith("ok ")) {
+        lastError = "The calculation service answered \"" + QString::fromLatin1(status) + "\"";
+        socket->abort();
+        return Unavailable;
+    }
+    int length = status.mid(3).toInt();
+    while (socket->bytesAvailable() < length) {
+        if (!socket->waitForReadyRead(qMax(1, int(timeoutMs - timer.elapsed())))) {
+            lastError = "No answer from the calculation service: " + socket->errorString();
+            socket->abort();
+            return Unavailable;
+        }
+    }
+    reply = socket->read(length);
+    return Ok;
+}
@@ -0,0 +1,259 @@
+/* exportcommand.cpp contains the StackupTool "export" command, which writes every record in the
+ * archive (-a) to one file for analysis, one column per template field, instead of thousands of
+ * two-column "key,<tab>value" records.
+ *
+ * The default output (-o, archive.n177c) is columnar, in little-endian binary:
+ *     header      "N177COL1", u32 version (1), u32 field count, then per field in template
+ *                 order: u8 type (0 text, 1 number, 2 step marker), u8 decimals, u16 name length
+ *                 and the name from recordgen/buildrecord.fields
+ *     row group   u32 row count, then one column chunk per field: u32 chunk length in bytes and
+ *                 the values, numbers as doubles (NaN where never entered), markers as one byte
+ *                 (1 once the step is saved), text as u16 length and Latin-1 bytes
+ *     end         u32 0, then u64 total rows
+ * The chunk lengths let a reader skip straight to the columns it wants.  --csv writes one wide
+ * .csv instead, a header of field names and a row per record, markers as 1 or 0.  "-o -" writes
+ * to stdout.
+ *
+ * Records are read and converted in row groups of -n records (1024 by default) on all cores (-j
+ * threads), a few groups per thread at a time, and the groups are written in control number
+ * order as each wave completes.  Only those groups are ever held in memory, plus the list of
+ * control numbers, so memory doesn't grow with the archive.
+*/
+
+#include "exportcommand.h"
+#include "buildarchive.h"
+#include "buildrecordio.h"
+#include "recordparser.h"
+
+#include <QFile>
+#include <QVector>
+#include <QtEndian>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrentMap>
+#include <cstring>
+
+static const char columnMagic[8] = { 'N', '1', '7', '7', 'C', 'O', 'L', '1' };
+static const quint32 columnVersion = 1;
+
+// one row group, converted on a worker thread and written in order
+struct ExportGroup {
+    QByteArray bytes;
+    int rows;
+    int skipped;
+};
+
+static void appendU16( QByteArray &bytes, quint16 value ) {
+    uchar data[2];
+    qToLittleEndian<quint16>(value, data);
+    bytes.append(reinterpret_cast<const char *>(data), 2);
+}
+
+static void appendU32( QByteArray &bytes, quint32 value ) {
+    uchar data[4];
+    qToLittleEndian<quint32>(value, data);
+    bytes.append(reinterpret_cast<const char *>(data), 4);
+}
+
+static void appendU64( QByteArray &bytes, quint64 value ) {
+    uchar data[8];
+    qToLittleEndian<quint64>(value, data);
+    bytes.append(reinterpret_cast<const char *>(data), 8);
+}
+
+static void appendDouble( QByteArray &bytes, double value ) {
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendU64(bytes, bits);
+}
+
+static QByteArray csvCell( const QString &text ) {
+    QByteArray cell = text.toLatin1();
+    if (cell.contains(',') || cell.contains('"') || cell.contains('\n')) {
+        cell.replace("\"", "\"\"");
+        cell = "\"" + cell + "\"";
+    }
+    return cell;
+}
+
+static QByteArray columnHeader( ) {
+    QByteArray bytes(columnMagic, 8);
+    appendU32(bytes, columnVersion);
+    appendU32(bytes, BuildRecord::RowCount);
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        const BuildRecordField &f = buildRecordFields[row];
+        QByteArray name(f.name);
+        bytes.append(char(f.type == RecordText ? 0 : f.type == RecordNumber ? 1 : 2));
+        bytes.append(char(f.decimals));
+        appendU16(bytes, name.size());
+        bytes.append(name);
+    }
+    return bytes;
+}
+
+static QByteArray csvHeader( ) {
+    QByteArray bytes;
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        if (row > 1)
+            bytes.append(',');
+        bytes.append(buildRecordFields[row].name);
+    }
+    return bytes + "\n";
+}
+
+// QtConcurrent functor, reads and converts one row group; read() is thread safe once mapped
+struct ExportRecords {
+    typedef ExportGroup result_type;
+    const BuildArchive *archive;
+    bool csv;
+    ExportGroup operator()( const QStringList &controls ) const {
+        ExportGroup group;
+        group.skipped = 0;
+        QVector <BuildRecord> records;
+        records.reserve(controls.size());
+        for (int i = 0; i < controls.size(); i++) {
+            QByteArray bytes;
+            BuildRecord record;
+            if (!archive->read(controls[i], bytes)) {
+                group.skipped++;
+                continue;
+            }
+            RecordParser parser(bytes.constData(), bytes.size());
+            if (BuildRecordIO::load( parser, record ) == 0) {
+                group.skipped++;
+                continue;
+            }
+            records << record;
+        }
+        group.rows = records.size();
+        if (csv) {
+            for (int i = 0; i < records.size(); i++) {
+                for (int row = 1; row <= BuildRecord::RowCount; row++) {
+                    const BuildRecordField &f = buildRecordFields[row];
+                    if (row > 1)
+                        group.bytes.append(',');
+                    if (f.type == RecordMarker)
+                        group.bytes.append(records[i].*f.marker ? '1' : '0');
+                    else
+                        group.bytes.append(csvCell( BuildRecordIO::text(records[i], row) ));
+                }
+                group.bytes.append('\n');
+            }
+            return group;
+        }
+        appendU32(group.bytes, records.size());
+        for (int row = 1; row <= BuildRecord::RowCount; row++) {
+            const BuildRecordField &f = buildRecordFields[row];
+            QByteArray chunk;
+            if (f.type == RecordNumber) {
+                chunk.reserve(8 * records.size());
+                for (int i = 0; i < records.size(); i++)
+                    appendDouble(chunk, records[i].*f.number);
+            } else if (f.type == RecordMarker) {
+                for (int i = 0; i < records.size(); i++)
+                    chunk.append(char(records[i].*f.marker ? 1 : 0));
+            } else {
+                for (int i = 0; i < records.size(); i++) {
+                    QByteArray text = (records[i].*f.text).toLatin1().left(0xffff);
+                    appendU16(chunk, text.size());
+                    chunk.append(text);
+                }
+            }
+            appendU32(group.bytes, chunk.size());
+            group.bytes.append(chunk);
+        }
+        return group;
+    }
+};
+
+ExportCommand::ExportCommand() :
+    archivePath("control/archive.dat"),
+    csv(false),
+    groupRows(1024)
+{
+}
+
+int ExportCommand::run( QStringList args ) {
+    QTextStream err(stderr);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-a" && !args.isEmpty()) {
+            archivePath = args.takeFirst();
+        } else if (arg == "-o" && !args.isEmpty()) {
+            outputPath = args.takeFirst();
+        } else if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "-n" && !args.isEmpty()) {
+            groupRows = qMax(1, args.takeFirst().toInt());
+        } else if (arg == "-j" && !args.isEmpty()) {
+            int threads = args.takeFirst().toInt();
+            if (threads > 0)
+                QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        } else {
+            err << "export: ignoring " << arg << endl;
+        }
+    }
+    if (outputPath.isEmpty())
+        outputPath = csv ? "archive.csv" : "archive.n177c";
+
+    QElapsedTimer timer;
+    timer.start();
+    BuildArchive archive(archivePath);
+    if (!archive.map()) {
+        err << "export: unable to open " << archivePath << ": " << archive.errorString() << endl;
+        return 1;
+    }
+    QStringList controls = archive.controls();
+    controls.sort();
+    QFile file(outputPath);
+    bool opened;
+    if (outputPath == "-")
+        opened = file.open(stdout, QIODevice::WriteOnly);
+    else
+        opened = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!opened) {
+        err << "export: unable to open " << outputPath << ": " << file.errorString() << endl;
+        return 1;
+    }
+    file.write(csv ? csvHeader() : columnHeader());
+
+    ExportRecords exportRecords;
+    exportRecords.archive = &archive;
+    exportRecords.csv = csv;
+    // a few groups per thread keeps every core busy while bounding what is held at once
+    int waveGroups = 2 * QThreadPool::globalInstance()->maxThreadCount();
+    quint64 rows = 0;
+    int skipped = 0;
+    bool ok = true;
+    for (int start = 0; start < controls.size() && ok; ) {
+        QList <QStringList> wave;
+        for ( ; start < controls.size() && wave.size() < waveGroups; start += groupRows)
+            wave << controls.mid(start, groupRows);
+        QList <ExportGroup> groups = QtConcurrent::blockingMapped(wave, exportRecords);
+        for (int i = 0; i < groups.size() && ok; i++) {
+            ok = file.write(groups[i].bytes) == groups[i].bytes.size();
+            rows += groups[i].rows;
+            skipped += groups[i].skipped;
+        }
+    }
+    if (ok && !csv) {
+        QByteArray end;
+        appendU32(end, 0);
+        appendU64(end, rows);
+        ok = file.write(end) == end.size();
+    }
+    ok = file.flush() && ok;
+    archive.unmap();
+    if (!ok) {
+        err << "export: writing " << outputPath << " failed: " << file.errorString() << endl;
+        return 2;
+    }
+    file.close();
+    err << "exported " << rows << " records from " << archivePath << " to " << outputPath
+        << " in " << timer.elapsed() << " ms";
+    if (skipped)
+        err << ", " << skipped << " unreadable or empty records skipped";
+    err << endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef EXPORTCOMMAND_H
+#define EXPORTCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class ExportCommand
+{
+public:
+    ExportCommand();
+    int run( QStringList );
+
+private:
+    QString archivePath;
+    QString outputPath;
+    bool csv;
+    int groupRows;
+};
+
+#endif // EXPORTCOMMAND_H
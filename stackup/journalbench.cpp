@@ -0,0 +1,177 @@
+/* journalbench.cpp contains the StackupTool "bench-journal" command, which times saves to one
+ * archive from many stations at once, straight to the archive and through the save journal.
+ *
+ * run() starts 1, 8 and 32 BenchStation threads (-s for other counts) on a scratch archive (-a).
+ * Each station has its own BuildArchive, so they contend for the lock directories exactly as
+ * separate stations on the share do, and saves -n records cycling over benchDewars dewars of its own so
+ * most saves are resaves, like the floor.  Every save is a full record with a few fields changed.
+ *
+ * Each run reports saves per second and the p50/p99/max time for write() to return, which for
+ * the journal is when the save is safe.  The journal is then replayed and every dewar read back
+ * and checked against its last save.
+*/
+
+#include "journalbench.h"
+#include "buildarchive.h"
+
+#include <QDir>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+// each station cycles its saves over this many dewars
+static const int benchDewars = 20;
+
+BenchStation::BenchStation( const QString &archivePath, bool journaled, int station, int saves ) :
+    failed(0),
+    archivePath(archivePath),
+    journaled(journaled),
+    station(station),
+    saves(saves)
+{
+}
+
+QString BenchStation::controlName( int station, int dewar ) {
+    return QString::number(Q_INT64_C(3001000000) + station * 1000 + dewar);
+}
+
+QByteArray BenchStation::record( int station, int dewar, int save ) {
+    // 35 "key,<tab>value" rows like a saved record, the last save shows in a few of them
+    QByteArray text;
+    QTextStream stream(&text, QIODevice::WriteOnly);
+    stream << "Control Number,\t" << controlName(station, dewar) << "\r\n"
+           << "Serial Number,\t" << QString("%1").arg(dewar, 3, 10, QChar('0')) << "\r\n";
+    for (int row = 3; row <= 35; row++) {
+        double value = 0.5 + row * 0.01 + (row % 7 == 0 ? save * 0.0001 : 0);
+        stream << "Build Field " << row << ",\t" << QString::number(value, 'f', 4) << "\r\n";
+    }
+    stream.flush();
+    return text;
+}
+
+void BenchStation::run() {
+    BuildArchive archive(archivePath);
+    archive.setJournaled( journaled );
+    QElapsedTimer timer;
+    for (int i = 0; i < saves; i++) {
+        timer.start();
+        if (!archive.write(controlName(station, i % benchDewars), record( station, i % benchDewars, i ))) {
+            failed++;
+            error = archive.errorString();
+        }
+        latencies << int(timer.elapsed());
+    }
+}
+
+JournalBench::JournalBench() :
+    saves(200),
+    archivePath(QDir::temp().filePath("bench-journal.dat"))
+{
+    stationCounts << 1 << 8 << 32;
+}
+
+int JournalBench::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-n" && !args.isEmpty())
+            saves = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "-s" && !args.isEmpty()) {
+            stationCounts.clear();
+            QStringList counts = args.takeFirst().split(',');
+            for (int i = 0; i < counts.size(); i++) {
+                if (counts[i].toInt() > 0)
+                    stationCounts << counts[i].toInt();
+            }
+        }
+        else
+            err << "bench-journal: ignoring " << arg << endl;
+    }
+    if (stationCounts.isEmpty()) {
+        err << "bench-journal: no station counts given" << endl;
+        return 1;
+    }
+
+    out << QString("%1%2%3%4%5%6").arg("stations", -10).arg("path", -10).arg("saves/s", 10)
+           .arg("p50 ms", 9).arg("p99 ms", 9).arg("max ms", 9) << endl;
+    for (int i = 0; i < stationCounts.size(); i++) {
+        for (int journaled = 0; journaled < 2; journaled++) {
+            QString line;
+            int status = runStations( stationCounts[i], journaled, line );
+            if (status != 0) {
+                err << "bench-journal: " << line << endl;
+                removeArchive( );
+                return status;
+            }
+            out << line << endl;
+        }
+    }
+    removeArchive( );
+    return 0;
+}
+
+void JournalBench::removeArchive( ) {
+    BuildArchive::remove(archivePath);
+}
+
+int JournalBench::runStations( int count, bool journaled, QString &line ) {
+    removeArchive( );
+    QList <BenchStation *> stations;
+    for (int s = 0; s < count; s++)
+        stations << new BenchStation(archivePath, journaled, s, saves);
+    QElapsedTimer timer;
+    timer.start();
+    for (int s = 0; s < count; s++)
+        stations[s]->start();
+    for (int s = 0; s < count; s++)
+        stations[s]->wait();
+    qint64 elapsed = qMax(Q_INT64_C(1), timer.elapsed());
+
+    QList <int> latencies;
+    int failed = 0;
+    QString error;
+    for (int s = 0; s < count; s++) {
+        latencies += stations[s]->latencies;
+        failed += stations[s]->failed;
+        if (!stations[s]->error.isEmpty())
+            error = stations[s]->error;
+    }
+    qDeleteAll(stations);
+    if (failed) {
+        line = QString("%1 of %2 saves failed: %3").arg(failed).arg(latencies.size()).arg(error);
+        return 2;
+    }
+
+    // whatever is still journaled goes in, then every dewar must read back as last saved
+    BuildArchive archive(archivePath);
+    if (!archive.replayJournal()) {
+        line = archive.errorString();
+        return 2;
+    }
+    for (int s = 0; s < count; s++) {
+        for (int d = 0; d < benchDewars && d < saves; d++) {
+            int last = saves - 1 - ((saves - 1 - d) % benchDewars);
+            QByteArray stored;
+            if (!archive.read(BenchStation::controlName(s, d), stored)
+                    || stored != BenchStation::record( s, d, last )) {
+                line = "C" + BenchStation::controlName(s, d) + " did not read back as last saved";
+                return 2;
+            }
+        }
+    }
+    line = QString("%1%2%3%4%5%6").arg(count, -10).arg(journaled ? "journal" : "direct", -10)
+            .arg(QString::number(latencies.size() * 1000.0 / elapsed, 'f', 0), 10)
+            .arg(percentile( latencies, 0.50 ), 9).arg(percentile( latencies, 0.99 ), 9)
+            .arg(percentile( latencies, 1.0 ), 9);
+    return 0;
+}
+
+int JournalBench::percentile( QList <int> values, double p ) {
+    if (values.isEmpty())
+        return 0;
+    qSort(values);
+    int index = qMin(values.size() - 1, int(p * (values.size() - 1) + 0.5));
+    return values[index];
+}
@@ -0,0 +1,45 @@
+#ifndef JOURNALBENCH_H
+#define JOURNALBENCH_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QThread>
+
+// one simulated station saving its own dewars back to back, on its own thread
+class BenchStation : public QThread
+{
+public:
+    BenchStation( const QString &archivePath, bool journaled, int station, int saves );
+    QList <int> latencies;      // ms per save, until write() returned
+    int failed;
+    QString error;
+    static QString controlName( int station, int dewar );
+    static QByteArray record( int station, int dewar, int save );
+
+protected:
+    void run();
+
+private:
+    QString archivePath;
+    bool journaled;
+    int station;
+    int saves;
+};
+
+class JournalBench
+{
+public:
+    JournalBench();
+    int run( QStringList );
+
+private:
+    int saves;
+    QList <int> stationCounts;
+    QString archivePath;
+    void removeArchive( );
+    int runStations( int, bool, QString & );
+    static int percentile( QList <int>, double );
+};
+
+#endif // JOURNALBENCH_H
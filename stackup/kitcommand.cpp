@@ -0,0 +1,146 @@
+/* kitcommand.cpp contains the StackupTool "kit" command, which pairs a lot of measured coldfilters
+ * with the dewars waiting at the coldfilter mount so that as many builds as possible meet ICD.
+ *
+ * run() takes the dewars from the summary index (-x, rebuilt from the archive -a when stale): every
+ * record with its coldshield step saved and its first coldfilter step not yet saved, using the
+ * coldshield height and optical centerline ColdfilterMount would load.  Coldfilters come from .csv files of "id, thickness" rows,
+ * skipping any line whose thickness isn't a number.  Stackup::kitColdfilters() does the pairing
+ * with the dispenser settings from control/stackup.ini (or -i).
+ *
+ * The report has one row per dewar with its coldfilter, bondline, ball height, expected ICD and
+ * margins, blank where no coldfilter fits.  stderr gets the count kitted against what taking the
+ * coldfilters in lot order would have managed.
+*/
+
+#include "kitcommand.h"
+#include "kitting.h"
+#include "batchcalc.h"
+#include "summaryindex.h"
+#include "buildrecordio.h"
+
+#include <QFile>
+#include <QVector>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+static QString number( double value ) {
+    return QString::number(value, 'f', 4);
+}
+
+static bool usable( double value ) {
+    return BuildRecordIO::isSet(value) && value;
+}
+
+KitCommand::KitCommand() :
+    archivePath("control/archive.dat"),
+    indexPath("control/summary.dat"),
+    settingsPath("control/stackup.ini")
+{
+}
+
+int KitCommand::run( QStringList args ) {
+    QTextStream err(stderr);
+    QStringList paths;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "-x" && !args.isEmpty())
+            indexPath = args.takeFirst();
+        else if (arg == "-i" && !args.isEmpty())
+            settingsPath = args.takeFirst();
+        else if (arg == "-o" && !args.isEmpty())
+            outputPath = args.takeFirst();
+        else
+            paths << arg;
+    }
+    Stackup::BondlineSpec spec = BatchCalc::loadBondlineSpec( settingsPath );
+
+    QStringList coldfilters;
+    QVector <double> cf;
+    for (int i = 0; i < paths.size(); i++) {
+        QFile file(paths[i]);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            err << "kit: unable to read " << paths[i] << endl;
+            return 2;
+        }
+        while (!file.atEnd()) {
+            QStringList cells = QString(file.readLine()).split(',');
+            if (cells.size() < 2)
+                continue;
+            bool ok;
+            double thickness = cells[1].trimmed().toDouble(&ok);
+            if (!ok || !thickness)
+                continue;
+            coldfilters << cells[0].trimmed();
+            cf << thickness;
+        }
+    }
+    if (coldfilters.isEmpty()) {
+        err << "kit: no coldfilters given" << endl;
+        return 1;
+    }
+
+    // dewars waiting at the coldfilter mount, from the summary index rather than every record
+    SummaryIndex index(indexPath, archivePath);
+    if (index.isStale() && !index.rebuild()) {
+        err << "kit: unable to index " << archivePath << ": " << index.errorString() << endl;
+        return 1;
+    }
+    QList <SummaryEntry> waiting = index.waitingFor( SummaryIndex::Coldfilter1Step );
+    QList <SummaryEntry> dewars;
+    QVector <double> cs, fpa;
+    for (int i = 0; i < waiting.size(); i++) {
+        if (!usable(waiting[i].coldshieldHeight) || !usable(waiting[i].opticalCenter))
+            continue;
+        dewars << waiting[i];
+        cs << waiting[i].coldshieldHeight;
+        fpa << waiting[i].opticalCenter;
+    }
+    if (dewars.isEmpty()) {
+        err << "kit: no dewars waiting for a coldfilter in " << archivePath << endl;
+        return 1;
+    }
+
+    QVector <int> kit(dewars.size());
+    QVector <int> inOrder(dewars.size());
+    QElapsedTimer timer;
+    timer.start();
+    int kitted = Stackup::kitColdfilters(cs.constData(), fpa.constData(), dewars.size(),
+                                         cf.constData(), cf.size(), kit.data(), spec);
+    qint64 kitMs = timer.elapsed();
+    int baseline = Stackup::kitInOrder(cs.constData(), fpa.constData(), dewars.size(),
+                                       cf.constData(), cf.size(), inOrder.data(), spec);
+
+    QFile outFile;
+    if (outputPath.isEmpty()) {
+        outFile.open(stdout, QIODevice::WriteOnly);
+    } else {
+        outFile.setFileName(outputPath);
+        if (!outFile.open(QFile::WriteOnly|QFile::Truncate)) {
+            err << "kit: unable to open " << outputPath << ": " << outFile.errorString() << endl;
+            return 1;
+        }
+    }
+    QTextStream out(&outFile);
+    out << "control,serial,csHeight,opticalCenter,coldfilter,cfThickness,bondline,ballHeight,"
+           "expectedIcd,bondStatus,marginMin,marginMax" << endl;
+    for (int i = 0; i < dewars.size(); i++) {
+        QStringList cells;
+        cells << dewars[i].control << dewars[i].serial << number(cs[i]) << number(fpa[i]);
+        if (kit[i] >= 0) {
+            Stackup::BondChoice bond = Stackup::chooseBondline(cf[kit[i]], cs[i], fpa[i], spec);
+            cells << coldfilters[kit[i]] << number(cf[kit[i]]) << number(bond.bondline)
+                  << number(bond.ballHeight) << number(bond.icd) << Stackup::statusName(bond.status)
+                  << number(bond.marginMin) << number(bond.marginMax);
+        } else {
+            cells << "" << "" << "" << "" << "" << "" << "" << "";
+        }
+        out << cells.join(",") << endl;
+    }
+    out.flush();
+    err << dewars.size() << " dewars, " << coldfilters.size() << " coldfilters: " << kitted
+        << " kitted in spec (" << baseline << " taking coldfilters in lot order), "
+        << kitMs << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef KITCOMMAND_H
+#define KITCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class KitCommand
+{
+public:
+    KitCommand();
+    int run( QStringList );
+
+private:
+    QString archivePath;
+    QString indexPath;
+    QString settingsPath;
+    QString outputPath;
+};
+
+#endif // KITCOMMAND_H
@@ -0,0 +1,143 @@
+/* kitting.cpp contains the Qt-free lot kitting behind StackupTool's "kit" command.
+ *
+ * A dewar meets ICD with a coldfilter when some dispensable bondline puts cs - fpa + cf + bondline
+ * inside icdMin..icdMax, so every dewar accepts coldfilters from one thickness window, and all the
+ * windows are the same width.  With windows like that, two kits that cross (thicker dewar base on
+ * the thicker coldfilter) can always be swapped without losing either build, so some best kitting
+ * keeps both lists in order.
+ *
+ * kitColdfilters() sorts the dewars by the coldfilter thickness they need and the coldfilters by
+ * thickness, then runs an order-preserving matching over the two lists, the same dynamic program
+ * as an edit distance.  A kit scores one build in spec, less its distance from icdTarget, so the
+ * count always comes first.  Only coldfilters inside a dewar's window are ever scored, found by
+ * binary search, which keeps thousands of parts to well under a second; the table costs one byte
+ * per dewar and coldfilter pair.
+ *
+ * kitInOrder() is the baseline: dewars in the order given, each taking the first coldfilter left
+ * that chooseBondline() says fits.
+*/
+
+#include "kitting.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace Stackup {
+
+// one build in spec outweighs any sum of distances from icdTarget
+static const double buildScore = 1000.0;
+
+// sort indices by a key without moving the measurements
+struct KeyLess {
+    const std::vector<double> *keys;
+    bool operator()( int a, int b ) const { return (*keys)[a] < (*keys)[b]; }
+};
+
+static std::vector<int> sortedOrder( const std::vector<double> &keys ) {
+    std::vector<int> order(keys.size());
+    for (unsigned i = 0; i < order.size(); i++)
+        order[i] = i;
+    KeyLess less;
+    less.keys = &keys;
+    std::stable_sort(order.begin(), order.end(), less);
+    return order;
+}
+
+int kitColdfilters( const double *cs, const double *fpa, int dewarCount,
+                    const double *cf, int coldfilterCount, int *kit, const BondlineSpec &spec ) {
+    for (int i = 0; i < dewarCount; i++)
+        kit[i] = -1;
+    if (dewarCount <= 0 || coldfilterCount <= 0)
+        return 0;
+
+    // the thickness each dewar wants with a zero bondline, and each coldfilter's thickness
+    std::vector<double> need(dewarCount);
+    for (int i = 0; i < dewarCount; i++)
+        need[i] = icdTarget - (fabs(cs[i]) - fabs(fpa[i]));
+    std::vector<double> thickness(coldfilterCount);
+    for (int j = 0; j < coldfilterCount; j++)
+        thickness[j] = fabs(cf[j]);
+    std::vector<int> dewars = sortedOrder(need);
+    std::vector<int> coldfilters = sortedOrder(thickness);
+    std::vector<double> sorted(coldfilterCount);
+    for (int j = 0; j < coldfilterCount; j++)
+        sorted[j] = thickness[coldfilters[j]];
+
+    // score[j] is the best kitting of the dewars so far with the first j coldfilters,
+    // step[] records which move got there: 0 dewar left out, 1 coldfilter left out, 2 kitted
+    int columns = coldfilterCount + 1;
+    std::vector<double> previous(columns, 0.0);
+    std::vector<double> score(columns, 0.0);
+    std::vector<unsigned char> step((size_t)dewarCount * columns, 1);
+    for (int i = 0; i < dewarCount; i++) {
+        int d = dewars[i];
+        double base = fabs(cs[d]) - fabs(fpa[d]);
+        // the widest window any dispensable bondline allows, pairs are checked exactly below
+        double low = icdMin - base - spec.max - 1e-9;
+        double high = icdMax - base - spec.min + 1e-9;
+        int first = std::lower_bound(sorted.begin(), sorted.end(), low) - sorted.begin();
+        int last = std::upper_bound(sorted.begin(), sorted.end(), high) - sorted.begin();
+        unsigned char *row = &step[(size_t)i * columns];
+        score[0] = previous[0];
+        row[0] = 0;
+        for (int j = 1; j < columns; j++) {
+            score[j] = previous[j];
+            row[j] = 0;
+            if (score[j - 1] > score[j]) {
+                score[j] = score[j - 1];
+                row[j] = 1;
+            }
+            if (j - 1 < first || j - 1 >= last)
+                continue;
+            BondChoice bond = chooseBondline(sorted[j - 1], cs[d], fpa[d], spec);
+            if (bond.status == Red)
+                continue;
+            double kitted = previous[j - 1] + buildScore - fabs(bond.icd - icdTarget);
+            if (kitted > score[j]) {
+                score[j] = kitted;
+                row[j] = 2;
+            }
+        }
+        previous.swap(score);
+    }
+
+    // walk back from the full table to read off the kits
+    int count = 0;
+    int i = dewarCount;
+    int j = coldfilterCount;
+    while (i > 0 && j > 0) {
+        unsigned char move = step[(size_t)(i - 1) * columns + j];
+        if (move == 2) {
+            kit[dewars[i - 1]] = coldfilters[j - 1];
+            count++;
+            i--;
+            j--;
+        } else if (move == 1) {
+            j--;
+        } else {
+            i--;
+        }
+    }
+    return count;
+}
+
+int kitInOrder( const double *cs, const double *fpa, int dewarCount,
+                const double *cf, int coldfilterCount, int *kit, const BondlineSpec &spec ) {
+    std::vector<bool> used(coldfilterCount, false);
+    int count = 0;
+    for (int i = 0; i < dewarCount; i++) {
+        kit[i] = -1;
+        for (int j = 0; j < coldfilterCount; j++) {
+            if (used[j] || chooseBondline(cf[j], cs[i], fpa[i], spec).status == Red)
+                continue;
+            kit[i] = j;
+            used[j] = true;
+            count++;
+            break;
+        }
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef KITTING_H
+#define KITTING_H
+
+#include "stackupcalc.h"
+
+// Qt-free lot kitting for the coldfilter mount step, see kitting.cpp
+
+namespace Stackup {
+
+// pairs each dewar (coldshield height cs, optical centerline fpa) with at most one coldfilter
+// (thickness cf) so that as many builds as possible meet ICD, then as close to icdTarget as
+// possible.  kit[dewar] is the coldfilter's index, or -1 when none fits.  returns the builds kitted.
+int kitColdfilters( const double *cs, const double *fpa, int dewarCount,
+                    const double *cf, int coldfilterCount, int *kit,
+                    const BondlineSpec &spec = defaultBondlineSpec );
+
+// what the floor does today: each dewar, in order, takes the first coldfilter left that fits
+int kitInOrder( const double *cs, const double *fpa, int dewarCount,
+                const double *cf, int coldfilterCount, int *kit,
+                const BondlineSpec &spec = defaultBondlineSpec );
+
+}
+
+#endif // KITTING_H
@@ -0,0 +1,161 @@
+// main.cpp dispatches StackupTool commands.  Each command lives in its own class.
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include "batchcalc.h"
+#include "archivecommand.h"
+#include "parsebench.h"
+#include "proteusstandin.h"
+#include "proteusbench.h"
+#include "prefetchcommand.h"
+#include "screencommand.h"
+#include "kitcommand.h"
+#include "simulatecommand.h"
+#include "spccommand.h"
+#include "summarycommand.h"
+#include "querycommand.h"
+#include "exportcommand.h"
+#include "journalbench.h"
+#include "calcservice.h"
+#include "tracecompare.h"
+
+static void printUsage() {
+    QTextStream err(stderr);
+    err << "usage: StackupTool <command> [options]" << endl
+        << endl
+        << "commands:" << endl
+        << "  calc [-o report.csv] [-j threads] [-i stackup.ini] <archive.dat | control dir | record.csv ...>" << endl
+        << "      recompute angle, centerline, ICD, bondline, ball height and parallelism" << endl
+        << "      for every record and report results against the saved values" << endl
+        << "  import [-a archive.dat] <control dir ...>" << endl
+        << "      copy control/<ctrl>.csv records into the build record archive" << endl
+        << "  get [-a archive.dat] <control ...>" << endl
+        << "      print archived records in their .csv form" << endl
+        << "  compact [-a archive.dat]" << endl
+        << "      drop superseded copies of records from the archive" << endl
+        << "  bench-parse [-n records] [-r repeats] [-a scratch.dat]" << endl
+        << "      time the old split/QMap record loading against RecordParser" << endl
+        << "  bench-journal [-n saves] [-s stations,stations,...] [-a scratch.dat]" << endl
+        << "      time saves from 1, 8 and 32 simulated stations, straight to the archive and" << endl
+        << "      through the save journal" << endl
+        << "  proteus-standin [-p port] [-r reply dir] [-l ms] [-j ms] [-e rate] [-d rate] [-t rate] [-s seed]" << endl
+        << "      serve dataFormResult replies locally in place of Proteus, with latency jitter," << endl
+        << "      errors (-e), \"No data found\" (-d) and unanswered requests (-t)" << endl
+        << "  bench-proteus [-u url] [-n loads] [-c concurrent] [-k controls] [-w timeout ms] [--cache]" << endl
+        << "                [stand-in options]" << endl
+        << "      time load-to-verification of dataforms 1061 and 1065, against -u or an" << endl
+        << "      in-process stand-in, and report p50/p90/p99 latency" << endl
+        << "  prefetch [-c concurrent] [-i proteus.ini] [-u url] [-f list.txt | -f -] [control ...]" << endl
+        << "      fetch dataforms 1061 and 1065 for every control number into the PHR cache" << endl
+        << "  screen [-o report.csv] [-i stackup.ini] [-r resolution] <lot.csv ...>" << endl
+        << "      solve the coldfilter bondline and ICD margins for every part in a lot," << endl
+        << "      one \"control,cf,cs,fpa\" row per part" << endl
+        << "  kit [-a archive.dat] [-x summary.dat] [-i stackup.ini] [-o kits.csv] <coldfilters.csv ...>" << endl
+        << "      pair a lot's coldfilters (\"id,thickness\" rows) with the dewars waiting at" << endl
+        << "      the coldfilter mount so the most builds meet ICD" << endl
+        << "  simulate [-n trials] [-j threads] [-s seed] [-i stackup.ini] [--cs mean,sigma]" << endl
+        << "           [--fpa mean,sigma] [--cf mean,sigma] [--gauge sigma] [--bondline sigma]" << endl
+        << "      Monte Carlo the ICD stackup and report yield and sensitivity to the ICD limits," << endl
+        << "      any contributor may be \"uniform:low,high\" instead" << endl
+        << "  spc [-s spc.dat] [--rebuild [-a archive.dat]]" << endl
+        << "      print mean, sigma, Cpk and red/yellow/green counts for each characteristic" << endl
+        << "  summary [-x summary.dat] [-a archive.dat] [--rebuild] [--waiting step]" << endl
+        << "      list every dewar's saved steps and key outputs from the summary index, or only" << endl
+        << "      those waiting at one step: motherboard, coldshield, coldfilter1, coldfilter2" << endl
+        << "  query [-x summary.dat] [-a archive.dat] [-c field,field,... | -r] <query>" << endl
+        << "      list the dewars matching e.g. \"cfParallelism > 0.0025 and saved >= -90d\" from" << endl
+        << "      the summary index, as control numbers, -c fields as .csv, or -r full records;" << endl
+        << "      the index keeps the first 16 characters of text fields (24 of serial), so" << endl
+        << "      longer text values are refused" << endl
+        << "  export [-a archive.dat] [-o file | -] [--csv] [-n rows] [-j threads]" << endl
+        << "      write every archived record, one column per template field, to a columnar" << endl
+        << "      file for analysis (see exportcommand.cpp), or --csv one wide .csv" << endl
+        << "  serve [-a archive.dat] [-i stackup.ini] [-n name] [--stats]" << endl
+        << "      share one cache of archived records, and one place saves are written, among" << endl
+        << "      the calculators over a local socket; --stats asks a running service what it" << endl
+        << "      holds" << endl
+        << "  trace-compare <before.json[,before.json ...]> <after.json[,after.json ...]>" << endl
+        << "      compare calculator --trace-startup traces step by step, with launch time and" << endl
+        << "      resident memory, averaging repeated runs" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    // drop the executable name, then the command
+    args.removeFirst();
+    if (args.isEmpty()) {
+        printUsage();
+        return 1;
+    }
+    QString command = args.takeFirst();
+    if (command == "calc") {
+        BatchCalc calc;
+        return calc.run( args );
+    }
+    if (command == "import" || command == "get" || command == "compact") {
+        ArchiveCommand archive;
+        return archive.run( command, args );
+    }
+    if (command == "bench-parse") {
+        ParseBench bench;
+        return bench.run( args );
+    }
+    if (command == "bench-journal") {
+        JournalBench bench;
+        return bench.run( args );
+    }
+    if (command == "proteus-standin") {
+        ProteusStandIn standIn;
+        return standIn.run( args );
+    }
+    if (command == "bench-proteus") {
+        ProteusBench bench;
+        return bench.run( args );
+    }
+    if (command == "screen") {
+        ScreenCommand screen;
+        return screen.run( args );
+    }
+    if (command == "kit") {
+        KitCommand kit;
+        return kit.run( args );
+    }
+    if (command == "simulate") {
+        SimulateCommand simulate;
+        return simulate.run( args );
+    }
+    if (command == "spc") {
+        SpcCommand spc;
+        return spc.run( args );
+    }
+    if (command == "summary") {
+        SummaryCommand summary;
+        return summary.run( args );
+    }
+    if (command == "query") {
+        QueryCommand query;
+        return query.run( args );
+    }
+    if (command == "export") {
+        ExportCommand exporter;
+        return exporter.run( args );
+    }
+    if (command == "serve") {
+        CalcService service;
+        return service.run( args );
+    }
+    if (command == "trace-compare") {
+        TraceCompare compare;
+        return compare.run( args );
+    }
+    if (command == "prefetch") {
+        PrefetchCommand prefetch;
+        return prefetch.run( args );
+    }
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,160 @@
+/* montecarlo.cpp contains the Qt-free Monte Carlo stackup behind StackupTool's "simulate" command.
+ *
+ * Each trial draws a true coldshield height, optical centerline and coldfilter thickness, adds
+ * gauge error to get what the station measures, and lets chooseBondline() pick the bondline from
+ * the measurements just as MountCF::calculateData1() would.  The epoxy then lays down that
+ * bondline plus its own variation, and the true ICD is cs - fpa + cf + bondline.
+ *
+ * runTrials() works in blocks of blockSize trials: every random number a block needs is drawn
+ * into flat arrays first, then the ICDs are computed in one pass over them, so the compiler can
+ * keep the inner loops vectorized.  Random numbers come from a xorshift128+ generator seeded from
+ * seed, so a run is repeatable, and the command gives every chunk of trials its own seed, so the
+ * result doesn't depend on how many threads ran it.  Normals are Box-Muller pairs.
+ *
+ * The counts from each chunk are summed with addCounts().  yieldWithLimits() reads the accepted
+ * builds' ICD histogram to give the yield under other ICD limits, with the station's bondline
+ * choice left as it is.
+*/
+
+#include "montecarlo.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Stackup {
+
+static const int blockSize = 1024;
+static const double twoPi = 6.28318530717958647692;
+
+struct Random {
+    unsigned long long s0, s1;
+};
+
+static unsigned long long splitMix( unsigned long long &x ) {
+    unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double uniform( Random &r ) {
+    // xorshift128+, top 53 bits to a double in (0, 1)
+    unsigned long long x = r.s0;
+    unsigned long long y = r.s1;
+    r.s0 = y;
+    x ^= x << 23;
+    r.s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
+    return ((r.s1 + y) >> 11) * (1.0 / 9007199254740992.0) + (0.5 / 9007199254740992.0);
+}
+
+static void fillUniform( Random &r, double *out, int count ) {
+    for (int i = 0; i < count; i++)
+        out[i] = uniform(r);
+}
+
+static void fillNormal( Random &r, double *out, int count ) {
+    // count is even, Box-Muller turns each pair of uniforms into a pair of normals
+    fillUniform(r, out, count);
+    for (int i = 0; i < count; i += 2) {
+        double radius = sqrt(-2.0 * log(out[i]));
+        double angle = twoPi * out[i + 1];
+        out[i] = radius * cos(angle);
+        out[i + 1] = radius * sin(angle);
+    }
+}
+
+static void fillTolerance( Random &r, const Tolerance &t, double *out, int count ) {
+    if (t.shape == Uniform) {
+        fillUniform(r, out, count);
+        for (int i = 0; i < count; i++)
+            out[i] = t.a + (t.b - t.a) * out[i];
+    } else {
+        fillNormal(r, out, count);
+        for (int i = 0; i < count; i++)
+            out[i] = t.a + t.b * out[i];
+    }
+}
+
+static void addNoise( Random &r, double sigma, const double *in, double *out, double *scratch, int count ) {
+    fillNormal(r, scratch, count);
+    for (int i = 0; i < count; i++)
+        out[i] = in[i] + sigma * scratch[i];
+}
+
+void clearCounts( TrialCounts &counts ) {
+    counts.trials = counts.accepted = counts.inSpec = counts.escapes = counts.falseRejects = 0;
+    counts.icdSum = counts.icdSumSquares = 0;
+    for (int i = 0; i < icdBins; i++)
+        counts.histogram[i] = 0;
+}
+
+void addCounts( TrialCounts &total, const TrialCounts &counts ) {
+    total.trials += counts.trials;
+    total.accepted += counts.accepted;
+    total.inSpec += counts.inSpec;
+    total.escapes += counts.escapes;
+    total.falseRejects += counts.falseRejects;
+    total.icdSum += counts.icdSum;
+    total.icdSumSquares += counts.icdSumSquares;
+    for (int i = 0; i < icdBins; i++)
+        total.histogram[i] += counts.histogram[i];
+}
+
+void runTrials( const StackupModel &model, unsigned long long seed, long long trials,
+                TrialCounts &counts ) {
+    Random r;
+    r.s0 = splitMix(seed);
+    r.s1 = splitMix(seed);
+    clearCounts(counts);
+    static const int n = blockSize;
+    double cs[n], fpa[n], cf[n];
+    double csSeen[n], fpaSeen[n], cfSeen[n];
+    double scratch[n], icd[n];
+    while (counts.trials < trials) {
+        int count = int(std::min<long long>(n, trials - counts.trials));
+        fillTolerance(r, model.cs, cs, n);
+        fillTolerance(r, model.fpa, fpa, n);
+        fillTolerance(r, model.cf, cf, n);
+        addNoise(r, model.gaugeSigma, cs, csSeen, scratch, n);
+        addNoise(r, model.gaugeSigma, fpa, fpaSeen, scratch, n);
+        addNoise(r, model.gaugeSigma, cf, cfSeen, scratch, n);
+        fillNormal(r, scratch, n);
+        for (int i = 0; i < count; i++) {
+            BondChoice bond = chooseBondline(cfSeen[i], csSeen[i], fpaSeen[i], model.bondSpec);
+            double bondline = bond.bondline + model.bondlineSigma * scratch[i];
+            icd[i] = fabs(cs[i]) - fabs(fpa[i]) + fabs(cf[i]) + bondline;
+            bool met = icd[i] >= icdMin && icd[i] <= icdMax;
+            if (bond.status == Red) {
+                if (met)
+                    counts.falseRejects++;
+                continue;
+            }
+            counts.accepted++;
+            // about target, so the sums keep their precision over millions of trials
+            counts.icdSum += icd[i] - icdTarget;
+            counts.icdSumSquares += (icd[i] - icdTarget) * (icd[i] - icdTarget);
+            if (met)
+                counts.inSpec++;
+            else
+                counts.escapes++;
+            int bin = int(floor((icd[i] - icdHistogramStart) / icdBinWidth));
+            counts.histogram[std::min(std::max(bin, 0), icdBins - 1)]++;
+        }
+        counts.trials += count;
+    }
+}
+
+double yieldWithLimits( const TrialCounts &counts, double low, double high ) {
+    if (!counts.trials)
+        return 0;
+    // bins entirely inside the limits, good to a bin width
+    long long met = 0;
+    for (int i = 0; i < icdBins; i++) {
+        double binLow = icdHistogramStart + i * icdBinWidth;
+        if (binLow >= low - icdBinWidth / 2 && binLow + icdBinWidth <= high + icdBinWidth / 2)
+            met += counts.histogram[i];
+    }
+    return double(met) / counts.trials;
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "stackupcalc.h"
+
+// Qt-free Monte Carlo tolerance stackup of the coldstack ICD, see montecarlo.cpp
+
+namespace Stackup {
+
+// a part or process contributor: Normal(a = mean, b = sigma) or Uniform(a = low, b = high)
+enum Distribution { Normal, Uniform };
+struct Tolerance {
+    Distribution shape;
+    double a;
+    double b;
+};
+
+struct StackupModel {
+    Tolerance cs;               // coldshield height
+    Tolerance fpa;              // optical centerline
+    Tolerance cf;               // coldfilter thickness
+    double gaugeSigma;          // measurement error on each of the three at the station
+    double bondlineSigma;       // epoxy bondline laid down vs the bondline asked for
+    BondlineSpec bondSpec;
+};
+
+// true ICD of accepted builds, binned around icdTarget, with the tails in the end bins
+const int icdBins = 2000;
+const double icdBinWidth = 0.00001;
+const double icdHistogramStart = icdTarget - icdBins / 2 * icdBinWidth;
+
+struct TrialCounts {
+    long long trials;
+    long long accepted;         // the station found a bondline for the measured parts
+    long long inSpec;           // accepted, and the true ICD met spec
+    long long escapes;          // accepted, but the true ICD missed spec
+    long long falseRejects;     // rejected, though the bondline it came closest with would have met spec
+    double icdSum;              // true ICD of accepted builds, for the mean and sigma
+    double icdSumSquares;
+    long long histogram[icdBins];
+};
+
+void clearCounts( TrialCounts &counts );
+void addCounts( TrialCounts &total, const TrialCounts &counts );
+void runTrials( const StackupModel &model, unsigned long long seed, long long trials,
+                TrialCounts &counts );
+double yieldWithLimits( const TrialCounts &counts, double low, double high );
+
+}
+
+#endif // MONTECARLO_H
@@ -0,0 +1,190 @@
+/* parsebench.cpp contains the StackupTool "bench-parse" command, which times the calculators' old
+ * record loading code against RecordParser on a large synthetic archive.
+ *
+ * run() writes recordCount synthetic build records (all steps saved, same 35 rows as
+ * saveTemplate.csv) to a scratch BuildArchive, reads them all back through a mapped archive, and
+ * then times both parsers over the same records, best of repeats runs each.
+ *
+ * legacyParse() is the loop loadData() used before RecordParser: readLine() per line,
+ * QByteArray::split(',') three times, a QMap of every field, and toDouble() on the way out.
+ *
+ * recordParse() is the current loadData() loop: one RecordParser pass copying every field
+ * straight into a BuildRecord.
+ *
+ * Both return the sum of every numeric field so the work cannot be optimized away and the two
+ * results can be checked against each other.
+*/
+
+#include "parsebench.h"
+#include "buildarchive.h"
+#include "recordparser.h"
+#include "buildrecordio.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QVector>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+// numeric rows of a saved record, 1-based like saveTable
+static const int numericRows[] = { 3, 4, 5, 6, 7, 8, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+                                   21, 22, 23, 24, 25, 26, 28, 29, 30, 31, 32, 33, 34 };
+static const int numericCount = sizeof(numericRows) / sizeof(numericRows[0]);
+
+ParseBench::ParseBench() :
+    recordCount(20000),
+    repeats(3),
+    archivePath(QDir::temp().filePath("bench-archive.dat"))
+{
+    // stand-in for saveTemplate.csv: 35 rows with the step markers in their real positions
+    saveTemplate << "@@@@@";
+    for (int row = 1; row <= 35; row++) {
+        if (row == 9)
+            saveTemplate << "***";
+        else if (row == 20)
+            saveTemplate << "****";
+        else if (row == 27)
+            saveTemplate << "*****";
+        else if (row == 35)
+            saveTemplate << "******";
+        else
+            saveTemplate << QString("Build Field %1%2").arg(row).arg(row % 4 == 0 ? "&" : "");
+    }
+}
+
+int ParseBench::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-n" && !args.isEmpty())
+            recordCount = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-r" && !args.isEmpty())
+            repeats = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+    }
+
+    // build the synthetic archive from scratch each run
+    QFile::remove(archivePath);
+    BuildArchive archive(archivePath);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < recordCount; i++) {
+        QString control = QString::number(Q_INT64_C(2001000000) + i);
+        if (!archive.write(control, syntheticRecord( i ))) {
+            err << "bench-parse: " << archive.errorString() << endl;
+            return 2;
+        }
+    }
+    qint64 writeMs = timer.elapsed();
+
+    timer.restart();
+    if (!archive.map()) {
+        err << "bench-parse: " << archive.errorString() << endl;
+        return 2;
+    }
+    QStringList controls = archive.controls();
+    QList <QByteArray> records;
+    for (int i = 0; i < controls.size(); i++) {
+        QByteArray record;
+        archive.read(controls[i], record);
+        records << record;
+    }
+    archive.unmap();
+    qint64 readMs = timer.elapsed();
+
+    qint64 legacyMs = -1;
+    qint64 parserMs = -1;
+    double legacySum = 0;
+    double parserSum = 0;
+    for (int run = 0; run < repeats; run++) {
+        timer.restart();
+        legacySum = legacyParse( records );
+        qint64 ms = timer.elapsed();
+        if (legacyMs < 0 || ms < legacyMs)
+            legacyMs = ms;
+        timer.restart();
+        parserSum = recordParse( records );
+        ms = timer.elapsed();
+        if (parserMs < 0 || ms < parserMs)
+            parserMs = ms;
+    }
+
+    out << "records:            " << records.size() << endl
+        << "archive write:      " << writeMs << " ms" << endl
+        << "archive read:       " << readMs << " ms" << endl
+        << "legacy split/QMap:  " << legacyMs << " ms" << endl
+        << "RecordParser:       " << parserMs << " ms" << endl;
+    if (parserMs > 0)
+        out << "speedup:            " << QString::number(double(legacyMs) / parserMs, 'f', 1) << "x" << endl;
+    if (QString::number(legacySum, 'f', 4) != QString::number(parserSum, 'f', 4)) {
+        err << "bench-parse: parsers disagree, " << QString::number(legacySum, 'f', 4)
+            << " vs " << QString::number(parserSum, 'f', 4) << endl;
+        return 2;
+    }
+    QFile::remove(archivePath);
+    return 0;
+}
+
+QByteArray ParseBench::syntheticRecord( int index ) {
+    QByteArray record;
+    QTextStream stream(&record, QIODevice::WriteOnly);
+    QVector <QString> values(36);
+    values[1] = QString::number(Q_INT64_C(2001000000) + index);
+    values[2] = QString("%1").arg(index % 1000, 3, 10, QChar('0'));
+    // spread the measurements a little so no two records are identical
+    double jitter = (index % 97) * 0.0001;
+    for (int i = 0; i < numericCount; i++)
+        values[numericRows[i]] = QString::number(0.5 + numericRows[i] * 0.1 + jitter, 'f', 4);
+    for (int row = 1; row <= 35; row++) {
+        QString value = values[row];
+        if (row == 9 || row == 20 || row == 27 || row == 35)
+            value = saveTemplate[row];
+        stream << saveTemplate[row] << ",\t" << value << endl;
+    }
+    stream.flush();
+    return record;
+}
+
+double ParseBench::legacyParse( const QList <QByteArray> &records ) {
+    double total = 0;
+    QList <QString> saveTable = saveTemplate;
+    for (int r = 0; r < records.size(); r++) {
+        QByteArray record = records[r];
+        QBuffer buffer(&record);
+        buffer.open(QIODevice::ReadOnly);
+        QMap <QString, QString> data;
+        int counter = 1;
+        while (!buffer.atEnd()) {
+            QByteArray line = buffer.readLine();
+            data.insert(line.split(',').first(), line.split(',').last().trimmed());
+            saveTable[counter++] = line.split(',').last().trimmed();
+        }
+        buffer.close();
+        for (int i = 0; i < numericCount; i++)
+            total += data.value(saveTemplate[numericRows[i]]).toDouble();
+    }
+    return total;
+}
+
+double ParseBench::recordParse( const QList <QByteArray> &records ) {
+    double total = 0;
+    BuildRecord buildRecord;
+    for (int r = 0; r < records.size(); r++) {
+        const QByteArray &record = records[r];
+        RecordParser parser(record.constData(), record.size());
+        BuildRecordIO::load( parser, buildRecord );
+        for (int i = 0; i < numericCount; i++) {
+            // the coldshield bondline is kept as its combo box text
+            const BuildRecordField &f = buildRecordFields[numericRows[i]];
+            if (f.type == RecordNumber)
+                total += buildRecord.*f.number;
+            else
+                total += (buildRecord.*f.text).toDouble();
+        }
+    }
+    return total;
+}
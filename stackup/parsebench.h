@@ -0,0 +1,25 @@
+#ifndef PARSEBENCH_H
+#define PARSEBENCH_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QByteArray>
+
+class ParseBench
+{
+public:
+    ParseBench();
+    int run( QStringList );
+
+private:
+    int recordCount;
+    int repeats;
+    QString archivePath;
+    QList <QString> saveTemplate;
+    QByteArray syntheticRecord( int );
+    double legacyParse( const QList <QByteArray> & );
+    double recordParse( const QList <QByteArray> & );
+};
+
+#endif // PARSEBENCH_H
@@ -0,0 +1,111 @@
+/* PhrCache class is shared code used by ProteusLookup to keep PHR dataform replies on the local
+ * disk, so loading a dewar that was loaded recently does not wait on sbfdb again, and a load
+ * still gets its PHR check when Proteus is slow or down.
+ *
+ * Each entry is one file, <control>-<dataform>.phr, in the cache directory:
+ *   line 1   "PHR1 <fetched, ms since epoch> <ETag> <Last-Modified>", "-" for a missing validator
+ *   rest     the reply text exactly as Proteus sent it
+ * The fetched time is what ProteusLookup compares against its TTL.  The validators are sent back
+ * on the next request so Proteus can answer 304 Not Modified instead of the whole dataform.
+ *
+ * write() goes to a .tmp file first and renames it over the entry, so a crash never leaves a
+ * half-written reply to be checked against.  touch() re-stamps an entry after a 304.
+ *
+ * prune() deletes entries older than maxAgeSecs, which keeps the cache bounded.  ProteusLookup
+ * calls it once at startup.
+*/
+
+#include "phrcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+static const char entryMagic[] = "PHR1";
+
+static QByteArray validator( const QByteArray &value ) {
+    // validators are single header values, keep them on one line and never empty
+    QByteArray v = value.simplified();
+    v.replace(' ', "%20");
+    return v.isEmpty() ? QByteArray("-") : v;
+}
+
+static QByteArray unvalidator( const QByteArray &value ) {
+    QByteArray v = value;
+    v.replace("%20", " ");
+    return v == "-" ? QByteArray() : v;
+}
+
+PhrCache::PhrCache( const QString &dirPath ) :
+    dirPath(dirPath)
+{
+    QDir().mkpath(dirPath);
+}
+
+bool PhrCache::read( const QString &control, int dataform, PhrEntry &entry ) const {
+    QFile file(fileName(control, dataform));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QList <QByteArray> header = file.readLine().trimmed().split(' ');
+    if (header.size() != 4 || header[0] != entryMagic)
+        return false;
+    bool ok;
+    qint64 fetched = header[1].toLongLong(&ok);
+    if (!ok)
+        return false;
+    entry.fetched = QDateTime::fromMSecsSinceEpoch(fetched);
+    entry.etag = unvalidator(header[2]);
+    entry.lastModified = unvalidator(header[3]);
+    entry.text = QString(file.readAll());
+    return true;
+}
+
+bool PhrCache::write( const QString &control, int dataform, const PhrEntry &entry ) {
+    QString target = fileName(control, dataform);
+    QFile file(target + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QByteArray header = QByteArray(entryMagic) + ' '
+            + QByteArray::number(entry.fetched.toMSecsSinceEpoch()) + ' '
+            + validator(entry.etag) + ' ' + validator(entry.lastModified) + '\n';
+    bool ok = file.write(header) == header.size();
+    QByteArray text = entry.text.toLatin1();
+    ok = ok && file.write(text) == text.size();
+    file.close();
+    // rename() won't replace on Windows, so the old entry goes first
+    QFile::remove(target);
+    if (!ok || !QFile::rename(file.fileName(), target)) {
+        QFile::remove(file.fileName());
+        return false;
+    }
+    return true;
+}
+
+bool PhrCache::touch( const QString &control, int dataform ) {
+    PhrEntry entry;
+    if (!read(control, dataform, entry))
+        return false;
+    entry.fetched = QDateTime::currentDateTime();
+    return write(control, dataform, entry);
+}
+
+int PhrCache::prune( int maxAgeSecs ) {
+    QDir dir(dirPath);
+    QDateTime oldest = QDateTime::currentDateTime().addSecs(-maxAgeSecs);
+    QFileInfoList files = dir.entryInfoList(QStringList() << "*.phr" << "*.tmp", QDir::Files);
+    int removed = 0;
+    for (int i = 0; i < files.size(); i++) {
+        if (files[i].lastModified() < oldest && QFile::remove(files[i].filePath()))
+            removed++;
+    }
+    return removed;
+}
+
+QString PhrCache::path() const {
+    return dirPath;
+}
+
+QString PhrCache::fileName( const QString &control, int dataform ) const {
+    return QDir(dirPath).filePath(QString("%1-%2.phr").arg(control).arg(dataform));
+}
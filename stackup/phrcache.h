@@ -0,0 +1,32 @@
+#ifndef PHRCACHE_H
+#define PHRCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+
+// one cached dataFormResult reply, with the validators Proteus sent along with it
+struct PhrEntry {
+    QString text;
+    QDateTime fetched;
+    QByteArray etag;
+    QByteArray lastModified;
+};
+
+// PhrCache keeps Proteus dataform replies on the station's disk, see phrcache.cpp
+class PhrCache
+{
+public:
+    explicit PhrCache( const QString &dirPath );
+    bool read( const QString &control, int dataform, PhrEntry &entry ) const;
+    bool write( const QString &control, int dataform, const PhrEntry &entry );
+    bool touch( const QString &control, int dataform );
+    int prune( int maxAgeSecs );
+    QString path() const;
+
+private:
+    QString dirPath;
+    QString fileName( const QString &, int ) const;
+};
+
+#endif // PHRCACHE_H
@@ -0,0 +1,34 @@
+#ifndef PHRREPLY_H
+#define PHRREPLY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+// every "key = value" field of one dataFormResult reply, see phrreply.cpp
+class PhrReply
+{
+public:
+    PhrReply();
+    explicit PhrReply( const QString &text );
+    bool contains( const QString &key ) const;
+    QString value( const QString &key ) const;
+    QStringList keys() const;
+    int size() const;
+    QString rawText() const;
+
+private:
+    struct Span {
+        int start;
+        int length;
+    };
+    QString text;
+    QVector <Span> keySpans;
+    QVector <Span> valueSpans;
+    QHash <QString, int> index;
+    void parse();
+    void addField( int, int, int, int );
+};
+
+#endif // PHRREPLY_H
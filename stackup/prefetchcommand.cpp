@@ -0,0 +1,72 @@
+/* prefetchcommand.cpp contains the StackupTool "prefetch" command, which fills a station's PHR
+ * cache with dataforms 1061 and 1065 for a list of control numbers before the shift scans them.
+ *
+ * Control numbers come from the command line, from -f files (one or more per line, as pasted from
+ * a schedule or wanded into a text file) and from standard input with -f -.  Server and cache
+ * settings are read from control/proteus.ini, or the file given with -i, so run it from the
+ * calculators' directory to warm the cache they read.  See PhrPrefetch.
+*/
+
+#include "prefetchcommand.h"
+
+#include <QFile>
+#include <QTextStream>
+
+PrefetchCommand::PrefetchCommand()
+{
+    prefetch = new PhrPrefetch(this);
+    connect(prefetch, SIGNAL(progress(int,int)), this, SLOT(showProgress(int,int)));
+    connect(prefetch, SIGNAL(finished()), &loop, SLOT(quit()));
+}
+
+int PrefetchCommand::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QString text;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-c" && !args.isEmpty()) {
+            prefetch->concurrent = qMax(1, args.takeFirst().toInt());
+        } else if (arg == "-i" && !args.isEmpty()) {
+            prefetch->client->loadSettings(args.takeFirst());
+        } else if (arg == "-u" && !args.isEmpty()) {
+            prefetch->client->baseUrl = args.takeFirst();
+        } else if (arg == "-f" && !args.isEmpty()) {
+            QString path = args.takeFirst();
+            QFile file(path);
+            bool opened = path == "-" ? file.open(stdin, QIODevice::ReadOnly)
+                                      : file.open(QIODevice::ReadOnly | QIODevice::Text);
+            if (!opened) {
+                err << "prefetch: unable to read " << path << endl;
+                return 2;
+            }
+            text += QString::fromLatin1(file.readAll()) + "\n";
+        } else {
+            text += arg + "\n";
+        }
+    }
+    QStringList controls = PhrPrefetch::parseControls(text);
+    if (controls.isEmpty()) {
+        err << "prefetch: no control numbers given" << endl;
+        return 1;
+    }
+    if (prefetch->client->cacheDir().isEmpty()) {
+        err << "prefetch: the PHR cache is turned off in proteus.ini, nothing to prefetch into" << endl;
+        return 1;
+    }
+
+    out << "prefetching " << controls.size() << " control numbers into "
+        << prefetch->client->cacheDir() << endl;
+    prefetch->start(controls);
+    // everything may already be cached, in which case finished() has come and gone
+    if (prefetch->isRunning())
+        loop.exec();
+    err << endl;
+    out << prefetch->summary() << endl;
+    return prefetch->failed ? 1 : 0;
+}
+
+void PrefetchCommand::showProgress( int done, int total ) {
+    QTextStream err(stderr);
+    err << "\r" << done << "/" << total << flush;
+}
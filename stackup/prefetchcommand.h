@@ -0,0 +1,27 @@
+#ifndef PREFETCHCOMMAND_H
+#define PREFETCHCOMMAND_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QEventLoop>
+
+#include "phrprefetch.h"
+
+class PrefetchCommand : public QObject
+{
+    Q_OBJECT
+
+public:
+    PrefetchCommand();
+    int run( QStringList );
+
+private slots:
+    void showProgress( int, int );
+
+private:
+    PhrPrefetch *prefetch;
+    QEventLoop loop;
+};
+
+#endif // PREFETCHCOMMAND_H
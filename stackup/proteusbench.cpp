@@ -0,0 +1,199 @@
+/* proteusbench.cpp contains the StackupTool "bench-proteus" command, which measures how long a
+ * calculator waits between loading a control number and having both of its PHR checks done.
+ *
+ * run() points a ProteusClient at -u, or at a ProteusStandIn started in this process when no url
+ * is given, and simulates loadCount loadData() calls with at most concurrent of them in flight.
+ * Each load fetches dataforms 1061 and 1065 and looks up the field ProteusLookup checks; its
+ * latency runs from the first fetch until both dataforms are checked, failed or found empty.
+ *
+ * Loads cycle through controlCount control numbers.  The PHR cache is off unless --cache is
+ * given, in which case a scratch cache is used and loads after the first pass through the
+ * controls measure cache hits.
+ *
+ * The report gives p50, p90, p99, max and mean latency over every load, and how many loads were
+ * verified, failed, found no data, fell back to a stale cached copy or were missing the field.
+*/
+
+#include "proteusbench.h"
+
+#include <QDir>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <qmath.h>
+
+ProteusBench::ProteusBench() :
+    loadCount(200),
+    concurrent(1),
+    controlCount(0),
+    useCache(false),
+    standIn(0),
+    client(0),
+    started(0),
+    okCount(0),
+    failedCount(0),
+    noDataCount(0),
+    staleCount(0),
+    mismatchCount(0)
+{
+}
+
+int ProteusBench::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    standIn = new ProteusStandIn(this);
+    // a station on the plant network sees a few tens of ms per dataform
+    standIn->latencyMs = 20;
+    standIn->jitterMs = 10;
+    int timeoutMs = 15000;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-n" && !args.isEmpty())
+            loadCount = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-c" && !args.isEmpty())
+            concurrent = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-k" && !args.isEmpty())
+            controlCount = qMax(1, args.takeFirst().toInt());
+        else if (arg == "-u" && !args.isEmpty())
+            url = args.takeFirst();
+        else if (arg == "-w" && !args.isEmpty())
+            timeoutMs = qMax(1, args.takeFirst().toInt());
+        else if (arg == "--cache")
+            useCache = true;
+        else if (!standIn->parseOption(arg, args))
+            err << "bench-proteus: ignoring " << arg << endl;
+    }
+    // two loads of one control in flight at once would share one entry in inFlight
+    if (!controlCount)
+        controlCount = loadCount;
+    controlCount = qMax(controlCount, concurrent);
+
+    if (url.isEmpty()) {
+        if (!standIn->listen()) {
+            err << "bench-proteus: unable to start the stand-in: " << standIn->errorString() << endl;
+            return 2;
+        }
+        url = standIn->url();
+    }
+    client = new ProteusClient(this);
+    client->baseUrl = url;
+    client->timeoutMs = timeoutMs;
+    QString cachePath = QDir::temp().filePath("bench-phrcache");
+    if (useCache) {
+        // start cold, so the first pass through the controls goes to the server
+        QDir cacheDir(cachePath);
+        QStringList stale = cacheDir.entryList(QDir::Files);
+        for (int i = 0; i < stale.size(); i++)
+            cacheDir.remove(stale[i]);
+        client->setCacheDir(cachePath);
+    }
+    connect(client, SIGNAL(replyReady(QString,int,PhrReply)), this,
+            SLOT(replyReady(QString,int,PhrReply)));
+    connect(client, SIGNAL(staleReply(QString,int,QString,QDateTime)), this,
+            SLOT(staleReply(QString,int,QString,QDateTime)));
+    connect(client, SIGNAL(noData(QString,int)), this, SLOT(noData(QString,int)));
+    connect(client, SIGNAL(fetchFailed(QString,int,QString)), this,
+            SLOT(fetchFailed(QString,int,QString)));
+
+    QElapsedTimer wall;
+    wall.start();
+    startLoads();
+    loop.exec();
+    qint64 wallMs = wall.elapsed();
+
+    qSort(latencies);
+    double total = 0;
+    for (int i = 0; i < latencies.size(); i++)
+        total += latencies[i];
+    out << "server:             " << url << endl
+        << "loads:              " << latencies.size() << " (" << concurrent << " at a time, "
+        << controlCount << " controls, cache " << (useCache ? "on" : "off") << ")" << endl
+        << "wall time:          " << wallMs << " ms" << endl
+        << "p50:                " << QString::number(percentile(latencies, 0.50), 'f', 1) << " ms" << endl
+        << "p90:                " << QString::number(percentile(latencies, 0.90), 'f', 1) << " ms" << endl
+        << "p99:                " << QString::number(percentile(latencies, 0.99), 'f', 1) << " ms" << endl
+        << "max:                " << QString::number(latencies.isEmpty() ? 0 : latencies.last(), 'f', 1) << " ms" << endl
+        << "mean:               " << QString::number(latencies.isEmpty() ? 0 : total / latencies.size(), 'f', 1) << " ms" << endl
+        << "verified:           " << okCount << endl
+        << "failed:             " << failedCount << endl
+        << "no data:            " << noDataCount << endl
+        << "stale cache:        " << staleCount << endl
+        << "field missing:      " << mismatchCount << endl;
+    if (standIn->served)
+        out << "stand-in requests:  " << standIn->served << endl;
+    if (useCache)
+        out << "cache:              " << cachePath << endl;
+    return failedCount + mismatchCount ? 1 : 0;
+}
+
+void ProteusBench::startLoads( ) {
+    while (started < loadCount && inFlight.size() < concurrent) {
+        QString control = controlName(started++ % controlCount);
+        BenchLoad load;
+        load.remaining = 2;
+        load.failed = false;
+        load.noData = false;
+        load.stale = false;
+        load.started.start();
+        inFlight.insert(control, load);
+        client->fetch(control, 1061);
+        client->fetch(control, 1065);
+    }
+    if (inFlight.isEmpty())
+        loop.quit();
+}
+
+void ProteusBench::dataformDone( const QString &control, bool ok ) {
+    if (!inFlight.contains(control))
+        return;
+    BenchLoad &load = inFlight[control];
+    if (!ok)
+        load.failed = true;
+    if (--load.remaining > 0)
+        return;
+    latencies << double(load.started.elapsed());
+    if (load.noData)
+        noDataCount++;
+    else if (load.failed)
+        failedCount++;
+    else
+        okCount++;
+    if (load.stale)
+        staleCount++;
+    inFlight.remove(control);
+    startLoads();
+}
+
+void ProteusBench::replyReady( const QString &control, int dataform, const PhrReply &reply ) {
+    // the same check ProteusLookup::checkFetchedText() makes
+    bool ok = reply.contains(ProteusStandIn::fieldKey(dataform));
+    if (!ok)
+        mismatchCount++;
+    dataformDone(control, ok);
+}
+
+void ProteusBench::staleReply( const QString &control, int, const QString &, const QDateTime & ) {
+    // replyReady follows with the cached copy
+    if (inFlight.contains(control))
+        inFlight[control].stale = true;
+}
+
+void ProteusBench::noData( const QString &control, int ) {
+    if (inFlight.contains(control))
+        inFlight[control].noData = true;
+    dataformDone(control, false);
+}
+
+void ProteusBench::fetchFailed( const QString &control, int, const QString & ) {
+    dataformDone(control, false);
+}
+
+QString ProteusBench::controlName( int index ) {
+    return QString("B%1").arg(2001000000 + index);
+}
+
+double ProteusBench::percentile( const QList <double> &sorted, double p ) {
+    if (sorted.isEmpty())
+        return 0;
+    int rank = qMax(1, int(qCeil(p * sorted.size())));
+    return sorted[qMin(rank, sorted.size()) - 1];
+}
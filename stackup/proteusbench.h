@@ -0,0 +1,61 @@
+#ifndef PROTEUSBENCH_H
+#define PROTEUSBENCH_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QList>
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+#include "proteusclient.h"
+#include "proteusstandin.h"
+
+// one simulated loadData(), done when both of its dataforms have been checked
+struct BenchLoad {
+    QElapsedTimer started;
+    int remaining;
+    bool failed;
+    bool noData;
+    bool stale;
+};
+
+class ProteusBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    ProteusBench();
+    int run( QStringList );
+
+private slots:
+    void replyReady( const QString &, int, const PhrReply & );
+    void staleReply( const QString &, int, const QString &, const QDateTime & );
+    void noData( const QString &, int );
+    void fetchFailed( const QString &, int, const QString & );
+
+private:
+    int loadCount;
+    int concurrent;
+    int controlCount;
+    bool useCache;
+    QString url;
+    ProteusStandIn *standIn;
+    ProteusClient *client;
+    QEventLoop loop;
+    QMap <QString, BenchLoad> inFlight;
+    QList <double> latencies;
+    int started;
+    int okCount;
+    int failedCount;
+    int noDataCount;
+    int staleCount;
+    int mismatchCount;
+    void startLoads( );
+    void dataformDone( const QString &, bool ok );
+    static QString controlName( int );
+    static double percentile( const QList <double> &, double );
+};
+
+#endif // PROTEUSBENCH_H
@@ -0,0 +1,69 @@
+#ifndef PROTEUSCLIENT_H
+#define PROTEUSCLIENT_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QMap>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+#include "phrcache.h"
+#include "phrreply.h"
+
+// one dataform request, keyed by its reply in ProteusClient::pending
+struct ProteusFetch {
+    QString control;
+    int dataform;
+    bool timedOut;
+    bool oversize;
+    bool cached;
+    PhrEntry entry;
+};
+
+// ProteusClient fetches PHR dataforms from Proteus without any UI, see proteusclient.cpp
+class ProteusClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProteusClient( QObject *parent = 0 );
+    ~ProteusClient();
+    QString baseUrl;
+    int timeoutMs;
+    qint64 maxReplyBytes;
+    int cacheTtlSecs;
+    int cacheMaxAgeSecs;
+    void loadSettings( const QString &path );
+    void setCacheDir( const QString &path );
+    QString cacheDir() const;
+    bool isCached( const QString &control, int dataform ) const;
+    void fetch( const QString &control, int dataform );
+    void cancel( );
+    int pendingCount() const;
+
+signals:
+    // the dataform's fields, from Proteus or the cache
+    void replyReady( const QString &control, int dataform, const PhrReply &reply );
+    // Proteus could not be reached, replyReady follows with the copy cached at that time
+    void staleReply( const QString &control, int dataform, const QString &reason, const QDateTime &fetched );
+    void noData( const QString &control, int dataform );
+    void fetchFailed( const QString &control, int dataform, const QString &reason );
+
+private slots:
+    void replyFinished( QNetworkReply * );
+    void fetchTimedOut( );
+    void fetchProgress( qint64, qint64 );
+    void deliverCached( );
+
+private:
+    QNetworkAccessManager *manager;
+    PhrCache *cache;
+    QMap <QNetworkReply*, ProteusFetch> pending;
+    QList <ProteusFetch> cacheHits;
+};
+
+#endif // PROTEUSCLIENT_H
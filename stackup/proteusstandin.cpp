@@ -0,0 +1,217 @@
+/* proteusstandin.cpp contains the StackupTool "proteus-standin" command, a local HTTP server that
+ * stands in for http://sbfdb/proteus/application/admin.php so ProteusLookup can be measured and
+ * exercised off the plant network.  Point a station at it with url in the [server] section of
+ * control/proteus.ini, e.g. url=http://localhost:8177/proteus/application/admin.php
+ *
+ * respond() answers any GET carrying controlNbr and dataForm query items, whatever the path.  The
+ * reply body is read from <responseDir>/<control>-<dataform>.txt when a recorded reply exists, so
+ * real dataFormResult pages can be replayed; otherwise a reply with the dataform's checked field
+ * (fieldKey()) and a value derived from the control number is made up.  The made-up reply runs
+ * each value straight into the next key, with no markup in between, the way the calculators'
+ * original extraction (read the value up to the next 'M') expected Proteus pages to look.  Replies carry an ETag and
+ * honor If-None-Match, so the PHR cache's revalidation can be exercised too.
+ *
+ * Each request waits latencyMs, plus up to jitterMs, before it is answered.  Then, at random,
+ * errorRate of requests get a 500, noDataRate get Proteus' "No data found" page and hangRate are
+ * never answered at all, which is what trips a client's deadline.
+ *
+ * StandInConnection keeps HTTP/1.1 connections open and answers their requests in order, as a
+ * QNetworkAccessManager reuses them.
+*/
+
+#include "proteusstandin.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+#include <QTextStream>
+#include <QCoreApplication>
+
+ProteusStandIn::ProteusStandIn( QObject *parent ) :
+    QObject(parent),
+    latencyMs(0),
+    jitterMs(0),
+    errorRate(0),
+    noDataRate(0),
+    hangRate(0),
+    served(0)
+{
+    server = new QTcpServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+bool ProteusStandIn::parseOption( const QString &arg, QStringList &args ) {
+    // options shared with bench-proteus, which starts its own stand-in
+    if (args.isEmpty())
+        return false;
+    if (arg == "-r")
+        responseDir = args.takeFirst();
+    else if (arg == "-l")
+        latencyMs = qMax(0, args.takeFirst().toInt());
+    else if (arg == "-j")
+        jitterMs = qMax(0, args.takeFirst().toInt());
+    else if (arg == "-e")
+        errorRate = args.takeFirst().toDouble();
+    else if (arg == "-d")
+        noDataRate = args.takeFirst().toDouble();
+    else if (arg == "-t")
+        hangRate = args.takeFirst().toDouble();
+    else if (arg == "-s")
+        qsrand(args.takeFirst().toUInt());
+    else
+        return false;
+    return true;
+}
+
+bool ProteusStandIn::listen( quint16 port ) {
+    return server->listen(QHostAddress::LocalHost, port);
+}
+
+QString ProteusStandIn::url() const {
+    return QString("http://127.0.0.1:%1/proteus/application/admin.php").arg(server->serverPort());
+}
+
+QString ProteusStandIn::errorString() const {
+    return server->errorString();
+}
+
+int ProteusStandIn::run( QStringList args ) {
+    QTextStream err(stderr);
+    quint16 port = 8177;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-p" && !args.isEmpty())
+            port = quint16(args.takeFirst().toUInt());
+        else if (!parseOption(arg, args))
+            err << "proteus-standin: ignoring " << arg << endl;
+    }
+    if (!listen(port)) {
+        err << "proteus-standin: unable to listen on port " << port << ": " << errorString() << endl;
+        return 1;
+    }
+    err << "serving " << url() << ", latency " << latencyMs << "+" << jitterMs << " ms" << endl;
+    return QCoreApplication::exec();
+}
+
+QString ProteusStandIn::fieldKey( int dataform ) {
+    // the field ProteusLookup::checkFetchedText() verifies for each dataform
+    switch (dataform) {
+    case 1061: return "MPPStepMountFPAMB_DATAFORM1061_Datum__dash_A_dash__to_Optical_Center_Height";
+    case 1065: return "MPPStepMountColdshield_DATAFORM1065_Datum__dash_A_dash__to_Coldshield_Pedestal__leftParen_CURE_rightParen_";
+    default: return QString("MPPStep_DATAFORM%1_Value").arg(dataform);
+    }
+}
+
+void ProteusStandIn::newConnection( ) {
+    while (server->hasPendingConnections()) {
+        QTcpSocket *socket = server->nextPendingConnection();
+        // the connection object lives as long as its socket
+        new StandInConnection(this, socket);
+    }
+}
+
+static bool chance( double rate ) {
+    return rate > 0 && qrand() < rate * (double(RAND_MAX) + 1);
+}
+
+QByteArray ProteusStandIn::respond( const QByteArray &request, bool &hang ) {
+    hang = false;
+    served++;
+    // "GET /proteus/application/admin.php?page=...&controlNbr=C...&dataForm=1061 HTTP/1.1"
+    QList <QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    QByteArray target = requestLine.size() > 1 ? requestLine[1] : QByteArray();
+    QString control;
+    int dataform = 0;
+    QList <QByteArray> items = target.mid(target.indexOf('?') + 1).split('&');
+    for (int i = 0; i < items.size(); i++) {
+        if (items[i].startsWith("controlNbr="))
+            control = QString::fromLatin1(items[i].mid(11));
+        else if (items[i].startsWith("dataForm="))
+            dataform = items[i].mid(9).toInt();
+    }
+    QByteArray ifNoneMatch;
+    QList <QByteArray> lines = request.split('\n');
+    for (int i = 1; i < lines.size(); i++) {
+        if (lines[i].toLower().startsWith("if-none-match:"))
+            ifNoneMatch = lines[i].mid(14).trimmed();
+    }
+
+    QByteArray status = "200 OK";
+    QByteArray body;
+    QByteArray etag;
+    if (chance(hangRate)) {
+        hang = true;
+        return QByteArray();
+    } else if (control.isEmpty() || !dataform) {
+        status = "400 Bad Request";
+        body = "controlNbr and dataForm are required";
+    } else if (chance(errorRate)) {
+        status = "500 Internal Server Error";
+        body = "stand-in error";
+    } else if (chance(noDataRate)) {
+        body = "No data found";
+    } else {
+        body = replyText(control, dataform);
+        etag = '"' + QByteArray::number(qChecksum(body.constData(), body.size())) + '"';
+        if (ifNoneMatch == etag) {
+            status = "304 Not Modified";
+            body.clear();
+        }
+    }
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+            "Content-Type: text/html\r\n"
+            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            "Connection: keep-alive\r\n";
+    if (!etag.isEmpty())
+        response += "ETag: " + etag + "\r\n";
+    return response + "\r\n" + body;
+}
+
+QByteArray ProteusStandIn::replyText( const QString &control, int dataform ) {
+    if (!responseDir.isEmpty()) {
+        QFile recorded(QDir(responseDir).filePath(QString("%1-%2.txt").arg(control).arg(dataform)));
+        if (recorded.open(QIODevice::ReadOnly))
+            return recorded.readAll();
+    }
+    // made up, but stable per control number so repeated loads see the same PHR
+    double value = 0.0100 + (qHash(control) % 50) * 0.0001;
+    QByteArray text;
+    text += "MPPStep_DATAFORM" + QByteArray::number(dataform) + "_Control = " + control.toLatin1();
+    text += fieldKey(dataform).toLatin1() + " = " + QByteArray::number(value, 'f', 4);
+    text += "MPPStep_DATAFORM" + QByteArray::number(dataform) + "_Operator = standin";
+    return text;
+}
+
+StandInConnection::StandInConnection( ProteusStandIn *standIn, QTcpSocket *socket ) :
+    QObject(socket),
+    standIn(standIn),
+    socket(socket),
+    busy(false)
+{
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+}
+
+void StandInConnection::readRequest( ) {
+    buffer += socket->readAll();
+    // one request at a time, the next is read once this one is answered
+    int end = buffer.indexOf("\r\n\r\n");
+    if (busy || end < 0)
+        return;
+    QByteArray request = buffer.left(end + 4);
+    buffer.remove(0, end + 4);
+    bool hang;
+    response = standIn->respond(request, hang);
+    if (hang)
+        return;
+    busy = true;
+    int delay = standIn->latencyMs + (standIn->jitterMs ? qrand() % (standIn->jitterMs + 1) : 0);
+    QTimer::singleShot(delay, this, SLOT(sendResponse()));
+}
+
+void StandInConnection::sendResponse( ) {
+    socket->write(response);
+    busy = false;
+    if (buffer.contains("\r\n\r\n"))
+        readRequest();
+}
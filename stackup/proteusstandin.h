@@ -0,0 +1,62 @@
+#ifndef PROTEUSSTANDIN_H
+#define PROTEUSSTANDIN_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// ProteusStandIn answers dataFormResult requests like Proteus does, see proteusstandin.cpp
+class ProteusStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProteusStandIn( QObject *parent = 0 );
+    QString responseDir;
+    int latencyMs;
+    int jitterMs;
+    double errorRate;
+    double noDataRate;
+    double hangRate;
+    int served;
+    bool parseOption( const QString &, QStringList & );
+    bool listen( quint16 port = 0 );
+    QString url() const;
+    QString errorString() const;
+    int run( QStringList );
+    static QString fieldKey( int dataform );
+
+private slots:
+    void newConnection( );
+
+private:
+    QTcpServer *server;
+    friend class StandInConnection;
+    QByteArray respond( const QByteArray &request, bool &hang );
+    QByteArray replyText( const QString &control, int dataform );
+};
+
+// one client connection, requests on it are answered in order after the stand-in's latency
+class StandInConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    StandInConnection( ProteusStandIn *, QTcpSocket * );
+
+private slots:
+    void readRequest( );
+    void sendResponse( );
+
+private:
+    ProteusStandIn *standIn;
+    QTcpSocket *socket;
+    QByteArray buffer;
+    QByteArray response;
+    bool busy;
+};
+
+#endif // PROTEUSSTANDIN_H
@@ -0,0 +1,175 @@
+/* querycommand.cpp contains the StackupTool "query" command, which answers a RecordQuery over every
+ * dewar in the summary index (-x, rebuilt from the archive -a when stale), e.g.
+ *     StackupTool query "cfParallelism > 0.0025 and cfBondline = 0.0030 and saved >= -90d"
+ * The words after the options make up the query, so it only needs quoting for the shell's sake.
+ *
+ * By default the matching control numbers are printed one per line, for xargs or a wand list.
+ * -c field,field,... prints those fields of each match from the index as .csv instead, and -r
+ * streams each match's full record out of the archive in its .csv form, one record after another
+ * the way get does.  stderr gets how many matched and how long the index load and the query took.
+*/
+
+#include "querycommand.h"
+#include "recordquery.h"
+#include "summaryindex.h"
+#include "buildarchive.h"
+#include "buildrecordio.h"
+
+#include <QFile>
+#include <QDateTime>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+// one -c column: where it lives in SummaryColumns and how it prints
+struct QueryColumn {
+    enum Kind { Control, Serial, Saved, Step, Number, Text } kind;
+    int index;
+    int decimals;
+};
+
+static bool findColumn( const QString &name, QueryColumn &column ) {
+    column.index = 0;
+    column.decimals = 0;
+    if (name.compare("saved", Qt::CaseInsensitive) == 0) {
+        column.kind = QueryColumn::Saved;
+        return true;
+    }
+    for (int row = 1; row <= BuildRecord::RowCount; row++) {
+        const BuildRecordField &f = buildRecordFields[row];
+        if (name.compare(QLatin1String(f.name), Qt::CaseInsensitive) != 0)
+            continue;
+        if (row == BuildRecord::RowControl) {
+            column.kind = QueryColumn::Control;
+        } else if (row == BuildRecord::RowSerial) {
+            column.kind = QueryColumn::Serial;
+        } else if (f.type == RecordNumber) {
+            column.kind = QueryColumn::Number;
+            column.index = SummaryIndex::numberRows().indexOf(row);
+            column.decimals = f.decimals;
+        } else if (f.type == RecordText) {
+            column.kind = QueryColumn::Text;
+            column.index = SummaryIndex::textRows().indexOf(row);
+        } else {
+            // step markers print as the step bit they stand for
+            column.kind = QueryColumn::Step;
+            column.index = row == BuildRecord::RowMotherboardSaved ? SummaryIndex::MotherboardStep
+                    : row == BuildRecord::RowColdshieldSaved ? SummaryIndex::ColdshieldStep
+                    : row == BuildRecord::RowColdfilter1Saved ? SummaryIndex::Coldfilter1Step
+                    : SummaryIndex::Coldfilter2Step;
+        }
+        return true;
+    }
+    return false;
+}
+
+static QString columnText( const SummaryColumns &columns, const QueryColumn &column, int i ) {
+    switch (column.kind) {
+    case QueryColumn::Control:
+        return columns.control[i];
+    case QueryColumn::Serial:
+        return columns.serial[i];
+    case QueryColumn::Saved:
+        return columns.saved[i] ? QDateTime::fromTime_t(columns.saved[i]).toString(Qt::ISODate) : QString();
+    case QueryColumn::Step:
+        return (columns.steps[i] & column.index) ? "true" : "false";
+    case QueryColumn::Number:
+        return BuildRecordIO::numberText( columns.numbers[column.index][i], column.decimals );
+    case QueryColumn::Text:
+        return columns.texts[column.index][i];
+    }
+    return QString();
+}
+
+QueryCommand::QueryCommand() :
+    indexPath("control/summary.dat"),
+    archivePath("control/archive.dat")
+{
+}
+
+int QueryCommand::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    bool records = false;
+    QStringList fields;
+    QStringList words;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-x" && !args.isEmpty())
+            indexPath = args.takeFirst();
+        else if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "-c" && !args.isEmpty())
+            fields = args.takeFirst().split(',', QString::SkipEmptyParts);
+        else if (arg == "-r")
+            records = true;
+        else
+            words << arg;
+    }
+    RecordQuery query;
+    if (!query.parse( words.join(" ") )) {
+        err << "query: " << query.errorString() << endl
+            << "fields: " << RecordQuery::fieldNames().join(" ") << endl;
+        return 1;
+    }
+    QList <QueryColumn> columnList;
+    for (int i = 0; i < fields.size(); i++) {
+        QueryColumn column;
+        if (!findColumn( fields[i].trimmed(), column )) {
+            err << "query: there is no field \"" << fields[i] << "\"" << endl;
+            return 1;
+        }
+        columnList << column;
+    }
+
+    SummaryIndex index(indexPath, archivePath);
+    QElapsedTimer timer;
+    timer.start();
+    if (index.isStale()) {
+        if (!index.rebuild()) {
+            err << "query: " << index.errorString() << endl;
+            return 2;
+        }
+        err << "query: rebuilt " << indexPath << " from " << archivePath << " in "
+            << timer.elapsed() << " ms" << endl;
+        timer.restart();
+    }
+    SummaryColumns columns;
+    if (!index.columns( columns )) {
+        err << "query: " << index.errorString() << endl;
+        return 2;
+    }
+    qint64 loaded = timer.restart();
+    QVector <int> matches = query.matches( columns );
+    qint64 queried = timer.elapsed();
+
+    if (records) {
+        // one record at a time, so memory doesn't grow with the number of matches
+        BuildArchive archive(archivePath);
+        QFile file;
+        file.open(stdout, QIODevice::WriteOnly);
+        for (int i = 0; i < matches.size(); i++) {
+            QByteArray record;
+            if (archive.read(columns.control[matches[i]], record))
+                file.write(record);
+            else
+                err << "query: C" << columns.control[matches[i]] << " not in " << archivePath << endl;
+        }
+        file.close();
+    } else if (!columnList.isEmpty()) {
+        out << fields.join(",") << endl;
+        for (int i = 0; i < matches.size(); i++) {
+            QStringList cells;
+            for (int c = 0; c < columnList.size(); c++)
+                cells << columnText( columns, columnList[c], matches[i] );
+            out << cells.join(",") << '\n';
+        }
+    } else {
+        for (int i = 0; i < matches.size(); i++)
+            out << columns.control[matches[i]] << '\n';
+    }
+    // lines are flushed once at the end rather than one endl at a time
+    out.flush();
+    err << matches.size() << " of " << columns.size() << " dewars match, index read in " << loaded
+        << " ms, query in " << queried << " ms" << endl;
+    return 0;
+}
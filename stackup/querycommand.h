@@ -0,0 +1,18 @@
+#ifndef QUERYCOMMAND_H
+#define QUERYCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class QueryCommand
+{
+public:
+    QueryCommand();
+    int run( QStringList );
+
+private:
+    QString indexPath;
+    QString archivePath;
+};
+
+#endif // QUERYCOMMAND_H
@@ -0,0 +1,111 @@
+/* screencommand.cpp contains the StackupTool "screen" command, which works out the coldfilter
+ * bondline for a whole lot of parts before any of them reach the mounting station.
+ *
+ * run() reads one or more .csv files of "control, cf thickness, cs height, optical center" rows,
+ * skipping any line whose measurements aren't numbers (headers, notes), and solves every part in
+ * one Stackup::chooseBondlines() call with the dispenser settings from control/stackup.ini, or the
+ * file given with -i, and -r to try another resolution.  Each part gets a report row with the
+ * bondline, ball height, expected ICD, the window of bondlines that meets ICD and the margin to
+ * each limit; parts no bondline can save are counted on stderr.
+*/
+
+#include "screencommand.h"
+#include "stackupcalc.h"
+#include "batchcalc.h"
+
+#include <QFile>
+#include <QVector>
+#include <QTextStream>
+
+static QString number( double value ) {
+    return QString::number(value, 'f', 4);
+}
+
+ScreenCommand::ScreenCommand() :
+    settingsPath("control/stackup.ini")
+{
+}
+
+int ScreenCommand::run( QStringList args ) {
+    QTextStream err(stderr);
+    QStringList paths;
+    double resolution = -1;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-o" && !args.isEmpty())
+            outputPath = args.takeFirst();
+        else if (arg == "-i" && !args.isEmpty())
+            settingsPath = args.takeFirst();
+        else if (arg == "-r" && !args.isEmpty())
+            resolution = args.takeFirst().toDouble();
+        else
+            paths << arg;
+    }
+    Stackup::BondlineSpec spec = BatchCalc::loadBondlineSpec( settingsPath );
+    if (resolution >= 0)
+        spec.resolution = resolution;
+
+    // measurements are gathered column by column so the whole lot is solved in one call
+    QStringList controls;
+    QVector <double> cf, cs, fpa;
+    for (int i = 0; i < paths.size(); i++) {
+        QFile file(paths[i]);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            err << "screen: unable to read " << paths[i] << endl;
+            return 2;
+        }
+        while (!file.atEnd()) {
+            QStringList cells = QString(file.readLine()).split(',');
+            if (cells.size() < 4)
+                continue;
+            bool okCf, okCs, okFpa;
+            double cfValue = cells[1].trimmed().toDouble(&okCf);
+            double csValue = cells[2].trimmed().toDouble(&okCs);
+            double fpaValue = cells[3].trimmed().toDouble(&okFpa);
+            if (!okCf || !okCs || !okFpa)
+                continue;
+            controls << cells[0].trimmed();
+            cf << cfValue;
+            cs << csValue;
+            fpa << fpaValue;
+        }
+    }
+    if (controls.isEmpty()) {
+        err << "screen: no parts given" << endl;
+        return 1;
+    }
+    QVector <Stackup::BondChoice> choices(controls.size());
+    Stackup::chooseBondlines(cf.constData(), cs.constData(), fpa.constData(), controls.size(),
+                             choices.data(), spec);
+
+    QFile outFile;
+    if (outputPath.isEmpty()) {
+        outFile.open(stdout, QIODevice::WriteOnly);
+    } else {
+        outFile.setFileName(outputPath);
+        if (!outFile.open(QFile::WriteOnly|QFile::Truncate)) {
+            err << "screen: unable to open " << outputPath << ": " << outFile.errorString() << endl;
+            return 1;
+        }
+    }
+    QTextStream out(&outFile);
+    out << "control,cfThickness,csHeight,opticalCenter,bondline,ballHeight,expectedIcd,bondStatus,"
+           "windowMin,windowMax,marginMin,marginMax" << endl;
+    int red = 0;
+    for (int i = 0; i < controls.size(); i++) {
+        const Stackup::BondChoice &c = choices[i];
+        if (c.status == Stackup::Red)
+            red++;
+        QStringList cells;
+        cells << controls[i] << number(cf[i]) << number(cs[i]) << number(fpa[i])
+              << number(c.bondline) << number(c.ballHeight) << number(c.icd)
+              << Stackup::statusName(c.status) << number(c.windowMin) << number(c.windowMax)
+              << number(c.marginMin) << number(c.marginMax);
+        out << cells.join(",") << endl;
+    }
+    out.flush();
+    err << controls.size() << " parts, " << red << " with no possible bondline (dispense "
+        << number(spec.min) << " to " << number(spec.max) << " in " << number(spec.resolution)
+        << " steps)" << endl;
+    return red ? 1 : 0;
+}
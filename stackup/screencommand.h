@@ -0,0 +1,18 @@
+#ifndef SCREENCOMMAND_H
+#define SCREENCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class ScreenCommand
+{
+public:
+    ScreenCommand();
+    int run( QStringList );
+
+private:
+    QString outputPath;
+    QString settingsPath;
+};
+
+#endif // SCREENCOMMAND_H
@@ -0,0 +1,178 @@
+/* simulatecommand.cpp contains the StackupTool "simulate" command, a Monte Carlo run of the
+ * coldstack ICD to predict yield when part tolerances, gauge error or bondline variation change.
+ *
+ * run() builds a Stackup::StackupModel from the [montecarlo] section of control/stackup.ini (or
+ * -i), overridden by any options given, and the dispenser settings in [bondline].  Contributors
+ * are written "mean,sigma" for a normal or "uniform:low,high":
+ *   [montecarlo]  cs, fpa, cf, gauge (sigma), bondline (sigma)
+ * The trials are split into chunks of chunkTrials, each with its own seed, and mapped over all
+ * cores with QtConcurrent, so a given -s seed gives the same answer on any machine.
+ *
+ * The report gives the yield, how often the station finds no bondline, escapes (accepted but out
+ * of spec) and false rejects, the accepted ICD's mean and sigma, and the yield with each ICD limit
+ * moved by a few tenths of a thou.  See montecarlo.cpp for the model.
+*/
+
+#include "simulatecommand.h"
+
+#include <QMap>
+#include <QSettings>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrentMap>
+#include <qmath.h>
+
+#include "batchcalc.h"
+
+static const long long chunkTrials = 250000;
+
+Stackup::TrialCounts RunTrials::operator()( const SimulationChunk &chunk ) const {
+    Stackup::TrialCounts counts;
+    Stackup::runTrials( model, chunk.seed, chunk.trials, counts );
+    return counts;
+}
+
+SimulateCommand::SimulateCommand() :
+    settingsPath("control/stackup.ini")
+{
+}
+
+int SimulateCommand::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    long long trials = 10000000;
+    unsigned long long seed = 177;
+    // options are applied after the settings file is read, wherever they appear
+    QMap <QString, QString> overrides;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (args.isEmpty()) {
+            err << "simulate: ignoring " << arg << endl;
+        } else if (arg == "-n") {
+            trials = qMax(1LL, args.takeFirst().toLongLong());
+        } else if (arg == "-s") {
+            seed = args.takeFirst().toULongLong();
+        } else if (arg == "-j") {
+            int threads = args.takeFirst().toInt();
+            if (threads > 0)
+                QThreadPool::globalInstance()->setMaxThreadCount(threads);
+        } else if (arg == "-i") {
+            settingsPath = args.takeFirst();
+        } else if (arg == "--cs" || arg == "--fpa" || arg == "--cf" || arg == "--gauge"
+                   || arg == "--bondline") {
+            overrides.insert(arg.mid(2), args.takeFirst());
+        } else {
+            err << "simulate: ignoring " << arg << endl;
+        }
+    }
+
+    // defaults are a typical lot, run centered on target with the default dispenser
+    RunTrials runner;
+    Stackup::StackupModel &model = runner.model;
+    model.bondSpec = BatchCalc::loadBondlineSpec( settingsPath );
+    QSettings settings(settingsPath, QSettings::IniFormat);
+    settings.beginGroup("montecarlo");
+    QStringList keys = QStringList() << "cs" << "fpa" << "cf" << "gauge" << "bondline";
+    QStringList defaults = QStringList() << "5.5900,0.0020" << "0.0500,0.0010" << "0.0520,0.0010"
+                                         << "0.0002" << "0.0002";
+    for (int i = 0; i < keys.size(); i++) {
+        // QSettings reads an unquoted "a,b" as a list
+        QString text = settings.value(keys[i], defaults[i]).toStringList().join(",");
+        text = overrides.value(keys[i], text);
+        Stackup::Tolerance tolerance;
+        if (!parseTolerance(text, tolerance)) {
+            err << "simulate: " << keys[i] << " should be \"mean,sigma\" or \"uniform:low,high\", not "
+                << text << endl;
+            return 1;
+        }
+        if (keys[i] == "cs")
+            model.cs = tolerance;
+        else if (keys[i] == "fpa")
+            model.fpa = tolerance;
+        else if (keys[i] == "cf")
+            model.cf = tolerance;
+        else if (keys[i] == "gauge")
+            model.gaugeSigma = tolerance.a;
+        else
+            model.bondlineSigma = tolerance.a;
+    }
+
+    QList <SimulationChunk> chunks;
+    for (long long done = 0; done < trials; done += chunkTrials) {
+        SimulationChunk chunk;
+        chunk.trials = qMin(chunkTrials, trials - done);
+        chunk.seed = seed * 1000003ULL + chunks.size();
+        chunks << chunk;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QList <Stackup::TrialCounts> results = QtConcurrent::blockingMapped(chunks, runner);
+    qint64 runMs = timer.elapsed();
+    Stackup::TrialCounts total;
+    Stackup::clearCounts( total );
+    for (int i = 0; i < results.size(); i++)
+        Stackup::addCounts( total, results[i] );
+
+    double n = double(total.trials);
+    double mean = 0;
+    double sigma = 0;
+    if (total.accepted) {
+        double offset = total.icdSum / total.accepted;
+        mean = Stackup::icdTarget + offset;
+        sigma = qSqrt(qMax(0.0, total.icdSumSquares / total.accepted - offset * offset));
+    }
+    out << "cs:                 " << describe(model.cs) << endl
+        << "fpa:                " << describe(model.fpa) << endl
+        << "cf:                 " << describe(model.cf) << endl
+        << "gauge sigma:        " << QString::number(model.gaugeSigma, 'f', 5) << endl
+        << "bondline sigma:     " << QString::number(model.bondlineSigma, 'f', 5) << endl
+        << "dispense:           " << QString::number(model.bondSpec.min, 'f', 4) << " to "
+        << QString::number(model.bondSpec.max, 'f', 4) << " in "
+        << QString::number(model.bondSpec.resolution, 'f', 4) << " steps" << endl
+        << "trials:             " << total.trials << " in " << runMs << " ms on "
+        << QThreadPool::globalInstance()->maxThreadCount() << " threads" << endl
+        << "yield:              " << QString::number(100 * total.inSpec / n, 'f', 2) << "%" << endl
+        << "no bondline:        " << QString::number(100 * (total.trials - total.accepted) / n, 'f', 2) << "%" << endl
+        << "escapes:            " << QString::number(100 * total.escapes / n, 'f', 2) << "%" << endl
+        << "false rejects:      " << QString::number(100 * total.falseRejects / n, 'f', 2) << "%" << endl
+        << "accepted ICD:       " << QString::number(mean, 'f', 5) << " mean, "
+        << QString::number(sigma, 'f', 5) << " sigma" << endl
+        << endl
+        << "limit shift   yield, icdMin moved   yield, icdMax moved" << endl;
+    double shifts[] = { -0.0004, -0.0002, -0.0001, 0, 0.0001, 0.0002, 0.0004 };
+    for (unsigned i = 0; i < sizeof(shifts) / sizeof(shifts[0]); i++) {
+        double low = Stackup::yieldWithLimits(total, Stackup::icdMin + shifts[i], Stackup::icdMax);
+        double high = Stackup::yieldWithLimits(total, Stackup::icdMin, Stackup::icdMax + shifts[i]);
+        out << QString("%1   %2%   %3%").arg(shifts[i], 11, 'f', 4).arg(100 * low, 18, 'f', 2)
+               .arg(100 * high, 18, 'f', 2) << endl;
+    }
+    return 0;
+}
+
+bool SimulateCommand::parseTolerance( const QString &text, Stackup::Tolerance &tolerance ) {
+    QString values = text.trimmed();
+    tolerance.shape = Stackup::Normal;
+    if (values.startsWith("uniform:")) {
+        tolerance.shape = Stackup::Uniform;
+        values = values.mid(8);
+    } else if (values.startsWith("normal:")) {
+        values = values.mid(7);
+    }
+    QStringList parts = values.split(',');
+    if (parts.size() > 2)
+        return false;
+    bool ok;
+    tolerance.a = parts[0].toDouble(&ok);
+    // a lone number is a sigma (gauge, bondline) or a part with no variation
+    tolerance.b = 0;
+    if (ok && parts.size() == 2)
+        tolerance.b = parts[1].toDouble(&ok);
+    return ok;
+}
+
+QString SimulateCommand::describe( const Stackup::Tolerance &t ) {
+    if (t.shape == Stackup::Uniform)
+        return QString("uniform %1 to %2").arg(t.a, 0, 'f', 4).arg(t.b, 0, 'f', 4);
+    return QString("%1 mean, %2 sigma").arg(t.a, 0, 'f', 4).arg(t.b, 0, 'f', 5);
+}
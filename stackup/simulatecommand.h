@@ -0,0 +1,34 @@
+#ifndef SIMULATECOMMAND_H
+#define SIMULATECOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+#include "montecarlo.h"
+
+// one run of trials, produced on a worker thread by SimulateCommand
+struct SimulationChunk {
+    long long trials;
+    unsigned long long seed;
+};
+
+// QtConcurrent functor: runs one chunk of the model's trials
+struct RunTrials {
+    typedef Stackup::TrialCounts result_type;
+    Stackup::StackupModel model;
+    Stackup::TrialCounts operator()( const SimulationChunk & ) const;
+};
+
+class SimulateCommand
+{
+public:
+    SimulateCommand();
+    int run( QStringList );
+
+private:
+    QString settingsPath;
+    static bool parseTolerance( const QString &, Stackup::Tolerance & );
+    static QString describe( const Stackup::Tolerance & );
+};
+
+#endif // SIMULATECOMMAND_H
@@ -0,0 +1,95 @@
+/* spccommand.cpp contains the StackupTool "spc" command, which prints the running process
+ * statistics the calculators keep in control/spc.dat (-s for another file): count, mean, sigma,
+ * Cpk and red/yellow/green counts for each characteristic.  See SpcStats.
+ *
+ * --rebuild starts the statistics over from every record in the archive (-a), for a new stats
+ * file or after records were imported with "import", which doesn't update them.
+*/
+
+#include "spccommand.h"
+#include "spcstats.h"
+#include "buildarchive.h"
+#include "buildrecordio.h"
+#include "recordparser.h"
+
+#include <QTextStream>
+#include <qnumeric.h>
+
+static QString number( double value, int decimals ) {
+    return qIsNaN(value) ? QString("-") : QString::number(value, 'f', decimals);
+}
+
+SpcCommand::SpcCommand() :
+    statsPath("control/spc.dat"),
+    archivePath("control/archive.dat")
+{
+}
+
+int SpcCommand::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    bool rebuild = false;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-s" && !args.isEmpty())
+            statsPath = args.takeFirst();
+        else if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "--rebuild")
+            rebuild = true;
+        else
+            err << "spc: ignoring " << arg << endl;
+    }
+    if (rebuild && rebuildStats( ) != 0)
+        return 2;
+
+    SpcStats stats(statsPath);
+    QList <SpcSummary> list = stats.summaries();
+    if (!stats.errorString().isEmpty()) {
+        err << "spc: " << stats.errorString() << endl;
+        return 2;
+    }
+    out << QString("%1%2%3%4%5%6%7%8%9")
+           .arg("characteristic", -26).arg("limits", -18).arg("n", 8).arg("mean", 10)
+           .arg("sigma", 9).arg("cpk", 7).arg("red", 8).arg("yellow", 8).arg("green", 8)
+        << endl;
+    for (int i = 0; i < list.size(); i++) {
+        const SpcSummary &s = list[i];
+        QString limits = (qIsNaN(s.lower) ? QString("<= ") : number(s.lower, 4) + "-")
+                + number(s.upper, 4);
+        out << QString("%1%2%3%4%5%6%7%8%9")
+               .arg(s.name, -26).arg(limits, -18).arg(s.count, 8).arg(number(s.mean, 4), 10)
+               .arg(number(s.sigma, 5), 9).arg(number(s.cpk, 2), 7)
+               .arg(s.red, 8).arg(s.yellow, 8).arg(s.green, 8)
+            << endl;
+    }
+    return 0;
+}
+
+int SpcCommand::rebuildStats( ) {
+    QTextStream err(stderr);
+    BuildArchive archive(archivePath);
+    if (!archive.map()) {
+        err << "spc: unable to open " << archivePath << ": " << archive.errorString() << endl;
+        return 1;
+    }
+    QStringList controls = archive.controls();
+    QList <BuildRecord> records;
+    BuildRecord record;
+    for (int i = 0; i < controls.size(); i++) {
+        QByteArray bytes;
+        if (!archive.read(controls[i], bytes))
+            continue;
+        RecordParser parser(bytes.constData(), bytes.size());
+        if (BuildRecordIO::load( parser, record ))
+            records << record;
+    }
+    archive.unmap();
+    SpcStats stats(statsPath);
+    if (!stats.rebuild( records )) {
+        err << "spc: " << stats.errorString() << endl;
+        return 1;
+    }
+    err << records.size() << " records counted into " << statsPath << endl;
+    return 0;
+}
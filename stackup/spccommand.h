@@ -0,0 +1,19 @@
+#ifndef SPCCOMMAND_H
+#define SPCCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class SpcCommand
+{
+public:
+    SpcCommand();
+    int run( QStringList );
+
+private:
+    QString statsPath;
+    QString archivePath;
+    int rebuildStats( );
+};
+
+#endif // SPCCOMMAND_H
@@ -0,0 +1,45 @@
+#ifndef SPCSTATS_H
+#define SPCSTATS_H
+
+#include <QString>
+#include <QList>
+#include <QByteArray>
+
+#include "buildrecord.h"
+
+// one characteristic's running statistics, as read back from SpcStats
+struct SpcSummary {
+    QString name;
+    double lower;               // NaN when the characteristic only has an upper limit
+    double upper;
+    qint64 count;
+    double mean;
+    double sigma;               // sample standard deviation
+    double cpk;                 // NaN until there are two values with some spread
+    qint64 red;
+    qint64 yellow;
+    qint64 green;
+};
+
+// SpcStats keeps running process statistics for every saved build, see spcstats.cpp
+class SpcStats
+{
+public:
+    enum Characteristic { Angle, Center, CsIcd, CsParallel, CfExpectedIcd, CfIcd, CfParallel,
+                          CharacteristicCount };
+    explicit SpcStats( const QString &path );
+    bool update( const QByteArray &previous, const BuildRecord &record );
+    bool rebuild( const QList <BuildRecord> &records );
+    QList <SpcSummary> summaries() const;
+    QString path() const;
+    QString errorString() const;
+
+private:
+    QString statsPath;
+    mutable QString lastError;
+    static void values( const BuildRecord &, double * );
+    bool lock();
+    void unlock();
+};
+
+#endif // SPCSTATS_H
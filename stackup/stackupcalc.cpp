@@ -0,0 +1,288 @@
+/* stackupcalc.cpp contains the Qt-free stackup math shared by the calculators and StackupTool.
+ *
+ * fpaAngle() and opticalCenter() are the motherboard mount formulas from MountMB::calculateData().
+ *
+ * averageHeight() and parallelism() reduce plateau (coldshield) or fiducial (coldfilter) heights to
+ * an average height and a max - min parallelism.
+ *
+ * coldshieldIcd() is the expected ICD from MountCS::calculateData().
+ *
+ * chooseBondline() is the bondline solver behind MountCF::calculateData1().  The ICD is linear in
+ * the bondline, so the window of bondlines that meets icdMin..icdMax and the bondline that hits
+ * icdTarget come straight from the part's heights.  That ideal bondline is clamped to what the
+ * dispenser can lay down and rounded to its resolution, ties going to the thinner bondline, which
+ * picks the same bondline the old search over 0.0010..0.0030 did.  The margin to each ICD limit
+ * is reported with it.  chooseBondlines() does the same for whole arrays of parts, e.g. a lot
+ * screened before kitting, two parts at a time in SSE2 registers where the compiler has them.
+ *
+ * coldfilterIcd() is the final ICD from MountCF::calculateData2().
+ *
+ * evaluateBuild() runs every step present in a BuildInputs and is what the batch CLI calls per record.
+ *
+ * the *Status() functions hold the red/yellow/green rules used to color-code the output labels.
+*/
+
+#include "stackupcalc.h"
+
+#include <cmath>
+#include <algorithm>
+
+// every x86 compiler the tools are built with has SSE2, VC++ 2008 included
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define STACKUP_SSE2
+#endif
+
+namespace Stackup {
+
+static const double pi = 3.14159265358979323846;
+
+double fpaAngle( double y1, double z1, double y2, double z2 ) {
+    return atan( (z2 - z1) / (y2 - y1) ) * ( 180 / pi );
+}
+
+double opticalCenter( double z1, double z2 ) {
+    return ( (z1 - z2) / 2 ) + z2;
+}
+
+Status angleStatus( double angle ) {
+    if (angle > angleMax || angle < angleMin)
+        return Red;
+    return Green;
+}
+
+Status centerStatus( double center ) {
+    if (center > centerMax || center < centerMin)
+        return Red;
+    return Green;
+}
+
+double averageHeight( const double *heights, int count ) {
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += fabs(heights[i]);
+    return sum / count;
+}
+
+double parallelism( const double *heights, int count ) {
+    double low = heights[0];
+    double high = heights[0];
+    for (int i = 1; i < count; i++) {
+        low = std::min(low, heights[i]);
+        high = std::max(high, heights[i]);
+    }
+    return fabs( high - low );
+}
+
+Status parallelStatus( double parallel, double limit ) {
+    if (parallel > limit)
+        return Red;
+    return Green;
+}
+
+double coldshieldIcd( double cs, double fpa, double cf, double bl ) {
+    return fabs(cs) - fabs(fpa) + fabs(cf) + fabs(bl);
+}
+
+Status icdStatus( double icd ) {
+    if (icd > icdMax || icd < icdMin)
+        return Red;
+    return Green;
+}
+
+static double snapMicroinch( double value ) {
+    // grid bondlines are sums of steps, snap them so 0.0010 + 0.0005 compares equal to 0.0015
+    return floor(value * 1e6 + 0.5) / 1e6;
+}
+
+static void finishChoice( BondChoice &choice, double base, double fpa ) {
+    choice.icd = base + fabs(choice.bondline);
+    choice.ballHeight = choice.icd + fabs(fpa);
+    choice.marginMin = choice.icd - icdMin;
+    choice.marginMax = icdMax - choice.icd;
+    if (choice.icd > icdMax || choice.icd < icdMin)
+        choice.status = Red;
+    else if (choice.icd == icdMax || choice.icd == icdMin)
+        choice.status = Yellow;
+    else
+        choice.status = Green;
+}
+
+#ifdef STACKUP_SSE2
+// std::max(a, b) is a < b ? b : a, which _mm_max_pd(b, a) matches for equal values and NaN too,
+// so the SSE2 path agrees with chooseBondline() bit for bit
+static inline __m128d maxOf( __m128d a, __m128d b ) { return _mm_max_pd(b, a); }
+static inline __m128d minOf( __m128d a, __m128d b ) { return _mm_min_pd(b, a); }
+static inline __m128d absOf( __m128d a ) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+
+// SSE2 has no floor() or ceil(), so truncate to int and back and step past the value when needed.
+// no part ever measured is a billion dispenser steps from anything, so int range is plenty
+static inline __m128d truncOf( __m128d a ) {
+    a = minOf(maxOf(a, _mm_set1_pd(-1e9)), _mm_set1_pd(1e9));
+    return _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+}
+static inline __m128d floorOf( __m128d a ) {
+    __m128d t = truncOf(a);
+    return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, a), _mm_set1_pd(1.0)));
+}
+static inline __m128d ceilOf( __m128d a ) {
+    __m128d t = truncOf(a);
+    return _mm_add_pd(t, _mm_and_pd(_mm_cmplt_pd(t, a), _mm_set1_pd(1.0)));
+}
+#endif
+
+BondChoice chooseBondline( double cf, double cs, double fpa, const BondlineSpec &spec ) {
+    BondChoice choice;
+    double base = fabs(cf) + fabs(cs) - fabs(fpa);
+    choice.windowMin = icdMin - base;
+    choice.windowMax = icdMax - base;
+    double ideal = std::min(std::max(icdTarget - base, spec.min), spec.max);
+    if (spec.resolution > 0) {
+        int steps = int(floor((spec.max - spec.min) / spec.resolution + 1e-9));
+        // round half down, so ties go to the thinner bondline
+        int step = int(ceil((ideal - spec.min) / spec.resolution - 0.5));
+        // a step narrower than the window always has a grid bondline inside it when any fits,
+        // but a coarse dispenser may round past the window when a neighbor would have met it
+        int low = int(ceil((choice.windowMin - spec.min) / spec.resolution - 1e-9));
+        int high = int(floor((choice.windowMax - spec.min) / spec.resolution + 1e-9));
+        if (low <= high)
+            step = std::min(std::max(step, low), high);
+        step = std::min(std::max(step, 0), steps);
+        choice.bondline = snapMicroinch(spec.min + step * spec.resolution);
+    } else {
+        choice.bondline = ideal;
+    }
+    finishChoice(choice, base, fpa);
+    return choice;
+}
+
+void chooseBondlines( const double *cf, const double *cs, const double *fpa, int count,
+                      BondChoice *choices, const BondlineSpec &spec ) {
+    int i = 0;
+#ifdef STACKUP_SSE2
+    // chooseBondline() two parts at a time, with masks in place of its branches
+    const __m128d min = _mm_set1_pd(spec.min);
+    const __m128d max = _mm_set1_pd(spec.max);
+    const __m128d resolution = _mm_set1_pd(spec.resolution);
+    const __m128d steps = _mm_set1_pd(spec.resolution > 0
+                                      ? floor((spec.max - spec.min) / spec.resolution + 1e-9) : 0);
+    const __m128d target = _mm_set1_pd(icdTarget);
+    const __m128d limitMin = _mm_set1_pd(icdMin);
+    const __m128d limitMax = _mm_set1_pd(icdMax);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d slack = _mm_set1_pd(1e-9);
+    const __m128d micro = _mm_set1_pd(1e6);
+    for ( ; i + 1 < count; i += 2) {
+        __m128d base = _mm_add_pd(absOf(_mm_loadu_pd(cf + i)), absOf(_mm_loadu_pd(cs + i)));
+        base = _mm_sub_pd(base, absOf(_mm_loadu_pd(fpa + i)));
+        __m128d windowMin = _mm_sub_pd(limitMin, base);
+        __m128d windowMax = _mm_sub_pd(limitMax, base);
+        __m128d bondline = minOf(maxOf(_mm_sub_pd(target, base), min), max);
+        if (spec.resolution > 0) {
+            __m128d step = _mm_div_pd(_mm_sub_pd(bondline, min), resolution);
+            __m128d low = _mm_div_pd(_mm_sub_pd(windowMin, min), resolution);
+            __m128d high = _mm_div_pd(_mm_sub_pd(windowMax, min), resolution);
+            step = ceilOf(_mm_sub_pd(step, half));
+            low = ceilOf(_mm_sub_pd(low, slack));
+            high = floorOf(_mm_add_pd(high, slack));
+            // low <= high picks the step held to the window, otherwise the rounded one stays
+            __m128d fits = _mm_cmple_pd(low, high);
+            __m128d fitted = minOf(maxOf(step, low), high);
+            step = _mm_or_pd(_mm_and_pd(fits, fitted), _mm_andnot_pd(fits, step));
+            step = minOf(maxOf(step, _mm_setzero_pd()), steps);
+            __m128d grid = _mm_add_pd(min, _mm_mul_pd(step, resolution));
+            bondline = _mm_div_pd(floorOf(_mm_add_pd(_mm_mul_pd(grid, micro), half)), micro);
+        }
+        double lanes[4][2];
+        _mm_storeu_pd(lanes[0], windowMin);
+        _mm_storeu_pd(lanes[1], windowMax);
+        _mm_storeu_pd(lanes[2], bondline);
+        _mm_storeu_pd(lanes[3], base);
+        for (int k = 0; k < 2; k++) {
+            BondChoice &choice = choices[i + k];
+            choice.windowMin = lanes[0][k];
+            choice.windowMax = lanes[1][k];
+            choice.bondline = lanes[2][k];
+            finishChoice(choice, lanes[3][k], fpa[i + k]);
+        }
+    }
+#endif
+    for ( ; i < count; i++)
+        choices[i] = chooseBondline(cf[i], cs[i], fpa[i], spec);
+}
+
+double coldfilterIcd( double cf, double fpa ) {
+    return fabs(cf) - fabs(fpa);
+}
+
+void clearInputs( BuildInputs &in ) {
+    in.hasMotherboard = false;
+    in.sca1y = in.sca1z = in.sca2y = in.sca2z = 0;
+    in.hasColdshield = false;
+    in.hasPlateaus = false;
+    for (int i = 0; i < 4; i++)
+        in.plateaus[i] = 0;
+    in.csHeight = in.csCf = in.csFpa = in.csBondline = 0;
+    in.hasColdfilter1 = false;
+    in.bondSpec = defaultBondlineSpec;
+    in.cf1Thickness = in.cf1Cs = in.cf1Fpa = 0;
+    in.hasColdfilter2 = false;
+    in.hasFiducials = false;
+    for (int i = 0; i < 3; i++)
+        in.fiducials[i] = 0;
+    in.cf2Height = in.cf2Fpa = 0;
+}
+
+void evaluateBuild( const BuildInputs &in, BuildResults &out ) {
+    out.angle = out.center = 0;
+    out.angleStatus = out.centerStatus = NotCalculated;
+    out.csHeight = out.csParallel = out.csIcd = 0;
+    out.csParallelStatus = out.csIcdStatus = NotCalculated;
+    out.bond.bondline = out.bond.ballHeight = out.bond.icd = 0;
+    out.bond.windowMin = out.bond.windowMax = out.bond.marginMin = out.bond.marginMax = 0;
+    out.bond.status = NotCalculated;
+    out.cfHeight = out.cfParallel = out.cfIcd = 0;
+    out.cfParallelStatus = out.cfIcdStatus = NotCalculated;
+
+    if (in.hasMotherboard) {
+        out.angle = fpaAngle(in.sca1y, in.sca1z, in.sca2y, in.sca2z);
+        out.center = opticalCenter(in.sca1z, in.sca2z);
+        out.angleStatus = angleStatus(out.angle);
+        out.centerStatus = centerStatus(out.center);
+    }
+    if (in.hasColdshield) {
+        // coldshield height is either typed in or averaged from the (4) plateau heights
+        out.csHeight = in.csHeight;
+        if (in.hasPlateaus) {
+            out.csHeight = averageHeight(in.plateaus, 4);
+            out.csParallel = parallelism(in.plateaus, 4);
+            out.csParallelStatus = parallelStatus(out.csParallel, csParallelMax);
+        }
+        out.csIcd = coldshieldIcd(out.csHeight, in.csFpa, in.csCf, in.csBondline);
+        out.csIcdStatus = icdStatus(out.csIcd);
+    }
+    if (in.hasColdfilter1)
+        out.bond = chooseBondline(in.cf1Thickness, in.cf1Cs, in.cf1Fpa, in.bondSpec);
+    if (in.hasColdfilter2) {
+        // coldfilter height is either typed in or averaged from the (3) fiducial heights
+        out.cfHeight = in.cf2Height;
+        if (in.hasFiducials) {
+            out.cfHeight = averageHeight(in.fiducials, 3);
+            out.cfParallel = parallelism(in.fiducials, 3);
+            out.cfParallelStatus = parallelStatus(out.cfParallel, cfParallelMax);
+        }
+        out.cfIcd = coldfilterIcd(out.cfHeight, in.cf2Fpa);
+        out.cfIcdStatus = icdStatus(out.cfIcd);
+    }
+}
+
+const char *statusName( Status status ) {
+    switch (status) {
+    case Red:       return "red";
+    case Yellow:    return "yellow";
+    case Green:     return "green";
+    default:        return "";
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+/* summarycommand.cpp contains the StackupTool "summary" command, which lists every dewar in the
+ * summary index, control/summary.dat (-x for another file): serial, the steps saved so far, the
+ * key outputs and when each was last saved.  See SummaryIndex.
+ *
+ * --waiting lists only the dewars waiting at one mount: motherboard, coldshield, coldfilter1 or
+ * coldfilter2.  An index that is missing or out of step with the archive (-a) is rebuilt first;
+ * --rebuild forces that.
+*/
+
+#include "summarycommand.h"
+#include "summaryindex.h"
+#include "buildrecordio.h"
+
+#include <QTextStream>
+#include <QElapsedTimer>
+
+static QString number( double value ) {
+    return BuildRecordIO::isSet(value) ? QString::number(value, 'f', 4) : QString();
+}
+
+static QString stepNames( int steps ) {
+    QStringList names;
+    if (steps & SummaryIndex::MotherboardStep)
+        names << "motherboard";
+    if (steps & SummaryIndex::ColdshieldStep)
+        names << "coldshield";
+    if (steps & SummaryIndex::Coldfilter1Step)
+        names << "coldfilter1";
+    if (steps & SummaryIndex::Coldfilter2Step)
+        names << "coldfilter2";
+    return names.join(" ");
+}
+
+SummaryCommand::SummaryCommand() :
+    indexPath("control/summary.dat"),
+    archivePath("control/archive.dat")
+{
+}
+
+int SummaryCommand::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    bool rebuild = false;
+    int waiting = 0;
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "-x" && !args.isEmpty())
+            indexPath = args.takeFirst();
+        else if (arg == "-a" && !args.isEmpty())
+            archivePath = args.takeFirst();
+        else if (arg == "--rebuild")
+            rebuild = true;
+        else if (arg == "--waiting" && !args.isEmpty()) {
+            QString step = args.takeFirst();
+            waiting = step == "motherboard" ? SummaryIndex::MotherboardStep
+                    : step == "coldshield" ? SummaryIndex::ColdshieldStep
+                    : step == "coldfilter1" ? SummaryIndex::Coldfilter1Step
+                    : step == "coldfilter2" ? SummaryIndex::Coldfilter2Step : 0;
+            if (!waiting) {
+                err << "summary: unknown step " << step << endl;
+                return 1;
+            }
+        }
+        else
+            err << "summary: ignoring " << arg << endl;
+    }
+
+    SummaryIndex index(indexPath, archivePath);
+    if (rebuild || index.isStale()) {
+        QElapsedTimer timer;
+        timer.start();
+        if (!index.rebuild()) {
+            err << "summary: " << index.errorString() << endl;
+            return 2;
+        }
+        err << "summary: rebuilt " << indexPath << " from " << archivePath << " in "
+            << timer.elapsed() << " ms" << endl;
+    }
+    QList <SummaryEntry> list = waiting ? index.waitingFor( SummaryIndex::Step(waiting) )
+                                        : index.entries();
+    if (!index.errorString().isEmpty()) {
+        err << "summary: " << index.errorString() << endl;
+        return 2;
+    }
+    out << "control,serial,steps,fpaAngle,opticalCenter,coldshieldHeight,csExpectedIcd,"
+           "cfExpectedIcd,finalIcd,saved" << endl;
+    for (int i = 0; i < list.size(); i++) {
+        const SummaryEntry &e = list[i];
+        QStringList cells;
+        cells << e.control << e.serial << stepNames(e.steps) << number(e.fpaAngle)
+              << number(e.opticalCenter) << number(e.coldshieldHeight) << number(e.csExpectedIcd)
+              << number(e.cfExpectedIcd) << number(e.finalIcd)
+              << (e.saved.isValid() ? e.saved.toString(Qt::ISODate) : QString());
+        out << cells.join(",") << endl;
+    }
+    return 0;
+}
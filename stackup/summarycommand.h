@@ -0,0 +1,18 @@
+#ifndef SUMMARYCOMMAND_H
+#define SUMMARYCOMMAND_H
+
+#include <QString>
+#include <QStringList>
+
+class SummaryCommand
+{
+public:
+    SummaryCommand();
+    int run( QStringList );
+
+private:
+    QString indexPath;
+    QString archivePath;
+};
+
+#endif // SUMMARYCOMMAND_H
@@ -0,0 +1,124 @@
+/* tracecompare.cpp contains the StackupTool "trace-compare" command, which puts two sets of
+ * calculator startup traces side by side, e.g. a build before and after a startup change:
+ *
+ *   ColdfilterMount --trace-startup before.json      (old build)
+ *   ColdfilterMount --trace-startup after.json       (new build)
+ *   StackupTool trace-compare before.json after.json
+ *
+ * Each side may be a comma separated list of traces from repeated launches, which are averaged.
+ * It prints every step's time before and after, the time from launch to the first paint and the
+ * resident memory after it, see StartupTrace.
+ *
+ * load() reads the files StartupTrace writes, one event per line, so it needs no JSON parser.
+*/
+
+#include "tracecompare.h"
+
+#include <QFile>
+#include <QRegExp>
+#include <QTextStream>
+
+static QString cell( double value, bool present ) {
+    return (present ? QString::number(value, 'f', 1) : QString("-")).rightJustified(11);
+}
+
+TraceCompare::TraceCompare()
+{
+}
+
+int TraceCompare::run( QStringList args ) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (args.size() != 2) {
+        err << "trace-compare: give the before and after traces, e.g. before.json after.json" << endl;
+        return 1;
+    }
+    StartupProfile before;
+    StartupProfile after;
+    QString error;
+    if (!load(args[0].split(","), before, error) || !load(args[1].split(","), after, error)) {
+        err << "trace-compare: " << error << endl;
+        return 1;
+    }
+    QStringList steps = before.order;
+    for (int i = 0; i < after.order.size(); i++) {
+        if (!steps.contains(after.order[i]))
+            steps << after.order[i];
+    }
+    out << QString("step").leftJustified(40) << QString("before ms").rightJustified(11)
+        << QString("after ms").rightJustified(11) << QString("change").rightJustified(11) << endl;
+    for (int i = 0; i < steps.size(); i++) {
+        bool inBefore = before.spanMs.contains(steps[i]);
+        bool inAfter = after.spanMs.contains(steps[i]);
+        double b = before.spanMs.value(steps[i]);
+        double a = after.spanMs.value(steps[i]);
+        out << steps[i].leftJustified(40) << cell(b, inBefore) << cell(a, inAfter)
+            << cell(a - b, inBefore && inAfter) << endl;
+    }
+    out << endl
+        << QString("launch to first paint, ms").leftJustified(40) << cell(before.launchMs, true)
+        << cell(after.launchMs, true) << cell(after.launchMs - before.launchMs, true) << endl
+        << QString("resident after first paint, MB").leftJustified(40)
+        << cell(before.residentMb, before.residentMb > 0) << cell(after.residentMb, after.residentMb > 0)
+        << cell(after.residentMb - before.residentMb, before.residentMb > 0 && after.residentMb > 0) << endl
+        << before.runs << " runs before, " << after.runs << " after" << endl;
+    return 0;
+}
+
+bool TraceCompare::load( const QStringList &paths, StartupProfile &profile, QString &error ) {
+    profile.runs = 0;
+    profile.order.clear();
+    profile.spanMs.clear();
+    profile.launchMs = 0;
+    profile.residentMb = 0;
+    QRegExp name("\"name\":\"([^\"]*)\"");
+    QRegExp phase("\"ph\":\"(\\w)\"");
+    QRegExp start("\"ts\":(\\d+)");
+    QRegExp duration("\"dur\":(\\d+)");
+    QRegExp resident("\"MB\":([0-9.]+)");
+    for (int i = 0; i < paths.size(); i++) {
+        QFile file(paths[i]);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            error = "unable to read " + paths[i] + ": " + file.errorString();
+            return false;
+        }
+        // steps in the order they started, which is not the order they were written
+        QMap <qint64, QString> started;
+        qint64 launch = 0;
+        qint64 lastSample = -1;
+        double lastMb = 0;
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine());
+            if (phase.indexIn(line) < 0 || start.indexIn(line) < 0)
+                continue;
+            qint64 ts = start.cap(1).toLongLong();
+            if (phase.cap(1) == "X" && name.indexIn(line) >= 0 && duration.indexIn(line) >= 0) {
+                qint64 dur = duration.cap(1).toLongLong();
+                profile.spanMs[name.cap(1)] += dur / 1000.0;
+                started.insertMulti(ts, name.cap(1));
+                launch = qMax(launch, ts + dur);
+            } else if (phase.cap(1) == "C" && resident.indexIn(line) >= 0 && ts >= lastSample) {
+                lastSample = ts;
+                lastMb = resident.cap(1).toDouble();
+            }
+        }
+        if (started.isEmpty()) {
+            error = paths[i] + " has no startup steps, was it written by --trace-startup?";
+            return false;
+        }
+        QList <QString> names = started.values();
+        for (int j = 0; j < names.size(); j++) {
+            if (!profile.order.contains(names[j]))
+                profile.order << names[j];
+        }
+        profile.launchMs += launch / 1000.0;
+        profile.residentMb += lastMb;
+        profile.runs++;
+    }
+    QMap <QString, double>::iterator it;
+    for (it = profile.spanMs.begin(); it != profile.spanMs.end(); ++it)
+        it.value() /= profile.runs;
+    profile.launchMs /= profile.runs;
+    profile.residentMb /= profile.runs;
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef TRACECOMPARE_H
+#define TRACECOMPARE_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+
+// one or more --trace-startup files, spans averaged over the runs
+struct StartupProfile {
+    int runs;
+    QStringList order;
+    QMap <QString, double> spanMs;
+    double launchMs;
+    double residentMb;
+};
+
+class TraceCompare
+{
+public:
+    TraceCompare();
+    int run( QStringList );
+    static bool load( const QStringList &paths, StartupProfile &profile, QString &error );
+};
+
+#endif // TRACECOMPARE_H